@@ -398,3 +398,123 @@ void delay_kalman (unsigned long usec) {
 }
 #endif // Kalman
 #endif
+
+/* -------------------------------------------------------------------
+ * Hybrid sleep then spin pacer
+ *
+ * o clock_nanosleep() wakes late by the timer slack plus the scheduler
+ *   latency, typically tens of microseconds. Sleeping all the way to
+ *   the deadline makes every send late by that amount.
+ * o Busy looping is exact but burns a core even for millisecond waits.
+ * o So sleep to a margin before the deadline and spin the remainder.
+ *   The margin tracks the measured wake error of the sleeps (smoothed
+ *   mean plus four mean absolute deviations) so it shrinks on quiet
+ *   systems and grows on busy ones.
+ * o Waits shorter than the margin only spin.
+ * ------------------------------------------------------------------- */
+#if defined(HAVE_CLOCK_GETTIME) && defined(HAVE_CLOCK_NANOSLEEP) && defined(TIMER_ABSTIME) && !defined(WIN32)
+#define HAVE_DELAY_PACER 1
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PACER_CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define PACER_CPU_RELAX() __asm__ __volatile__("yield")
+#else
+#define PACER_CPU_RELAX()
+#endif
+
+#define PACER_GAIN (1.0 / 16.0)
+
+void delay_pacer_init (struct delay_pacer *pacer) {
+    memset(pacer, 0, sizeof(struct delay_pacer));
+    pacer->margin = PACER_MARGIN_INIT;
+    pacer->oversleep = PACER_MARGIN_INIT / 2.0;
+    pacer->deviation = PACER_MARGIN_INIT / 8.0;
+}
+
+#ifdef HAVE_DELAY_PACER
+// signed difference tv1 - tv0 in nanoseconds
+static inline double pacer_diff (const struct timespec *tv1, const struct timespec *tv0) {
+    return ((double) (tv1->tv_sec - tv0->tv_sec) * BILLION) + (double) (tv1->tv_nsec - tv0->tv_nsec);
+}
+
+static void pacer_calibrate (struct delay_pacer *pacer, double err) {
+    double dev = fabs(err - pacer->oversleep);
+    pacer->oversleep += PACER_GAIN * (err - pacer->oversleep);
+    pacer->deviation += PACER_GAIN * (dev - pacer->deviation);
+    double margin = pacer->oversleep + (4.0 * pacer->deviation);
+    if (margin < PACER_MARGIN_MIN)
+	margin = PACER_MARGIN_MIN;
+    else if (margin > PACER_MARGIN_MAX)
+	margin = PACER_MARGIN_MAX;
+    pacer->margin = margin;
+}
+
+static int pacer_wait (struct delay_pacer *pacer, clockid_t clock, const struct timespec *deadline) {
+    struct timespec now;
+    int rc = 0;
+    clock_gettime(clock, &now);
+    double remaining = pacer_diff(deadline, &now);
+    if (remaining <= 0)
+	return 0;
+    if (remaining > pacer->margin) {
+	struct timespec wake = *deadline;
+	long margin = (long) pacer->margin;
+	wake.tv_nsec -= margin;
+	while (wake.tv_nsec < 0) {
+	    wake.tv_nsec += BILLION;
+	    wake.tv_sec--;
+	}
+	rc = clock_nanosleep(clock, TIMER_ABSTIME, &wake, NULL);
+	clock_gettime(clock, &now);
+	pacer->sleeps++;
+	// an interrupted sleep says nothing about the wake error
+	if (!rc) {
+	    pacer_calibrate(pacer, pacer_diff(&now, &wake));
+	}
+	if (pacer_diff(&now, deadline) >= 0) {
+	    pacer->late++;
+	    return rc;
+	}
+    } else {
+	pacer->spins++;
+    }
+    while (pacer_diff(deadline, &now) > 0) {
+	PACER_CPU_RELAX();
+	clock_gettime(clock, &now);
+    }
+    return rc;
+}
+#endif
+
+// Relative delay in nanoseconds
+void delay_pacer (struct delay_pacer *pacer, double nsecs) {
+    if (nsecs <= 0)
+	return;
+#ifdef HAVE_DELAY_PACER
+    struct timespec deadline;
+#if defined(CLOCK_MONOTONIC)
+    clockid_t clock = CLOCK_MONOTONIC;
+#else
+    clockid_t clock = CLOCK_REALTIME;
+#endif
+    clock_gettime(clock, &deadline);
+    timespec_add_ulong(&deadline, (unsigned long) nsecs);
+    pacer_wait(pacer, clock, &deadline);
+#else
+    delay_loop((unsigned long) (nsecs / 1000));
+#endif
+}
+
+// Absolute CLOCK_REALTIME deadline, returns the clock_nanosleep() rc
+int delay_pacer_abstime (struct delay_pacer *pacer, struct timespec *deadline) {
+#ifdef HAVE_DELAY_PACER
+    return pacer_wait(pacer, CLOCK_REALTIME, deadline);
+#else
+    struct timeval tmp;
+    tmp.tv_sec = deadline->tv_sec;
+    tmp.tv_usec = deadline->tv_nsec / 1000;
+    return clock_usleep_abstime(&tmp);
+#endif
+}
@@ -0,0 +1,136 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * fastclock.c
+ * Invariant TSC calibration and per thread re-anchoring, see fastclock.h
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "fastclock.h"
+#if HAVE_FASTCLOCK
+#include <cpuid.h>
+#endif
+
+int fastclock_enabled = 0;
+
+#if HAVE_FASTCLOCK
+__thread struct fastclock_anchor fastclock_anchor;
+uint64_t fastclock_mult = 0;
+static uint64_t fastclock_reanchor_ticks = 0;
+static double fastclock_ticks_per_ns = 0;
+
+// Sample a clock bracketed by two TSC reads and return the
+// midpoint, the tightest of a few tries wins to keep a preemption
+// or SMI out of the pair
+static uint64_t fastclock_pair (clockid_t clock, int64_t *ns) {
+    uint64_t best = UINT64_MAX, tsc = 0;
+    int ix;
+    *ns = 0;
+    for (ix = 0; ix < 5; ix++) {
+	struct timespec t1;
+	uint64_t t0 = __rdtsc();
+	clock_gettime(clock, &t1);
+	uint64_t t2 = __rdtsc();
+	if ((t2 - t0) < best) {
+	    best = t2 - t0;
+	    tsc = t0 + ((t2 - t0) / 2);
+	    *ns = ((int64_t) t1.tv_sec * 1000000000) + t1.tv_nsec;
+	}
+    }
+    return tsc;
+}
+
+void fastclock_reanchor (struct timespec *ts) {
+    int64_t ns;
+    uint64_t tsc = fastclock_pair(CLOCK_REALTIME, &ns);
+    fastclock_anchor.tsc = tsc;
+    fastclock_anchor.sec = (time_t) (ns / 1000000000);
+    fastclock_anchor.nsec = (long) (ns % 1000000000);
+    fastclock_anchor.expire = tsc + fastclock_reanchor_ticks;
+    ts->tv_sec = fastclock_anchor.sec;
+    ts->tv_nsec = fastclock_anchor.nsec;
+}
+
+// Requires the invariant TSC bit (CPUID 0x80000007 EDX[8]), i.e. a
+// constant rate that keeps counting in deep C-states
+static int fastclock_invariant (void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || (eax < 0x80000007))
+	return 0;
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return ((edx & (1 << 8)) != 0);
+}
+
+int fastclock_init (void) {
+    if (!fastclock_invariant())
+	return -1;
+    // CLOCK_MONOTONIC_RAW isn't slewed by NTP so it gives the
+    // hardware rate, CLOCK_REALTIME is only used for the anchors
+#ifdef CLOCK_MONOTONIC_RAW
+    clockid_t clock = CLOCK_MONOTONIC_RAW;
+#else
+    clockid_t clock = CLOCK_MONOTONIC;
+#endif
+    int64_t ns0 = 0, ns1 = 0;
+    uint64_t tsc0 = fastclock_pair(clock, &ns0);
+    struct timespec req = {0, FASTCLOCK_CALIBRATE_NS};
+    nanosleep(&req, NULL);
+    uint64_t tsc1 = fastclock_pair(clock, &ns1);
+    if ((tsc1 <= tsc0) || (ns1 <= ns0))
+	return -1;
+    fastclock_ticks_per_ns = (double) (tsc1 - tsc0) / (double) (ns1 - ns0);
+    fastclock_mult = (uint64_t) (((double) (1ULL << FASTCLOCK_SHIFT)) / fastclock_ticks_per_ns);
+    fastclock_reanchor_ticks = (uint64_t) (FASTCLOCK_REANCHOR_NS * fastclock_ticks_per_ns);
+    fastclock_enabled = 1;
+    return 0;
+}
+
+double fastclock_ghz (void) {
+    return fastclock_ticks_per_ns;
+}
+#else
+int fastclock_init (void) {
+    return -1;
+}
+
+double fastclock_ghz (void) {
+    return 0;
+}
+#endif
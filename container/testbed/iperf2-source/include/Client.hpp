@@ -91,6 +91,9 @@ public:
 
 private:
     inline void WritePacketID(intmax_t);
+    inline void WriteNsecTs(int64_t);
+    inline void WriteClockOffset(int64_t);
+    void ClockOffsetPoll(void);
     inline void WriteTcpTxHdr(struct ReportStruct *, int, int);
     inline void WriteTcpTxBBHdr(struct ReportStruct *, uint32_t, int);
     inline int myWrite(int inSock, const void *inBuf, int inLen);
@@ -116,8 +119,11 @@ private:
     bool one_report;
     bool apply_first_udppkt_delay;
     int udp_payload_minimum;
+    bool udp_nsects;
     void myReportPacket(void);
     void myReportPacket(struct ReportStruct *);
+    void myDelayLoop(double nsecs);
+    void myTickStats(void);
     // TCP plain
     void RunTCP(void);
     // TCP version which supports rate limiting per -b
@@ -132,6 +138,10 @@ private:
     // UDP plain
     void RunUDP(void);
     void RunUDPBurst(void);
+    // UDP with many logical flows, --udp-flows
+    void RunUDPFlows(void);
+    // UDP lengths and gaps from a capture, --pcap-replay
+    void RunUDPPcapReplay(void);
 #if HAVE_UDP_L4S
     void RunUDPL4S(void);
     int ack_poll (time_tp ack_timeout);
@@ -146,6 +156,11 @@ private:
     int mySocket;
 #endif
     struct ReporterData *myReport;
+    struct HotPathStats *hotpath;
+    struct KernelTsStats *kernelts;
+    struct ClockOffset *clkoffset;
+    int64_t clkoffset_lastpoll;
+    struct delay_pacer pacer;
     Timestamp mEndTime;
     Timestamp lastPacketTime;
     Timestamp now;
@@ -157,6 +172,7 @@ private:
     bool peerclose;
     Timestamp write_start;
     struct markov_graph *markov_graph_len;
+    struct RateSchedule *rateschedule;
 
 #if HAVE_DECL_SO_MAX_PACING_RATE
     Timestamp PacingStepTime;
@@ -479,6 +479,55 @@ extern const char report_client_bb_triptime_clocksync_error[];
 
 extern const char report_omitted[] ;
 
+extern const char report_hotpath_stats[];
+
+extern const char report_kernelts_tx_stats[];
+
+extern const char report_kernelts_rx_stats[];
+
+extern const char report_clock_offset[];
+
+extern const char report_clock_offset_none[];
+
+extern const char report_link_emul[];
+
+extern const char report_rate_schedule[];
+
+extern const char report_rate_schedule_total[];
+
+extern const char report_capacity_event[];
+
+extern const char report_capacity_summary[];
+
+extern const char report_seq_window[];
+
+extern const char report_outage[];
+
+extern const char report_loss_bursts[];
+
+extern const char report_loss_model[];
+
+extern const char report_jitter_buffer[];
+
+extern const char report_dscp_stats[];
+
+extern const char report_dscp_latency[];
+
+extern const char report_dscp_remarked[];
+
+extern const char report_udp_flows[];
+
+extern const char report_udp_flow[];
+
+extern const char report_pcap_replay[];
+extern const char report_selftest_heading[];
+extern const char report_selftest[];
+extern const char report_selftest_failed[];
+extern const char report_selftest_within[];
+extern const char warn_selftest_ceiling[];
+extern const char report_tsc_clock[];
+extern const char warn_tsc_clock[];
+
 #ifdef __cplusplus
 } /* end extern "C" */
 #endif
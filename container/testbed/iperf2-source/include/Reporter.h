@@ -59,6 +59,14 @@
 #include "packet_ring.h"
 #include "gettcpinfo.h"
 #include "payloads.h"
+#include "rate_schedule.h"
+#include "capacity_detect.h"
+#include "seq_window.h"
+#include "loss_stats.h"
+#include "jitter_buffer.h"
+#include "dscp_stats.h"
+#include "udp_flows.h"
+#include "pcap_replay.h"
 
 // forward declarations found in Settings.hpp
 struct thread_Settings;
@@ -206,6 +214,7 @@ struct ReportCommon {
     int flags;
     int flags_extend;
     int flags_extend2;
+    int flags_extend3;
     int threads;
     int working_load_threads;
     unsigned short Port;
@@ -340,6 +349,7 @@ struct ReportTimeStamps {
     double iStart;
     double iEnd;
     double significant_partial;
+    double tStart; // offset of the first sample from startTime, --profile flows share a startTime
     struct timeval startTime;
     struct timeval packetTime;
     struct timeval prevpacketTime;
@@ -373,6 +383,8 @@ struct TransferInfo {
     intmax_t cntIPG;
     intmax_t PacketID;
     double jitter;
+    int64_t jitter_ns; // RFC 3550 estimator in integer nanoseconds, scaled by 16
+    int64_t transit_ns; // last transit, units nanoseconds
     double IPGsum;
     double IPGsumcarry;
     struct ShiftCounters total; // Shift counters used to calculate interval reports and hold totals
@@ -392,6 +404,14 @@ struct TransferInfo {
     struct RunningMMMStats bbowdfro;
     struct RunningMMMStats bbasym;
     struct markov_graph *markov_graph_len;
+    struct RateSchedule *rate_schedule;
+    struct CapacityDetect *capdetect;
+    struct SeqWindow *seqwin;
+    struct LossStats *lossstats;
+    struct JitterBuffer *jitterbuf;
+    struct DSCPStats *dscpstats;
+    struct UDPFlowsRx *udpflows;
+    struct PcapReplayReport pcapreplay; // set by the client thread before its final packet
     uintmax_t bb_clocksync_error;
     struct MeanMinMaxStats schedule_error;
     struct L2Stats l2counts;
@@ -412,6 +432,8 @@ struct TransferInfo {
     double fInPVar;
     intmax_t FQPacingRateCurrent;
     int threadcnt_final;
+    struct iperf_metrics_flow *metrics; // live counters, see --metrics-port
+    struct timeval metrics_nextpct;
 };
 
 struct SumReport {
@@ -434,6 +456,7 @@ struct ReporterData {
 
     struct PacketRing *packetring;
     int reporter_thread_suspends; // used to detect CPU bound systems
+    struct HotPathStats hotpath_prev; // last output --hotpath-stats counters
 
     // group sum and full duplext reports
     struct SumReport *GroupSumReport;
@@ -502,6 +525,8 @@ void reporter_handle_packet_client(struct ReporterData *data, struct ReportStruc
 void reporter_handle_packet_server_udp(struct ReporterData *data, struct ReportStruct *packet);
 void reporter_handle_packet_server_tcp(struct ReporterData *data, struct ReportStruct *packet);
 void reporter_handle_packet_bb_client(struct ReporterData *data, struct ReportStruct *packet);
+// welford's running mean/min/max/var, extern for iperf_bench
+void reporter_update_mmm(struct MeanMinMaxStats *stats, double value);
 
 // Reporter thread's conditional prints of interval reports
 // Invoked from the Reporter thread per function vector this_ireport->transfer_interval_handler
@@ -617,6 +642,21 @@ void reporter_peerversion (struct ConnectionInfo *report, uint32_t upper, uint32
 void PrintMSS(struct ReporterData *data);
 void reporter_default_heading_flags(int);
 void reporter_connect_printf_tcp_final(struct ConnectionInfo *report);
+// Option reports printed after a traffic report, no output in CSV mode
+void reporter_print_hotpath_stats(struct ReporterData *data, int suspends, bool final);
+void reporter_print_kernelts_stats(struct ReporterData *data, bool final);
+void reporter_print_clock_offset(struct ReporterData *data);
+void reporter_print_link_emul(struct ReporterData *data, bool final);
+void reporter_print_rate_schedule(struct ReporterData *data, bool final);
+void reporter_print_capacity_event(struct TransferInfo *stats);
+void reporter_print_capacity_summary(struct TransferInfo *stats);
+void reporter_print_seq_window(struct ReporterData *data, bool final);
+void reporter_print_outage(struct TransferInfo *stats);
+void reporter_print_loss_stats(struct ReporterData *data, bool final);
+void reporter_print_jitter_buffer(struct ReporterData *data, bool final);
+void reporter_print_dscp_stats(struct TransferInfo *stats, bool final);
+void reporter_print_udp_flows(struct TransferInfo *stats, bool final);
+void reporter_print_pcap_replay(struct TransferInfo *stats);
 
 void write_UDP_AckFIN(struct TransferInfo *stats, int len);
 
@@ -91,6 +91,8 @@ private:
     bool ReadBBWithRXTimestamp ();
     int ReadWithRxTimestamp(void);
     bool ReadPacketID(int);
+    void ClockOffsetEcho(void);
+    void LinkEmulation(bool isLastPacket);
     void L2_processing(void);
     int L2_quintuple_filter(void);
     void udp_isoch_processing(int);
@@ -111,6 +113,14 @@ private:
 #endif
     struct ReportHeader *myJob;
     struct ReporterData *myReport;
+    struct HotPathStats *hotpath;
+    struct KernelTsStats *kernelts;
+    struct ClockOffset *clkoffset;
+    int clkoffset_echoes;
+    int64_t clkoffset_lastecho;
+    struct LinkEmul *linkemul;
+    struct timeval linkemul_prevSentTime;
+    struct timeval linkemul_prevPacketTime;
     struct markov_graph *markov_graph_len;
 #if HAVE_DECL_SO_TIMESTAMP
     // Structures needed for recvmsg
@@ -119,7 +129,9 @@ private:
     struct iovec iov[1];
     struct msghdr message;
     char ctrl[(CMSG_SPACE(sizeof(struct timeval)) \
-	       + CMSG_SPACE(sizeof(u_char)))]; // add space for rcvtos
+	       + CMSG_SPACE(sizeof(struct timespec)) \
+	       + CMSG_SPACE(3 * sizeof(struct timespec)) \
+	       + CMSG_SPACE(sizeof(u_char)))]; // add space for rcvtos, SO_TIMESTAMPNS and SO_TIMESTAMPING
     struct cmsghdr *cmsg;
 #if HAVE_DECL_MSG_CTRUNC
     bool ctrunc_warn_enable;
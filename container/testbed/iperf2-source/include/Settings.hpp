@@ -64,6 +64,8 @@
 #include "Condition.h"
 #include "packet_ring.h"
 #include "markov.h"
+#include "link_emul.h"
+#include "jitter_buffer.h"
 
 /* -------------------------------------------------------------------
  * constants
@@ -179,6 +181,8 @@ struct thread_Settings {
     char*  mSSMMulticastStr;        // --ssm-host
     char*  mIsochronousStr;         // --isochronous
     char*  mHistogramStr;         // --histograms (packets)
+    char*  mMetricsStr;             // --metrics-port
+    char*  mStatsShmStr;            // --stats-shm
     char*  mTransferIDStr;          //
     char*  mBuf;
     FILE*  Extractor_file;
@@ -206,6 +210,14 @@ struct thread_Settings {
     int Extractor_size;
     int mBufLen;                    // -l
     char *mBraKetGraph;            // -l braket string
+    char *mRateScheduleStr;        // --rate-schedule file
+    struct RateSchedule *mRateSchedule; // --rate-schedule parsed once, shared by the client threads
+    char *mPcapReplayStr;          // --pcap-replay file and options
+    struct PcapReplay *mPcapReplay; // --pcap-replay table shared by the client threads
+    char *mProfileStr;             // --profile file
+    char *mProfileName;            // --profile flow name
+    struct TrafficProfile *mProfile;      // --profile shared report origin
+    struct thread_Settings *mProfileNext; // --profile next declared flow
     int mWriteAckLen;               // --write-ack
     int mMSS;                       // -M
     int mTCPWin;                    // -w
@@ -234,6 +246,7 @@ struct thread_Settings {
     int flags;
     int flags_extend;
     int flags_extend2;
+    int flags_extend3;
     // enums (which should be special int's)
     enum ThreadMode mThreadMode;         // -s or -c
     enum ReportMode mReportMode;
@@ -281,12 +294,20 @@ struct thread_Settings {
     double mFPS; //frames per second
     double mMean; //variable bit rate mean
     uint32_t mBurstSize; //number of bytes in a burst
-    int mJitterBufSize; //Server jitter buffer size, units is frames
+    int mJitterBufSize; //Server jitter buffer depths, --jitter-buffer, in mJitterBufDepth
+    int64_t mJitterBufDepth[JITTERBUF_MAXDEPTHS]; // playout depths, ns
+    int mUDPFlows; // --udp-flows, logical flows multiplexed over the one socket
     double mBurstIPG; //Interpacket gap
     int l4offset; // used in l2 mode to offset the raw packet
     int l4payloadoffset;
     int recvflags; // used to set recv flags,e.g. MSG_TRUNC with L
     double mVariance; //vbr variance
+    double mSelfTestTime; // --selftest seconds per configuration
+    int mTickSchedThreads; // --tick-scheduler timer wheel threads
+    struct LinkEmulParams mLinkEmul; // --link-emul
+    int64_t mCapDetectWindow; // --capacity-detect dispersion window, ns
+    intmax_t mReorderWindow; // --reorder-window tolerance, datagrams
+    int mOutageFactor; // --loss-stats outage threshold in expected IPGs
     uintmax_t mFQPacingRate;
 #if (HAVE_DECL_SO_MAX_PACING_RATE)
     int mFQPacingRateStep;
@@ -446,6 +467,27 @@ struct thread_Settings {
 #define FLAG_SETRANDSEED     0x20000000
 #define FLAG_OMIT            0x40000000
 
+/*
+ * Third set of extended flags
+ */
+#define FLAG_METRICS         0x00000001
+#define FLAG_STATSSHM        0x00000002
+#define FLAG_HOTPATHSTATS    0x00000004
+#define FLAG_SELFTEST        0x00000008
+#define FLAG_TSCCLOCK        0x00000010
+#define FLAG_TICKSCHED       0x00000020
+#define FLAG_NSECTS          0x00000040
+#define FLAG_SOTIMESTAMPING  0x00000080
+#define FLAG_HWTIMESTAMPING  0x00000100
+#define FLAG_CLKOFFSET       0x00000200
+#define FLAG_LINKEMUL        0x00000400
+#define FLAG_CAPDETECT       0x00000800
+#define FLAG_REORDERWIN      0x00001000
+#define FLAG_LOSSSTATS       0x00002000
+#define FLAG_JITTERBUF       0x00004000
+#define FLAG_DSCPSTATS       0x00008000
+#define FLAG_UDPFLOWS        0x00010000
+
 #define isBuflenSet(settings)      ((settings->flags & FLAG_BUFLENSET) != 0)
 #define isCompat(settings)         ((settings->flags & FLAG_COMPAT) != 0)
 #define isDaemon(settings)         ((settings->flags & FLAG_DAEMON) != 0)
@@ -536,6 +578,23 @@ struct thread_Settings {
 #define isUDPL4S(settings)         ((settings->flags_extend2 & FLAG_UDPL4S) != 0)
 #define isUDPL4SVideo(settings)    ((settings->flags_extend2 & FLAG_UDPL4SVIDEO) != 0)
 #define isSetRandSeed(settings)    ((settings->flags_extend2 & FLAG_SETRANDSEED) != 0)
+#define isMetrics(settings)        ((settings->flags_extend3 & FLAG_METRICS) != 0)
+#define isStatsShm(settings)       ((settings->flags_extend3 & FLAG_STATSSHM) != 0)
+#define isHotPathStats(settings)   ((settings->flags_extend3 & FLAG_HOTPATHSTATS) != 0)
+#define isSelfTest(settings)       ((settings->flags_extend3 & FLAG_SELFTEST) != 0)
+#define isTscClock(settings)       ((settings->flags_extend3 & FLAG_TSCCLOCK) != 0)
+#define isTickScheduler(settings)  ((settings->flags_extend3 & FLAG_TICKSCHED) != 0)
+#define isNsecTs(settings)         ((settings->flags_extend3 & FLAG_NSECTS) != 0)
+#define isSoTimestamping(settings) ((settings->flags_extend3 & FLAG_SOTIMESTAMPING) != 0)
+#define isHwTimestamping(settings) ((settings->flags_extend3 & FLAG_HWTIMESTAMPING) != 0)
+#define isClockOffset(settings)    ((settings->flags_extend3 & FLAG_CLKOFFSET) != 0)
+#define isLinkEmul(settings)       ((settings->flags_extend3 & FLAG_LINKEMUL) != 0)
+#define isCapDetect(settings)      ((settings->flags_extend3 & FLAG_CAPDETECT) != 0)
+#define isReorderWindow(settings)  ((settings->flags_extend3 & FLAG_REORDERWIN) != 0)
+#define isLossStats(settings)      ((settings->flags_extend3 & FLAG_LOSSSTATS) != 0)
+#define isJitterBuffer(settings)   ((settings->flags_extend3 & FLAG_JITTERBUF) != 0)
+#define isDSCPStats(settings)      ((settings->flags_extend3 & FLAG_DSCPSTATS) != 0)
+#define isUDPFlows(settings)       ((settings->flags_extend3 & FLAG_UDPFLOWS) != 0)
 
 #define setBuflenSet(settings)     settings->flags |= FLAG_BUFLENSET
 #define setCompat(settings)        settings->flags |= FLAG_COMPAT
@@ -624,6 +683,23 @@ struct thread_Settings {
 #define setUDPL4S(settings)         settings->flags_extend2 |= FLAG_UDPL4S
 #define setUDPL4SVideo(settings)    settings->flags_extend2 |= FLAG_UDPL4SVIDEO
 #define setRandSeed(settings)      settings->flags_extend2 |= FLAG_SETRANDSEED
+#define setMetrics(settings)       settings->flags_extend3 |= FLAG_METRICS
+#define setStatsShm(settings)      settings->flags_extend3 |= FLAG_STATSSHM
+#define setHotPathStats(settings)  settings->flags_extend3 |= FLAG_HOTPATHSTATS
+#define setSelfTest(settings)      settings->flags_extend3 |= FLAG_SELFTEST
+#define setTscClock(settings)      settings->flags_extend3 |= FLAG_TSCCLOCK
+#define setTickScheduler(settings) settings->flags_extend3 |= FLAG_TICKSCHED
+#define setNsecTs(settings)        settings->flags_extend3 |= FLAG_NSECTS
+#define setSoTimestamping(settings) settings->flags_extend3 |= FLAG_SOTIMESTAMPING
+#define setHwTimestamping(settings) settings->flags_extend3 |= FLAG_HWTIMESTAMPING
+#define setClockOffset(settings)   settings->flags_extend3 |= FLAG_CLKOFFSET
+#define setLinkEmul(settings)      settings->flags_extend3 |= FLAG_LINKEMUL
+#define setCapDetect(settings)     settings->flags_extend3 |= FLAG_CAPDETECT
+#define setReorderWindow(settings) settings->flags_extend3 |= FLAG_REORDERWIN
+#define setLossStats(settings)     settings->flags_extend3 |= FLAG_LOSSSTATS
+#define setJitterBuffer(settings)  settings->flags_extend3 |= FLAG_JITTERBUF
+#define setDSCPStats(settings)     settings->flags_extend3 |= FLAG_DSCPSTATS
+#define setUDPFlows(settings)      settings->flags_extend3 |= FLAG_UDPFLOWS
 
 #define unsetBuflenSet(settings)   settings->flags &= ~FLAG_BUFLENSET
 #define unsetCompat(settings)      settings->flags &= ~FLAG_COMPAT
@@ -711,6 +787,22 @@ struct thread_Settings {
 #define unsetUDPL4S(settings)         settings->flags_extend2 &= ~FLAG_UDPL4S
 #define unsetUDPL4SVideo(settings)    settings->flags_extend2 &= ~FLAG_UDPL4SVIDEO
 #define unsetRandSeed(settings)       settings->flags_extend2 &= ~FLAG_SETRANDSEED
+#define unsetMetrics(settings)        settings->flags_extend3 &= ~FLAG_METRICS
+#define unsetStatsShm(settings)       settings->flags_extend3 &= ~FLAG_STATSSHM
+#define unsetHotPathStats(settings)   settings->flags_extend3 &= ~FLAG_HOTPATHSTATS
+#define unsetSelfTest(settings)       settings->flags_extend3 &= ~FLAG_SELFTEST
+#define unsetTscClock(settings)       settings->flags_extend3 &= ~FLAG_TSCCLOCK
+#define unsetTickScheduler(settings)  settings->flags_extend3 &= ~FLAG_TICKSCHED
+#define unsetNsecTs(settings)      settings->flags_extend3 &= ~FLAG_NSECTS
+#define unsetSoTimestamping(settings) settings->flags_extend3 &= ~(FLAG_SOTIMESTAMPING | FLAG_HWTIMESTAMPING)
+#define unsetClockOffset(settings) settings->flags_extend3 &= ~FLAG_CLKOFFSET
+#define unsetLinkEmul(settings)    settings->flags_extend3 &= ~FLAG_LINKEMUL
+#define unsetCapDetect(settings)   settings->flags_extend3 &= ~FLAG_CAPDETECT
+#define unsetReorderWindow(settings) settings->flags_extend3 &= ~FLAG_REORDERWIN
+#define unsetLossStats(settings)   settings->flags_extend3 &= ~FLAG_LOSSSTATS
+#define unsetJitterBuffer(settings) settings->flags_extend3 &= ~FLAG_JITTERBUF
+#define unsetDSCPStats(settings)   settings->flags_extend3 &= ~FLAG_DSCPSTATS
+#define unsetUDPFlows(settings)    settings->flags_extend3 &= ~FLAG_UDPFLOWS
 
 // set to defaults
 void Settings_Initialize(struct thread_Settings* main);
@@ -61,6 +61,7 @@
 #define TIMESTAMP_H
 
 #include "headers.h"
+#include "fastclock.h"
 
 /* ------------------------------------------------------------------- */
 class Timestamp {
@@ -78,6 +79,7 @@ public:
     Timestamp(const Timestamp &t2) {
         mTime.tv_sec = t2.mTime.tv_sec;
         mTime.tv_usec = t2.mTime.tv_usec;
+        mNsecs = t2.mNsecs;
     }
 
     /* -------------------------------------------------------------------
@@ -100,11 +102,18 @@ public:
     void inline setnow(void) {
 #ifdef HAVE_CLOCK_GETTIME
 	struct timespec t1;
+#if HAVE_FASTCLOCK
+	if (fastclock_enabled)
+	    fastclock_gettime(&t1);
+	else
+#endif
 	clock_gettime(CLOCK_REALTIME, &t1);
 	mTime.tv_sec  = t1.tv_sec;
         mTime.tv_usec = t1.tv_nsec / 1000;
+	mNsecs = t1.tv_nsec % 1000;
 #else
 	gettimeofday(&mTime, NULL);
+	mNsecs = 0;
 #endif
     }
 
@@ -117,6 +126,7 @@ public:
 
         mTime.tv_sec  = sec;
         mTime.tv_usec = usec;
+        mNsecs = 0;
     }
 
     /* -------------------------------------------------------------------
@@ -125,6 +135,7 @@ public:
     void set(double sec) {
         mTime.tv_sec  = (time_t) sec;
         mTime.tv_usec = (long) ((sec - mTime.tv_sec) * kMillion);
+        mNsecs = 0;
     }
 
     /* -------------------------------------------------------------------
@@ -141,6 +152,14 @@ public:
         return mTime.tv_usec;
     }
 
+    /* -------------------------------------------------------------------
+     * return timestamp as integer nanoseconds, the sub microsecond
+     * part is only kept from setnow()
+     * ------------------------------------------------------------------- */
+    int64_t inline getNsecs(void) {
+        return ((static_cast<int64_t>(mTime.tv_sec) * kBillion) + (static_cast<int64_t>(mTime.tv_usec) * 1000) + mNsecs);
+    }
+
     /* -------------------------------------------------------------------
      * return timestamp as a floating point seconds
      * ------------------------------------------------------------------- */
@@ -203,6 +222,7 @@ public:
 
         assert(mTime.tv_usec >= 0  &&
                 mTime.tv_usec <  kMillion);
+        mNsecs = 0;
     }
 
     /* -------------------------------------------------------------------
@@ -224,6 +244,7 @@ public:
 
         assert(mTime.tv_usec >= 0  &&
                 mTime.tv_usec <  kMillion);
+        mNsecs = 0;
     }
 
     /* -------------------------------------------------------------------
@@ -242,6 +263,7 @@ public:
 
         assert(mTime.tv_usec >= 0  &&
                 mTime.tv_usec <  kMillion);
+        mNsecs = 0;
     }
 
     /* -------------------------------------------------------------------
@@ -251,6 +273,7 @@ public:
         mTime.tv_usec += usec;
 	mTime.tv_sec += mTime.tv_usec / kMillion;
 	mTime.tv_usec = mTime.tv_usec % kMillion;
+	mNsecs = 0;
 	// assert((mTime.tv_usec >= 0) && (mTime.tv_usec < kMillion));
     }
 
@@ -289,10 +312,12 @@ public:
 
 protected:
     enum {
-        kMillion = 1000000
+        kMillion = 1000000,
+        kBillion = 1000000000
     };
 
     struct timeval mTime;
+    long mNsecs; // sub microsecond nanoseconds
 
 }; // end class Timestamp
 
@@ -0,0 +1,119 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * capacity_detect.h
+ * Streaming change detector for the UDP server's delivered rate
+ * (--capacity-detect). Packets are grouped into short dispersion
+ * windows, each giving a delivered rate and a queueing delay slope
+ * over the transit floor. A two sided CUSUM on the window rates,
+ * scaled by their learned spread, decides when the rate has moved,
+ * and the queueing delay says whether that was the bottleneck's
+ * capacity or the sender's offered load.
+ * ------------------------------------------------------------------- */
+#ifndef CAPACITYDETECT_H
+#define CAPACITYDETECT_H
+
+#include "headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CAPDETECT_DEFWINDOW 10000000 // ns, 10 ms dispersion windows
+#define CAPDETECT_MINPKTS 8          // a window closes only with this many packets
+#define CAPDETECT_LEARN 8            // windows to learn the first level and spread
+#define CAPDETECT_SLACK 0.5          // CUSUM allowance, in spreads
+#define CAPDETECT_DECIDE 8.0         // CUSUM decision threshold, in spreads
+#define CAPDETECT_MINSPREAD 0.02     // relative spread floor so a clean link doesn't alarm on small wobbles
+#define CAPDETECT_MINCHANGE 0.05     // smaller level moves are absorbed rather than reported
+#define CAPDETECT_QUEUE 1000000      // ns over the transit floor that says a bottleneck queue is in play
+#define CAPDETECT_BUILDING 0.05      // queueing delay slope, s per s, of a queue that's building
+
+struct CapacityEvent {
+    int64_t at;       // ns, start of the window where the CUSUM run began
+    int64_t detected; // ns, end of the window that crossed the threshold
+    double from;      // bits per second
+    double to;
+    int64_t queue;    // ns of queueing delay over the transit floor
+    double trend;     // queueing delay slope of the deciding window, seconds per second
+    bool capacity;    // queueing says the bottleneck moved, otherwise the offered load did
+};
+
+struct CapacityRun {
+    double cusum;
+    int64_t start;
+    double sum;
+    int windows;
+};
+
+struct CapacityDetect {
+    int64_t window;
+    // the open window, all but the sums are ns
+    int64_t wstart;   // arrival of the previous window's last packet
+    int64_t wtransit; // first transit of the window, the regression's origin
+    intmax_t wbytes;
+    int wpkts;
+    double sx, sy, sxx, sxy;
+    int64_t floor;    // min transit seen
+    int64_t queue;    // transit over the floor as of the last packet
+    // the current regime
+    int learned;
+    double level;     // bits per second
+    double variance;  // of the relative window rates
+    double spread;
+    struct CapacityRun up;
+    struct CapacityRun down;
+    double rate;      // last closed window
+    double trend;
+    intmax_t windows;
+    intmax_t changes;
+    intmax_t capacity_changes;
+    struct CapacityEvent event; // the last change
+};
+
+extern struct CapacityDetect *capdetect_alloc(int64_t window);
+extern void capdetect_free(struct CapacityDetect *cd);
+extern bool capdetect_packet(struct CapacityDetect *cd, int64_t arrival, int64_t transit, intmax_t bytes);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // CAPACITYDETECT_H
@@ -0,0 +1,106 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * clock_offset.h
+ * In band clock offset and drift estimation for --clock-offset. The
+ * server echoes a few of the client's datagrams with its receive and
+ * send times, the client filters these NTP style (minimum delay of the
+ * last few samples) and fits the drift over the filtered samples. The
+ * resulting offset is carried in the datagrams so the server can
+ * correct the sent time before computing transit.
+ * ------------------------------------------------------------------- */
+#ifndef CLOCKOFFSET_H
+#define CLOCKOFFSET_H
+
+#include "headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CLKOFFSET_FILTER 8           // clock filter register, per NTP
+#define CLKOFFSET_MINSAMPLES 4       // samples needed before an estimate is used
+#define CLKOFFSET_HISTORY 16         // filtered samples used for the drift fit
+#define CLKOFFSET_EPOCH 1000000000LL // ns between drift fit samples
+#define CLKOFFSET_FITSPAN 4000000000LL // ns of samples needed before fitting drift
+#define CLKOFFSET_PHI 15e-6          // frequency tolerance, per NTP
+#define CLKOFFSET_MAXDRIFT 500e-6
+#define CLKOFFSET_ECHOBURST 8        // server echoes the first n datagrams
+#define CLKOFFSET_ECHOPERIOD 100000000LL // then one per n ns
+#define CLKOFFSET_POLLPERIOD 10000000LL  // client reads echoes every n ns
+
+struct ClockOffsetSample {
+    int64_t t;      // client time of the sample
+    int64_t offset; // server minus client
+    int64_t delay;  // round trip less the server's hold time
+};
+
+// What the reporter outputs, written by the traffic thread
+struct ClockOffsetReport {
+    bool valid;
+    int64_t offset;
+    int64_t bound;
+    double drift;
+    intmax_t samples;
+};
+
+struct ClockOffset {
+    struct ClockOffsetReport pub;
+    int64_t reftime;
+    int64_t offset;
+    int64_t delay;
+    double drift;
+    int nfilter;
+    int filterix;
+    struct ClockOffsetSample filter[CLKOFFSET_FILTER];
+    int nhistory;
+    int historyix;
+    struct ClockOffsetSample history[CLKOFFSET_HISTORY];
+};
+
+extern struct ClockOffset *clock_offset_alloc(void);
+extern void clock_offset_sample(struct ClockOffset *co, int64_t t1, int64_t t2, int64_t t3, int64_t t4);
+extern int64_t clock_offset_at(struct ClockOffset *co, int64_t t, int64_t *bound);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // CLOCKOFFSET_H
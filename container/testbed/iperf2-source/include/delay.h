@@ -55,11 +55,30 @@
 extern "C" {
 #endif
 #include <time.h>
+#include <stdint.h>
 void delay_loop( unsigned long usecs );
 void delay_busyloop(unsigned long usecs);
 void delay_nanosleep(unsigned long usecs);
 int clock_usleep(struct timeval *request);
 int clock_usleep_abstime(struct timeval *request);
+
+// Hybrid pacer, sleep until a margin before the deadline then spin on
+// the clock. The margin is learned from the measured wake error of
+// the sleeps so each thread needs its own pacer state.
+struct delay_pacer {
+    double margin;    // nanoseconds before the deadline to stop sleeping
+    double oversleep; // smoothed wake error of the sleep phase, nanoseconds
+    double deviation; // smoothed mean absolute deviation of the wake error
+    uintmax_t sleeps;
+    uintmax_t spins;  // calls that only spun because the wait was under the margin
+    uintmax_t late;   // calls where the sleep alone overshot the deadline
+};
+#define PACER_MARGIN_INIT 100000  // 100 usecs until calibrated
+#define PACER_MARGIN_MIN  2000
+#define PACER_MARGIN_MAX  2000000
+void delay_pacer_init(struct delay_pacer *pacer);
+void delay_pacer(struct delay_pacer *pacer, double nsecs);
+int delay_pacer_abstime(struct delay_pacer *pacer, struct timespec *deadline);
 #ifdef HAVE_KALMAN
 // Kalman filter states
 struct kalman_state {
@@ -0,0 +1,130 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * dscp_stats.h
+ * Per DSCP class accounting within a UDP flow and across the flows of a
+ * sum report (--dscp-stats), off the received IP_TOS of each datagram.
+ *
+ * o) a class per DSCP, 64 directly indexed, with packets, bytes, loss,
+ *    latency and RFC 3550 jitter within the class, and the ECN codepoints
+ *    it arrived with
+ * o) re-marking by the path, a DSCP other than the one the client sent,
+ *    and ECN bleaching, sent ECT arriving not-ECT
+ *
+ * A gap in the sequence numbers is charged to the class of the datagram
+ * that closes it. A late datagram takes one back from the class its gap
+ * was charged to, found in a small ring of the most recent gaps, so a
+ * duplicate, or a datagram later than the ring reaches, takes nothing
+ * back. The first datagram is read by the listener without its TOS and
+ * is counted with the class of the next one. Everything is constant
+ * time per datagram.
+ * ------------------------------------------------------------------- */
+#ifndef DSCPSTATS_H
+#define DSCPSTATS_H
+
+#include "headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DSCPSTATS_CLASSES 64
+#define DSCPSTATS_NOTOS -1 // sums, nothing to compare with, or a TOS not received
+#define DSCPSTATS_GAPS 16  // recent gaps a late datagram is looked up in
+
+struct DSCPStatsCounters {
+    intmax_t packets;
+    intmax_t bytes;
+    intmax_t lost;
+    intmax_t remarked;  // arrived with a DSCP other than the one sent
+    intmax_t bleached;  // sent ECT, arrived not-ECT
+    intmax_t ecn[4];    // not-ECT, ECT(1), ECT(0), CE
+};
+
+struct DSCPStatsLatency {
+    intmax_t cnt;
+    int64_t sum; // ns
+    int64_t min;
+    int64_t max;
+};
+
+struct DSCPClass {
+    struct DSCPStatsCounters cnt;
+    struct DSCPStatsCounters prev; // reporter's copy at the last interval
+    struct DSCPStatsLatency ilat;
+    struct DSCPStatsLatency tlat;
+    int64_t transit;               // ns, the class's last
+    double jitter;                 // ns
+};
+
+struct DSCPStatsGap {
+    intmax_t start;   // first missing sequence number
+    intmax_t end;     // the one that closed the gap
+    intmax_t missing; // still lost, what late datagrams can take back
+    int dscp;         // the class charged
+};
+
+struct DSCPStatsHeld {
+    intmax_t len;
+    int64_t transit;
+    bool valid;
+};
+
+struct DSCPStats {
+    int sent_tos;
+    intmax_t top;     // highest sequence number seen
+    uint64_t active;  // a bit per class seen
+    struct DSCPClass cls[DSCPSTATS_CLASSES];
+    struct DSCPStatsGap gap[DSCPSTATS_GAPS];
+    int gapix;        // the next slot, the oldest gap once the ring is full
+    struct DSCPStatsHeld held; // a datagram waiting on the next for its class
+};
+
+extern struct DSCPStats *dscpstats_alloc(int sent_tos);
+extern void dscpstats_free(struct DSCPStats *ds);
+extern void dscpstats_packet(struct DSCPStats *ds, int tos, intmax_t seqno, intmax_t len, int64_t transit);
+extern void dscpstats_sum(struct DSCPStats *sum, struct DSCPStats *ds);
+extern void dscpstats_next_interval(struct DSCPStats *ds);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // DSCPSTATS_H
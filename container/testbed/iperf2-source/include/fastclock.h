@@ -0,0 +1,110 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * fastclock.h
+ * Optional invariant TSC clock for per packet timestamps (--tsc-clock)
+ *
+ * The TSC is calibrated once against CLOCK_MONOTONIC_RAW and each thread
+ * keeps its own anchor pair (tsc, CLOCK_REALTIME ns) which is refreshed
+ * every FASTCLOCK_REANCHOR_NS. Reads between anchors are a rdtsc plus a
+ * multiply and shift, so timestamps stay aligned to the wall clock
+ * (needed by --trip-times) to within the TSC drift over one anchor
+ * period, and NTP steps are picked up at the next re-anchor.
+ * ------------------------------------------------------------------- */
+#ifndef FASTCLOCK_H
+#define FASTCLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(HAVE_CLOCK_GETTIME) && (defined(__x86_64__) || defined(__i386__)) && !defined(WIN32)
+#define HAVE_FASTCLOCK 1
+#include <x86intrin.h>
+#else
+#define HAVE_FASTCLOCK 0
+#endif
+
+#define FASTCLOCK_REANCHOR_NS 100000000  // 100 ms
+#define FASTCLOCK_CALIBRATE_NS 50000000  // 50 ms
+#define FASTCLOCK_SHIFT 32
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int fastclock_enabled;
+
+// returns 0 on success, -1 when no usable invariant TSC
+extern int fastclock_init(void);
+extern double fastclock_ghz(void);
+
+#if HAVE_FASTCLOCK
+struct fastclock_anchor {
+    uint64_t tsc;
+    uint64_t expire;    // tsc value at which to re-anchor
+    time_t sec;         // CLOCK_REALTIME at tsc
+    long nsec;
+};
+extern __thread struct fastclock_anchor fastclock_anchor;
+extern uint64_t fastclock_mult; // ns per tick << FASTCLOCK_SHIFT
+extern void fastclock_reanchor(struct timespec *ts);
+
+static inline void fastclock_gettime (struct timespec *ts) {
+    uint64_t tsc = __rdtsc();
+    if (tsc >= fastclock_anchor.expire) {
+	fastclock_reanchor(ts);
+	return;
+    }
+    // the delta is under one anchor period so a single carry suffices, no divides
+    long nsec = fastclock_anchor.nsec + (long) (((tsc - fastclock_anchor.tsc) * fastclock_mult) >> FASTCLOCK_SHIFT);
+    ts->tv_sec = fastclock_anchor.sec;
+    if (nsec >= 1000000000) {
+	nsec -= 1000000000;
+	ts->tv_sec++;
+    }
+    ts->tv_nsec = nsec;
+}
+#endif
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // FASTCLOCK_H
@@ -48,6 +48,10 @@
 #ifndef HISTOGRAMC_H
 #define HISTOGRAMC_H
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct histogram {
     unsigned int id;
     unsigned int *mybins;
@@ -77,7 +81,13 @@ extern struct histogram *histogram_init(unsigned int bincount, unsigned int binw
 					float units, double ci_lower, double ci_upper, unsigned int id, char *name, bool omit);
 extern void histogram_delete(struct histogram *h);
 extern int histogram_insert(struct histogram *h, float value, struct timeval *ts);
+extern int histogram_insert_ns(struct histogram *h, int64_t value, struct timeval *ts);
 extern void histogram_clear(struct histogram *h);
 extern void histogram_add(struct histogram *to, struct histogram *from);
 extern void histogram_print(struct histogram *h, double, double);
+extern double histogram_percentile(struct histogram *h, double pct);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
 #endif // HISTOGRAMC_H
@@ -0,0 +1,116 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * iperf_metrics.h
+ * Live per flow and per group counters published by the reporter
+ * thread into a fixed table of seqlock protected slots. Readers,
+ * e.g. the OpenMetrics http endpoint, copy a slot and retry if the
+ * sequence number changed, so they never block the reporter or
+ * the traffic threads.
+ * -------------------------------------------------------------------
+ */
+#ifndef IPERFMETRICS_H
+#define IPERFMETRICS_H
+
+#include "headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define METRICS_MAXFLOWS 1024
+#define METRICS_READRETRIES 64
+
+// --stats-shm segment, a header followed by METRICS_MAXFLOWS flow slots
+// Readers must check magic, version and flowsize before using the table
+#define METRICS_SHM_MAGIC 0x69706d66
+#define METRICS_SHM_VERSION 1
+
+struct ReporterData;
+struct TransferInfo;
+
+// Fixed size, pointer free layout
+struct iperf_metrics_flow {
+    uint32_t seq;       // odd while the reporter is writing
+    uint32_t inuse;
+    int32_t transferID;
+    int32_t type;       // DATA_REPORT or SUM_REPORT
+    int32_t server;
+    int32_t udp;
+    uint64_t bytes;
+    int64_t datagrams;
+    int64_t lost;
+    int64_t outoforder;
+    int64_t ring_stalls;
+    int64_t transit_cnt;
+    double transit_mean;
+    double transit_min;
+    double transit_max;
+    double transit_p50;
+    double transit_p90;
+    double transit_p99;
+    double jitter;
+    double transit_last;
+    int64_t tcp_cwnd;      // KBytes, from gettcpinfo() on tcp clients
+    int64_t tcp_rtt;       // usecs
+    int64_t tcp_retry;
+};
+
+struct iperf_metrics_shm {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t maxflows;
+    uint32_t flowsize;
+    int64_t pid;           // writer, readers can use this to detect a stale segment
+    int64_t start_sec;
+};
+
+extern struct iperf_metrics_flow *iperf_metrics_alloc(void);
+extern void iperf_metrics_free(struct iperf_metrics_flow *slot);
+extern void iperf_metrics_publish(struct TransferInfo *stats, struct ReporterData *data);
+extern bool iperf_metrics_snapshot(struct iperf_metrics_flow *slot, struct iperf_metrics_flow *copy);
+extern int iperf_metrics_start(char *bindstr);
+extern int iperf_metrics_shm_open(char *name);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // IPERFMETRICS_H
@@ -0,0 +1,85 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * iperf_probes.h
+ * USDT (systemtap sys/sdt.h style) static tracepoints, provider "iperf".
+ * Each probe is a single nop plus an ELF note, so there's no runtime
+ * dependency or cost until a tracer attaches, e.g.
+ *
+ *   bpftrace -e 'usdt:./iperf:iperf:udp_recv { @[arg0] = count(); }'
+ *   perf probe -x ./iperf sdt_iperf:ring_stall
+ *
+ * Probes compile to nothing when <sys/sdt.h> isn't available, or when
+ * built with -DIPERF_DISABLE_USDT
+ *
+ * Probe                    Arguments
+ * tcp_send, tcp_recv       transfer id, write/read count, length, tv_sec, tv_usec
+ * udp_send, udp_recv       transfer id, packet id, length, tv_sec, tv_usec
+ * ring_enqueue             ring, packet id, length, occupancy
+ * ring_dequeue             ring, packet id, length
+ * ring_stall               ring, await count
+ * interval_report          transfer id, start usecs, end usecs, bytes
+ * wait_tick                frame counter, slot, sched err usecs, slips
+ * -------------------------------------------------------------------
+ */
+#ifndef IPERFPROBES_H
+#define IPERFPROBES_H
+
+#if !defined(IPERF_DISABLE_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HAVE_USDT 1
+#endif
+#endif
+
+#if HAVE_USDT
+#define IPERF_PROBE2(name, a1, a2) DTRACE_PROBE2(iperf, name, a1, a2)
+#define IPERF_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(iperf, name, a1, a2, a3)
+#define IPERF_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(iperf, name, a1, a2, a3, a4)
+#define IPERF_PROBE5(name, a1, a2, a3, a4, a5) DTRACE_PROBE5(iperf, name, a1, a2, a3, a4, a5)
+#else
+#define IPERF_PROBE2(name, a1, a2) do {} while (0)
+#define IPERF_PROBE3(name, a1, a2, a3) do {} while (0)
+#define IPERF_PROBE4(name, a1, a2, a3, a4) do {} while (0)
+#define IPERF_PROBE5(name, a1, a2, a3, a4, a5) do {} while (0)
+#endif
+
+#endif // IPERFPROBES_H
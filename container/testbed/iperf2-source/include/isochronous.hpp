@@ -51,6 +51,8 @@
 #include <time.h>
 #include "Settings.hpp"
 #include "Timestamp.hpp"
+#include "delay.h"
+#include "timer_wheel.h"
 
 /* ------------------------------------------------------------------- */
 namespace Isochronous {
@@ -69,6 +71,7 @@ namespace Isochronous {
 	long getUsecs(void);
 	void reset(void);
         Timestamp next_slot(void);
+	void set_timer_wheel(struct timer_wheel *);
 	unsigned int slip;
     private :
 	double frequency;
@@ -81,6 +84,10 @@ namespace Isochronous {
 	int mySetWaitableTimer (long delay_time);
 	HANDLE my_timer;	// Timer handle
 	LARGE_INTEGER delay;    // units is 100 nanoseconds
+#else
+	struct delay_pacer pacer; // sleep then spin to the slot time
+	struct timer_wheel *wheel; // central scheduler releases the slots when set
+	struct timer_wheel_entry wheel_entry;
 #endif
 
     }; // end class FrameCounter
@@ -0,0 +1,98 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * jitter_buffer.h
+ * Playout buffer simulation and an E-model MOS estimate for VoIP
+ * flows on the UDP server (--jitter-buffer), several buffer depths
+ * run side by side off the one-way transit of each datagram.
+ *
+ * o) a fixed depth playout buffer anchored to the least transit yet,
+ *    a datagram arriving more than the depth behind it is a late
+ *    discard
+ * o) effective loss is the network loss plus the late discards
+ * o) the ITU-T G.107 E-model R factor in its simplified form (Cole
+ *    and Rosenbluth) for G.711 with packet loss concealment, the delay
+ *    impairment from the mouth to ear delay, the least transit plus
+ *    the depth, and the loss impairment from the effective loss,
+ *    then R to MOS per G.107 annex B
+ *
+ * The per datagram work is a compare per depth, the depths are kept
+ * ascending so it stops at the first the datagram wasn't late for.
+ * ------------------------------------------------------------------- */
+#ifndef JITTERBUF_H
+#define JITTERBUF_H
+
+#include "headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JITTERBUF_MAXDEPTHS 8
+#define JITTERBUF_DEFDEPTHS "20,40,60,100" // ms
+#define JITTERBUF_R0 93.2    // R0 less the simultaneous impairments, G.107 defaults
+#define JITTERBUF_IE 0.0     // G.711 equipment impairment
+#define JITTERBUF_BPL 25.1   // G.711 with PLC loss robustness, G.113 appendix I
+
+struct JitterBufferCounters {
+    intmax_t arrived;
+    intmax_t late[JITTERBUF_MAXDEPTHS];
+};
+
+struct JitterBuffer {
+    int depths;
+    int64_t depth[JITTERBUF_MAXDEPTHS]; // ns, ascending
+    int64_t anchor;                     // ns, least transit yet
+    bool anchored;
+    struct JitterBufferCounters cnt;
+    struct JitterBufferCounters prev;   // reporter's copy at the last interval
+};
+
+extern struct JitterBuffer *jitterbuf_alloc(int depths, int64_t *depth);
+extern void jitterbuf_free(struct JitterBuffer *jb);
+extern void jitterbuf_packet(struct JitterBuffer *jb, int64_t transit);
+extern double jitterbuf_rfactor(double delay_ms, double loss_pct);
+extern double jitterbuf_mos(double rfactor);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // JITTERBUF_H
@@ -0,0 +1,108 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * kernel_timestamps.h
+ * SO_TIMESTAMPING support, see --so-timestamping. The UDP server
+ * takes kernel (software or hardware) receive stamps and the UDP
+ * client collects transmit stamps from the socket error queue so
+ * the one way delay can be split into user->stack, stack->wire and
+ * wire->user portions.
+ * ------------------------------------------------------------------- */
+#ifndef KERNELTIMESTAMPS_H
+#define KERNELTIMESTAMPS_H
+
+#include "headers.h"
+
+#if defined(HAVE_LINUX_SOCKIOS_H) && (HAVE_DECL_MSG_ERRQUEUE)
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+#ifdef SO_TIMESTAMPING
+#define HAVE_SO_TIMESTAMPING 1
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pending transmits awaiting their error queue stamps, must be a power of 2
+#define KERNELTS_TXSLOTS 1024
+#define KERNELTS_TXDRAIN 32  // drain the error queue every n writes
+
+// Running totals, delays are nanosecond sums for averages
+struct KernelTsCounters {
+    intmax_t tx;          // writes handed to the kernel
+    intmax_t tx_sched;    // writes with a SCHED (entered the qdisc) stamp
+    intmax_t tx_wire;     // writes with a driver (software or hardware) stamp
+    intmax_t tx_unmatched;// stamps that couldn't be paired with a write
+    int64_t user2stack;
+    int64_t user2stack_max;
+    int64_t stack2wire;
+    int64_t stack2wire_max;
+    intmax_t rx;
+    int64_t wire2user;
+    int64_t wire2user_max;
+};
+
+// Only the traffic thread writes cnt and the tx slots, the reporter
+// reads cnt for interval output and owns prev
+struct KernelTsStats {
+    struct KernelTsCounters cnt;
+    struct KernelTsCounters prev;
+    bool hardware;        // hardware stamps requested
+    bool hwseen;          // at least one hardware stamp was returned
+    uint32_t tx_next;     // SOF_TIMESTAMPING_OPT_ID of the next write
+    int64_t tx_user[KERNELTS_TXSLOTS];
+    int64_t tx_sched[KERNELTS_TXSLOTS];
+};
+
+extern struct KernelTsStats *kernelts_alloc(bool hardware);
+extern int kernelts_enable_rx(int sock, bool hardware, const char *ifname);
+extern int kernelts_enable_tx(int sock, bool hardware, const char *ifname);
+extern void kernelts_tx_sent(struct KernelTsStats *kts, int sock, int64_t user_ns);
+extern void kernelts_tx_drain(struct KernelTsStats *kts, int sock);
+extern void kernelts_rx(struct KernelTsStats *kts, int64_t wire_ns, bool hardware);
+extern int64_t kernelts_now(void);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // KERNELTIMESTAMPS_H
@@ -0,0 +1,123 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * link_emul.h
+ * Userspace link emulation for the UDP server (--link-emul), a netem
+ * like stage between the socket read and the reporter. Packets are
+ * lost (random or Gilbert-Elliott), shaped by a token bucket and then
+ * held in a timing wheel delay line for the delay plus jitter. The
+ * reporter sees each packet at its emulated delivery time.
+ * ------------------------------------------------------------------- */
+#ifndef LINKEMUL_H
+#define LINKEMUL_H
+
+#include "headers.h"
+#include "packet_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LINKEMUL_TICKSHIFT 12     // wheel slots are 2^n ns, ~4 us
+#define LINKEMUL_WHEELBITS 16     // 64K slots, ~268 ms per revolution
+#define LINKEMUL_DEFLIMIT 1000    // packets held, netem's default
+#define LINKEMUL_MAXLIMIT 4000000
+#define LINKEMUL_DEFBURST 15000   // token bucket depth in bytes, ten 1500 byte packets
+
+struct LinkEmulParams {
+    int64_t delay;    // ns
+    int64_t jitter;   // ns, uniform +/- around the delay, reorders like netem
+    double rate;      // bits per second, zero is unshaped
+    intmax_t burst;   // token bucket depth, bytes
+    intmax_t limit;   // max packets held, shaped or delayed, per netem
+    double loss;      // random loss probability
+    bool gemodel;     // Gilbert-Elliott loss, per netem's loss gemodel p r 1-h 1-k
+    double ge_p;      // good to bad transition probability
+    double ge_r;      // bad to good transition probability
+    double ge_lossbad;  // 1-h, loss probability in the bad state
+    double ge_lossgood; // 1-k, loss probability in the good state
+};
+
+struct LinkEmulCounters {
+    intmax_t in;
+    intmax_t out;
+    intmax_t lost_random;
+    intmax_t lost_burst;  // lost in the Gilbert-Elliott bad state
+    intmax_t queue_drops; // tail drops with limit packets held
+    int64_t added;        // ns of delay added to the delivered packets
+    int64_t added_max;
+    intmax_t held_max;
+};
+
+struct LinkEmulEntry {
+    int64_t release; // ns
+    int32_t next;
+    struct ReportStruct packet;
+};
+
+struct LinkEmul {
+    struct LinkEmulParams params;
+    struct LinkEmulCounters cnt;
+    struct LinkEmulCounters prev; // reporter's copy at the last interval
+    uint64_t rng;
+    bool ge_bad;
+    double tb_tokens; // bytes
+    int64_t tb_time;  // ns the tokens are as of, ahead of now when backlogged
+    int64_t cursor;   // wheel tick whose slot is being released
+    intmax_t held;
+    int32_t freelist;
+    int32_t *head;
+    int32_t *tail;
+    struct LinkEmulEntry *pool;
+    struct ReportStruct out; // the last released packet
+};
+
+extern int linkemul_parse(const char *spec, struct LinkEmulParams *params);
+extern struct LinkEmul *linkemul_alloc(struct LinkEmulParams *params);
+extern void linkemul_free(struct LinkEmul *le);
+extern bool linkemul_enqueue(struct LinkEmul *le, struct ReportStruct *packet, int64_t now);
+extern struct ReportStruct *linkemul_dequeue(struct LinkEmul *le, int64_t now);
+extern struct ReportStruct *linkemul_flush(struct LinkEmul *le);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // LINKEMUL_H
@@ -0,0 +1,128 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * loss_stats.h
+ * Loss burst, gap and outage statistics for the UDP server
+ * (--loss-stats), built up per datagram from the sequence numbers and
+ * arrival times with fixed size counters, nothing allocated per packet.
+ *
+ * o) burst and gap length distributions, runs of consecutive lost and
+ *    received datagrams in log2 bins
+ * o) Gilbert estimates from the runs, p and r, and Gilbert-Elliott ones
+ *    per RFC 3611's gmin burst definition, p, r, 1-h and 1-k, in the
+ *    terms --link-emul ge= (and netem) take
+ * o) outages, nothing arriving for more than n expected IPGs, with
+ *    their start and end times
+ *
+ * Only the highest sequence number yet advances the runs, a reordered
+ * datagram doesn't take back the loss it was counted as.
+ * ------------------------------------------------------------------- */
+#ifndef LOSSSTATS_H
+#define LOSSSTATS_H
+
+#include "headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOSSSTATS_BINS 12        // 1, 2, 3-4, ... 513-1024 and the rest
+#define LOSSSTATS_GMIN 16        // received datagrams that end a burst, RFC 3611's default
+#define LOSSSTATS_DEFOUTAGE 20   // expected IPGs of silence that make an outage
+#define LOSSSTATS_IPGSAMPLES 16  // IPG samples before outages are looked for
+
+struct LossStatsCounters {
+    intmax_t rcvd;       // datagrams advancing the highest sequence number
+    intmax_t bursts;     // runs of consecutive lost datagrams
+    intmax_t burst_lost;
+    intmax_t burst_bins[LOSSSTATS_BINS];
+    intmax_t gaps;       // runs of consecutive received datagrams a loss ended
+    intmax_t gap_rcvd;
+    intmax_t gap_bins[LOSSSTATS_BINS];
+    intmax_t good;       // datagrams in the Gilbert-Elliott good state
+    intmax_t good_lost;
+    intmax_t bad;
+    intmax_t bad_lost;
+    intmax_t badcnt;     // bad state periods
+    intmax_t outages;
+    int64_t outage_time; // ns
+};
+
+// Maxima don't difference, so the interval's are kept apart and the
+// reporter zeroes them
+struct LossStatsMax {
+    intmax_t burst;
+    intmax_t gap;
+    int64_t outage; // ns
+};
+
+struct LossOutage {
+    int64_t start;  // ns, arrival of the last datagram before the silence
+    int64_t end;    // ns, arrival of the one that ended it
+    intmax_t lost;  // datagrams missing across it
+};
+
+struct LossStats {
+    int outage_factor;
+    intmax_t top;       // highest sequence number seen
+    int64_t last;       // ns, its arrival
+    double ipg;         // ns per sequence number
+    int ipg_samples;
+    intmax_t run;       // received since the last loss
+    bool burst;         // a burst candidate is open, per gmin
+    intmax_t burst_len;
+    intmax_t burst_lost;
+    struct LossStatsCounters cnt;
+    struct LossStatsCounters prev; // reporter's copy at the last interval
+    struct LossStatsMax imax;
+    struct LossStatsMax tmax;
+    struct LossOutage outage;      // the last outage
+};
+
+extern struct LossStats *lossstats_alloc(int outage_factor);
+extern void lossstats_free(struct LossStats *ls);
+extern bool lossstats_packet(struct LossStats *ls, intmax_t seqno, int64_t arrival);
+extern int lossstats_bins_snprintf(char *buf, size_t len, intmax_t *bins, intmax_t *prev);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // LOSSSTATS_H
@@ -84,12 +84,16 @@ struct ReportStruct {
     struct timeval prevPacketTime;
     struct timeval sentTime;
     struct timeval prevSentTime;
+    int64_t packetTimeNs; // nanosecond rx and tx times when known, zero otherwise
+    int64_t sentTimeNs;
     enum ReadWriteExtReturnVals err_readwrite;
     bool emptyreport;
     int l2errors;
     int l2len;
     int expected_l2len;
     u_char tos;
+    uint32_t flowid;   // --udp-flows logical flow and its sequence number, zero when none
+    intmax_t flowseqno;
     // isochStartTime is overloaded: first write timestamp of the frame or burst w/trip-times or very first read w/o trip-times
     // reporter calculation will compute latency accordingly
     struct timeval isochStartTime;
@@ -113,6 +117,87 @@ struct ReportStruct {
 #endif
 };
 
+// The packet ring doesn't hold ReportStructs, which are mostly rarely
+// used fields, but a compact record of the per packet hot fields with
+// nanosecond times. The other fields are carried in a side record,
+// allocated by packetring_side_init(), and only copied when flagged in
+// the record.
+// packetring_dequeue() unpacks back into a ReportStruct owned by the ring.
+#define REPORT_EMPTY         0x0001
+#define REPORT_TRANSIT_READY 0x0002
+#define REPORT_SCHEDULED     0x0004
+#define REPORT_SIDE_FRAME    0x0010 // isochronous, burst and frame fields
+#define REPORT_SIDE_WRITE    0x0020 // write times and bounceback byte counts
+#define REPORT_SIDE_BB       0x0040 // bounceback rx/tx times
+#define REPORT_SIDE_L2       0x0080 // --l2checks
+#define REPORT_SIDE_TCP      0x0100 // tcpinfo samples and fq pacing rate
+#define REPORT_SIDE_FLOW     0x0200 // --udp-flows logical flow
+#define REPORT_SIDE_MASK     0x03F0
+
+struct ReportRecord {
+    intmax_t packetID;
+    intmax_t packetLen;
+    int64_t packetTime; // units nanoseconds
+    int64_t sentTime;
+    int64_t prevPacketTime;
+    int64_t prevSentTime;
+    int32_t writecnt;
+    uint16_t flags;
+    uint8_t err_readwrite;
+    u_char tos;
+};
+
+struct ReportSide {
+    // REPORT_SIDE_FRAME
+    struct timeval isochStartTime;
+    uint32_t prevframeID;
+    uint32_t frameID;
+    uint32_t burstsize;
+    uint32_t burstperiod;
+    uint32_t remaining;
+    long sched_err;
+    // REPORT_SIDE_WRITE
+    long write_time;
+    intmax_t writeLen;
+    intmax_t recvLen;
+    // REPORT_SIDE_BB
+    struct timeval sentTimeRX;
+    struct timeval sentTimeTX;
+    // REPORT_SIDE_L2
+    int l2errors;
+    int l2len;
+    int expected_l2len;
+    // REPORT_SIDE_TCP
+    struct iperf_tcpstats tcpstats;
+#if defined(HAVE_DECL_SO_MAX_PACING_RATE)
+    intmax_t FQPacingRate;
+#endif
+    // REPORT_SIDE_FLOW
+    uint32_t flowid;
+    intmax_t flowseqno;
+};
+
+// Hot path self instrumentation, see --hotpath-stats.  Only the
+// producer (traffic) thread writes these, the reporter reads them
+// when outputting interval reports. Times are in seconds.
+struct HotPathStats {
+    intmax_t syscalls;
+    double syscall_time;
+    double syscall_max;
+    double enqueue_blocked;
+    intmax_t enqueue_waits;
+    int ring_highwater;
+    intmax_t delay_calls;
+    double delay_oversleep;
+    double delay_oversleep_max;
+    unsigned int tick_slips;
+    long sched_err_max; // usecs, per FrameCounter::wait_tick()
+};
+
+struct KernelTsStats;
+struct ClockOffset;
+struct LinkEmul;
+
 struct PacketRing {
     // producer and consumer
     // must be an atomic type, e.g. int
@@ -134,10 +219,18 @@ struct PacketRing {
     //    (signaled by the producer)
     struct Condition *awake_producer;
     struct Condition *awake_consumer;
-    struct ReportStruct *data;
+    struct ReportRecord *data;
+    struct ReportSide *side; // NULL until a side record is needed
+    struct ReportStruct unpacked; // consumer's view of the last dequeue
+    uint16_t unpacked_side;
+    struct HotPathStats *hotpath; // NULL unless --hotpath-stats
+    struct KernelTsStats *kernelts; // NULL unless --so-timestamping
+    struct ClockOffset *clkoffset; // NULL unless --clock-offset
+    struct LinkEmul *linkemul; // NULL unless --link-emul
 };
 
 extern struct PacketRing * packetring_init(int count, struct Condition *awake_consumer, struct Condition *awake_producer);
+extern void packetring_side_init(struct PacketRing *pr);
 extern void packetring_enqueue(struct PacketRing *pr, struct ReportStruct *metapacket);
 extern struct ReportStruct *packetring_dequeue(struct PacketRing * pr);
 extern void enqueue_ackring(struct PacketRing *pr, struct ReportStruct *metapacket);
@@ -145,6 +238,9 @@ extern struct ReportStruct *dequeue_ackring(struct PacketRing * pr);
 extern void packetring_free(struct PacketRing *pr);
 extern void free_ackring(struct PacketRing *pr);
 extern enum edgeLevel toggleLevel(enum edgeLevel level);
+extern double hotpath_now(void);
+extern void hotpath_syscall(struct HotPathStats *hp, double start);
+extern void hotpath_delay(struct HotPathStats *hp, double start, unsigned long usecs);
 #ifdef HAVE_THREAD_DEBUG
 extern int packetring_getcount(struct PacketRing *pr);
 #endif
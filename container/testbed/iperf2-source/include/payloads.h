@@ -80,6 +80,7 @@ extern "C" {
 #define HEADER_UDPAVOID2     0x02000000
 #define HEADER_UDPAVOID1     0x01000000
 #define HEADER_BOUNCEBACK    0x00800000
+#define HEADER_NSECTS        0x00400000
 
 #define HEADER32_SMALL_TRIPTIMES 0x00020000
 #define HEADER_LEN_BIT       0x00010000
@@ -110,7 +111,7 @@ extern "C" {
 #define HEADER_L2LENCHECK     0x0004
 #define HEADER_NOUDPFIN       0x0008
 #define HEADER_TRIPTIME       0x0010
-#define HEADER_UNUSED2        0x0020
+#define HEADER_CLKOFFSET      0x0020
 #define HEADER_ISOCH_SETTINGS 0x0040
 #define HEADER_UNITS_PPS      0x0080
 #define HEADER_BWSET          0x0100
@@ -126,6 +127,7 @@ extern "C" {
 #define HEADER_CCA          0x8000
 #define HEADER_BARRIER_TIME 0x4000
 #define HEADER_UDPL4S       0x2000
+#define HEADER_UDPFLOWS     0x1000
 
 // later features
 #define HDRXACKMAX 2500000 // default 2.5 seconds, units microseconds
@@ -143,7 +145,8 @@ enum MsgType {
     CLIENTHDRACK,
     CLIENTTCPHDR,
     SERVERHDR,
-    SERVERHDRACK
+    SERVERHDRACK,
+    CLKOFFSETECHO
 };
 
 #define MINIPERFPAYLOAD 18
@@ -558,6 +561,53 @@ struct client_udp_testhdr {
     struct client_hdrext_isoch_settings isoch_settings;
 };
 
+/*
+ * 64 bit nanosecond send timestamp per HEADER_NSECTS. It follows the
+ * client_udp_testhdr so an older server sees it as payload and keeps
+ * using the microsecond tv_sec/tv_usec in the UDP_datagram
+ */
+struct UDP_datagram_nsects {
+    uint32_t tv_nsec_u;
+    uint32_t tv_nsec_l;
+};
+
+/*
+ * Clock offset estimate per HEADER_CLKOFFSET, follows the nanosecond
+ * timestamp. The offset is the server clock minus the client clock at
+ * the packet's send time. A zero bound means no estimate yet.
+ */
+struct UDP_datagram_clkoffset {
+    uint32_t offset_ns_u;
+    uint32_t offset_ns_l;
+    uint32_t bound_ns;
+    int32_t drift_ppb;
+};
+
+/*
+ * Logical flow of a datagram per HEADER_UDPFLOWS, follows the clock
+ * offset estimate. The flows share the socket's sequence number in the
+ * UDP_datagram and each also has its own.
+ */
+struct UDP_datagram_flow {
+    uint32_t flowid;
+    uint32_t seqno_u;
+    uint32_t seqno_l;
+};
+
+/*
+ * Server to client echo of a HEADER_CLKOFFSET datagram, NTP style
+ * t1 client send, t2 server receive and t3 server send times (ns)
+ */
+struct clkoffset_echo {
+    struct hdr_typelen typelen;
+    uint32_t t1_u;
+    uint32_t t1_l;
+    uint32_t t2_u;
+    uint32_t t2_l;
+    uint32_t t3_u;
+    uint32_t t3_l;
+};
+
 struct client_udpsmall_testhdr {
     struct UDP_datagram seqno_ts;
     uint16_t flags;
@@ -724,6 +774,9 @@ struct server_hdr {
 #define SIZEOF_TCPHDRMSG_EXT (sizeof(struct client_tcp_testhdr))
 #define MINMBUFALLOCSIZE (int) (sizeof(struct client_tcp_testhdr)) + TAPBYTESSLOP
 #define MINTRIPTIMEPAYLOAD (int) (sizeof(struct client_udp_testhdr) - sizeof(struct client_hdrext_isoch_settings))
+#define MINNSECTSPAYLOAD (int) (sizeof(struct client_udp_testhdr) + sizeof(struct UDP_datagram_nsects))
+#define MINCLKOFFSETPAYLOAD (int) (MINNSECTSPAYLOAD + sizeof(struct UDP_datagram_clkoffset))
+#define MINUDPFLOWSPAYLOAD (int) (MINCLKOFFSETPAYLOAD + sizeof(struct UDP_datagram_flow))
 #ifdef __cplusplus
 } /* end extern "C" */
 #endif
@@ -0,0 +1,105 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * pcap_replay.h
+ * Replay of a capture's UDP datagram lengths and inter departure times,
+ * --pcap-replay <file>[,scale=<x>][,loop[=<n>]][,port=<p>]. The pcap or
+ * pcapng file is read with a built in parser, no libpcap, and reduced to
+ * a compact array of (gap, length) entries once at startup. The client
+ * then sends its own datagrams, with the iperf headers, on that schedule
+ * so the server's loss, latency and jitter accounting applies as usual.
+ *
+ * o) scale multiplies the gaps, e.g. 0.5 replays twice as fast
+ * o) loop replays the capture n times, no n loops until -t
+ * o) port keeps only the datagrams to or from that UDP port
+ *
+ * Gaps are stored already scaled in ns so the send loop only adds and
+ * compares. Idle periods longer than a uint32_t of ns take extra entries
+ * with a zero length.
+ * ------------------------------------------------------------------- */
+#ifndef PCAPREPLAY_H
+#define PCAPREPLAY_H
+
+#include "headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PCAPREPLAY_MAXLEN 65507 // largest UDP payload over IPv4
+#define PCAPREPLAY_LATE 100000  // ns, a departure later than this counts as late
+
+struct PcapReplayPkt {
+    uint32_t gap;       // ns since the previous entry, scaled
+    uint16_t len;       // UDP payload bytes, zero for an idle only entry
+};
+
+// Read only once loaded, shared by all the client's traffic threads
+struct PcapReplay {
+    struct PcapReplayPkt *pkts;
+    intmax_t count;     // entries
+    intmax_t datagrams; // entries with a length
+    intmax_t skipped;   // capture records that aren't UDP or not the port
+    int maxlen;
+    int64_t duration;   // ns, first to last datagram, scaled
+    int64_t wrapgap;    // ns, the last to the first datagram when looping
+    double scale;
+    int loops;          // zero loops until -t
+    int port;
+};
+
+// A traffic thread's replay counts, handed to its report before the
+// final packet for the reporter to output
+struct PcapReplayReport {
+    intmax_t sent;
+    intmax_t padded;    // shorter than the test header, sent at its length
+    intmax_t late;      // departed later than PCAPREPLAY_LATE
+    double lag_sum;     // ns
+    int64_t lag_max;    // ns
+};
+
+extern struct PcapReplay *pcap_replay_load(const char *spec);
+extern void pcap_replay_free(struct PcapReplay *pr);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // PCAPREPLAY_H
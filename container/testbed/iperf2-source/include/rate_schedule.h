@@ -0,0 +1,92 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * rate_schedule.h
+ * Time varying offered load for --rate-schedule, e.g. to follow a
+ * link's adaptive coding and modulation levels. A schedule file has
+ * one segment per line, a duration and a rate held for that duration
+ * or, with the ramp keyword, reached linearly by its end. The schedule
+ * repeats. Rates are bits per second with the -b suffixes or, with an
+ * x suffix, a multiple of -b.
+ *
+ *   # duration rate [ramp]
+ *   2s    1.0x
+ *   1s    0.8x
+ *   500ms 10m ramp
+ *
+ * Pacing integrates the schedule, so a rate change takes effect at the
+ * segment boundary and not the next time something polls for it.
+ * ------------------------------------------------------------------- */
+#ifndef RATESCHEDULE_H
+#define RATESCHEDULE_H
+
+#include "headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct RateSegment {
+    int64_t start;      // ns from the start of the period
+    int64_t duration;   // ns
+    double rate_start;  // bits per second, differs from rate_end for ramps
+    double rate_end;
+    double bits_before; // bits scheduled in the period before this segment
+};
+
+// Read only once loaded, shared by the traffic thread and the reporter
+struct RateSchedule {
+    int count;
+    int64_t period;     // ns, the sum of the durations
+    double period_bits;
+    struct RateSegment *segments;
+};
+
+extern struct RateSchedule *rate_schedule_load(const char *filename, double base_rate);
+extern void rate_schedule_free(struct RateSchedule *rs);
+extern double rate_schedule_bits(struct RateSchedule *rs, int64_t t0, int64_t t1);
+extern int64_t rate_schedule_advance(struct RateSchedule *rs, int64_t t, double bits);
+extern int rate_schedule_segment(struct RateSchedule *rs, int64_t t);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // RATESCHEDULE_H
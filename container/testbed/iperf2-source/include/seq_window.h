@@ -0,0 +1,94 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * seq_window.h
+ * Sliding bitmap window over the UDP sequence numbers (--reorder-window)
+ * so the server can tell in order, reordered, duplicate and late
+ * datagrams apart. A missing sequence number is only counted lost once
+ * the window slides past it, i.e. once it's more than the reorder
+ * tolerance behind the highest seen, so reordering doesn't read as loss.
+ * ------------------------------------------------------------------- */
+#ifndef SEQWINDOW_H
+#define SEQWINDOW_H
+
+#include "headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SEQWINDOW_DEFAULT 1024     // datagrams of reorder tolerance
+#define SEQWINDOW_MAX (1 << 24)
+
+enum SeqClass {
+    SEQ_INORDER = 0, // the highest yet, gaps before it are pending
+    SEQ_REORDERED,   // filled a pending gap
+    SEQ_DUPLICATE,   // already seen within the window
+    SEQ_LATE         // behind the window, it was already counted lost
+};
+
+struct SeqWindowCounters {
+    intmax_t lost;      // final, slid out of the window unseen
+    intmax_t reordered;
+    intmax_t duplicates;
+    intmax_t late;
+    intmax_t distance;  // sum of the reorder distances, datagrams behind the highest
+    intmax_t distance_max;
+};
+
+struct SeqWindow {
+    intmax_t tolerance;
+    intmax_t mask;     // bitmap is mask + 1 bits, a power of two over the tolerance
+    intmax_t top;      // highest sequence number seen
+    struct SeqWindowCounters cnt;
+    struct SeqWindowCounters prev; // reporter's copy at the last interval
+    uint64_t *bits;
+};
+
+extern struct SeqWindow *seqwin_alloc(intmax_t tolerance);
+extern void seqwin_free(struct SeqWindow *sw);
+extern enum SeqClass seqwin_packet(struct SeqWindow *sw, intmax_t seqno);
+extern void seqwin_flush(struct SeqWindow *sw);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // SEQWINDOW_H
@@ -0,0 +1,100 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * timer_wheel.h
+ * Central frame release for isochronous and burst flows (--tick-scheduler)
+ *
+ * A small number of scheduler threads each run a hierarchical timer
+ * wheel. Flow threads put their next frame deadline on a wheel and
+ * block on their own condition until the scheduler fires it, rather
+ * than each arming its own clock_nanosleep(). Insert and expire are
+ * O(1) so the scheduler's cost per tick doesn't grow with the number of
+ * flows, only with the number of frames actually due in that tick.
+ * ------------------------------------------------------------------- */
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include "headers.h"
+#include "Condition.h"
+
+#define TIMER_WHEEL_TICK_NS 100000     // 100 usecs resolution
+#define TIMER_WHEEL_ROOTBITS 8         // level 0, 256 ticks or 25.6 ms
+#define TIMER_WHEEL_LEVELBITS 6        // levels 1..3, 64 slots each
+#define TIMER_WHEEL_LEVELS 4           // spans 2^26 ticks or ~1.8 hours
+#define TIMER_WHEEL_ROOTSIZE (1 << TIMER_WHEEL_ROOTBITS)
+#define TIMER_WHEEL_LEVELSIZE (1 << TIMER_WHEEL_LEVELBITS)
+#define TIMER_WHEEL_MAXTHREADS 16
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct timer_wheel_entry {
+    struct timer_wheel_entry *next;
+    uint64_t expire;            // units ticks since the epoch
+    struct Condition await;
+    int fired;
+};
+
+struct timer_wheel {
+    struct Condition await;     // mutex guards the slots, signaled when idle wheel gets work
+    struct timer_wheel_entry *root[TIMER_WHEEL_ROOTSIZE];
+    struct timer_wheel_entry *level[TIMER_WHEEL_LEVELS - 1][TIMER_WHEEL_LEVELSIZE];
+    uint64_t current;           // last tick processed
+    int count;                  // entries on the wheel
+    uintmax_t ticks;
+    uintmax_t fired;
+    uintmax_t cascaded;
+};
+
+// Returns 0 on success, the scheduler threads are detached
+extern int timer_wheel_start(int threads);
+// Round robin wheel for a new flow, NULL when the scheduler isn't running
+extern struct timer_wheel *timer_wheel_attach(void);
+extern void timer_wheel_entry_init(struct timer_wheel_entry *entry);
+extern void timer_wheel_entry_destroy(struct timer_wheel_entry *entry);
+// Block until the CLOCK_REALTIME deadline's tick fires, returns 0 like clock_nanosleep()
+extern int timer_wheel_wait(struct timer_wheel *wheel, struct timer_wheel_entry *entry, struct timespec *deadline);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // TIMER_WHEEL_H
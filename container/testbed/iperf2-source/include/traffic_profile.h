@@ -0,0 +1,87 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * traffic_profile.h
+ * A declared mix of flows run by one client process, --profile. The
+ * file has one flow per line, a name followed by the client options
+ * for that flow. Options on the command line are common to every flow
+ * and a line's options override them.
+ *
+ *   # name options
+ *   voip   -u -b 64k -l 200 --tos 0xb8
+ *   video  -u --isochronous=60:8m,2m --tos 0x88 --txdelay-time 1
+ *   bulk   -P 2
+ *   web    --burst-period 0.5 --burst-size 512K
+ *
+ * The flows share the process's scheduler and reporter. Their reports
+ * are on one clock, the profile start, and one interval grid so that
+ * the lines of different flows, and the sum, are time aligned. A flow
+ * delayed by --txdelay-time starts its first interval at its offset.
+ * ------------------------------------------------------------------- */
+#ifndef TRAFFICPROFILE_H
+#define TRAFFICPROFILE_H
+
+#include "headers.h"
+#include "Mutex.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRAFFICPROFILE_MAXARGS 64
+
+struct thread_Settings;
+struct ReportTimeStamps;
+
+// One per process, shared by all the flows of the profile
+struct TrafficProfile {
+    Mutex lock;
+    struct timeval origin; // set by the first flow to start
+    int flows;
+};
+
+extern struct thread_Settings *traffic_profile_load(int argc, char **argv, struct thread_Settings *common);
+extern void traffic_profile_start(struct TrafficProfile *profile, struct ReportTimeStamps *ts, const struct timeval *holdback);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // TRAFFICPROFILE_H
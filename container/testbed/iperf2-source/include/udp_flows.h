@@ -0,0 +1,124 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * udp_flows.h
+ * Many logical UDP flows multiplexed over one socket, --udp-flows. Each
+ * datagram carries a flow id and the flow's own sequence number past the
+ * test header (struct UDP_datagram_flow), while the socket sequence
+ * number in the UDP_datagram stays as it is, so the server's loss, FIN
+ * and everything else keyed by it carry on unchanged.
+ *
+ * o) sender, a min-heap of the flows' next send times, each flow paced
+ *    to -b on its own with its own length pattern when -l is a markov
+ *    chain, the flows' start phases spread over one inter packet gap
+ * o) receiver, flows indexed by id with per flow packets, bytes, loss,
+ *    reordering and RFC 3550 jitter off its own sequence and transit
+ *
+ * One thread and one socket carry all the flows, e.g. hundreds of VoIP
+ * calls, instead of a thread and a server accept per call with -P.
+ * ------------------------------------------------------------------- */
+#ifndef UDPFLOWS_H
+#define UDPFLOWS_H
+
+#include "headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UDPFLOWS_MAX 65536
+#define UDPFLOWS_MAXLAG 100000000 // ns, a flow further behind restarts its schedule from now
+
+struct markov_graph;
+
+struct UDPFlowsTx {
+    int flows;
+    int minlen;                 // the flow record has to fit
+    int buflen;
+    double rate;                // per flow, bits or packets per second
+    bool pps;
+    int *heap;                  // flow ids ordered by next send time
+    int64_t *next;              // ns relative to the start
+    intmax_t *seqno;
+    struct markov_graph **len_graph;
+};
+
+struct UDPFlowCounters {
+    intmax_t packets;
+    intmax_t bytes;
+    intmax_t lost;
+    intmax_t reordered;
+};
+
+struct UDPFlow {
+    struct UDPFlowCounters cnt;
+    struct UDPFlowCounters prev; // reporter's copy at the last interval
+    intmax_t top;                // highest sequence number seen
+    int64_t transit;             // ns, the last
+    double jitter;               // ns
+};
+
+struct UDPFlowsRx {
+    int slots;
+    int flows;                   // highest flow id seen plus one
+    intmax_t unknown;            // datagrams with a flow id out of range
+    struct UDPFlow *flow;
+};
+
+extern struct UDPFlowsTx *udpflows_tx_alloc(int flows, double rate, bool pps, int buflen, int minlen, char *braket);
+extern void udpflows_tx_free(struct UDPFlowsTx *tx);
+extern int udpflows_tx_len(struct UDPFlowsTx *tx, int flowid);
+extern void udpflows_tx_advance(struct UDPFlowsTx *tx, int len, int64_t now);
+
+// The flow with the earliest send time is at the top of the heap
+static inline int udpflows_tx_next (struct UDPFlowsTx *tx) {
+    return tx->heap[0];
+}
+
+extern struct UDPFlowsRx *udpflows_rx_alloc(void);
+extern void udpflows_rx_free(struct UDPFlowsRx *rx);
+extern void udpflows_rx_packet(struct UDPFlowsRx *rx, uint32_t flowid, intmax_t seqno, intmax_t len, int64_t transit);
+extern void udpflows_rx_next_interval(struct UDPFlowsRx *rx);
+
+#ifdef __cplusplus
+} /* end extern "C" */
+#endif
+#endif // UDPFLOWS_H
@@ -56,6 +56,7 @@
 #ifdef HAVE_CONFIG_H
     #include "config.h"
 #endif
+#include "fastclock.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -202,7 +203,17 @@ void make_lower(char *s);
 #define rMillion 1000000
 
 
-#ifdef HAVE_CLOCK_GETTIME
+#if HAVE_FASTCLOCK
+#define TimeGetNow(timeval) do { \
+    struct timespec t1;			\
+    if (fastclock_enabled)		\
+	fastclock_gettime(&t1);		\
+    else				\
+	clock_gettime(CLOCK_REALTIME, &t1); \
+    timeval.tv_sec  = t1.tv_sec; \
+    timeval.tv_usec = t1.tv_nsec / 1000; \
+} while (0)
+#elif defined(HAVE_CLOCK_GETTIME)
 #define TimeGetNow(timeval) do { \
     struct timespec t1;			\
     clock_gettime(CLOCK_REALTIME, &t1); \
@@ -226,6 +237,8 @@ void make_lower(char *s);
 
 #define TimeDouble(timeval) (timeval.tv_sec + timeval.tv_usec / ((double) rMillion))
 
+#define TimeNsecs(timeval) ((((int64_t) timeval.tv_sec) * 1000000000LL) + (((int64_t) timeval.tv_usec) * 1000))
+
 #define TimeAdd(left, right)  do {                                    \
                                     left.tv_usec += right.tv_usec;      \
                                     if (left.tv_usec > rMillion) {    \
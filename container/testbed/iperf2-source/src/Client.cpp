@@ -65,8 +65,14 @@
 #include "pdfs.h"
 #include "version.h"
 #include "payloads.h"
+#include "iperf_probes.h"
 #include "active_hosts.h"
 #include "gettcpinfo.h"
+#include "kernel_timestamps.h"
+#include "clock_offset.h"
+#include "traffic_profile.h"
+#include "udp_flows.h"
+#include "pcap_replay.h"
 
 // const double kSecs_to_usecs = 1e6;
 const double kSecs_to_nsecs = 1e9;
@@ -83,11 +89,18 @@ Client::Client (thread_Settings *inSettings) {
     mSettings = inSettings;
     myJob = NULL;
     myReport = NULL;
+    hotpath = NULL;
+    kernelts = NULL;
+    clkoffset = NULL;
+    clkoffset_lastpoll = 0;
+    delay_pacer_init(&pacer);
     framecounter = NULL;
     one_report = false;
     udp_payload_minimum = 1;
+    udp_nsects = false;
     apply_first_udppkt_delay = false;
     markov_graph_len = NULL;
+    rateschedule = NULL;
     memset(&scratchpad, 0, sizeof(struct ReportStruct));
     reportstruct = &scratchpad;
     reportstruct->packetID = 1;
@@ -305,21 +318,66 @@ inline void Client::mygetTcpInfo (void) {
 }
 inline int Client::myWrite (int inSock, const void *inBuf, int inLen) {
     mygetTcpInfo();
+    if (hotpath) {
+        double start = hotpath_now();
+        int rc = write(inSock, inBuf, inLen);
+        hotpath_syscall(hotpath, start);
+        return rc;
+    }
     return write(inSock, inBuf, inLen);
 }
 inline int Client::myWriten(int inSock, const void *inBuf, int inLen, int *count) {
     mygetTcpInfo();
+    if (hotpath) {
+        double start = hotpath_now();
+        int rc = writen(inSock, inBuf, inLen, count);
+        hotpath_syscall(hotpath, start);
+        return rc;
+    }
     return writen(inSock, inBuf, inLen, count);
 }
 #else
 inline int Client::myWrite (int inSock, const void *inBuf, int inLen) {
+    if (hotpath) {
+        double start = hotpath_now();
+        int rc = write(inSock, inBuf, inLen);
+        hotpath_syscall(hotpath, start);
+        return rc;
+    }
     return write(inSock, inBuf, inLen);
 }
 inline int Client::myWriten(int inSock, const void *inBuf, int inLen, int *count) {
+    if (hotpath) {
+        double start = hotpath_now();
+        int rc = writen(mySocket, mSettings->mBuf, inLen, count);
+        hotpath_syscall(hotpath, start);
+        return rc;
+    }
     return writen(mySocket, mSettings->mBuf, inLen, count);
 }
 #endif
 
+// Pacing delay in nanoseconds using the thread's calibrated sleep then spin
+// pacer, with --hotpath-stats also account for oversleep
+inline void Client::myDelayLoop (double nsecs) {
+    if (hotpath) {
+        double start = hotpath_now();
+        delay_pacer(&pacer, nsecs);
+        hotpath_delay(hotpath, start, static_cast<unsigned long>(nsecs / 1000));
+    } else {
+        delay_pacer(&pacer, nsecs);
+    }
+}
+
+// Capture FrameCounter::wait_tick() slips and scheduling error for --hotpath-stats
+inline void Client::myTickStats (void) {
+    if (hotpath) {
+        hotpath->tick_slips = framecounter->slip;
+        if (reportstruct->sched_err > hotpath->sched_err_max)
+            hotpath->sched_err_max = reportstruct->sched_err;
+    }
+}
+
 // There are multiple startup synchronizations, this code
 // handles them all. The caller decides to apply them
 // either before connect() or after connect() and before writes()
@@ -333,9 +391,13 @@ int Client::StartSynch () {
     }
     myJob = InitIndividualReport(mSettings);
     myReport = static_cast<struct ReporterData *>(myJob->this_report);
+    hotpath = myReport->packetring->hotpath;
+    kernelts = myReport->packetring->kernelts;
+    clkoffset = myReport->packetring->clkoffset;
     myReport->info.common->socket=mySocket;
     myReport->info.isEnableTcpInfo = false; // default here, set in init traffic actions
     markov_graph_len = myReport->info.markov_graph_len;
+    rateschedule = myReport->info.rate_schedule;
     if (!isReverse(mSettings) && (mSettings->mReportMode == kReport_CSV)) {
         format_ips_port_string(&myReport->info, 0);
     }
@@ -386,6 +448,8 @@ int Client::StartSynch () {
         }
         if (mSettings->mFPS > 0) {
             framecounter = new Isochronous::FrameCounter(mSettings->mFPS, tmp);
+            if (isTickScheduler(mSettings))
+                framecounter->set_timer_wheel(timer_wheel_attach());
             // set the mbuf valid for burst period ahead of time. The same value will be set for all burst writes
             if (!isUDP(mSettings) && framecounter) {
                 struct TCP_burst_payload * mBuf_burst = reinterpret_cast<struct TCP_burst_payload *>(mSettings->mBuf);
@@ -472,12 +536,18 @@ inline void Client::SetReportStartTime () {
         myReport->info.ts.nextTime = myReport->info.ts.startTime;
         TimeAdd(myReport->info.ts.nextTime, myReport->info.ts.intervalTime);
     }
+    if (mSettings->mProfile) {
+        // all the flows of a --profile report on one clock and interval grid
+        traffic_profile_start(mSettings->mProfile, &myReport->info.ts, (isTxHoldback(mSettings) ? &mSettings->txholdback_timer : NULL));
+    }
     if (myReport->GroupSumReport) {
         struct TransferInfo *sumstats = &myReport->GroupSumReport->info;
         assert(sumstats != NULL);
         Mutex_Lock(&myReport->GroupSumReport->reference.lock);
         if (TimeZero(sumstats->ts.startTime)) {
             sumstats->ts.startTime = myReport->info.ts.startTime;
+            sumstats->ts.tStart = myReport->info.ts.tStart;
+            sumstats->ts.iEnd = myReport->info.ts.iEnd;
             if (mSettings->mIntervalMode == kInterval_Time) {
                 sumstats->ts.nextTime = myReport->info.ts.nextTime;
             }
@@ -573,6 +643,20 @@ void Client::InitTrafficLoop () {
     // set the lower bounds delay based of the socket timeout timer
     // units needs to be in nanoseconds
     delay_lower_bounds = static_cast<double>(sosndtimer) * -1e3;
+    // Enable transmit stamps now so the kernel's write ids start with the traffic loop
+    if (kernelts && (kernelts_enable_tx(mySocket, isHwTimestamping(mSettings), mSettings->mIfrnametx) != 0)) {
+        WARN_errno(1, "setsockopt SO_TIMESTAMPING");
+        kernelts = NULL;
+    }
+#ifdef SO_TIMESTAMPNS
+    // Kernel receive times for the server's clock offset echoes
+    if (clkoffset) {
+        int timestampOn = 1;
+        if (setsockopt(mySocket, SOL_SOCKET, SO_TIMESTAMPNS, &timestampOn, sizeof(timestampOn)) < 0) {
+            WARN_errno(1, "setsockopt SO_TIMESTAMPNS");
+        }
+    }
+#endif
 
     if (isIsochronous(mSettings))
         myReport->info.matchframeID = 1;
@@ -627,7 +711,11 @@ void Client::Run () {
             readAt += sizeof(struct UDP_datagram);
         }
         // Launch the approprate UDP traffic loop
-        if (isIsochronous(mSettings)) {
+        if (isUDPFlows(mSettings)) {
+            RunUDPFlows();
+        } else if (mSettings->mPcapReplay) {
+            RunUDPPcapReplay();
+        } else if (isIsochronous(mSettings)) {
             RunUDPIsochronous();
         } else if (isBurstSize(mSettings)) {
             RunUDPBurst();
@@ -642,7 +730,7 @@ void Client::Run () {
         // Launch the approprate TCP traffic loop
         if (isBounceBack(mSettings)) {
             RunBounceBackTCP();
-        } else if (mSettings->mAppRate > 0) {
+        } else if ((mSettings->mAppRate > 0) || rateschedule) {
             RunRateLimitedTCP();
         } else if (isNearCongest(mSettings)) {
             RunNearCongestionTCP();
@@ -796,6 +884,8 @@ void Client::RunTCP () {
                 mSettings->mAmount = 0;
             }
         }
+        IPERF_PROBE5(tcp_send, myReport->info.common->transferID, reportstruct->writecnt, reportstruct->packetLen, \
+                     reportstruct->packetTime.tv_sec, reportstruct->packetTime.tv_usec);
         if (!one_report) {
 #if (HAVE_DECL_SO_MAX_PACING_RATE)
             if (isFQPacing(mSettings)) {
@@ -901,8 +991,13 @@ void Client::RunNearCongestionTCP () {
 #else
             pacing_timer = static_cast<int>(100 * mSettings->rtt_nearcongest_weight_factor);
 #endif
-            if (pacing_timer)
-                delay_loop(pacing_timer);
+            if (pacing_timer) {
+                // the near congestion delay stays on delay_loop(), the pacer is for the UDP loops
+                double start = (hotpath ? hotpath_now() : 0);
+                delay_loop(static_cast<unsigned long>(pacing_timer));
+                if (hotpath)
+                    hotpath_delay(hotpath, start, static_cast<unsigned long>(pacing_timer));
+            }
         }
     }
     FinishTrafficActions();
@@ -919,6 +1014,9 @@ void Client::RunRateLimitedTCP () {
 
     long var_rate = mSettings->mAppRate;
     int fatalwrite_err = 0;
+    // --rate-schedule times are relative to the report start so the intervals line up
+    int64_t schedule_origin = TimeNsecs(myReport->info.ts.startTime);
+    int64_t schedule_time = time1.getNsecs() - schedule_origin;
 
     now.setnow();
     reportstruct->packetTime.tv_sec = now.getSecs();
@@ -936,7 +1034,14 @@ void Client::RunRateLimitedTCP () {
                     var_rate = 0;
             }
         }
-        tokens += time2.subSec(time1) * (var_rate / 8.0);
+        if (rateschedule) {
+            // the schedule's bits between the loops, exact across rate changes
+            int64_t t2 = time2.getNsecs() - schedule_origin;
+            tokens += rate_schedule_bits(rateschedule, schedule_time, t2) / 8.0;
+            schedule_time = t2;
+        } else {
+            tokens += time2.subSec(time1) * (var_rate / 8.0);
+        }
         time1 = time2;
         if (tokens >= 0.0) {
             if (isModeAmount(mSettings)) {
@@ -1149,6 +1254,8 @@ void Client::RunWriteEventsTCP () {
                 mSettings->mAmount = 0;
             }
         }
+        IPERF_PROBE5(tcp_send, myReport->info.common->transferID, reportstruct->writecnt, reportstruct->packetLen, \
+                     reportstruct->packetTime.tv_sec, reportstruct->packetTime.tv_usec);
         if (!one_report) {
 #if (HAVE_DECL_SO_MAX_PACING_RATE)
             if (isFQPacing(mSettings)) {
@@ -1334,6 +1441,8 @@ void Client::RunUDP () {
     // Set this to > 0 so first loop iteration will delay the IPG
     currLen = 1;
     double variance = mSettings->mVariance;
+    // --rate-schedule time of the current datagram, relative to the report start
+    int64_t schedule_time = 0;
     if (apply_first_udppkt_delay && (delay_target > 100000)) {
         //the case when a UDP first packet went out in SendFirstPayload
         delay_loop(static_cast<unsigned long>(delay_target / 1000));
@@ -1368,6 +1477,24 @@ void Client::RunUDP () {
         WritePacketID(reportstruct->packetID);
         mBuf_UDP->tv_sec  = htonl(reportstruct->packetTime.tv_sec);
         mBuf_UDP->tv_usec = htonl(reportstruct->packetTime.tv_usec);
+        if (udp_nsects)
+            WriteNsecTs(now.getNsecs());
+        if (clkoffset)
+            WriteClockOffset(now.getNsecs());
+        // the length is picked up front so the schedule paces on what's written
+        int writelen;
+        if (isModeAmount(mSettings)) {
+            writelen = ((mSettings->mAmount < static_cast<unsigned>(mSettings->mBufLen)) ? mSettings->mAmount : mSettings->mBufLen);
+        } else {
+            writelen = (markov_graph_len ? markov_graph_next(markov_graph_len) : mSettings->mBufLen);
+        }
+        if (rateschedule) {
+            // the gap to the next datagram is where the schedule has carried
+            // this one's bits, so rate changes land on their boundaries
+            int64_t next = rate_schedule_advance(rateschedule, schedule_time, writelen * kBytes_to_Bits);
+            delay_target = static_cast<double>(next - schedule_time);
+            schedule_time = next;
+        }
 
         if (delay_target > 0) {
             // Adjustment for the running delay
@@ -1396,17 +1523,20 @@ void Client::RunUDP () {
 	    // Don't let delay grow unbounded
 	    if (delay < delay_lower_bounds) {
 		delay = delay_target;
+		// too far behind, so the schedule restarts from now too
+		if (rateschedule)
+		    schedule_time = now.getNsecs() - TimeNsecs(myReport->info.ts.startTime) + static_cast<int64_t>(delay_target);
 	    }
 	}
 	reportstruct->err_readwrite = WriteSuccess;
 	reportstruct->emptyreport = false;
 	// perform write
-	if (isModeAmount(mSettings)) {
-	    currLen = write(mySocket, mSettings->mBuf, (mSettings->mAmount < static_cast<unsigned>(mSettings->mBufLen)) ? mSettings->mAmount : mSettings->mBufLen);
-	} else {
-	    int markov_len = (markov_graph_len ? markov_graph_next(markov_graph_len) : mSettings->mBufLen);
-	    currLen = write(mySocket, mSettings->mBuf, markov_len);
-	}
+	double hotpath_start = (hotpath ? hotpath_now() : 0);
+	currLen = write(mySocket, mSettings->mBuf, writelen);
+	if (hotpath)
+	    hotpath_syscall(hotpath, hotpath_start);
+	if (kernelts && (currLen > 0))
+	    kernelts_tx_sent(kernelts, mySocket, now.getNsecs());
 	if (currLen <= 0) {
 	    reportstruct->emptyreport = true;
 	    if (currLen == 0) {
@@ -1436,19 +1566,232 @@ void Client::RunUDP () {
         // report packets
         reportstruct->packetLen = static_cast<unsigned long>(currLen);
         reportstruct->prevPacketTime = myReport->info.ts.prevpacketTime;
+        IPERF_PROBE5(udp_send, myReport->info.common->transferID, reportstruct->packetID, reportstruct->packetLen, \
+                     reportstruct->packetTime.tv_sec, reportstruct->packetTime.tv_usec);
         myReportPacket();
         if (!reportstruct->emptyreport) {
             reportstruct->packetID++;
             myReport->info.ts.prevpacketTime = reportstruct->packetTime;
-            // Insert delay here only if the running delay is greater than 100 usec,
+            // Insert delay here only if the running delay is greater than 1 usec,
             // otherwise don't delay and immediately continue with the next tx.
-            if (delay >= 100000) {
-                // Convert from nanoseconds to microseconds
-                // and invoke the microsecond delay
-                delay_loop(static_cast<unsigned long>(delay / 1000));
+            // The pacer spins the sub margin remainder so short gaps no longer
+            // have to be batched into micro bursts.
+            if (delay >= 1000) {
+                myDelayLoop(delay);
+            }
+        }
+    }
+    FinishTrafficActions();
+}
+
+/*
+ * UDP send loop for --udp-flows, many logical flows over the one socket
+ * each paced to -b on its own. The flow with the earliest send time goes
+ * next and each datagram carries its flow id and flow sequence number
+ * past the test header
+ */
+void Client::RunUDPFlows () {
+    struct UDP_datagram* mBuf_UDP = reinterpret_cast<struct UDP_datagram*>(mSettings->mBuf);
+    struct UDP_datagram_flow *mBuf_flow = reinterpret_cast<struct UDP_datagram_flow *>(mSettings->mBuf + MINCLKOFFSETPAYLOAD);
+    struct UDPFlowsTx *tx = udpflows_tx_alloc(mSettings->mUDPFlows, static_cast<double>(mSettings->mAppRate), \
+                                              (mSettings->mAppRateUnits == kRate_PPS), mSettings->mBufLen, \
+                                              MINUDPFLOWSPAYLOAD, mSettings->mBraKetGraph);
+    FAIL((tx == NULL), "Out of Memory!!\n", mSettings);
+    int64_t start = TimeNsecs(myReport->info.ts.startTime);
+    int currLen;
+
+    while (InProgress()) {
+        int flowid = udpflows_tx_next(tx);
+        now.setnow();
+        int64_t wait = (start + tx->next[flowid]) - now.getNsecs();
+        if (wait >= 1000) {
+            myDelayLoop(static_cast<double>(wait));
+            now.setnow();
+        }
+        reportstruct->writecnt = 1;
+        reportstruct->packetTime.tv_sec = now.getSecs();
+        reportstruct->packetTime.tv_usec = now.getUsecs();
+        reportstruct->sentTime = reportstruct->packetTime;
+        WritePacketID(reportstruct->packetID);
+        mBuf_UDP->tv_sec  = htonl(reportstruct->packetTime.tv_sec);
+        mBuf_UDP->tv_usec = htonl(reportstruct->packetTime.tv_usec);
+        if (udp_nsects)
+            WriteNsecTs(now.getNsecs());
+        if (clkoffset)
+            WriteClockOffset(now.getNsecs());
+        intmax_t flowseqno = ++tx->seqno[flowid];
+        mBuf_flow->flowid = htonl(static_cast<uint32_t>(flowid));
+        mBuf_flow->seqno_u = htonl(static_cast<uint32_t>(static_cast<uint64_t>(flowseqno) >> 32));
+        mBuf_flow->seqno_l = htonl(static_cast<uint32_t>(flowseqno & 0xFFFFFFFFLL));
+        int len = udpflows_tx_len(tx, flowid);
+        if (isModeAmount(mSettings) && (mSettings->mAmount < static_cast<unsigned>(len)))
+            len = ((mSettings->mAmount > static_cast<unsigned>(MINUDPFLOWSPAYLOAD)) ? static_cast<int>(mSettings->mAmount) : MINUDPFLOWSPAYLOAD);
+        reportstruct->err_readwrite = WriteSuccess;
+        reportstruct->emptyreport = false;
+        double hotpath_start = (hotpath ? hotpath_now() : 0);
+        currLen = write(mySocket, mSettings->mBuf, len);
+        if (hotpath)
+            hotpath_syscall(hotpath, hotpath_start);
+        if (kernelts && (currLen > 0))
+            kernelts_tx_sent(kernelts, mySocket, now.getNsecs());
+        if (currLen <= 0) {
+            reportstruct->emptyreport = true;
+            // the flow's datagram never went out so it keeps its sequence number
+            tx->seqno[flowid]--;
+            if (currLen == 0) {
+                reportstruct->err_readwrite = WriteTimeo;
+            } else {
+                if (FATALUDPWRITERR(errno)) {
+                    reportstruct->err_readwrite = WriteErrFatal;
+                    WARN_errno(1, "write");
+                    currLen = 0;
+                    break;
+                } else {
+                    currLen = 0;
+                    reportstruct->err_readwrite = WriteErrAccount;
+                }
+            }
+        }
+        if (isModeAmount(mSettings)) {
+            if (mSettings->mAmount >= static_cast<unsigned long>(currLen)) {
+                mSettings->mAmount -= static_cast<unsigned long>(currLen);
+            } else {
+                mSettings->mAmount = 0;
             }
         }
+        reportstruct->packetLen = static_cast<unsigned long>(currLen);
+        reportstruct->prevPacketTime = myReport->info.ts.prevpacketTime;
+        IPERF_PROBE5(udp_send, myReport->info.common->transferID, reportstruct->packetID, reportstruct->packetLen, \
+                     reportstruct->packetTime.tv_sec, reportstruct->packetTime.tv_usec);
+        myReportPacket();
+        if (!reportstruct->emptyreport) {
+            reportstruct->packetID++;
+            myReport->info.ts.prevpacketTime = reportstruct->packetTime;
+            udpflows_tx_advance(tx, currLen, now.getNsecs() - start);
+        }
     }
+    // the FIN datagrams reuse the buffer, so they carry no flow record
+    memset(mBuf_flow, 0, sizeof(struct UDP_datagram_flow));
+    FinishTrafficActions();
+    udpflows_tx_free(tx);
+}
+
+/*
+ * UDP send loop for --pcap-replay, the lengths and gaps of a capture's
+ * datagrams. Departures follow the capture's absolute schedule from the
+ * start so a late datagram doesn't push out the ones after it, i.e. the
+ * pacing catches back up rather than drift
+ */
+void Client::RunUDPPcapReplay () {
+    struct UDP_datagram* mBuf_UDP = reinterpret_cast<struct UDP_datagram*>(mSettings->mBuf);
+    struct PcapReplay *pr = mSettings->mPcapReplay;
+    int64_t start = TimeNsecs(myReport->info.ts.startTime);
+    int64_t schedule_time = 0;
+    struct PcapReplayReport replay;
+    intmax_t ix = 0;
+    int loop = 0;
+    bool last = false;
+    int currLen;
+
+    memset(&replay, 0, sizeof(struct PcapReplayReport));
+    while (InProgress()) {
+        struct PcapReplayPkt *pkt = &pr->pkts[ix];
+        schedule_time += pkt->gap;
+        if (++ix == pr->count) {
+            ix = 0;
+            if (pr->loops && (++loop >= pr->loops))
+                last = true;
+            else
+                schedule_time += pr->wrapgap;
+        }
+        if (pkt->len == 0) {
+            // an idle period longer than one entry's gap, which can end the last loop
+            if (last)
+                break;
+            continue;
+        }
+        now.setnow();
+        int64_t lag = now.getNsecs() - (start + schedule_time);
+        if (lag <= -1000) {
+            struct timespec deadline;
+            deadline.tv_sec = static_cast<time_t>((start + schedule_time) / 1000000000LL);
+            deadline.tv_nsec = static_cast<long>((start + schedule_time) % 1000000000LL);
+            delay_pacer_abstime(&pacer, &deadline);
+            now.setnow();
+            lag = now.getNsecs() - (start + schedule_time);
+        }
+        if (lag > 0) {
+            replay.lag_sum += lag;
+            if (lag > replay.lag_max)
+                replay.lag_max = lag;
+            if (lag > PCAPREPLAY_LATE)
+                replay.late++;
+        }
+        reportstruct->writecnt = 1;
+        reportstruct->packetTime.tv_sec = now.getSecs();
+        reportstruct->packetTime.tv_usec = now.getUsecs();
+        reportstruct->sentTime = reportstruct->packetTime;
+        WritePacketID(reportstruct->packetID);
+        mBuf_UDP->tv_sec  = htonl(reportstruct->packetTime.tv_sec);
+        mBuf_UDP->tv_usec = htonl(reportstruct->packetTime.tv_usec);
+        if (udp_nsects)
+            WriteNsecTs(now.getNsecs());
+        if (clkoffset)
+            WriteClockOffset(now.getNsecs());
+        // datagrams shorter than the test header carry it anyway
+        int len = pkt->len;
+        if (len < udp_payload_minimum) {
+            len = udp_payload_minimum;
+            replay.padded++;
+        }
+        if (isModeAmount(mSettings) && (mSettings->mAmount < static_cast<unsigned>(len)))
+            len = static_cast<int>(mSettings->mAmount);
+        reportstruct->err_readwrite = WriteSuccess;
+        reportstruct->emptyreport = false;
+        double hotpath_start = (hotpath ? hotpath_now() : 0);
+        currLen = write(mySocket, mSettings->mBuf, len);
+        if (hotpath)
+            hotpath_syscall(hotpath, hotpath_start);
+        if (kernelts && (currLen > 0))
+            kernelts_tx_sent(kernelts, mySocket, now.getNsecs());
+        if (currLen <= 0) {
+            reportstruct->emptyreport = true;
+            if (currLen == 0) {
+                reportstruct->err_readwrite = WriteTimeo;
+            } else {
+                if (FATALUDPWRITERR(errno)) {
+                    reportstruct->err_readwrite = WriteErrFatal;
+                    WARN_errno(1, "write");
+                    currLen = 0;
+                    break;
+                } else {
+                    currLen = 0;
+                    reportstruct->err_readwrite = WriteErrAccount;
+                }
+            }
+        }
+        if (isModeAmount(mSettings)) {
+            if (mSettings->mAmount >= static_cast<unsigned long>(currLen)) {
+                mSettings->mAmount -= static_cast<unsigned long>(currLen);
+            } else {
+                mSettings->mAmount = 0;
+            }
+        }
+        reportstruct->packetLen = static_cast<unsigned long>(currLen);
+        reportstruct->prevPacketTime = myReport->info.ts.prevpacketTime;
+        IPERF_PROBE5(udp_send, myReport->info.common->transferID, reportstruct->packetID, reportstruct->packetLen, \
+                     reportstruct->packetTime.tv_sec, reportstruct->packetTime.tv_usec);
+        myReportPacket();
+        if (!reportstruct->emptyreport) {
+            reportstruct->packetID++;
+            myReport->info.ts.prevpacketTime = reportstruct->packetTime;
+        }
+        replay.sent++;
+        if (last)
+            break;
+    }
+    // the reporter outputs these with the final report, which the final packet triggers
+    myReport->info.pcapreplay = replay;
     FinishTrafficActions();
 }
 
@@ -1470,6 +1813,8 @@ void Client::RunUDPIsochronous () {
     // make sure the packet can carry the isoch payload
     if (!framecounter) {
         framecounter = new Isochronous::FrameCounter(mSettings->mFPS);
+        if (isTickScheduler(mSettings))
+            framecounter->set_timer_wheel(timer_wheel_attach());
     }
     udp_payload->isoch.burstperiod = htonl(framecounter->period_us());
 
@@ -1486,6 +1831,7 @@ void Client::RunUDPIsochronous () {
         udp_payload->isoch.prevframeid  = htonl(frameid);
         reportstruct->burstsize=bytecnt;
         frameid =  framecounter->wait_tick(&reportstruct->sched_err, true);
+        myTickStats();
         reportstruct->scheduled = true;
         udp_payload->isoch.frameid  = htonl(frameid);
         lastPacketTime.setnow();
@@ -1501,6 +1847,10 @@ void Client::RunUDPIsochronous () {
             reportstruct->sentTime = reportstruct->packetTime;
             mBuf_UDP->tv_sec  = htonl(reportstruct->packetTime.tv_sec);
             mBuf_UDP->tv_usec = htonl(reportstruct->packetTime.tv_usec);
+            if (udp_nsects)
+                WriteNsecTs(t1.getNsecs());
+            if (clkoffset)
+                WriteClockOffset(t1.getNsecs());
             WritePacketID(reportstruct->packetID);
 
             // Adjustment for the running delay
@@ -1536,6 +1886,7 @@ void Client::RunUDPIsochronous () {
             reportstruct->writecnt = 1;
 
 	    // perform write
+	    double hotpath_start = (hotpath ? hotpath_now() : 0);
 	    if (isModeAmount(mSettings) && (mSettings->mAmount < static_cast<unsigned>(mSettings->mBufLen))) {
 	        udp_payload->isoch.remaining = htonl(mSettings->mAmount);
 		reportstruct->remaining=mSettings->mAmount;
@@ -1545,6 +1896,10 @@ void Client::RunUDPIsochronous () {
 		reportstruct->remaining=bytecnt;
 	        currLen = write(mySocket, mSettings->mBuf, (bytecnt < mSettings->mBufLen) ? bytecnt : mSettings->mBufLen);
 	    }
+	    if (hotpath)
+		hotpath_syscall(hotpath, hotpath_start);
+	    if (kernelts && (currLen > 0))
+		kernelts_tx_sent(kernelts, mySocket, t1.getNsecs());
             if (currLen < 0) {
                 reportstruct->packetID--;
                 reportstruct->emptyreport = true;
@@ -1583,6 +1938,8 @@ void Client::RunUDPIsochronous () {
             reportstruct->frameID=frameid;
             reportstruct->packetLen = static_cast<unsigned long>(currLen);
             reportstruct->prevPacketTime = myReport->info.ts.prevpacketTime;
+            IPERF_PROBE5(udp_send, myReport->info.common->transferID, reportstruct->packetID, reportstruct->packetLen, \
+                         reportstruct->packetTime.tv_sec, reportstruct->packetTime.tv_usec);
             myReportPacket();
             reportstruct->scheduled = false; // reset to false after the report
             reportstruct->packetID++;
@@ -1590,9 +1947,7 @@ void Client::RunUDPIsochronous () {
             // Insert delay here only if the running delay is greater than 1 usec,
             // otherwise don't delay and immediately continue with the next tx.
             if (delay >= 1000) {
-                // Convert from nanoseconds to microseconds
-                // and invoke the microsecond delay
-                delay_loop(static_cast<unsigned long>(delay / 1000));
+                myDelayLoop(delay);
             }
         }
     }
@@ -1606,10 +1961,13 @@ void Client::RunUDPBurst () {
     int remaining;
     if (mSettings->mFPS > 0) {
         framecounter = new Isochronous::FrameCounter(mSettings->mFPS);
+        if (isTickScheduler(mSettings))
+            framecounter->set_timer_wheel(timer_wheel_attach());
     }
     while (InProgress()) {
         remaining = mSettings->mBurstSize;
         framecounter->wait_tick(&reportstruct->sched_err, true);
+        myTickStats();
         do  {
             now.setnow();
             reportstruct->writecnt = 1;
@@ -1620,21 +1978,30 @@ void Client::RunUDPBurst () {
             WritePacketID(reportstruct->packetID);
             mBuf_UDP->tv_sec  = htonl(reportstruct->packetTime.tv_sec);
             mBuf_UDP->tv_usec = htonl(reportstruct->packetTime.tv_usec);
+            if (udp_nsects)
+                WriteNsecTs(now.getNsecs());
+            if (clkoffset)
+                WriteClockOffset(now.getNsecs());
 
 	    reportstruct->err_readwrite = WriteSuccess;
 	    reportstruct->emptyreport = false;
 	    // perform write
+	    double hotpath_start = (hotpath ? hotpath_now() : 0);
 	    if (isModeAmount(mSettings)) {
 		currLen = write(mySocket, mSettings->mBuf, (mSettings->mAmount < static_cast<unsigned>(mSettings->mBufLen)) ? mSettings->mAmount : mSettings->mBufLen);
 	    } else {
 		currLen = write(mySocket, mSettings->mBuf, ((remaining > mSettings->mBufLen) ? mSettings->mBufLen : \
 							    (remaining < static_cast<int>(sizeof(struct UDP_datagram)) ? static_cast<int>(sizeof(struct UDP_datagram)) : remaining)));
 	    }
+	    if (hotpath)
+		hotpath_syscall(hotpath, hotpath_start);
+	    if (kernelts && (currLen > 0))
+		kernelts_tx_sent(kernelts, mySocket, now.getNsecs());
 	    if (isIPG(mSettings)) {
 		Timestamp t2;
-		double delay = mSettings->mBurstIPG - (1e-6 * t2.subSec(now));
-		if (delay)
-		    delay_loop(static_cast<unsigned long> (delay));
+		double delay = (mSettings->mBurstIPG * 1e3) - (1e9 * t2.subSec(now)); // usecs ipg to ns
+		if (delay > 0)
+		    myDelayLoop(delay);
 	    }
 	    if (currLen <= 0) {
 		reportstruct->emptyreport = true;
@@ -1772,6 +2139,8 @@ void Client::RunUDPL4S () {
 	    WritePacketID(reportstruct->packetID);
 	    mBuf_UDP->seqno_ts.tv_sec  = htonl(reportstruct->packetTime.tv_sec);
 	    mBuf_UDP->seqno_ts.tv_usec = htonl(reportstruct->packetTime.tv_usec);
+	    if (udp_nsects)
+		WriteNsecTs(now.getNsecs());
 
 	    reportstruct->err_readwrite = WriteSuccess;
 	    reportstruct->emptyreport = false;
@@ -1900,6 +2269,77 @@ inline void Client::WritePacketID (intmax_t packetID) {
 #endif
 }
 
+// Nanosecond send timestamp per HEADER_NSECTS, placed after the udp test header
+inline void Client::WriteNsecTs (int64_t nsecs) {
+    struct UDP_datagram_nsects * mBuf_nsects = reinterpret_cast<struct UDP_datagram_nsects *>(mSettings->mBuf + sizeof(struct client_udp_testhdr));
+    mBuf_nsects->tv_nsec_u = htonl(static_cast<uint32_t>(nsecs >> 32));
+    mBuf_nsects->tv_nsec_l = htonl(static_cast<uint32_t>(nsecs & 0xFFFFFFFFLL));
+}
+
+// Clock offset estimate per HEADER_CLKOFFSET, placed after the nanosecond timestamp
+inline void Client::WriteClockOffset (int64_t nsecs) {
+    struct UDP_datagram_clkoffset *mBuf_clkoffset = reinterpret_cast<struct UDP_datagram_clkoffset *>(mSettings->mBuf + MINNSECTSPAYLOAD);
+    if ((nsecs - clkoffset_lastpoll) >= CLKOFFSET_POLLPERIOD) {
+        clkoffset_lastpoll = nsecs;
+        ClockOffsetPoll();
+    }
+    if (clkoffset->pub.valid) {
+        int64_t bound;
+        int64_t offset = clock_offset_at(clkoffset, nsecs, &bound);
+        mBuf_clkoffset->offset_ns_u = htonl(static_cast<uint32_t>(static_cast<uint64_t>(offset) >> 32));
+        mBuf_clkoffset->offset_ns_l = htonl(static_cast<uint32_t>(offset & 0xFFFFFFFFLL));
+        // a zero bound means no estimate so never send one
+        mBuf_clkoffset->bound_ns = htonl(static_cast<uint32_t>((bound > 0) ? ((bound < UINT32_MAX) ? bound : UINT32_MAX) : 1));
+        mBuf_clkoffset->drift_ppb = htonl(static_cast<int32_t>(clkoffset->drift * 1e9));
+    } else {
+        memset(mBuf_clkoffset, 0, sizeof(struct UDP_datagram_clkoffset));
+    }
+}
+
+// Read the server's clock offset echoes, t4 is the kernel receive time
+void Client::ClockOffsetPoll () {
+    struct clkoffset_echo echo;
+    struct iovec iov;
+    struct msghdr msg;
+#ifdef SO_TIMESTAMPNS
+    char ctrl[CMSG_SPACE(sizeof(struct timespec))];
+#endif
+    while (1) {
+        memset(&msg, 0, sizeof(msg));
+        iov.iov_base = &echo;
+        iov.iov_len = sizeof(echo);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+#ifdef SO_TIMESTAMPNS
+        msg.msg_control = ctrl;
+        msg.msg_controllen = sizeof(ctrl);
+#endif
+        int rc = recvmsg(mySocket, &msg, MSG_DONTWAIT);
+        if (rc < 0)
+            break;
+        if ((rc != sizeof(echo)) || (ntohl(echo.typelen.type) != CLKOFFSETECHO))
+            continue;
+        int64_t t4 = 0;
+#ifdef SO_TIMESTAMPNS
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_TIMESTAMPNS)) {
+                struct timespec rxts;
+                memcpy(&rxts, CMSG_DATA(cmsg), sizeof(struct timespec));
+                t4 = (static_cast<int64_t>(rxts.tv_sec) * 1000000000LL) + rxts.tv_nsec;
+            }
+        }
+#endif
+        if (!t4) {
+            Timestamp rxnow;
+            t4 = rxnow.getNsecs();
+        }
+        int64_t t1 = (static_cast<int64_t>(ntohl(echo.t1_u)) << 32) | ntohl(echo.t1_l);
+        int64_t t2 = (static_cast<int64_t>(ntohl(echo.t2_u)) << 32) | ntohl(echo.t2_l);
+        int64_t t3 = (static_cast<int64_t>(ntohl(echo.t3_u)) << 32) | ntohl(echo.t3_l);
+        clock_offset_sample(clkoffset, t1, t2, t3, t4);
+    }
+}
+
 inline void Client::WriteTcpTxHdr (struct ReportStruct *reportstruct, int burst_size, int burst_id) {
     struct TCP_burst_payload * mBuf_burst = reinterpret_cast<struct TCP_burst_payload *>(mSettings->mBuf);
     // store packet ID into buffer
@@ -2033,6 +2473,9 @@ void Client::FinishTrafficActions () {
             myReportPacket();
         }
     } else {
+	// pick up the stamps of the last writes before the fin packets go out
+	if (kernelts)
+	    kernelts_tx_drain(kernelts, mySocket);
 	// stop timing
 	now.setnow();
 	reportstruct->packetTime.tv_sec = now.getSecs();
@@ -2046,6 +2489,8 @@ void Client::FinishTrafficActions () {
 	struct UDP_datagram * mBuf_UDP = reinterpret_cast<struct UDP_datagram *>(mSettings->mBuf);
 	mBuf_UDP->tv_sec = htonl(reportstruct->packetTime.tv_sec);
 	mBuf_UDP->tv_usec = htonl(reportstruct->packetTime.tv_usec);
+	if (udp_nsects)
+	    WriteNsecTs(now.getNsecs());
 	int len = write(mySocket, mSettings->mBuf, mSettings->mBufLen);
 #ifdef HAVE_THREAD_DEBUG
         thread_debug("UDP client sent final packet per negative seqno %ld", -reportstruct->packetID);
@@ -2128,6 +2573,13 @@ void Client::AwaitServerFinPacket () {
                     continue;
                 }
             }
+            // and clock offset echoes still in flight
+            if (rc == sizeof(struct clkoffset_echo)) {
+                struct clkoffset_echo *echo = reinterpret_cast<struct clkoffset_echo *>(mSettings->mBuf);
+                if (ntohl(echo->typelen.type) == CLKOFFSETECHO) {
+                    continue;
+                }
+            }
             // only warn when threads is small, too many warnings are too much outputs
             if (rc < 0 && (--read_warn_rate_limiter > 0)) {
                 int len = snprintf(NULL, 0, "%sRead UDP fin", mSettings->mTransferIDStr);
@@ -2224,6 +2676,10 @@ int Client::SendFirstPayload () {
                 WritePacketID(reportstruct->packetID);
                 tmphdr->seqno_ts.tv_sec  = htonl(reportstruct->packetTime.tv_sec);
                 tmphdr->seqno_ts.tv_usec = htonl(reportstruct->packetTime.tv_usec);
+                if (!isSmallTripTime(mSettings) && (ntohl(tmphdr->base.flags) & HEADER_NSECTS)) {
+                    udp_nsects = true;
+                    WriteNsecTs(TimeNsecs(reportstruct->packetTime));
+                }
                 udp_payload_minimum = pktlen;
 #if HAVE_DECL_MSG_DONTWAIT
 		pktlen = send(mySocket, mSettings->mBuf, (pktlen > mSettings->mBufLen) ? pktlen : mSettings->mBufLen, MSG_DONTWAIT);
@@ -162,6 +162,9 @@ void server_spawn(struct thread_Settings *thread) {
         } else
 #endif
 	{
+            if (isDSCPStats(thread)) {
+                SetSocketOptionsIPRCVTos(thread);
+            }
             theServer->RunUDP();
         }
     } else {
@@ -185,7 +188,7 @@ static void clientside_client_basic (struct thread_Settings *thread, Client *the
 #endif
     SockAddr_remoteAddr(thread);
     theClient->my_connect(false);
-    if ((thread->mThreads > 1) && !isNoConnectSync(thread) && !isCompat(thread))
+    if (((thread->mThreads > 1) || thread->mProfile) && !isNoConnectSync(thread) && !isCompat(thread))
         // When -P > 1 then all threads finish connect before starting traffic
         theClient->BarrierClient(thread->connects_done);
     if (theClient->isConnected()) {
@@ -203,7 +206,7 @@ static void clientside_client_reverse (struct thread_Settings *thread,  \
 #ifdef HAVE_THREAD_DEBUG
     thread_debug("Launch: client spawn thread reverse (sock=%d)", thread->mSock);
 #endif
-    if ((thread->mThreads > 1) && !isNoConnectSync(thread))
+    if (((thread->mThreads > 1) || thread->mProfile) && !isNoConnectSync(thread))
         // When -P > 1 then all threads finish connect before starting traffic
         theClient->BarrierClient(thread->connects_done);
     if (theClient->isConnected()) {
@@ -239,7 +242,7 @@ static void clientside_client_fullduplex (struct thread_Settings *thread, \
 #ifdef HAVE_THREAD_DEBUG
     thread_debug("Launch: client spawn thread fullduplex (sock=%d)", thread->mSock);
 #endif
-    if ((thread->mThreads > 1) && !isNoConnectSync(thread))
+    if (((thread->mThreads > 1) || thread->mProfile) && !isNoConnectSync(thread))
         // When -P > 1 then all threads finish connect before starting traffic
         theClient->BarrierClient(thread->connects_done);
     if (theClient->isConnected()) {
@@ -479,6 +482,11 @@ void client_init(struct thread_Settings *clients) {
             }
         }
     }
+    if (clients->mProfileNext) {
+        // the next flow of a --profile and its threads
+        itr->runNow = clients->mProfileNext;
+        client_init(clients->mProfileNext);
+    }
 #else
     if (next != NULL) {
         // We don't have threads and we need to start a listener so
@@ -702,6 +702,10 @@ int Listener::udp_accept (thread_Settings *server) {
             if (!isCompat(mSettings) && (nread >= 4) && !(flags & HEADER_SEQNO64B)) {
                 unsetSeqNo64b(server);
             }
+            unsetNsecTs(server);
+            if (!isCompat(mSettings) && (nread >= MINNSECTSPAYLOAD) && (flags & HEADER_NSECTS)) {
+                setNsecTs(server);
+            }
             // filter and ignore negative sequence numbers, these can be heldover from a previous run
             if (isSeqNo64b(server)) {
                 // New client - Signed PacketID packed into unsigned id2,id
@@ -1000,6 +1004,12 @@ bool Listener::apply_client_settings_udp (thread_Settings *server) {
                     setUDPL4S(server);
                     SetSocketOptionsIPRCVTos(server);
                 }
+                if (upperflags & HEADER_CLKOFFSET) {
+                    setClockOffset(server);
+                }
+                if ((ntohs(hdr->extend.lowerflags) & HEADER_UDPFLOWS) && !isCompat(mSettings)) {
+                    setUDPFlows(server);
+                }
             }
             if (upperflags & HEADER_EPOCH_START) {
                 server->txstart_epoch.tv_sec = ntohl(hdr->start_fq.start_tv_sec);
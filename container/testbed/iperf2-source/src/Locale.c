@@ -90,15 +90,21 @@ Client/Server:\n\
   -e, --enhanced    use enhanced reporting giving more tcp/udp and traffic information\n\
   -f, --format    [kmgKMG]   format to report: Kbits, Mbits, KBytes, MBytes\n\
       --hide-ips           hide ip addresses and host names within outputs\n\
+      --hotpath-stats      report per thread syscall, packet ring, pacing and reporter internals\n\
       --histograms         enable histograms (see client or server for more)\n\
   -i, --interval  #        seconds between periodic bandwidth reports\n\
   -l, --len       #[kmKM]    length of buffer in bytes to read or write (Defaults: TCP=128K, v4 UDP=1470, v6 UDP=1450)\n\
   -m, --print_mss          print TCP maximum segment size\n\
+      --metrics-port [<addr>:]<port> serve live counters in OpenMetrics format over HTTP\n\
       --omit      #        omit n seconds of samples (TCP only)\n\
   -o, --output    <filename> output the report or error message to this specified file\n\
   -p, --port      #        client/server port to listen/send on and to connect\n\
       --permit-key         permit key to be used to verify client and server (TCP only)\n\
+      --selftest [=<secs>] measure this host's iperf pps/throughput ceiling over loopback first\n\
+      --so-timestamping [=sw|hw] use SO_TIMESTAMPING kernel stamps and split delay into user/stack/wire (UDP only)\n\
       --tcp-tx-delay       set socket option of TCP_TX_DELAY (units is milliseconds)\n\
+      --tsc-clock          use a calibrated invariant TSC for packet timestamps\n\
+      --stats-shm <name>   publish live flow counters to a POSIX shared memory segment\n\
       --sum-only           output sum only reports\n\
   -u, --udp                use UDP rather than TCP\n\
       --utc                use coordinated universal time (UTC) with time output\n\
@@ -118,9 +124,15 @@ Server specific:\n\
   -p, --port      #[-#]    server port(s) to listen on/connect to\n\
   -s, --server             run in server mode\n\
   -1, --singleclient       run one server at a time\n\
+      --capacity-detect[=<ms>] detect delivered rate changes on UDP receive within tens of ms, optional window (default 10 ms)\n\
+      --dscp-stats         per DSCP class bytes, packets, loss, latency, jitter and ECN of UDP flows and sums, with re-marking detected\n\
       --histograms         enable latency histograms\n\
+      --jitter-buffer[=<ms>[,<ms>...]] simulate VoIP playout buffers of these depths (default 20,40,60,100), late discards, effective loss and E-model R/MOS\n\
       --jitter-histograms  enable jitter histograms\n\
+      --link-emul <spec>   emulate a link on UDP receive, spec is delay=,jitter=,rate=,burst=,limit=,loss=,ge=p:r:1-h:1-k\n\
+      --loss-stats[=<n>]   UDP loss burst and gap distributions, Gilbert-Elliott estimates and outages of n (default 20) expected IPGs\n\
       --permit-key-timeout set the timeout for a permit key in seconds\n\
+      --reorder-window[=<n>] count UDP loss only once n datagrams behind (default 1024), reporting reordered, duplicate and late datagrams\n\
       --set-rand-seed #[n] set the seed for pseudo random number generator\n\
       --skip-rx-copy       set MSG_TRUNC to avoid kernel to application spaced copy of data\n\
       --tcp-rx-window-clamp set the TCP receive window clamp size in bytes\n\
@@ -147,6 +159,7 @@ Client specific:\n\
       --bounceback-reply   set the bounceback reply message size (defaults to symmetric)\n \
       --bounceback-txdelay  request the bounceback server delay n seconds between the request and the reply\n \
   -c, --client    <host>   run in client mode, connecting to <host>\n\
+      --clock-offset       with --trip-times estimate the clock offset in band and correct latency (UDP only)\n\
       --connect-only       run a connect only test\n\
       --connect-retry-timer minimum time interval in seconds between application level connect retries\n\
       --connect-retry-time time interval in seconds to attempt application level connect retries \n\
@@ -169,6 +182,10 @@ Client specific:\n\
       --no-connect-sync    No sychronization after connect when -P or parallel traffic threads\n\
       --no-udp-fin         No final server to client stats at end of UDP test\n\
   -n, --num       #[kmgKMG]    number of bytes to transmit (instead of -t)\n\
+      --pcap-replay <file>[,scale=<x>][,loop[=<n>]][,port=<p>] replay the UDP datagram lengths and gaps of a pcap or pcapng capture\n\
+      --profile <file>     run the mix of flows in a file of 'name options' lines, one flow per line, with time aligned reports\n\
+      --rate-schedule <file> vary the rate per a schedule file of 'duration rate [ramp]' lines, rate in bits/sec or a multiple (x) of -b\n\
+      --tick-scheduler [=<n>] release isochronous/burst frames from n shared timer wheel threads (default 1)\n\
       --sync-transfer-id   pass the clients' transfer id(s) to the server so both will use the same id in their respective outputs\n\
   -r, --tradeoff           Do a fullduplexectional test individually\n\
       --tcp-quickack       set the socket's TCP_QUICKACK option (off by default)\n\
@@ -180,6 +197,7 @@ Client specific:\n\
       --txstart-time       unix epoch time to schedule first write and start traffic\n\
       --udp-l4s            run a UDP L4S flow\n\
       --udp-l4s-video      run a UDP L4S video flow\n\
+      --udp-flows <n>      multiplex n logical UDP flows over the one socket, each paced to -b, with per flow server stats (-l of 196 or more)\n\
   -B, --bind [<ip> | <ip:port>] bind ip (and optional port) from which to source traffic\n\
   -F, --fileinput <name>   input the data to be transmitted from a file\n\
   -H, --ssm-host <ip>      set the SSM source, use with -B for (S,G) \n\
@@ -920,6 +938,91 @@ const char error_delaytime_exceeds[] =
 
 const char report_omitted[] = "  (omit)";
 
+const char report_hotpath_stats[] =
+"%s" IPERFTimeFrmt " sec  hotpath: syscalls=%" PRIdMAX " avg/max=%.1f/%.1f us  ring blocked=%.3f ms (%d waits) hwm=%d/%d  delay oversleep avg/max=%.1f/%.1f us (%" PRIdMAX " calls)  tick slips=%u sched-err max=%ld us  reporter suspends=%d\n";
+
+const char report_kernelts_tx_stats[] =
+"%s" IPERFTimeFrmt " sec  kernel-ts(%s): writes=%" PRIdMAX " user->stack avg/max=%.1f/%.1f us  stack->wire avg/max=%.1f/%.1f us  (%" PRIdMAX "/%" PRIdMAX " sched/wire stamps, %" PRIdMAX " unmatched)\n";
+
+const char report_kernelts_rx_stats[] =
+"%s" IPERFTimeFrmt " sec  kernel-ts(%s): reads=%" PRIdMAX " wire->user avg/max=%.1f/%.1f us\n";
+
+const char report_clock_offset[] =
+"%s" IPERFTimeFrmt " sec  clock-offset(%s): %+.3f ms +/- %.3f ms drift=%+.3f ppm (%" PRIdMAX " samples)\n";
+
+const char report_clock_offset_none[] =
+"%s" IPERFTimeFrmt " sec  clock-offset(%s): no estimate yet, transit is uncorrected\n";
+
+const char report_link_emul[] =
+"%s" IPERFTimeFrmt " sec  link-emul: in=%" PRIdMAX " out=%" PRIdMAX " lost random/burst=%" PRIdMAX "/%" PRIdMAX " queue-drops=%" PRIdMAX " held=%" PRIdMAX "(%" PRIdMAX ") added avg/max=%.3f/%.3f ms\n";
+
+const char report_rate_schedule[] =
+"%s" IPERFTimeFrmt " sec  rate-schedule: target %s/sec (segment %d of %d)\n";
+
+const char report_rate_schedule_total[] =
+"%s" IPERFTimeFrmt " sec  rate-schedule: target %s/sec (%d segments)\n";
+
+const char report_capacity_event[] =
+"%s%.3f sec  %s changed from %s/sec to %s/sec (detected in %.1f ms, queue %.3f ms, trend %+.1f ms/s)\n";
+
+const char report_capacity_summary[] =
+"%s" IPERFTimeFrmt " sec  capacity-detect: %" PRIdMAX " changes (%" PRIdMAX " capacity), level %s/sec +/- %.1f%%, %.1f ms windows (%" PRIdMAX "), transit floor %.3f ms\n";
+
+const char report_seq_window[] =
+"%s" IPERFTimeFrmt " sec  reorder-window: reordered=%" PRIdMAX " distance avg/max=%.1f/%" PRIdMAX " duplicates=%" PRIdMAX " late=%" PRIdMAX " (tolerance %" PRIdMAX ")\n";
+
+const char report_outage[] =
+"%s%.3f-%.3f sec  outage: %.1f ms, %" PRIdMAX " datagrams lost (%.0f expected IPGs)\n";
+
+const char report_loss_bursts[] =
+"%s" IPERFTimeFrmt " sec  loss-bursts: %" PRIdMAX " len avg/max=%.1f/%" PRIdMAX " (%s) gaps: %" PRIdMAX " len avg/max=%.1f/%" PRIdMAX " (%s)\n";
+
+const char report_loss_model[] =
+"%s" IPERFTimeFrmt " sec  loss-model: gilbert p=%.3f%% r=%.1f%% ge(gmin %d) p=%.3f%% r=%.1f%% 1-h=%.1f%% 1-k=%.3f%% outages=%" PRIdMAX " %.1f/%.1f ms total/max\n";
+
+const char report_jitter_buffer[] =
+"%s" IPERFTimeFrmt " sec  jitter-buffer %g ms: late=%" PRIdMAX " (%.2f%%) eff-loss=%.2f%% delay=%.1f ms R=%.1f MOS=%.2f\n";
+
+const char report_dscp_stats[] =
+"%s" IPERFTimeFrmt " sec  dscp %d: %ss %" PRIdMAX " pkts lost=%" PRIdMAX " ecn not-ect/ect1/ect0/ce=%" PRIdMAX "/%" PRIdMAX "/%" PRIdMAX "/%" PRIdMAX " jitter=%.3f ms%s%s\n";
+
+const char report_dscp_latency[] =
+" latency avg/min/max=%.3f/%.3f/%.3f ms";
+
+const char report_dscp_remarked[] =
+" remarked=%" PRIdMAX " ecn-bleached=%" PRIdMAX;
+
+const char report_udp_flows[] =
+"%s" IPERFTimeFrmt " sec  udp-flows: %d/%d active lost/total=%" PRIdMAX "/%" PRIdMAX " reordered=%" PRIdMAX " worst loss=%.2f%% (flow %d) jitter avg/max=%.3f/%.3f ms (flow %d)\n";
+
+const char report_udp_flow[] =
+"%s" IPERFTimeFrmt " sec  flow %d: %ss lost/total=%" PRIdMAX "/%" PRIdMAX " (%.2f%%) reordered=%" PRIdMAX " jitter=%.3f ms\n";
+
+const char report_pcap_replay[] =
+"%s" IPERFTimeFrmt " sec  pcap-replay: %" PRIdMAX " datagrams, %" PRIdMAX " padded to the test header, %" PRIdMAX " late by more than %d us, lag (mean/max) = %0.3f/%0.3f ms\n";
+
+const char report_selftest_heading[] =
+"Selftest: iperf client and server over loopback, %.1f sec per test (this host's ceiling, not the network's)\n\
+[selftest] Test         Len   P          pps   Gbits/sec     pps/flow  Gbits/core  Client-cpu  Server-cpu  Ring-stalls\n";
+
+const char report_selftest[] =
+"[selftest] %-10s %7d %3d %12.0f %11.3f %12.0f %11.3f %10.1f%% %10.1f%% %12" PRIdMAX "\n";
+
+const char report_selftest_failed[] =
+"[selftest] %-10s %7d %3d  test failed\n";
+
+const char report_selftest_within[] =
+"[selftest] planned offered load of %.3f Gbits/sec is %.0f%% of the selftest ceiling\n";
+
+const char warn_selftest_ceiling[] =
+"WARN: planned offered load of %.3f Gbits/sec exceeds this host's iperf ceiling of %.3f Gbits/sec (%.0f pps), results will be sender or receiver limited\n";
+
+const char report_tsc_clock[] =
+"TSC clock enabled at %.6f GHz, re-anchored to CLOCK_REALTIME every %d ms\n";
+
+const char warn_tsc_clock[] =
+"WARN: --tsc-clock requires an invariant TSC, using clock_gettime()\n";
+
 #ifdef __cplusplus
 } /* end extern "C" */
 #endif
@@ -52,6 +52,9 @@
 #include "SocketAddr.h"
 #include "iperf_formattime.h"
 #include "dscp.h"
+#include "kernel_timestamps.h"
+#include "clock_offset.h"
+#include "link_emul.h"
 
 // These static variables are not thread safe but ok to use becase only
 // the repoter thread usses them
@@ -2656,6 +2659,371 @@ void reporter_connect_printf_tcp_final (struct ConnectionInfo * report) {
     fflush(stdout);
 }
 
+// The option reports below print after a traffic report's line, they are
+// human output only so skip the print (but not the interval bookkeeping)
+// when the report mode is CSV
+//
+// Output the --hotpath-stats for a traffic thread, counts and averages are
+// for the interval (or the whole test when final) while maximums are running
+void reporter_print_hotpath_stats (struct ReporterData *data, int suspends, bool final) {
+    struct HotPathStats *hp = data->packetring->hotpath;
+    struct HotPathStats zero;
+    struct HotPathStats *prev = &data->hotpath_prev;
+    struct TransferInfo *stats = &data->info;
+    if (final) {
+	memset(&zero, 0, sizeof(struct HotPathStats));
+	prev = &zero;
+    }
+    if (stats->common->ReportMode != kReport_CSV) {
+	intmax_t syscalls = hp->syscalls - prev->syscalls;
+	intmax_t delays = hp->delay_calls - prev->delay_calls;
+	printf(report_hotpath_stats, stats->common->transferIDStr, stats->ts.iStart, stats->ts.iEnd, syscalls, \
+	       (syscalls ? ((hp->syscall_time - prev->syscall_time) * 1e6 / syscalls) : 0.0), (hp->syscall_max * 1e6), \
+	       ((hp->enqueue_blocked - prev->enqueue_blocked) * 1e3), (int) (hp->enqueue_waits - prev->enqueue_waits), \
+	       hp->ring_highwater, data->packetring->maxcount, \
+	       (delays ? ((hp->delay_oversleep - prev->delay_oversleep) * 1e6 / delays) : 0.0), (hp->delay_oversleep_max * 1e6), delays, \
+	       (hp->tick_slips - prev->tick_slips), hp->sched_err_max, suspends);
+	cond_flush(stats);
+    }
+    data->hotpath_prev = *hp;
+}
+
+// Output the --so-timestamping delay split, averages are per interval (or
+// the whole test when final) and maximums are running
+void reporter_print_kernelts_stats (struct ReporterData *data, bool final) {
+    struct KernelTsStats *kts = data->packetring->kernelts;
+    struct KernelTsCounters zero;
+    struct KernelTsCounters *prev = &kts->prev;
+    struct KernelTsCounters *cnt = &kts->cnt;
+    struct TransferInfo *stats = &data->info;
+    if (final) {
+	memset(&zero, 0, sizeof(struct KernelTsCounters));
+	prev = &zero;
+    }
+    if (stats->common->ReportMode != kReport_CSV) {
+	const char *source = (kts->hwseen ? "hw" : "sw");
+	if (stats->common->ThreadMode == kMode_Client) {
+	    intmax_t sched = cnt->tx_sched - prev->tx_sched;
+	    intmax_t wire = cnt->tx_wire - prev->tx_wire;
+	    printf(report_kernelts_tx_stats, stats->common->transferIDStr, stats->ts.iStart, stats->ts.iEnd, source, \
+		   (cnt->tx - prev->tx), \
+		   (sched ? ((cnt->user2stack - prev->user2stack) / 1e3 / sched) : 0.0), (cnt->user2stack_max / 1e3), \
+		   (wire ? ((cnt->stack2wire - prev->stack2wire) / 1e3 / wire) : 0.0), (cnt->stack2wire_max / 1e3), \
+		   sched, wire, (cnt->tx_unmatched - prev->tx_unmatched));
+	} else {
+	    intmax_t rx = cnt->rx - prev->rx;
+	    printf(report_kernelts_rx_stats, stats->common->transferIDStr, stats->ts.iStart, stats->ts.iEnd, source, rx, \
+		   (rx ? ((cnt->wire2user - prev->wire2user) / 1e3 / rx) : 0.0), (cnt->wire2user_max / 1e3));
+	}
+	cond_flush(stats);
+    }
+    kts->prev = *cnt;
+}
+
+// Output the --clock-offset estimate (client) or the one last applied to
+// the sent times (server)
+void reporter_print_clock_offset (struct ReporterData *data) {
+    struct ClockOffsetReport *pub = &data->packetring->clkoffset->pub;
+    struct TransferInfo *stats = &data->info;
+    const char *role = ((stats->common->ThreadMode == kMode_Client) ? "estimate" : "applied");
+    if (stats->common->ReportMode == kReport_CSV)
+	return;
+    if (pub->valid) {
+	printf(report_clock_offset, stats->common->transferIDStr, stats->ts.iStart, stats->ts.iEnd, role, \
+	       (pub->offset / 1e6), (pub->bound / 1e6), (pub->drift * 1e6), pub->samples);
+    } else {
+	printf(report_clock_offset_none, stats->common->transferIDStr, stats->ts.iStart, stats->ts.iEnd, role);
+    }
+    cond_flush(stats);
+}
+
+// Output the --link-emul counters, per interval or for the whole test when
+// final, held is the current (max) number of packets in the delay line
+void reporter_print_link_emul (struct ReporterData *data, bool final) {
+    struct LinkEmul *le = data->packetring->linkemul;
+    struct LinkEmulCounters zero;
+    struct LinkEmulCounters *prev = &le->prev;
+    struct LinkEmulCounters *cnt = &le->cnt;
+    struct TransferInfo *stats = &data->info;
+    if (final) {
+	memset(&zero, 0, sizeof(struct LinkEmulCounters));
+	prev = &zero;
+    }
+    if (stats->common->ReportMode != kReport_CSV) {
+	intmax_t out = cnt->out - prev->out;
+	printf(report_link_emul, stats->common->transferIDStr, stats->ts.iStart, stats->ts.iEnd, \
+	       (cnt->in - prev->in), out, (cnt->lost_random - prev->lost_random), (cnt->lost_burst - prev->lost_burst), \
+	       (cnt->queue_drops - prev->queue_drops), le->held, cnt->held_max, \
+	       (out ? ((cnt->added - prev->added) / 1e6 / out) : 0.0), (cnt->added_max / 1e6));
+	cond_flush(stats);
+    }
+    le->prev = *cnt;
+}
+
+// Output the --rate-schedule target averaged over the report's time span,
+// and the segment in force at its start, to compare with the achieved rate
+void reporter_print_rate_schedule (struct ReporterData *data, bool final) {
+    struct RateSchedule *rs = data->info.rate_schedule;
+    struct TransferInfo *stats = &data->info;
+    char target[64];
+    int64_t t0 = (int64_t) (stats->ts.iStart * 1e9);
+    int64_t t1 = (int64_t) (stats->ts.iEnd * 1e9);
+    if ((stats->common->ReportMode != kReport_CSV) && (t1 > t0)) {
+	byte_snprintf(target, sizeof(target), rate_schedule_bits(rs, t0, t1) / 8.0 / ((t1 - t0) / 1e9), \
+		      stats->common->Format);
+	target[sizeof(target)-1]='\0';
+	if (final) {
+	    printf(report_rate_schedule_total, stats->common->transferIDStr, stats->ts.iStart, stats->ts.iEnd, \
+		   target, rs->count);
+	} else {
+	    printf(report_rate_schedule, stats->common->transferIDStr, stats->ts.iStart, stats->ts.iEnd, \
+		   target, (rate_schedule_segment(rs, t0) + 1), rs->count);
+	}
+	cond_flush(stats);
+    }
+}
+
+// Output a --capacity-detect change as it's decided, timed from the
+// report start per the arrival of the window where the change began
+void reporter_print_capacity_event (struct TransferInfo *stats) {
+    struct CapacityEvent *event = &stats->capdetect->event;
+    char from[64];
+    char to[64];
+    if (stats->common->ReportMode == kReport_CSV)
+	return;
+    byte_snprintf(from, sizeof(from), event->from / 8.0, stats->common->Format);
+    byte_snprintf(to, sizeof(to), event->to / 8.0, stats->common->Format);
+    from[sizeof(from)-1]='\0';
+    to[sizeof(to)-1]='\0';
+    printf(report_capacity_event, stats->common->transferIDStr, \
+	   ((event->at - TimeNsecs(stats->ts.startTime)) / 1e9), \
+	   (event->capacity ? "capacity" : "offered load"), from, to, \
+	   ((event->detected - event->at) / 1e6), (event->queue / 1e6), (event->trend * 1e3));
+    cond_flush(stats);
+}
+
+void reporter_print_capacity_summary (struct TransferInfo *stats) {
+    struct CapacityDetect *cd = stats->capdetect;
+    char level[64];
+    if (stats->common->ReportMode == kReport_CSV)
+	return;
+    byte_snprintf(level, sizeof(level), cd->level / 8.0, stats->common->Format);
+    level[sizeof(level)-1]='\0';
+    printf(report_capacity_summary, stats->common->transferIDStr, stats->ts.iStart, stats->ts.iEnd, \
+	   cd->changes, cd->capacity_changes, level, (cd->spread * 100.0), (cd->window / 1e6), cd->windows, \
+	   ((cd->floor == INT64_MAX) ? 0.0 : (cd->floor / 1e6)));
+    cond_flush(stats);
+}
+
+// Output the --reorder-window counts beyond those in the report line,
+// per interval or for the whole test when final
+void reporter_print_seq_window (struct ReporterData *data, bool final) {
+    struct SeqWindow *sw = data->info.seqwin;
+    struct SeqWindowCounters zero;
+    struct SeqWindowCounters *prev = &sw->prev;
+    struct SeqWindowCounters *cnt = &sw->cnt;
+    struct TransferInfo *stats = &data->info;
+    if (final) {
+	memset(&zero, 0, sizeof(struct SeqWindowCounters));
+	prev = &zero;
+    }
+    if (stats->common->ReportMode != kReport_CSV) {
+	intmax_t reordered = cnt->reordered - prev->reordered;
+	printf(report_seq_window, stats->common->transferIDStr, stats->ts.iStart, stats->ts.iEnd, \
+	       reordered, (reordered ? ((double) (cnt->distance - prev->distance) / reordered) : 0.0), cnt->distance_max, \
+	       (cnt->duplicates - prev->duplicates), (cnt->late - prev->late), sw->tolerance);
+	cond_flush(stats);
+    }
+    sw->prev = *cnt;
+}
+
+// Output a --loss-stats outage as it ends, timed from the report start
+void reporter_print_outage (struct TransferInfo *stats) {
+    struct LossOutage *outage = &stats->lossstats->outage;
+    int64_t origin = TimeNsecs(stats->ts.startTime);
+    int64_t duration = outage->end - outage->start;
+    if (stats->common->ReportMode == kReport_CSV)
+	return;
+    printf(report_outage, stats->common->transferIDStr, ((outage->start - origin) / 1e9), ((outage->end - origin) / 1e9), \
+	   (duration / 1e6), outage->lost, (duration / stats->lossstats->ipg));
+    cond_flush(stats);
+}
+
+// Output the --loss-stats burst and gap distributions and the loss model
+// estimates, per interval or for the whole test when final
+void reporter_print_loss_stats (struct ReporterData *data, bool final) {
+    struct LossStats *ls = data->info.lossstats;
+    struct LossStatsCounters zero;
+    struct LossStatsCounters *prev = &ls->prev;
+    struct LossStatsCounters *cnt = &ls->cnt;
+    struct LossStatsMax *max = (final ? &ls->tmax : &ls->imax);
+    struct TransferInfo *stats = &data->info;
+    char bursts[256];
+    char gaps[256];
+    if (final) {
+	memset(&zero, 0, sizeof(struct LossStatsCounters));
+	prev = &zero;
+    }
+    if (stats->common->ReportMode != kReport_CSV) {
+	intmax_t nbursts = cnt->bursts - prev->bursts;
+	intmax_t burst_lost = cnt->burst_lost - prev->burst_lost;
+	intmax_t ngaps = cnt->gaps - prev->gaps;
+	intmax_t rcvd = cnt->rcvd - prev->rcvd;
+	intmax_t good = cnt->good - prev->good;
+	intmax_t bad = cnt->bad - prev->bad;
+	intmax_t badcnt = cnt->badcnt - prev->badcnt;
+	if (!lossstats_bins_snprintf(bursts, sizeof(bursts), cnt->burst_bins, prev->burst_bins))
+	    strcpy(bursts, "-");
+	if (!lossstats_bins_snprintf(gaps, sizeof(gaps), cnt->gap_bins, prev->gap_bins))
+	    strcpy(gaps, "-");
+	printf(report_loss_bursts, stats->common->transferIDStr, stats->ts.iStart, stats->ts.iEnd, \
+	       nbursts, (nbursts ? ((double) burst_lost / nbursts) : 0.0), max->burst, bursts, \
+	       ngaps, (ngaps ? ((double) (cnt->gap_rcvd - prev->gap_rcvd) / ngaps) : 0.0), max->gap, gaps);
+	printf(report_loss_model, stats->common->transferIDStr, stats->ts.iStart, stats->ts.iEnd, \
+	       (rcvd ? (100.0 * nbursts / rcvd) : 0.0), (burst_lost ? (100.0 * nbursts / burst_lost) : 0.0), LOSSSTATS_GMIN, \
+	       (good ? (100.0 * badcnt / good) : 0.0), (bad ? (100.0 * badcnt / bad) : 0.0), \
+	       (bad ? (100.0 * (cnt->bad_lost - prev->bad_lost) / bad) : 0.0), (good ? (100.0 * (cnt->good_lost - prev->good_lost) / good) : 0.0), \
+	       (cnt->outages - prev->outages), ((cnt->outage_time - prev->outage_time) / 1e6), (max->outage / 1e6));
+	cond_flush(stats);
+    }
+    ls->prev = *cnt;
+    memset(&ls->imax, 0, sizeof(struct LossStatsMax));
+}
+
+// Output the --jitter-buffer late discards, effective loss and E-model
+// estimate per playout depth, per interval or for the whole test when final
+void reporter_print_jitter_buffer (struct ReporterData *data, bool final) {
+    struct TransferInfo *stats = &data->info;
+    struct JitterBuffer *jb = stats->jitterbuf;
+    struct JitterBufferCounters zero;
+    struct JitterBufferCounters *prev = &jb->prev;
+    // the least transit is only a delay when the clocks are synced
+    double base_ms = ((isTripTime(stats->common) && (jb->anchor > 0)) ? (jb->anchor / 1e6) : 0.0);
+    if (final) {
+	memset(&zero, 0, sizeof(struct JitterBufferCounters));
+	prev = &zero;
+    }
+    if ((stats->common->ReportMode != kReport_CSV) && (stats->cntDatagrams > 0)) {
+	for (int ix = 0; ix < jb->depths; ix++) {
+	    intmax_t late = jb->cnt.late[ix] - prev->late[ix];
+	    double loss_pct = 100.0 * (stats->cntError + late) / stats->cntDatagrams;
+	    double delay_ms = base_ms + (jb->depth[ix] / 1e6);
+	    double rfactor = jitterbuf_rfactor(delay_ms, loss_pct);
+	    printf(report_jitter_buffer, stats->common->transferIDStr, stats->ts.iStart, stats->ts.iEnd, \
+		   (jb->depth[ix] / 1e6), late, (100.0 * late / stats->cntDatagrams), loss_pct, delay_ms, \
+		   rfactor, jitterbuf_mos(rfactor));
+	}
+	cond_flush(stats);
+    }
+    jb->prev = jb->cnt;
+}
+
+// Output the --dscp-stats classes seen, per interval or for the whole
+// test when final, for a flow or a sum report. The counters move on to
+// the next interval even when the output is masked so sums stay whole
+void reporter_print_dscp_stats (struct TransferInfo *stats, bool final) {
+    struct DSCPStats *ds = stats->dscpstats;
+    struct DSCPStatsCounters zero;
+    // sum reports don't carry a transfer ID string
+    const char *idstr = ((ds->sent_tos == DSCPSTATS_NOTOS) ? "[SUM] " : stats->common->transferIDStr);
+    bool output = (!stats->isMaskOutput && (stats->common->ReportMode != kReport_CSV));
+    if (final)
+	memset(&zero, 0, sizeof(struct DSCPStatsCounters));
+    for (int ix = 0; output && (ix < DSCPSTATS_CLASSES); ix++) {
+	struct DSCPClass *cls = &ds->cls[ix];
+	struct DSCPStatsCounters *prev = (final ? &zero : &cls->prev);
+	struct DSCPStatsLatency *lat = (final ? &cls->tlat : &cls->ilat);
+	char bytes[40];
+	char latency[80] = "";
+	char remarked[80] = "";
+	if (!(ds->active & (((uint64_t) 1) << ix)) || (cls->cnt.packets == prev->packets))
+	    continue;
+	intmax_t lost = cls->cnt.lost - prev->lost;
+	intmax_t nremarked = cls->cnt.remarked - prev->remarked;
+	intmax_t nbleached = cls->cnt.bleached - prev->bleached;
+	byte_snprintf(bytes, sizeof(bytes), (double) (cls->cnt.bytes - prev->bytes), toupper((int)stats->common->Format));
+	if (isTripTime(stats->common) && lat->cnt) {
+	    snprintf(latency, sizeof(latency), report_dscp_latency, \
+		     (lat->sum / 1e6 / lat->cnt), (lat->min / 1e6), (lat->max / 1e6));
+	}
+	if (nremarked || nbleached) {
+	    snprintf(remarked, sizeof(remarked), report_dscp_remarked, nremarked, nbleached);
+	}
+	printf(report_dscp_stats, idstr, stats->ts.iStart, stats->ts.iEnd, ix, \
+	       bytes, (cls->cnt.packets - prev->packets), ((lost > 0) ? lost : 0), \
+	       (cls->cnt.ecn[0] - prev->ecn[0]), (cls->cnt.ecn[1] - prev->ecn[1]), \
+	       (cls->cnt.ecn[2] - prev->ecn[2]), (cls->cnt.ecn[3] - prev->ecn[3]), \
+	       (cls->jitter / 1e6), latency, remarked);
+    }
+    if (output)
+	cond_flush(stats);
+    dscpstats_next_interval(ds);
+}
+
+// Output the --udp-flows summary across the logical flows, per interval
+// or for the whole test when final, which also lists every flow. The
+// flows move on to the next interval even when the output is masked
+void reporter_print_udp_flows (struct TransferInfo *stats, bool final) {
+    struct UDPFlowsRx *rx = stats->udpflows;
+    struct UDPFlowCounters zero;
+    intmax_t received = 0, lost = 0, reordered = 0;
+    int active = 0, worst_loss_flow = -1, worst_jitter_flow = -1;
+    double worst_loss = 0.0, worst_jitter = 0.0, jitter_sum = 0.0;
+    bool output = (!stats->isMaskOutput && (stats->common->ReportMode != kReport_CSV));
+    memset(&zero, 0, sizeof(struct UDPFlowCounters));
+    for (int ix = 0; output && (ix < rx->flows); ix++) {
+	struct UDPFlow *flow = &rx->flow[ix];
+	struct UDPFlowCounters *prev = (final ? &zero : &flow->prev);
+	intmax_t packets = flow->cnt.packets - prev->packets;
+	intmax_t flost = flow->cnt.lost - prev->lost;
+	if (packets == 0)
+	    continue;
+	if (flost < 0)
+	    flost = 0;
+	double loss_pct = 100.0 * flost / (packets + flost);
+	active++;
+	received += packets;
+	lost += flost;
+	reordered += flow->cnt.reordered - prev->reordered;
+	jitter_sum += flow->jitter;
+	if ((worst_loss_flow < 0) || (loss_pct > worst_loss)) {
+	    worst_loss = loss_pct;
+	    worst_loss_flow = ix;
+	}
+	if ((worst_jitter_flow < 0) || (flow->jitter > worst_jitter)) {
+	    worst_jitter = flow->jitter;
+	    worst_jitter_flow = ix;
+	}
+    }
+    if (active) {
+	printf(report_udp_flows, stats->common->transferIDStr, stats->ts.iStart, stats->ts.iEnd, \
+	       active, rx->flows, lost, (received + lost), reordered, worst_loss, worst_loss_flow, \
+	       (jitter_sum / active / 1e6), (worst_jitter / 1e6), worst_jitter_flow);
+	for (int ix = 0; final && (ix < rx->flows); ix++) {
+	    struct UDPFlow *flow = &rx->flow[ix];
+	    char bytes[40];
+	    if (flow->cnt.packets == 0)
+		continue;
+	    byte_snprintf(bytes, sizeof(bytes), (double) flow->cnt.bytes, toupper((int)stats->common->Format));
+	    printf(report_udp_flow, stats->common->transferIDStr, stats->ts.iStart, stats->ts.iEnd, ix, \
+		   bytes, flow->cnt.lost, (flow->cnt.packets + flow->cnt.lost), \
+		   (100.0 * flow->cnt.lost / (flow->cnt.packets + flow->cnt.lost)), flow->cnt.reordered, (flow->jitter / 1e6));
+	}
+	cond_flush(stats);
+    }
+    udpflows_rx_next_interval(rx);
+}
+
+// Output the --pcap-replay departures of a client thread, for the whole test
+void reporter_print_pcap_replay (struct TransferInfo *stats) {
+    struct PcapReplayReport *rp = &stats->pcapreplay;
+    if (stats->common->ReportMode == kReport_CSV)
+	return;
+    printf(report_pcap_replay, stats->common->transferIDStr, stats->ts.iStart, stats->ts.iEnd, \
+	   rp->sent, rp->padded, rp->late, (PCAPREPLAY_LATE / 1000), ((rp->lag_sum / rp->sent) * 1e-6), (rp->lag_max * 1e-6));
+    cond_flush(stats);
+}
+
 void reporter_print_connection_report (struct ConnectionInfo *report) {
     assert(report->common);
     // copy the inet_ntop into temp buffers, to avoid overwriting
@@ -64,6 +64,11 @@
 #include "packet_ring.h"
 #include "payloads.h"
 #include "iperf_formattime.h"
+#include "iperf_metrics.h"
+#include "kernel_timestamps.h"
+#include "clock_offset.h"
+#include "link_emul.h"
+#include "iperf_probes.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -85,7 +90,6 @@ static void reporter_reset_transfer_stats_server_tcp(struct TransferInfo *stats)
 static void reporter_reset_transfer_stats_sum(struct TransferInfo *stats);
 
 // code for welfornd's algorithm to produce running mean/min/max/var
-static void reporter_update_mmm (struct MeanMinMaxStats *stats, double value);
 static void reporter_reset_mmm (struct MeanMinMaxStats *stats);
 static void reporter_update_mmm_sum (struct MeanMinMaxStats *sumstats, struct MeanMinMaxStats *stats);
 
@@ -379,7 +383,7 @@ static inline struct ReportHeader *reporter_jobq_set_root (struct thread_Setting
  *       return (mean, variance, sampleVariance)
  *
  */
-static void reporter_update_mmm (struct MeanMinMaxStats *stats, double value) {
+void reporter_update_mmm (struct MeanMinMaxStats *stats, double value) {
     assert(stats != NULL);
     stats->cnt++;
     if (stats->cnt == 1) {
@@ -416,7 +420,6 @@ static void reporter_reset_mmm (struct MeanMinMaxStats *stats) {
 
 static void reporter_update_mmm_sum (struct MeanMinMaxStats *sumstats, struct MeanMinMaxStats *stats) {
     assert(stats != NULL);
-    stats->cnt++;
     if (sumstats->cnt == 0) {
 	// Very first entry
 	sumstats->min = stats->min;
@@ -614,6 +617,42 @@ bool reporter_process_transfer_report (struct ReporterData *this_ireport) {
 	    this_ireport->info.ts.packetTime = packet->packetTime;
 	    assert(this_ireport->transfer_protocol_handler != NULL);
 	    (*this_ireport->transfer_protocol_handler)(this_ireport, true);
+	    if (this_ireport->packetring->hotpath && !this_ireport->info.isMaskOutput) {
+		reporter_print_hotpath_stats(this_ireport, consumption_detector.reporter_thread_suspends, true);
+	    }
+	    if (this_ireport->packetring->kernelts && !this_ireport->info.isMaskOutput) {
+		reporter_print_kernelts_stats(this_ireport, true);
+	    }
+	    if (this_ireport->packetring->clkoffset && !this_ireport->info.isMaskOutput) {
+		reporter_print_clock_offset(this_ireport);
+	    }
+	    if (this_ireport->packetring->linkemul && !this_ireport->info.isMaskOutput) {
+		reporter_print_link_emul(this_ireport, true);
+	    }
+	    if (this_ireport->info.rate_schedule && !this_ireport->info.isMaskOutput) {
+		reporter_print_rate_schedule(this_ireport, true);
+	    }
+	    if (this_ireport->info.capdetect && !this_ireport->info.isMaskOutput) {
+		reporter_print_capacity_summary(&this_ireport->info);
+	    }
+	    if (this_ireport->info.seqwin && !this_ireport->info.isMaskOutput) {
+		reporter_print_seq_window(this_ireport, true);
+	    }
+	    if (this_ireport->info.lossstats && !this_ireport->info.isMaskOutput) {
+		reporter_print_loss_stats(this_ireport, true);
+	    }
+	    if (this_ireport->info.jitterbuf && !this_ireport->info.isMaskOutput) {
+		reporter_print_jitter_buffer(this_ireport, true);
+	    }
+	    if (this_ireport->info.dscpstats) {
+		reporter_print_dscp_stats(&this_ireport->info, true);
+	    }
+	    if (this_ireport->info.udpflows) {
+		reporter_print_udp_flows(&this_ireport->info, true);
+	    }
+	    if (this_ireport->info.pcapreplay.sent && !this_ireport->info.isMaskOutput) {
+		reporter_print_pcap_replay(&this_ireport->info);
+	    }
 	    // This is a final report so set the sum report header's packet time
 	    // Note, the thread with the max value will set this
 	    if (fullduplexstats && isEnhanced(this_ireport->info.common)) {
@@ -643,6 +682,14 @@ bool reporter_process_transfer_report (struct ReporterData *this_ireport) {
 	    }
 	}
     }
+    // Publish live counters for the --metrics-port scraper, these
+    // are seqlock writes so a scrape never holds off the reporter
+    if (this_ireport->info.metrics) {
+	iperf_metrics_publish(&this_ireport->info, this_ireport);
+    }
+    if (sumstats && sumstats->metrics) {
+	iperf_metrics_publish(sumstats, NULL);
+    }
     return need_free;
 }
 /*
@@ -757,16 +804,20 @@ static inline void reporter_compute_packet_pps (struct TransferInfo *stats, stru
 }
 
 static void reporter_handle_packet_oneway_transit (struct TransferInfo *stats, struct ReportStruct *packet) {
-    // Transit or latency updates done inline below
-    double transit = TimeDifference(packet->packetTime, packet->sentTime);
+    // Transit or latency updates done inline below. The math is in integer
+    // nanoseconds, a peer without HEADER_NSECTS (or a receive without
+    // SO_TIMESTAMPNS) falls back to its microsecond timeval
+    int64_t transit_ns = (packet->packetTimeNs ? packet->packetTimeNs : TimeNsecs(packet->packetTime)) \
+	- (packet->sentTimeNs ? packet->sentTimeNs : TimeNsecs(packet->sentTime));
+    double transit = transit_ns / 1e9;
     if (stats->latency_histogram) {
-        histogram_insert(stats->latency_histogram, transit, &packet->packetTime);
+        histogram_insert_ns(stats->latency_histogram, transit_ns, &packet->packetTime);
     }
-    double deltaTransit;
-    deltaTransit = transit - stats->transit.current.last;
-    stats->transit.current.last = transit; // shift transit for next time
-    if (deltaTransit < 0.0) {
-	deltaTransit = -deltaTransit;
+    int64_t deltaTransit_ns = transit_ns - stats->transit_ns;
+    stats->transit_ns = transit_ns; // shift transit for next time
+    stats->transit.current.last = transit;
+    if (deltaTransit_ns < 0) {
+	deltaTransit_ns = -deltaTransit_ns;
     }
     // Compute end/end delay stats
     reporter_update_mmm(&stats->transit.total, transit);
@@ -813,11 +864,13 @@ static void reporter_handle_packet_oneway_transit (struct TransferInfo *stats, s
         --stats->isochstats.newburst; // decr the burst counter, need for RTP estimator w/isoch
 	//	printf("**** skip value %f per frame change packet %d expected %d max = %f %d\n", deltaTransit, packet->frameID, stats->isochstats.frameID, stats->inline_jitter.total.max, stats->isochstats.newburst);
     } else if (stats->transit.total.cnt > 1) {
-	stats->jitter += (deltaTransit - stats->jitter) / (16.0);
+	// J is kept scaled by 16, i.e. J=J+(|D|-J)/16 without a divide, per RFC 3550 A.8
+	stats->jitter_ns += deltaTransit_ns - ((stats->jitter_ns + 8) >> 4);
+	stats->jitter = (stats->jitter_ns >> 4) / 1e9;
 	reporter_update_mmm(&stats->inline_jitter.total, stats->jitter);
 	reporter_update_mmm(&stats->inline_jitter.current, stats->jitter);
 	if (stats->jitter_histogram) {
-	    histogram_insert(stats->jitter_histogram, deltaTransit, NULL);
+	    histogram_insert_ns(stats->jitter_histogram, deltaTransit_ns, NULL);
 	}
     }
 }
@@ -1108,8 +1161,14 @@ inline void reporter_handle_packet_server_udp (struct ReporterData *data, struct
 	reporter_reset_mmm(&stats->transit.current);
     } else if (!packet->emptyreport && (packet->packetID > 0)) {
 	bool ooo_packet = false;
-	// packet loss occured if the datagram numbers aren't sequential
-	if (packet->packetID != stats->PacketID + 1) {
+	if (stats->seqwin) {
+	    // A gap is only lost once the reorder window slides past it,
+	    // and only the highest yet goes on to the transit stats
+	    ooo_packet = (seqwin_packet(stats->seqwin, packet->packetID) != SEQ_INORDER);
+	    stats->total.Lost.current = stats->seqwin->cnt.lost;
+	    stats->total.OutofOrder.current = stats->seqwin->cnt.reordered;
+	} else if (packet->packetID != stats->PacketID + 1) {
+	    // packet loss occured if the datagram numbers aren't sequential
 	    if (packet->packetID < stats->PacketID + 1) {
 		stats->total.OutofOrder.current++;
 		ooo_packet = true;
@@ -1121,6 +1180,25 @@ inline void reporter_handle_packet_server_udp (struct ReporterData *data, struct
 	if (packet->packetID > stats->PacketID) {
 	    stats->PacketID = packet->packetID;
 	}
+	if (stats->lossstats && \
+	    lossstats_packet(stats->lossstats, packet->packetID, (packet->packetTimeNs ? packet->packetTimeNs : TimeNsecs(packet->packetTime)))) {
+	    reporter_print_outage(stats);
+	}
+	// The first datagram is read by the listener so has no read status
+	// and no received TOS, it still counts here
+	if ((stats->jitterbuf || stats->dscpstats || (stats->udpflows && packet->flowseqno)) && \
+	    ((packet->err_readwrite != ReadErrLen) || (packet->packetLen >= sizeof(struct UDP_datagram)))) {
+	    int64_t transit = (packet->packetTimeNs ? packet->packetTimeNs : TimeNsecs(packet->packetTime)) \
+		- (packet->sentTimeNs ? packet->sentTimeNs : TimeNsecs(packet->sentTime));
+	    // reordered datagrams too, they may still make their playout
+	    if (stats->jitterbuf)
+		jitterbuf_packet(stats->jitterbuf, transit);
+	    if (stats->dscpstats)
+		dscpstats_packet(stats->dscpstats, (packet->err_readwrite ? packet->tos : DSCPSTATS_NOTOS), \
+				 packet->packetID, packet->packetLen, transit);
+	    if (stats->udpflows && packet->flowseqno)
+		udpflows_rx_packet(stats->udpflows, packet->flowid, packet->flowseqno, packet->packetLen, transit);
+	}
 	// These are valid packets that need standard iperf accounting
 	// Do L2 accounting first (if needed)
 	if (packet->l2errors && (stats->total.Datagrams.current > L2DROPFILTERCOUNTER)) {
@@ -1146,6 +1224,11 @@ inline void reporter_handle_packet_server_udp (struct ReporterData *data, struct
 	    ((packet->err_readwrite == ReadSuccess) ||
 	     ((packet->err_readwrite == ReadErrLen) && (packet->packetLen >= sizeof(struct UDP_datagram))))) {
 	    reporter_handle_packet_oneway_transit(stats, packet);
+	    if (stats->capdetect && \
+		capdetect_packet(stats->capdetect, (packet->packetTimeNs ? packet->packetTimeNs : TimeNsecs(packet->packetTime)), \
+				 stats->transit_ns, packet->packetLen)) {
+		reporter_print_capacity_event(stats);
+	    }
 	}
 	stats->total.Bytes.current += packet->packetLen;
 	reporter_compute_packet_pps(stats, packet);
@@ -1214,7 +1297,7 @@ static inline void reporter_set_timestamps_time (struct TransferInfo *stats, enu
 	}
 	case TOTAL:
 	{
-	    times->iStart = (isOmit(stats->common) ? TimeDifference(times->omitTime, times->startTime) : 0);
+	    times->iStart = (isOmit(stats->common) ? TimeDifference(times->omitTime, times->startTime) : times->tStart);
 	    times->iEnd = TimeDifference(times->packetTime, times->startTime);
 	    stats->final = true;
 	    break;
@@ -1374,12 +1457,20 @@ void reporter_transfer_protocol_server_udp (struct ReporterData *data, bool fina
     struct TransferInfo *stats = &data->info;
     struct TransferInfo *sumstats = (data->GroupSumReport != NULL) ? &data->GroupSumReport->info : NULL;
     struct TransferInfo *fullduplexstats = (data->FullDuplexReport != NULL) ? &data->FullDuplexReport->info : NULL;
+    if (final && stats->seqwin) {
+	// what's still missing from the reorder window is lost now
+	seqwin_flush(stats->seqwin);
+	stats->total.Lost.current = stats->seqwin->cnt.lost;
+    }
     // print a interval report and possibly a partial interval report if this a final
     stats->cntBytes = stats->total.Bytes.current - stats->total.Bytes.prev;
     stats->cntOutofOrder = stats->total.OutofOrder.current - stats->total.OutofOrder.prev;
     // assume most of the  time out-of-order packets are
     // duplicate packets, so conditionally subtract them from the lost packets.
-    stats->cntError = stats->total.Lost.current - stats->total.Lost.prev - stats->cntOutofOrder;
+    // With a reorder window the loss is already net of them
+    stats->cntError = stats->total.Lost.current - stats->total.Lost.prev;
+    if (!isReorderWindow(stats->common))
+	stats->cntError -= stats->cntOutofOrder;
     if (stats->cntError < 0)
 	stats->cntError = 0;
     stats->cntDatagrams = stats->PacketID - stats->total.Datagrams.prev;
@@ -1402,8 +1493,10 @@ void reporter_transfer_protocol_server_udp (struct ReporterData *data, bool fina
 	    stats->framelatency_histogram->final = final;
 	}
     }
-    if (stats->total.Datagrams.current == 1)
+    if (stats->total.Datagrams.current == 1) {
 	stats->jitter = 0;
+	stats->jitter_ns = 0;
+    }
     if (isTripTime(stats->common) && !final) {
 	double lambda =  ((stats->IPGsum > 0.0) ? (round (stats->cntIPG / stats->IPGsum)) : 0.0);
 	double meantransit = (double) ((stats->transit.current.cnt > 0) ? (stats->transit.current.sum / stats->transit.current.cnt) : 0.0);
@@ -1430,6 +1523,9 @@ void reporter_transfer_protocol_server_udp (struct ReporterData *data, bool fina
 	    reporter_update_mmm_sum(&sumstats->transit.current, &stats->transit.current);
 	    reporter_update_mmm_sum(&sumstats->transit.total, &stats->transit.total);
 	}
+	if (stats->dscpstats && sumstats->dscpstats) {
+	    dscpstats_sum(sumstats->dscpstats, stats->dscpstats);
+	}
 	if (final) {
 	    sumstats->threadcnt_final++;
 	    if (data->packetring->downlevel != sumstats->downlevel) {
@@ -1458,7 +1554,8 @@ void reporter_transfer_protocol_server_udp (struct ReporterData *data, bool fina
 	    // assume most of the  time out-of-order packets are not
 	    // duplicate packets, so conditionally subtract them from the lost packets.
 	    stats->cntError = stats->total.Lost.current - stats->total.Lost.prev;
-	    stats->cntError -= stats->cntOutofOrder;
+	    if (!isReorderWindow(stats->common))
+		stats->cntError -= stats->cntOutofOrder;
 	    if (stats->cntError < 0)
 		stats->cntError = 0;
 	    stats->cntDatagrams = stats->PacketID - stats->total.Datagrams.prev;
@@ -1474,7 +1571,8 @@ void reporter_transfer_protocol_server_udp (struct ReporterData *data, bool fina
 	// assume most of the  time out-of-order packets are not
 	// duplicate packets, so conditionally subtract them from the lost packets.
 	stats->cntError = stats->total.Lost.current;
-	stats->cntError -= stats->cntOutofOrder;
+	if (!isReorderWindow(stats->common))
+	    stats->cntError -= stats->cntOutofOrder;
 	if (stats->cntError < 0)
 	    stats->cntError = 0;
 	stats->cntDatagrams = stats->PacketID;
@@ -1539,7 +1637,8 @@ void reporter_transfer_protocol_sum_server_udp (struct TransferInfo *stats, bool
 	// assume most of the  time out-of-order packets are not
 	// duplicate packets, so conditionally subtract them from the lost packets.
 	stats->cntError = stats->total.Lost.current;
-	stats->cntError -= stats->cntOutofOrder;
+	if (!isReorderWindow(stats->common))
+	    stats->cntError -= stats->cntOutofOrder;
 	if (stats->cntError < 0)
 	    stats->cntError = 0;
 	stats->cntDatagrams = stats->total.Datagrams.current;
@@ -1551,7 +1650,8 @@ void reporter_transfer_protocol_sum_server_udp (struct TransferInfo *stats, bool
 	// assume most of the  time out-of-order packets are not
 	// duplicate packets, so conditionally subtract them from the lost packets.
 	stats->cntError = stats->total.Lost.current - stats->total.Lost.prev;
-	stats->cntError -= stats->cntOutofOrder;
+	if (!isReorderWindow(stats->common))
+	    stats->cntError -= stats->cntOutofOrder;
 	if (stats->cntError < 0)
 	    stats->cntError = 0;
 	stats->cntDatagrams = stats->total.Datagrams.current - stats->total.Datagrams.prev;
@@ -1562,6 +1662,9 @@ void reporter_transfer_protocol_sum_server_udp (struct TransferInfo *stats, bool
 	(*stats->output_handler)(stats);
 	reporter_reset_transfer_stats_sum(stats);
     }
+    if (stats->dscpstats) {
+	reporter_print_dscp_stats(stats, final);
+    }
     if (!final) {
 	// there is no packet ID for sum server reports, set it to total cnt for calculation
 	stats->PacketID = stats->total.Datagrams.current;
@@ -2096,7 +2199,39 @@ bool reporter_condprint_time_interval_report (struct ReporterData *data, struct
 	printf("*** packetID TRIGGER = %ld pt=%ld.%06ld empty=%d nt=%ld.%06ld carry %f\n",packet->packetID, packet->packetTime.tv_sec, packet->packetTime.tv_usec, packet->emptyreport, stats->ts.nextTime.tv_sec, stats->ts.nextTime.tv_usec, stats->IPGsumcarry);
 #endif
 	reporter_set_timestamps_time(stats, INTERVAL);
+	IPERF_PROBE4(interval_report, stats->common->transferID, (int64_t) (stats->ts.iStart * 1e6), \
+		     (int64_t) (stats->ts.iEnd * 1e6), stats->total.Bytes.current);
 	(*data->transfer_protocol_handler)(data, 0);
+	if (data->packetring->hotpath && !stats->isMaskOutput) {
+	    reporter_print_hotpath_stats(data, consumption_detector.reporter_thread_suspends, false);
+	}
+	if (data->packetring->kernelts && !stats->isMaskOutput) {
+	    reporter_print_kernelts_stats(data, false);
+	}
+	if (data->packetring->clkoffset && !stats->isMaskOutput) {
+	    reporter_print_clock_offset(data);
+	}
+	if (data->packetring->linkemul && !stats->isMaskOutput) {
+	    reporter_print_link_emul(data, false);
+	}
+	if (stats->rate_schedule && !stats->isMaskOutput) {
+	    reporter_print_rate_schedule(data, false);
+	}
+	if (stats->seqwin && !stats->isMaskOutput) {
+	    reporter_print_seq_window(data, false);
+	}
+	if (stats->lossstats && !stats->isMaskOutput) {
+	    reporter_print_loss_stats(data, false);
+	}
+	if (stats->jitterbuf && !stats->isMaskOutput) {
+	    reporter_print_jitter_buffer(data, false);
+	}
+	if (stats->dscpstats) {
+	    reporter_print_dscp_stats(stats, false);
+	}
+	if (stats->udpflows) {
+	    reporter_print_udp_flows(stats, false);
+	}
 	if (fullduplexstats && ((++data->FullDuplexReport->threads) == 2) && isEnhanced(stats->common)) {
 	    data->FullDuplexReport->threads = 0;
 	    assert(data->FullDuplexReport->transfer_protocol_sum_handler != NULL);
@@ -2154,7 +2289,8 @@ bool reporter_condprint_frame_interval_report_server_udp (struct ReporterData *d
 	// assume most of the  time out-of-order packets are not
 	// duplicate packets, so conditionally subtract them from the lost packets.
 	stats->cntError = stats->total.Lost.current - stats->total.Lost.prev;
-	stats->cntError -= stats->cntOutofOrder;
+	if (!isReorderWindow(stats->common))
+	    stats->cntError -= stats->cntOutofOrder;
 	if (stats->cntError < 0)
 	    stats->cntError = 0;
 	stats->cntDatagrams = stats->PacketID - stats->total.Datagrams.prev;
@@ -60,6 +60,10 @@
 #include "active_hosts.h"
 #include "payloads.h"
 #include "markov.h"
+#include "iperf_metrics.h"
+#include "kernel_timestamps.h"
+#include "clock_offset.h"
+#include "link_emul.h"
 
 static int transferid_counter = 0;
 
@@ -101,6 +105,7 @@ static void common_copy (struct ReportCommon **common, struct thread_Settings *i
     (*common)->flags = inSettings->flags;
     (*common)->flags_extend = inSettings->flags_extend;
     (*common)->flags_extend2 = inSettings->flags_extend2;
+    (*common)->flags_extend3 = inSettings->flags_extend3;
     (*common)->ThreadMode = inSettings->mThreadMode;
     (*common)->ReportMode = inSettings->mReportMode;
     (*common)->KeyCheck = inSettings->mKeyCheck;
@@ -210,7 +215,13 @@ void setTransferID (struct thread_Settings *inSettings, enum TansferIDType traff
 	int len = 0;
 	if (traffic_direction == REVERSED)  {
 #ifdef HAVE_ROLE_REVERSAL_ID
-	    if (isPermitKey(inSettings) && (inSettings->mPermitKey[0] != '\0')) {
+	    if (inSettings->mProfileName) {
+		len = snprintf(NULL, 0, "[%s(*%d)] ", \
+			       inSettings->mProfileName, inSettings->mTransferID);
+		inSettings->mTransferIDStr = (char *) calloc(len + 1, sizeof(char));
+		len = sprintf(inSettings->mTransferIDStr, "[%s(*%d)] ", \
+			       inSettings->mProfileName, inSettings->mTransferID);
+	    } else if (isPermitKey(inSettings) && (inSettings->mPermitKey[0] != '\0')) {
 		len = snprintf(NULL, 0, "[%s(*%d)] ", \
 			       inSettings->mPermitKey, inSettings->mTransferID);
 		inSettings->mTransferIDStr = (char *) calloc(len + 1, sizeof(char));
@@ -226,6 +237,13 @@ void setTransferID (struct thread_Settings *inSettings, enum TansferIDType traff
 		len = sprintf(inSettings->mTransferIDStr, "[*%d] ", inSettings->mTransferID);
 	    }
 #endif
+	} else if (inSettings->mProfileName) {
+	    // flows of a --profile are identified by their declared names
+	    len = snprintf(NULL, 0, "[%s(%d)] ", \
+			   inSettings->mProfileName, inSettings->mTransferID);
+	    inSettings->mTransferIDStr = (char *) calloc(len + 1, sizeof(char));
+	    len = sprintf(inSettings->mTransferIDStr, "[%s(%d)] ", \
+			   inSettings->mProfileName, inSettings->mTransferID);
 	} else if (isPermitKey(inSettings) && (inSettings->mPermitKey[0] != '\0')) {
 	    len = snprintf(NULL, 0, "[%s(%d)] ", \
 			   inSettings->mPermitKey, inSettings->mTransferID);
@@ -460,6 +478,14 @@ struct SumReport* InitSumReport(struct thread_Settings *inSettings, int inID, bo
 	}
     } else {
 	SetSumHandlers(inSettings, sumreport);
+	if (isMetrics(inSettings) || isStatsShm(inSettings)) {
+	    sumreport->info.metrics = iperf_metrics_alloc();
+	}
+	if ((inSettings->mThreadMode == kMode_Server) && isUDP(inSettings) && isDSCPStats(inSettings)) {
+	    if ((sumreport->info.dscpstats = dscpstats_alloc(DSCPSTATS_NOTOS)) == NULL) {
+		FAIL(1, "Out of Memory!!\n", inSettings);
+	    }
+	}
     }
 #ifdef HAVE_THREAD_DEBUG
     thread_debug("Init sum report %p id=%d", (void *)sumreport, inID);
@@ -508,6 +534,12 @@ void FreeSumReport (struct SumReport *sumreport) {
     if (sumreport->info.jitter_histogram) {
 	histogram_delete(sumreport->info.jitter_histogram);
     }
+    if (sumreport->info.metrics) {
+	iperf_metrics_free(sumreport->info.metrics);
+    }
+    if (sumreport->info.dscpstats) {
+	dscpstats_free(sumreport->info.dscpstats);
+    }
     free_common_copy(sumreport->info.common);
     free(sumreport);
 }
@@ -550,6 +582,27 @@ static void Free_iReport (struct ReporterData *ireport) {
     if (ireport->info.markov_graph_len) {
 	markov_graph_free(ireport->info.markov_graph_len);
     }
+    if (ireport->info.capdetect) {
+	capdetect_free(ireport->info.capdetect);
+    }
+    if (ireport->info.seqwin) {
+	seqwin_free(ireport->info.seqwin);
+    }
+    if (ireport->info.lossstats) {
+	lossstats_free(ireport->info.lossstats);
+    }
+    if (ireport->info.jitterbuf) {
+	jitterbuf_free(ireport->info.jitterbuf);
+    }
+    if (ireport->info.dscpstats) {
+	dscpstats_free(ireport->info.dscpstats);
+    }
+    if (ireport->info.udpflows) {
+	udpflows_rx_free(ireport->info.udpflows);
+    }
+    if (ireport->info.metrics) {
+	iperf_metrics_free(ireport->info.metrics);
+    }
     free_common_copy(ireport->info.common);
     free(ireport);
 }
@@ -679,6 +732,27 @@ struct ReportHeader* InitIndividualReport (struct thread_Settings *inSettings) {
     // This is needed so summing works properly
     ireport->packetring = packetring_init((inSettings->numreportstructs ? inSettings->numreportstructs : (isSingleUDP(inSettings) ? 40 : NUM_REPORT_STRUCTS)), \
 					  &ReportCond, (isSingleUDP(inSettings) ? NULL : &inSettings->awake_me));
+    // TCP carries tcpinfo, write times, burst headers and bounceback times,
+    // UDP only the isoch, burst, l2 and logical flow fields
+    if (!isUDP(inSettings) || isIsochronous(inSettings) || isPeriodicBurst(inSettings) \
+	|| isL2LengthCheck(inSettings) || isUDPFlows(inSettings)) {
+	packetring_side_init(ireport->packetring);
+    }
+    if (isHotPathStats(inSettings)) {
+	ireport->packetring->hotpath = (struct HotPathStats *) calloc(1, sizeof(struct HotPathStats));
+	if (ireport->packetring->hotpath == NULL) {
+	    FAIL(1, "Out of Memory!!\n", inSettings);
+	}
+    }
+    if (isSoTimestamping(inSettings) && isUDP(inSettings)) {
+	ireport->packetring->kernelts = kernelts_alloc(isHwTimestamping(inSettings));
+    }
+    if (isClockOffset(inSettings) && isUDP(inSettings)) {
+	ireport->packetring->clkoffset = clock_offset_alloc();
+    }
+    if (isLinkEmul(inSettings) && isUDP(inSettings) && (inSettings->mThreadMode == kMode_Server)) {
+	ireport->packetring->linkemul = linkemul_alloc(&inSettings->mLinkEmul);
+    }
 #ifdef HAVE_THREAD_DEBUG
     char rs[REPORTTXTMAX];
     reporttype_text(reporthdr, &rs[0]);
@@ -687,6 +761,9 @@ struct ReportHeader* InitIndividualReport (struct thread_Settings *inSettings) {
 		 (void *) inSettings->mSumReport, (void *) inSettings->mFullDuplexReport, \
 		 (void *) ireport->packetring, ireport->packetring->bytes, (void *) ireport->packetring->awake_producer, inSettings->mSock);
 #endif
+    if (isMetrics(inSettings) || isStatsShm(inSettings)) {
+	ireport->info.metrics = iperf_metrics_alloc();
+    }
     if (inSettings->numreportstructs)
 	fprintf (stdout, "%sNUM_REPORT_STRUCTS override from %d to %d\n", inSettings->mTransferIDStr, NUM_REPORT_STRUCTS, inSettings->numreportstructs);
 
@@ -903,6 +980,40 @@ struct ReportHeader* InitIndividualReport (struct thread_Settings *inSettings) {
     if (isUDP(inSettings) && inSettings->mBraKetGraph) {
 	ireport->info.markov_graph_len = markov_graph_init(inSettings->mBraKetGraph);
     }
+    if (inSettings->mThreadMode == kMode_Client) {
+	// parsed by the settings, read only and shared across the threads
+	ireport->info.rate_schedule = inSettings->mRateSchedule;
+    }
+    if ((inSettings->mThreadMode == kMode_Server) && isUDP(inSettings) && isCapDetect(inSettings)) {
+	if ((ireport->info.capdetect = capdetect_alloc(inSettings->mCapDetectWindow)) == NULL) {
+	    FAIL(1, "Out of Memory!!\n", inSettings);
+	}
+    }
+    if ((inSettings->mThreadMode == kMode_Server) && isUDP(inSettings) && isReorderWindow(inSettings)) {
+	if ((ireport->info.seqwin = seqwin_alloc(inSettings->mReorderWindow)) == NULL) {
+	    FAIL(1, "Out of Memory!!\n", inSettings);
+	}
+    }
+    if ((inSettings->mThreadMode == kMode_Server) && isUDP(inSettings) && isLossStats(inSettings)) {
+	if ((ireport->info.lossstats = lossstats_alloc(inSettings->mOutageFactor)) == NULL) {
+	    FAIL(1, "Out of Memory!!\n", inSettings);
+	}
+    }
+    if ((inSettings->mThreadMode == kMode_Server) && isUDP(inSettings) && isJitterBuffer(inSettings)) {
+	if ((ireport->info.jitterbuf = jitterbuf_alloc(inSettings->mJitterBufSize, inSettings->mJitterBufDepth)) == NULL) {
+	    FAIL(1, "Out of Memory!!\n", inSettings);
+	}
+    }
+    if ((inSettings->mThreadMode == kMode_Server) && isUDP(inSettings) && isDSCPStats(inSettings)) {
+	if ((ireport->info.dscpstats = dscpstats_alloc(inSettings->mTOS & 0xFF)) == NULL) {
+	    FAIL(1, "Out of Memory!!\n", inSettings);
+	}
+    }
+    if ((inSettings->mThreadMode == kMode_Server) && isUDP(inSettings) && isUDPFlows(inSettings)) {
+	if ((ireport->info.udpflows = udpflows_rx_alloc()) == NULL) {
+	    FAIL(1, "Out of Memory!!\n", inSettings);
+	}
+    }
 
     if ((inSettings->mThreadMode == kMode_Client) && isBounceBack(inSettings)) {
 	char name[] = " BB8";
@@ -66,6 +66,11 @@
 #include "SocketAddr.h"
 #include "payloads.h"
 #include "prague_cc.h"
+#include "iperf_probes.h"
+#include "kernel_timestamps.h"
+#include "clock_offset.h"
+#include "link_emul.h"
+#include "traffic_profile.h"
 #include <cmath>
 #if defined(HAVE_LINUX_FILTER_H) && defined(HAVE_AF_PACKET)
 #include "checksums.h"
@@ -81,6 +86,16 @@ Server::Server (thread_Settings *inSettings) {
 #endif
     mSettings = inSettings;
     myJob = NULL;
+    hotpath = NULL;
+    kernelts = NULL;
+    clkoffset = NULL;
+    clkoffset_echoes = 0;
+    clkoffset_lastecho = 0;
+    linkemul = NULL;
+    linkemul_prevSentTime.tv_sec = 0;
+    linkemul_prevSentTime.tv_usec = 0;
+    linkemul_prevPacketTime.tv_sec = 0;
+    linkemul_prevPacketTime.tv_usec = 0;
     reportstruct = &scratchpad;
     memset(&scratchpad, 0, sizeof(struct ReportStruct));
     mySocket = inSettings->mSock;
@@ -123,6 +138,10 @@ Server::Server (thread_Settings *inSettings) {
             sorcvtimer = 1000; // lower bound of 1 ms
         }
     }
+    // held packets are only released between reads
+    if (isLinkEmul(mSettings) && isUDP(mSettings) && ((sorcvtimer == 0) || (sorcvtimer > 1000))) {
+        sorcvtimer = 1000;
+    }
     if (sorcvtimer > 0) {
         SetSocketOptionsReceiveTimeout(mSettings, sorcvtimer);
     }
@@ -253,7 +272,10 @@ void Server::RunTCP () {
 #else
                 int recvflags = 0;
 #endif
+                double hotpath_start = (hotpath ? hotpath_now() : 0);
                 n = recv(mSettings->mSock, mSettings->mBuf, readLen, recvflags);
+                if (hotpath)
+                    hotpath_syscall(hotpath, hotpath_start);
                 if (n > 0) {
                     reportstruct->emptyreport = false;
                     if (isburst) {
@@ -293,6 +315,8 @@ void Server::RunTCP () {
                 tokens -= currLen;
 
             reportstruct->packetLen = currLen;
+            IPERF_PROBE5(tcp_recv, myReport->info.common->transferID, reportstruct->writecnt, reportstruct->packetLen, \
+                         reportstruct->packetTime.tv_sec, reportstruct->packetTime.tv_usec);
             ReportPacket(myReport, reportstruct);
             // Check for reverse and amount where
             // the server stops after receiving
@@ -503,6 +527,20 @@ void Server::InitKernelTimeStamping () {
     message.msg_controllen = sizeof(ctrl);
 
     int timestampOn = 1;
+#if HAVE_SO_TIMESTAMPING
+    if (isSoTimestamping(mSettings) && isUDP(mSettings)) {
+        if (kernelts_enable_rx(mSettings->mSock, isHwTimestamping(mSettings), mSettings->mIfrname) == 0) {
+            return;
+        }
+        WARN_errno(1, "setsockopt SO_TIMESTAMPING");
+    }
+#endif
+#ifdef SO_TIMESTAMPNS
+    // Prefer nanosecond kernel timestamps, needed by HEADER_NSECTS flows
+    if (setsockopt(mSettings->mSock, SOL_SOCKET, SO_TIMESTAMPNS, &timestampOn, sizeof(timestampOn)) == 0) {
+        return;
+    }
+#endif
     if (setsockopt(mSettings->mSock, SOL_SOCKET, SO_TIMESTAMP, &timestampOn, sizeof(timestampOn)) < 0) {
         WARN_errno(mSettings->mSock == SO_TIMESTAMP, "socket");
     }
@@ -563,12 +601,18 @@ inline void Server::SetReportStartTime () {
 	printf("**** start %ld.%ld omit %ld.%ld\n", myReport->info.ts.startTime.tv_sec, myReport->info.ts.startTime.tv_usec, myReport->info.ts.omitTime.tv_sec, myReport->info.ts.omitTime.tv_usec);
 #endif
     }
+    if (mSettings->mProfile) {
+        // reverse flows of a --profile share the client's report clock
+        traffic_profile_start(mSettings->mProfile, &myReport->info.ts, NULL);
+    }
     if (myReport->GroupSumReport) {
         struct TransferInfo *sumstats = &myReport->GroupSumReport->info;
         assert(sumstats != NULL);
         Mutex_Lock(&myReport->GroupSumReport->reference.lock);
         if (TimeZero(sumstats->ts.startTime)) {
             sumstats->ts.startTime = myReport->info.ts.startTime;
+            sumstats->ts.tStart = myReport->info.ts.tStart;
+            sumstats->ts.iEnd = myReport->info.ts.iEnd;
             if (mSettings->mIntervalMode == kInterval_Time) {
                 sumstats->ts.nextTime = myReport->info.ts.nextTime;
             }
@@ -678,6 +722,10 @@ bool Server::InitTrafficLoop (void) {
     myJob = InitIndividualReport(mSettings);
     myReport = static_cast<struct ReporterData *>(myJob->this_report);
     assert(myJob != NULL);
+    hotpath = myReport->packetring->hotpath;
+    kernelts = myReport->packetring->kernelts;
+    clkoffset = myReport->packetring->clkoffset;
+    linkemul = myReport->packetring->linkemul;
     if (mSettings->mReportMode == kReport_CSV) {
         format_ips_port_string(&myReport->info, 0);
     }
@@ -763,6 +811,7 @@ bool Server::InitTrafficLoop (void) {
         if (isUDP(mSettings)) {
             int offset = 0;
             reportstruct->packetTime = mSettings->accept_time;
+            reportstruct->packetTimeNs = 0;
             UDPReady = !ReadPacketID(offset);
         } else {
             reportstruct->sentTime.tv_sec = myReport->info.ts.startTime.tv_sec;
@@ -779,9 +828,13 @@ inline int Server::ReadWithRxTimestamp () {
     int tsdone = false;
 
     reportstruct->err_readwrite = ReadSuccess;
+    reportstruct->packetTimeNs = 0;
+    double hotpath_start = (hotpath ? hotpath_now() : 0);
 #if (HAVE_DECL_SO_TIMESTAMP) && (HAVE_DECL_MSG_CTRUNC)
     cmsg = reinterpret_cast<struct cmsghdr *>(&ctrl);
     currLen = recvmsg(mSettings->mSock, &message, mSettings->recvflags);
+    if (hotpath)
+        hotpath_syscall(hotpath, hotpath_start);
     if (currLen > 0) {
 #if HAVE_DECL_MSG_TRUNC
         if (message.msg_flags & MSG_TRUNC) {
@@ -800,6 +853,41 @@ inline int Server::ReadWithRxTimestamp () {
                     }
                     tsdone = true;
                 }
+#ifdef SO_TIMESTAMPNS
+                if (cmsg->cmsg_level == SOL_SOCKET &&
+                    cmsg->cmsg_type  == SCM_TIMESTAMPNS &&
+                    cmsg->cmsg_len   == CMSG_LEN(sizeof(struct timespec))) {
+                    struct timespec rxts;
+                    memcpy(&rxts, CMSG_DATA(cmsg), sizeof(struct timespec));
+                    reportstruct->packetTime.tv_sec = rxts.tv_sec;
+                    reportstruct->packetTime.tv_usec = rxts.tv_nsec / 1000;
+                    reportstruct->packetTimeNs = (static_cast<int64_t>(rxts.tv_sec) * 1000000000LL) + rxts.tv_nsec;
+                    if (TimeZero(myReport->info.ts.prevpacketTime)) {
+                        myReport->info.ts.prevpacketTime = reportstruct->packetTime;
+                    }
+                    tsdone = true;
+                }
+#endif
+#if HAVE_SO_TIMESTAMPING
+                if (cmsg->cmsg_level == SOL_SOCKET &&
+                    cmsg->cmsg_type  == SCM_TIMESTAMPING &&
+                    cmsg->cmsg_len   == CMSG_LEN(sizeof(struct scm_timestamping))) {
+                    struct scm_timestamping tss;
+                    memcpy(&tss, CMSG_DATA(cmsg), sizeof(struct scm_timestamping));
+                    // ts[2] is the raw hardware stamp, zero when the device didn't provide one
+                    bool hwts = (tss.ts[2].tv_sec || tss.ts[2].tv_nsec);
+                    struct timespec *rxts = (hwts ? &tss.ts[2] : &tss.ts[0]);
+                    reportstruct->packetTime.tv_sec = rxts->tv_sec;
+                    reportstruct->packetTime.tv_usec = rxts->tv_nsec / 1000;
+                    reportstruct->packetTimeNs = (static_cast<int64_t>(rxts->tv_sec) * 1000000000LL) + rxts->tv_nsec;
+                    if (TimeZero(myReport->info.ts.prevpacketTime)) {
+                        myReport->info.ts.prevpacketTime = reportstruct->packetTime;
+                    }
+                    if (kernelts)
+                        kernelts_rx(kernelts, reportstruct->packetTimeNs, hwts);
+                    tsdone = true;
+                }
+#endif
 		if (cmsg->cmsg_level == IPPROTO_IP &&
                     cmsg->cmsg_type  == IP_TOS &&
                     cmsg->cmsg_len   == CMSG_LEN(sizeof(u_char))) {
@@ -813,6 +901,8 @@ inline int Server::ReadWithRxTimestamp () {
     }
 #else
     currLen = recv(mSettings->mSock, mSettings->mBuf, mSettings->mBufLen, mSettings->recvflags);
+    if (hotpath)
+        hotpath_syscall(hotpath, hotpath_start);
 #endif
     // RJM clean up
     if (currLen <= 0) {
@@ -838,10 +928,43 @@ inline int Server::ReadWithRxTimestamp () {
         now.setnow();
         reportstruct->packetTime.tv_sec = now.getSecs();
         reportstruct->packetTime.tv_usec = now.getUsecs();
+        reportstruct->packetTimeNs = now.getNsecs();
     }
     return currLen;
 }
 
+// Echo a datagram's send time with this server's receive and send times
+// so the client can estimate the clock offset, see --clock-offset. The
+// first few are echoed back to back for a quick initial estimate.
+void Server::ClockOffsetEcho () {
+    if (!isNsecTs(mSettings) || (reportstruct->packetLen < MINCLKOFFSETPAYLOAD))
+        return;
+    int64_t t2 = (reportstruct->packetTimeNs ? reportstruct->packetTimeNs : TimeNsecs(reportstruct->packetTime));
+    if ((clkoffset_echoes >= CLKOFFSET_ECHOBURST) && ((t2 - clkoffset_lastecho) < CLKOFFSET_ECHOPERIOD))
+        return;
+    clkoffset_echoes++;
+    clkoffset_lastecho = t2;
+    // t1 is the raw client send time, not the offset corrected one
+    struct UDP_datagram_nsects *mBuf_nsects = reinterpret_cast<struct UDP_datagram_nsects *>(mSettings->mBuf + sizeof(struct client_udp_testhdr));
+    struct clkoffset_echo echo;
+    echo.typelen.type = htonl(CLKOFFSETECHO);
+    echo.typelen.length = htonl(sizeof(echo));
+    echo.t1_u = mBuf_nsects->tv_nsec_u;
+    echo.t1_l = mBuf_nsects->tv_nsec_l;
+    echo.t2_u = htonl(static_cast<uint32_t>(t2 >> 32));
+    echo.t2_l = htonl(static_cast<uint32_t>(t2 & 0xFFFFFFFFLL));
+    Timestamp txnow;
+    int64_t t3 = txnow.getNsecs();
+    echo.t3_u = htonl(static_cast<uint32_t>(t3 >> 32));
+    echo.t3_l = htonl(static_cast<uint32_t>(t3 & 0xFFFFFFFFLL));
+#if HAVE_DECL_MSG_DONTWAIT
+    int rc = send(mySocket, reinterpret_cast<const char *>(&echo), sizeof(echo), MSG_DONTWAIT);
+#else
+    int rc = send(mySocket, reinterpret_cast<const char *>(&echo), sizeof(echo), 0);
+#endif
+    WARN_errno((rc < 0) && (errno != EAGAIN), "send clock offset echo");
+}
+
 // Returns true if the client has indicated this is the final packet
 inline bool Server::ReadPacketID (int offset_adjust) {
     bool terminate = false;
@@ -852,6 +975,39 @@ inline bool Server::ReadPacketID (int offset_adjust) {
     // read the sent timestamp from the rx packet
     reportstruct->sentTime.tv_sec = ntohl(mBuf_UDP->tv_sec);
     reportstruct->sentTime.tv_usec = ntohl(mBuf_UDP->tv_usec);
+    // a short isoch or burst write may not carry the nanosecond timestamp
+    if (isNsecTs(mSettings) && (reportstruct->packetLen >= MINNSECTSPAYLOAD)) {
+        struct UDP_datagram_nsects *mBuf_nsects = reinterpret_cast<struct UDP_datagram_nsects *>(mSettings->mBuf + offset_adjust + sizeof(struct client_udp_testhdr));
+        reportstruct->sentTimeNs = (static_cast<int64_t>(ntohl(mBuf_nsects->tv_nsec_u)) << 32) | ntohl(mBuf_nsects->tv_nsec_l);
+    } else {
+        reportstruct->sentTimeNs = 0;
+    }
+    // move the sent time into this server's clock per the client's --clock-offset estimate
+    if (clkoffset && (reportstruct->packetLen >= MINCLKOFFSETPAYLOAD)) {
+        struct UDP_datagram_clkoffset *mBuf_clkoffset = reinterpret_cast<struct UDP_datagram_clkoffset *>(mSettings->mBuf + offset_adjust + MINNSECTSPAYLOAD);
+        uint32_t bound = ntohl(mBuf_clkoffset->bound_ns);
+        if (bound) {
+            int64_t offset = static_cast<int64_t>((static_cast<uint64_t>(ntohl(mBuf_clkoffset->offset_ns_u)) << 32) | ntohl(mBuf_clkoffset->offset_ns_l));
+            int64_t sentns = (reportstruct->sentTimeNs ? reportstruct->sentTimeNs : TimeNsecs(reportstruct->sentTime)) + offset;
+            reportstruct->sentTime.tv_sec = static_cast<time_t>(sentns / 1000000000LL);
+            reportstruct->sentTime.tv_usec = static_cast<long>((sentns % 1000000000LL) / 1000);
+            if (reportstruct->sentTimeNs)
+                reportstruct->sentTimeNs = sentns;
+            clkoffset->pub.offset = offset;
+            clkoffset->pub.bound = bound;
+            clkoffset->pub.drift = static_cast<int32_t>(ntohl(mBuf_clkoffset->drift_ppb)) / 1e9;
+            clkoffset->pub.samples++;
+            clkoffset->pub.valid = true;
+        }
+    }
+    // the logical flow of a --udp-flows datagram, the FIN and short reads have none
+    if (isUDPFlows(mSettings) && (reportstruct->packetLen >= MINUDPFLOWSPAYLOAD)) {
+        struct UDP_datagram_flow *mBuf_flow = reinterpret_cast<struct UDP_datagram_flow *>(mSettings->mBuf + offset_adjust + MINCLKOFFSETPAYLOAD);
+        reportstruct->flowid = ntohl(mBuf_flow->flowid);
+        reportstruct->flowseqno = (static_cast<intmax_t>(ntohl(mBuf_flow->seqno_u)) << 32) | ntohl(mBuf_flow->seqno_l);
+    } else {
+        reportstruct->flowseqno = 0;
+    }
     if (isSeqNo64b(mSettings)) {
         // New client - Signed PacketID packed into unsigned id2,id
         reportstruct->packetID = (static_cast<uint32_t>(ntohl(mBuf_UDP->id))) | (static_cast<uintmax_t>(ntohl(mBuf_UDP->id2)) << 32);
@@ -1031,6 +1187,43 @@ inline void Server::udp_isoch_processing (int rxlen) {
     }
 }
 
+// Pass the packet through the --link-emul stage and report whatever it
+// releases, stamped with the emulated delivery time. Lost packets are
+// never reported so the sequence accounting sees them as lost. The last
+// packet flushes the delay line rather than wait on it, so the client's
+// final exchange isn't delayed, and is then reported as delivered last.
+void Server::LinkEmulation (bool isLastPacket) {
+    struct ReportStruct *packet;
+    bool held = false;
+    int64_t arrival = (reportstruct->packetTimeNs ? reportstruct->packetTimeNs : TimeNsecs(reportstruct->packetTime));
+    if (!reportstruct->emptyreport && !isLastPacket && !(reportstruct->l2errors & L2UNKNOWN)) {
+        linkemul_enqueue(linkemul, reportstruct, arrival);
+        held = true;
+    }
+    now.setnow();
+    int64_t last = now.getNsecs();
+    if (isLastPacket && ((arrival + linkemul->params.delay) > last)) {
+        last = arrival + linkemul->params.delay;
+    }
+    while ((packet = (isLastPacket ? linkemul_flush(linkemul) : linkemul_dequeue(linkemul, last))) != NULL) {
+        // the released order, which jitter can change, sets the previous times
+        packet->prevSentTime = (TimeZero(linkemul_prevSentTime) ? packet->sentTime : linkemul_prevSentTime);
+        packet->prevPacketTime = (TimeZero(linkemul_prevPacketTime) ? packet->packetTime : linkemul_prevPacketTime);
+        linkemul_prevSentTime = packet->sentTime;
+        linkemul_prevPacketTime = packet->packetTime;
+        if (packet->packetTimeNs > last)
+            last = packet->packetTimeNs;
+        ReportPacket(myReport, packet);
+    }
+    if (!held) {
+        // timeouts and the last packet are reported after anything released before them
+        reportstruct->packetTime.tv_sec = static_cast<long>(last / 1000000000LL);
+        reportstruct->packetTime.tv_usec = static_cast<long>((last % 1000000000LL) / 1000);
+        reportstruct->packetTimeNs = last;
+        ReportPacket(myReport, reportstruct);
+    }
+}
+
 /* -------------------------------------------------------------------
  * Receive UDP data from the (connected) socket.
  * Sends termination flag several times at the end.
@@ -1084,9 +1277,19 @@ void Server::RunUDP () {
                     if (isIsochronous(mSettings)) {
                         udp_isoch_processing(rxlen);
                     }
+                    // the echo is written to the UDP socket so not with L2 packet sockets
+                    if (clkoffset && !isLastPacket && !isL2LengthCheck(mSettings)) {
+                        ClockOffsetEcho();
+                    }
                 }
             }
-            ReportPacket(myReport, reportstruct);
+            IPERF_PROBE5(udp_recv, myReport->info.common->transferID, reportstruct->packetID, reportstruct->packetLen, \
+                         reportstruct->packetTime.tv_sec, reportstruct->packetTime.tv_usec);
+            if (linkemul) {
+                LinkEmulation(isLastPacket);
+            } else {
+                ReportPacket(myReport, reportstruct);
+            }
         }
     }
     disarm_itimer();
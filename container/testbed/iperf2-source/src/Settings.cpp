@@ -74,6 +74,12 @@
 #include "PerfSocket.hpp"
 #include "dscp.h"
 #include "iperf_formattime.h"
+#include "rate_schedule.h"
+#include "capacity_detect.h"
+#include "seq_window.h"
+#include "loss_stats.h"
+#include "udp_flows.h"
+#include "pcap_replay.h"
 #include <math.h>
 
 static int reversetest = 0;
@@ -138,6 +144,24 @@ static int skiprxcopy = 0;
 static int udpl4s = 0;
 static int udpl4svideo = 0;
 static int setrandseed = 0;
+static int metricsport = 0;
+static int statsshm = 0;
+static int hotpathstats = 0;
+static int selftest = 0;
+static int tscclock = 0;
+static int ticksched = 0;
+static int sotimestamping = 0;
+static int clockoffset = 0;
+static int linkemul = 0;
+static int capdetect = 0;
+static int reorderwindow = 0;
+static int lossstats = 0;
+static int jitterbuffer = 0;
+static int dscpstats = 0;
+static int rateschedule = 0;
+static int profile = 0;
+static int udpflows = 0;
+static int pcapreplay = 0;
 
 void Settings_Interpret(char option, const char *optarg, struct thread_Settings *mExtSettings);
 // apply compound settings after the command line has been fully parsed
@@ -249,6 +273,24 @@ const struct option long_options[] =
 {"burst-size", required_argument, &burstsize, 1},
 {"burst-period", required_argument, &burstperiodic, 1},
 {"set-rand-seed", required_argument, &setrandseed, 1},
+{"metrics-port", required_argument, &metricsport, 1},
+{"stats-shm", required_argument, &statsshm, 1},
+{"hotpath-stats", no_argument, &hotpathstats, 1},
+{"selftest", optional_argument, &selftest, 1},
+{"tsc-clock", no_argument, &tscclock, 1},
+{"tick-scheduler", optional_argument, &ticksched, 1},
+{"so-timestamping", optional_argument, &sotimestamping, 1},
+{"clock-offset", no_argument, &clockoffset, 1},
+{"link-emul", required_argument, &linkemul, 1},
+{"capacity-detect", optional_argument, &capdetect, 1},
+{"reorder-window", optional_argument, &reorderwindow, 1},
+{"loss-stats", optional_argument, &lossstats, 1},
+{"jitter-buffer", optional_argument, &jitterbuffer, 1},
+{"dscp-stats", no_argument, &dscpstats, 1},
+{"rate-schedule", required_argument, &rateschedule, 1},
+{"profile", required_argument, &profile, 1},
+{"udp-flows", required_argument, &udpflows, 1},
+{"pcap-replay", required_argument, &pcapreplay, 1},
 {"skip-rx-copy", no_argument, &skiprxcopy, 1},
 {"tos-override", required_argument, &overridetos, 1},
 {"tcp-rx-window-clamp", required_argument, &rxwinclamp, 1},
@@ -344,6 +386,7 @@ void Settings_Initialize (struct thread_Settings *main) {
     main->flags         = FLAG_MODETIME | FLAG_STDOUT; // Default time and stdout
     main->flags_extend  = 0x0;           // Default all extend flags to off
     main->flags_extend2 = 0x0;           // Default all extend flags to off
+    main->flags_extend3 = 0x0;           // Default all extend flags to off
     //main->mAppRate      = 0;           // -b,  offered (or rate limited) load (both UDP and TCP)
     main->mAppRateUnits = kRate_BW;
     //main->mHost         = NULL;        // -c,  none, required for client
@@ -456,6 +499,18 @@ void Settings_Copy (struct thread_Settings *from, struct thread_Settings **into,
 	    (*into)->mBraKetGraph = new char[strlen(from->mBraKetGraph) + 1];
 	    strcpy((*into)->mBraKetGraph, from->mBraKetGraph);
 	}
+	if (from->mRateScheduleStr != NULL) {
+	    (*into)->mRateScheduleStr = new char[strlen(from->mRateScheduleStr) + 1];
+	    strcpy((*into)->mRateScheduleStr, from->mRateScheduleStr);
+	}
+	if (from->mPcapReplayStr != NULL) {
+	    (*into)->mPcapReplayStr = new char[strlen(from->mPcapReplayStr) + 1];
+	    strcpy((*into)->mPcapReplayStr, from->mPcapReplayStr);
+	}
+	if (from->mProfileName != NULL) {
+	    (*into)->mProfileName = new char[strlen(from->mProfileName) + 1];
+	    strcpy((*into)->mProfileName, from->mProfileName);
+	}
     } else {
 	(*into)->mHost = NULL;
 	(*into)->mOutputFileName = NULL;
@@ -467,6 +522,9 @@ void Settings_Copy (struct thread_Settings *from, struct thread_Settings **into,
 	(*into)->mIfrnametx = NULL;
 	(*into)->mIsochronousStr = NULL;
 	(*into)->mCongestion = NULL;
+	(*into)->mRateScheduleStr = NULL;
+	(*into)->mPcapReplayStr = NULL;
+	(*into)->mProfileName = NULL;
 	// apply the server side congestion setting to reverse clients
 	if (from->mIsochronousStr != NULL) {
 	    (*into)->mIsochronousStr = new char[strlen(from->mIsochronousStr) + 1];
@@ -474,6 +532,9 @@ void Settings_Copy (struct thread_Settings *from, struct thread_Settings **into,
 	}
     }
 
+    // the metrics listener and stats segment are process wide and owned by the global settings
+    (*into)->mMetricsStr = NULL;
+    (*into)->mStatsShmStr = NULL;
     (*into)->txstart_epoch = from->txstart_epoch;
     (*into)->mSumReport = from->mSumReport;
     (*into)->mFullDuplexReport = from->mFullDuplexReport;
@@ -482,6 +543,8 @@ void Settings_Copy (struct thread_Settings *from, struct thread_Settings **into,
     (*into)->mTID = thread_zeroid();
     (*into)->runNext = NULL;
     (*into)->runNow = NULL;
+    (*into)->mProfileStr = NULL;
+    (*into)->mProfileNext = NULL;
 #if defined(HAVE_LINUX_FILTER_H) && defined(HAVE_AF_PACKET)
     (*into)->mSockDrop = INVALID_SOCKET;
 #endif
@@ -530,10 +593,16 @@ void Settings_Destroy (struct thread_Settings *mSettings) {
     DELETE_ARRAY(mSettings->mCongestion);
     DELETE_ARRAY(mSettings->mLoadCCA);
     DELETE_ARRAY(mSettings->mBraKetGraph);
+    DELETE_ARRAY(mSettings->mRateScheduleStr);
+    DELETE_ARRAY(mSettings->mPcapReplayStr);
+    DELETE_ARRAY(mSettings->mProfileStr);
+    DELETE_ARRAY(mSettings->mProfileName);
     FREE_ARRAY(mSettings->mIfrname);
     FREE_ARRAY(mSettings->mIfrnametx);
     FREE_ARRAY(mSettings->mTransferIDStr);
     DELETE_ARRAY(mSettings->mIsochronousStr);
+    DELETE_ARRAY(mSettings->mMetricsStr);
+    DELETE_ARRAY(mSettings->mStatsShmStr);
     DELETE_ARRAY(mSettings->mBuf);
     DELETE_PTR(mSettings);
 } // end ~Settings
@@ -1561,6 +1630,192 @@ void Settings_Interpret (char option, const char *optarg, struct thread_Settings
 	    setUDPL4SVideo(mExtSettings);
 #endif
 	}
+	if (metricsport) {
+	    metricsport = 0;
+#ifndef HAVE_POSIX_THREAD
+	    fprintf (stderr, "WARN: --metrics-port requires posix threads\n");
+#else
+	    DELETE_ARRAY(mExtSettings->mMetricsStr);
+	    mExtSettings->mMetricsStr = new char[strlen(optarg) + 1];
+	    strcpy(mExtSettings->mMetricsStr, optarg);
+	    setMetrics(mExtSettings);
+#endif
+	}
+	if (statsshm) {
+	    statsshm = 0;
+#ifdef WIN32
+	    fprintf (stderr, "WARN: --stats-shm not supported\n");
+#else
+	    DELETE_ARRAY(mExtSettings->mStatsShmStr);
+	    // POSIX shared memory names start with a slash
+	    mExtSettings->mStatsShmStr = new char[strlen(optarg) + 2];
+	    snprintf(mExtSettings->mStatsShmStr, strlen(optarg) + 2, "%s%s", ((optarg[0] == '/') ? "" : "/"), optarg);
+	    setStatsShm(mExtSettings);
+#endif
+	}
+	if (hotpathstats) {
+	    hotpathstats = 0;
+	    setHotPathStats(mExtSettings);
+	}
+	if (selftest) {
+	    selftest = 0;
+#ifdef WIN32
+	    fprintf (stderr, "WARN: --selftest not supported\n");
+#else
+	    setSelfTest(mExtSettings);
+	    if (optarg) {
+		mExtSettings->mSelfTestTime = atof(optarg);
+		if (mExtSettings->mSelfTestTime <= 0) {
+		    fprintf(stderr, "ERROR: --selftest seconds must be positive\n");
+		    exit(1);
+		}
+	    }
+#endif
+	}
+	if (tscclock) {
+	    tscclock = 0;
+#if HAVE_FASTCLOCK
+	    setTscClock(mExtSettings);
+#else
+	    fprintf (stderr, "WARN: --tsc-clock not supported on this platform\n");
+#endif
+	}
+	if (ticksched) {
+	    ticksched = 0;
+#ifdef WIN32
+	    fprintf (stderr, "WARN: --tick-scheduler not supported\n");
+#else
+	    setTickScheduler(mExtSettings);
+	    mExtSettings->mTickSchedThreads = 1;
+	    if (optarg) {
+		mExtSettings->mTickSchedThreads = atoi(optarg);
+		if ((mExtSettings->mTickSchedThreads < 1) || (mExtSettings->mTickSchedThreads > TIMER_WHEEL_MAXTHREADS)) {
+		    fprintf(stderr, "ERROR: --tick-scheduler threads must be 1 to %d\n", TIMER_WHEEL_MAXTHREADS);
+		    exit(1);
+		}
+	    }
+#endif
+	}
+	if (sotimestamping) {
+	    sotimestamping = 0;
+#ifdef WIN32
+	    fprintf (stderr, "WARN: --so-timestamping not supported\n");
+#else
+	    setSoTimestamping(mExtSettings);
+	    if (optarg) {
+		if (strcmp(optarg, "hw") == 0) {
+		    setHwTimestamping(mExtSettings);
+		} else if (strcmp(optarg, "sw") != 0) {
+		    fprintf(stderr, "ERROR: --so-timestamping must be sw or hw\n");
+		    exit(1);
+		}
+	    }
+#endif
+	}
+	if (clockoffset) {
+	    clockoffset = 0;
+	    setClockOffset(mExtSettings);
+	}
+	if (linkemul) {
+	    linkemul = 0;
+	    if (linkemul_parse(optarg, &mExtSettings->mLinkEmul) != 0) {
+		fprintf(stderr, "ERROR: --link-emul %s not understood, expect delay=,jitter=,rate=,burst=,limit=,loss= or ge= with jitter no more than delay\n", optarg);
+		exit(1);
+	    }
+	    setLinkEmul(mExtSettings);
+	}
+	if (capdetect) {
+	    capdetect = 0;
+	    setCapDetect(mExtSettings);
+	    mExtSettings->mCapDetectWindow = CAPDETECT_DEFWINDOW;
+	    if (optarg) {
+		// milliseconds, fractions allowed
+		double window = atof(optarg);
+		if (window <= 0) {
+		    fprintf(stderr, "ERROR: --capacity-detect window must be a positive number of milliseconds\n");
+		    exit(1);
+		}
+		mExtSettings->mCapDetectWindow = (int64_t) (window * 1e6);
+	    }
+	}
+	if (reorderwindow) {
+	    reorderwindow = 0;
+	    setReorderWindow(mExtSettings);
+	    mExtSettings->mReorderWindow = SEQWINDOW_DEFAULT;
+	    if (optarg) {
+		mExtSettings->mReorderWindow = atoi(optarg);
+		if ((mExtSettings->mReorderWindow < 1) || (mExtSettings->mReorderWindow > SEQWINDOW_MAX)) {
+		    fprintf(stderr, "ERROR: --reorder-window must be from 1 to %d datagrams\n", SEQWINDOW_MAX);
+		    exit(1);
+		}
+	    }
+	}
+	if (lossstats) {
+	    lossstats = 0;
+	    setLossStats(mExtSettings);
+	    mExtSettings->mOutageFactor = LOSSSTATS_DEFOUTAGE;
+	    if (optarg && ((mExtSettings->mOutageFactor = atoi(optarg)) < 2)) {
+		fprintf(stderr, "ERROR: --loss-stats outage threshold must be at least 2 expected IPGs\n");
+		exit(1);
+	    }
+	}
+	if (jitterbuffer) {
+	    // comma separated playout depths in milliseconds
+	    char depths[256];
+	    char *saveptr = NULL;
+	    jitterbuffer = 0;
+	    setJitterBuffer(mExtSettings);
+	    mExtSettings->mJitterBufSize = 0;
+	    strncpy(depths, (optarg ? optarg : JITTERBUF_DEFDEPTHS), sizeof(depths) - 1);
+	    depths[sizeof(depths) - 1] = '\0';
+	    for (char *tok = strtok_r(depths, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+		double depth = atof(tok);
+		if (mExtSettings->mJitterBufSize == JITTERBUF_MAXDEPTHS) {
+		    fprintf(stderr, "ERROR: --jitter-buffer takes at most %d depths\n", JITTERBUF_MAXDEPTHS);
+		    exit(1);
+		}
+		if (depth <= 0) {
+		    fprintf(stderr, "ERROR: --jitter-buffer depth %s must be a positive number of milliseconds\n", tok);
+		    exit(1);
+		}
+		mExtSettings->mJitterBufDepth[mExtSettings->mJitterBufSize++] = (int64_t) (depth * 1e6);
+	    }
+	    if (mExtSettings->mJitterBufSize == 0) {
+		fprintf(stderr, "ERROR: --jitter-buffer needs at least one depth\n");
+		exit(1);
+	    }
+	}
+	if (dscpstats) {
+	    dscpstats = 0;
+	    setDSCPStats(mExtSettings);
+	}
+	if (rateschedule) {
+	    rateschedule = 0;
+	    DELETE_ARRAY(mExtSettings->mRateScheduleStr);
+	    mExtSettings->mRateScheduleStr = new char[strlen(optarg) + 1];
+	    strcpy(mExtSettings->mRateScheduleStr, optarg);
+	}
+	if (profile) {
+	    profile = 0;
+	    DELETE_ARRAY(mExtSettings->mProfileStr);
+	    mExtSettings->mProfileStr = new char[strlen(optarg) + 1];
+	    strcpy(mExtSettings->mProfileStr, optarg);
+	}
+	if (udpflows) {
+	    udpflows = 0;
+	    mExtSettings->mUDPFlows = atoi(optarg);
+	    if ((mExtSettings->mUDPFlows < 1) || (mExtSettings->mUDPFlows > UDPFLOWS_MAX)) {
+		fprintf(stderr, "ERROR: --udp-flows %s must be between 1 and %d\n", optarg, UDPFLOWS_MAX);
+		exit(1);
+	    }
+	    setUDPFlows(mExtSettings);
+	}
+	if (pcapreplay) {
+	    pcapreplay = 0;
+	    DELETE_ARRAY(mExtSettings->mPcapReplayStr);
+	    mExtSettings->mPcapReplayStr = new char[strlen(optarg) + 1];
+	    strcpy(mExtSettings->mPcapReplayStr, optarg);
+	}
 	break;
     default: // ignore unknown
 	break;
@@ -1762,6 +2017,31 @@ void Settings_ModalOptions (struct thread_Settings *mExtSettings) {
 	    fprintf(stderr, "WARN: option of --jitter-histogram not supported on the client\n");
 	    unsetJitterHistogram(mExtSettings);
 	}
+	if (isLinkEmul(mExtSettings)) {
+	    fprintf(stderr, "WARN: option of --link-emul not supported on the client\n");
+	    unsetLinkEmul(mExtSettings);
+	}
+	if (isCapDetect(mExtSettings)) {
+	    fprintf(stderr, "WARN: option of --capacity-detect not supported on the client\n");
+	    unsetCapDetect(mExtSettings);
+	}
+	if (isReorderWindow(mExtSettings)) {
+	    fprintf(stderr, "WARN: option of --reorder-window not supported on the client\n");
+	    unsetReorderWindow(mExtSettings);
+	}
+	if (isLossStats(mExtSettings)) {
+	    fprintf(stderr, "WARN: option of --loss-stats not supported on the client\n");
+	    unsetLossStats(mExtSettings);
+	}
+	if (isJitterBuffer(mExtSettings) && !isReverse(mExtSettings) && !isFullDuplex(mExtSettings)) {
+	    // the reverse receiver plays out the same as a server
+	    fprintf(stderr, "WARN: option of --jitter-buffer only supported on the client with --reverse or --full-duplex\n");
+	    unsetJitterBuffer(mExtSettings);
+	}
+	if (isDSCPStats(mExtSettings)) {
+	    fprintf(stderr, "WARN: option of --dscp-stats not supported on the client\n");
+	    unsetDSCPStats(mExtSettings);
+	}
 	if (isPeriodicBurst(mExtSettings)) {
 	    setEnhanced(mExtSettings);
 	    setFrameInterval(mExtSettings);
@@ -1907,6 +2187,60 @@ void Settings_ModalOptions (struct thread_Settings *mExtSettings) {
 	    fprintf(stderr, "WARN: companion option of --connect-retry-time not set - setting to default value of ten seconds\n");
 	    mExtSettings->connect_retry_time = 10;
 	}
+	if (mExtSettings->mRateScheduleStr) {
+	    if (isVaryLoad(mExtSettings) || isIsochronous(mExtSettings) || isBurstSize(mExtSettings) || isPeriodicBurst(mExtSettings) \
+		|| isIPG(mExtSettings) || isUDPL4S(mExtSettings) || isReverse(mExtSettings) || isBounceBack(mExtSettings) || isNearCongest(mExtSettings)) {
+		fprintf(stderr, "ERROR: option --rate-schedule not supported with a -b variance, --isochronous, --burst-size, --burst-period, --ipg, --udp-l4s, --reverse, --bounceback or --near-congestion\n");
+		bail = true;
+	    } else if (isBWSet(mExtSettings) && (mExtSettings->mAppRateUnits == kRate_PPS)) {
+		fprintf(stderr, "ERROR: option --rate-schedule requires -b in bits per second\n");
+		bail = true;
+	    } else {
+		struct RateSchedule *rs = rate_schedule_load(mExtSettings->mRateScheduleStr, static_cast<double>(mExtSettings->mAppRate));
+		mExtSettings->mRateSchedule = rs;
+		if (rs == NULL) {
+		    bail = true;
+		} else {
+		    // interval reports line up with the schedule when its changes fall on interval boundaries
+		    if ((mExtSettings->mInterval > 0) && (mExtSettings->mIntervalMode == kInterval_Time)) {
+			int64_t interval = static_cast<int64_t>(mExtSettings->mInterval) * 1000;
+			for (int ix = 0; ix < rs->count; ix++) {
+			    if (((rs->segments[ix].start % interval) != 0) || ((rs->period % interval) != 0)) {
+				fprintf(stderr, "WARN: --rate-schedule change at %.3f sec isn't on a -i boundary, interval reports will mix rates\n", \
+					(((rs->segments[ix].start % interval) != 0) ? rs->segments[ix].start : rs->period) / 1e9);
+				break;
+			    }
+			}
+		    }
+		}
+	    }
+	}
+	if (isUDPFlows(mExtSettings) && isUDP(mExtSettings)) {
+	    if (isVaryLoad(mExtSettings) || isIsochronous(mExtSettings) || isBurstSize(mExtSettings) || isPeriodicBurst(mExtSettings) \
+		|| isIPG(mExtSettings) || isUDPL4S(mExtSettings) || isReverse(mExtSettings) || isFullDuplex(mExtSettings) \
+		|| isBounceBack(mExtSettings) || mExtSettings->mRateScheduleStr || isSmallTripTime(mExtSettings) \
+		|| (mExtSettings->mMode != kTest_Normal)) {
+		fprintf(stderr, "ERROR: option --udp-flows not supported with a -b variance, --isochronous, --burst-size, --burst-period, --ipg, --udp-l4s, --reverse, --full-duplex, --bounceback, --rate-schedule, -d or -r\n");
+		bail = true;
+	    } else if (mExtSettings->mBufLen < MINUDPFLOWSPAYLOAD) {
+		fprintf(stderr, "ERROR: option --udp-flows needs -l of at least %d bytes to carry the flow id\n", MINUDPFLOWSPAYLOAD);
+		bail = true;
+	    }
+	}
+	if (mExtSettings->mPcapReplayStr && isUDP(mExtSettings)) {
+	    if (isVaryLoad(mExtSettings) || isIsochronous(mExtSettings) || isBurstSize(mExtSettings) || isPeriodicBurst(mExtSettings) \
+		|| isIPG(mExtSettings) || isUDPL4S(mExtSettings) || isReverse(mExtSettings) || isFullDuplex(mExtSettings) \
+		|| isBounceBack(mExtSettings) || mExtSettings->mRateScheduleStr || isUDPFlows(mExtSettings) || isBWSet(mExtSettings) \
+		|| mExtSettings->mBraKetGraph || isFileInput(mExtSettings) || (mExtSettings->mMode != kTest_Normal)) {
+		fprintf(stderr, "ERROR: option --pcap-replay not supported with -b, --isochronous, --burst-size, --burst-period, --ipg, --udp-l4s, --reverse, --full-duplex, --bounceback, --rate-schedule, --udp-flows, a markov -l, -F, -d or -r\n");
+		bail = true;
+	    } else if ((mExtSettings->mPcapReplay = pcap_replay_load(mExtSettings->mPcapReplayStr)) == NULL) {
+		bail = true;
+	    } else {
+		// the capture sets the lengths, -l is sized to its largest datagram
+		mExtSettings->mBufLen = mExtSettings->mPcapReplay->maxlen;
+	    }
+	}
 	if (isUDP(mExtSettings)) {
 	    if (isPeerVerDetect(mExtSettings)) {
 		fprintf(stderr, "ERROR: option of -X or --peer-detect not supported with -u UDP\n");
@@ -1948,6 +2282,18 @@ void Settings_ModalOptions (struct thread_Settings *mExtSettings) {
 		fprintf(stderr, "WARN: setting of option --tcp-tx-delay is not supported with -u UDP\n");
 		unsetTcpTxDelay(mExtSettings);
 	    }
+	    if (isClockOffset(mExtSettings)) {
+		if (!isTripTime(mExtSettings)) {
+		    fprintf(stderr, "ERROR: option --clock-offset requires --trip-times\n");
+		    bail = true;
+		} else if (isReverse(mExtSettings) || isFullDuplex(mExtSettings) || isUDPL4S(mExtSettings) || isMulticast(mExtSettings)) {
+		    fprintf(stderr, "ERROR: option --clock-offset not supported with --reverse, --full-duplex, --udp-l4s or multicast\n");
+		    bail = true;
+		} else if (mExtSettings->mBufLen < MINCLKOFFSETPAYLOAD) {
+		    fprintf(stderr, "ERROR: option --clock-offset requires -l of at least %d bytes\n", MINCLKOFFSETPAYLOAD);
+		    bail = true;
+		}
+	    }
 	    {
 		double delay_target;
 		if (isIPG(mExtSettings)) {
@@ -2073,6 +2419,23 @@ void Settings_ModalOptions (struct thread_Settings *mExtSettings) {
 	if (isVaryLoad(mExtSettings)) {
 	    fprintf(stderr, "WARN: option of variance per -b is not supported on the server\n");
 	}
+	if (mExtSettings->mRateScheduleStr) {
+	    fprintf(stderr, "WARN: option of --rate-schedule is not supported on the server\n");
+	    DELETE_ARRAY(mExtSettings->mRateScheduleStr);
+	}
+	if (isUDPFlows(mExtSettings)) {
+	    // the server learns of the flows from the datagrams
+	    fprintf(stderr, "WARN: option of --udp-flows is not supported on the server\n");
+	    unsetUDPFlows(mExtSettings);
+	}
+	if (mExtSettings->mPcapReplayStr) {
+	    fprintf(stderr, "WARN: option of --pcap-replay is not supported on the server\n");
+	    DELETE_ARRAY(mExtSettings->mPcapReplayStr);
+	}
+	if (mExtSettings->mProfileStr) {
+	    fprintf(stderr, "WARN: option of --profile is not supported on the server\n");
+	    DELETE_ARRAY(mExtSettings->mProfileStr);
+	}
 	if (isTxStartTime(mExtSettings)) {
 	    fprintf(stderr, "WARN: option of --txstart-time is not supported on the server\n");
 	}
@@ -2142,6 +2505,52 @@ void Settings_ModalOptions (struct thread_Settings *mExtSettings) {
 	fprintf(stderr, "ERROR: option of --omit not supported with -u UDP\n");
 	bail = true;
     }
+    if (!isUDP(mExtSettings) && isClockOffset(mExtSettings)) {
+	fprintf(stderr, "WARN: option of --clock-offset only supported with -u UDP\n");
+	unsetClockOffset(mExtSettings);
+    }
+    if (!isUDP(mExtSettings) && isSoTimestamping(mExtSettings)) {
+	fprintf(stderr, "WARN: option of --so-timestamping only supported with -u UDP\n");
+	unsetSoTimestamping(mExtSettings);
+    }
+    if (!isUDP(mExtSettings) && isLinkEmul(mExtSettings)) {
+	fprintf(stderr, "WARN: option of --link-emul only supported with -u UDP\n");
+	unsetLinkEmul(mExtSettings);
+    }
+    if (!isUDP(mExtSettings) && isCapDetect(mExtSettings)) {
+	fprintf(stderr, "WARN: option of --capacity-detect only supported with -u UDP\n");
+	unsetCapDetect(mExtSettings);
+    }
+    if (!isUDP(mExtSettings) && isReorderWindow(mExtSettings)) {
+	fprintf(stderr, "WARN: option of --reorder-window only supported with -u UDP\n");
+	unsetReorderWindow(mExtSettings);
+    }
+    if (!isUDP(mExtSettings) && isLossStats(mExtSettings)) {
+	fprintf(stderr, "WARN: option of --loss-stats only supported with -u UDP\n");
+	unsetLossStats(mExtSettings);
+    }
+    if (!isUDP(mExtSettings) && isJitterBuffer(mExtSettings)) {
+	fprintf(stderr, "WARN: option of --jitter-buffer only supported with -u UDP\n");
+	unsetJitterBuffer(mExtSettings);
+    }
+    if (!isUDP(mExtSettings) && isUDPFlows(mExtSettings)) {
+	fprintf(stderr, "WARN: option of --udp-flows only supported with -u UDP\n");
+	unsetUDPFlows(mExtSettings);
+    }
+    if (!isUDP(mExtSettings) && mExtSettings->mPcapReplayStr) {
+	fprintf(stderr, "WARN: option of --pcap-replay only supported with -u UDP\n");
+	DELETE_ARRAY(mExtSettings->mPcapReplayStr);
+    }
+    if (!isUDP(mExtSettings) && isDSCPStats(mExtSettings)) {
+	fprintf(stderr, "WARN: option of --dscp-stats only supported with -u UDP\n");
+	unsetDSCPStats(mExtSettings);
+    }
+#if !HAVE_DECL_IP_RECVTOS
+    if (isDSCPStats(mExtSettings)) {
+	fprintf(stderr, "WARN: option of --dscp-stats needs IP_RECVTOS, not supported on this platform\n");
+	unsetDSCPStats(mExtSettings);
+    }
+#endif
     if (!isUDP(mExtSettings) && mExtSettings->mBraKetGraph) {
 	fprintf(stderr, "ERROR: length markov chains only supported with -u UDP\n");
 	bail = true;
@@ -2734,6 +3143,9 @@ int Settings_GenerateClientHdr (struct thread_Settings *client, void *testhdr, s
 	memset(hdr, 0, buflen);
 	flags |= HEADER_SEQNO64B; // use 64 bit by default
 	flags |= HEADER_EXTEND;
+	if (!isCompat(client) && (client->mBufLen >= MINNSECTSPAYLOAD)) {
+	    flags |= HEADER_NSECTS; // nanosecond send timestamp follows the test header
+	}
 	hdr->extend.version_u = htonl(IPERF_VERSION_MAJORHEX);
 	hdr->extend.version_l = htonl(IPERF_VERSION_MINORHEX);
 	hdr->extend.tos = htons(client->mTOS & 0xFF);
@@ -2798,6 +3210,10 @@ int Settings_GenerateClientHdr (struct thread_Settings *client, void *testhdr, s
 	    flags |= (HEADER_UDPTESTS | HEADER_EXTEND);
 	    upperflags |= HEADER_NOUDPFIN;
 	}
+	if (isUDPFlows(client) && (client->mBufLen >= MINUDPFLOWSPAYLOAD)) {
+	    flags |= (HEADER_UDPTESTS | HEADER_EXTEND);
+	    lowerflags |= HEADER_UDPFLOWS;
+	}
 	if (isTripTime(client) || isFQPacing(client) || isTxStartTime(client)) {
 	    flags |= HEADER_UDPTESTS;
 	    if (isTripTime(client) || isTxStartTime(client)) {
@@ -2805,6 +3221,8 @@ int Settings_GenerateClientHdr (struct thread_Settings *client, void *testhdr, s
 		hdr->start_fq.start_tv_usec = htonl(startTime.tv_usec);
 		if (isTripTime(client))
 		    upperflags |= HEADER_TRIPTIME;
+		if (isClockOffset(client))
+		    upperflags |= HEADER_CLKOFFSET;
 	    }
 	    if (isFQPacing(client)) {
 		upperflags |= HEADER_FQRATESET;
@@ -0,0 +1,170 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * capacity_detect.c
+ * Dispersion windows and a CUSUM change test for --capacity-detect
+ * ------------------------------------------------------------------- */
+#include <math.h>
+#include "headers.h"
+#include "capacity_detect.h"
+
+struct CapacityDetect *capdetect_alloc (int64_t window) {
+    struct CapacityDetect *cd = (struct CapacityDetect *) calloc(1, sizeof(struct CapacityDetect));
+    if (cd) {
+	cd->window = (window > 0) ? window : CAPDETECT_DEFWINDOW;
+	cd->floor = INT64_MAX;
+    }
+    return cd;
+}
+
+void capdetect_free (struct CapacityDetect *cd) {
+    free(cd);
+}
+
+// One side of the CUSUM, a run starts when the sum leaves zero and
+// remembers its windows' rates, less the first which likely straddles
+// the change, to give the new level
+static inline void capdetect_run (struct CapacityRun *run, double z, int64_t wstart, double rate) {
+    if (run->cusum <= 0) {
+	run->start = wstart;
+	run->sum = 0;
+	run->windows = 0;
+    }
+    run->cusum += z - CAPDETECT_SLACK;
+    if (run->cusum <= 0) {
+	run->cusum = 0;
+    } else if (run->windows++ > 0) {
+	run->sum += rate;
+    }
+}
+
+static bool capdetect_window (struct CapacityDetect *cd, int64_t arrival, int64_t transit) {
+    double n = cd->wpkts;
+    double denom = (n * cd->sxx) - (cd->sx * cd->sx);
+    int64_t wstart = cd->wstart;
+    struct CapacityRun *run = NULL;
+    bool fired = false;
+
+    cd->rate = (cd->wbytes * 8.0) / ((arrival - wstart) / 1e9);
+    cd->trend = (denom > 0) ? (((n * cd->sxy) - (cd->sx * cd->sy)) / denom) : 0.0;
+    cd->windows++;
+    // the next window's dispersion starts at this packet
+    cd->wstart = arrival;
+    cd->wtransit = transit;
+    cd->wbytes = 0;
+    cd->wpkts = 0;
+    cd->sx = cd->sy = cd->sxx = cd->sxy = 0;
+
+    if (cd->learned < CAPDETECT_LEARN) {
+	// Welford's running mean and sum of squares for the first level
+	double delta = cd->rate - cd->level;
+	cd->learned++;
+	cd->level += delta / cd->learned;
+	cd->variance += delta * (cd->rate - cd->level);
+	if (cd->learned == CAPDETECT_LEARN) {
+	    cd->variance /= ((CAPDETECT_LEARN - 1) * cd->level * cd->level);
+	    cd->spread = fmax(CAPDETECT_MINSPREAD, sqrt(cd->variance));
+	}
+	return false;
+    }
+    double rel = (cd->rate - cd->level) / cd->level;
+    capdetect_run(&cd->up, (rel / cd->spread), wstart, cd->rate);
+    capdetect_run(&cd->down, -(rel / cd->spread), wstart, cd->rate);
+    if ((cd->up.cusum > CAPDETECT_DECIDE) && (cd->up.windows > 1)) {
+	run = &cd->up;
+    } else if ((cd->down.cusum > CAPDETECT_DECIDE) && (cd->down.windows > 1)) {
+	run = &cd->down;
+    }
+    if (run) {
+	double to = run->sum / (run->windows - 1);
+	if (fabs(to - cd->level) >= (CAPDETECT_MINCHANGE * cd->level)) {
+	    // A sender changing its rate under the capacity leaves no
+	    // queue. With a queue, a drop is the bottleneck slowing, and
+	    // a rise is it speeding up unless the queue is building, which
+	    // is the sender's rate reaching the bottleneck
+	    cd->event.at = run->start;
+	    cd->event.detected = arrival;
+	    cd->event.from = cd->level;
+	    cd->event.to = to;
+	    cd->event.queue = cd->queue;
+	    cd->event.trend = cd->trend;
+	    cd->event.capacity = (cd->queue > CAPDETECT_QUEUE) && ((to < cd->level) || (cd->trend < CAPDETECT_BUILDING));
+	    cd->changes++;
+	    if (cd->event.capacity)
+		cd->capacity_changes++;
+	    fired = true;
+	}
+	cd->level = to;
+	cd->up.cusum = 0;
+	cd->down.cusum = 0;
+    } else if ((cd->up.cusum < 1.0) && (cd->down.cusum < 1.0)) {
+	// quiet, so let the level and spread follow slow drift
+	cd->level += (cd->rate - cd->level) / 16;
+	cd->variance += ((rel * rel) - cd->variance) / 16;
+	cd->spread = fmax(CAPDETECT_MINSPREAD, sqrt(cd->variance));
+    }
+    return fired;
+}
+
+// Per packet in arrival order, true when the closing window decided on
+// a change, which is then in cd->event
+bool capdetect_packet (struct CapacityDetect *cd, int64_t arrival, int64_t transit, intmax_t bytes) {
+    if (transit < cd->floor)
+	cd->floor = transit;
+    cd->queue = transit - cd->floor;
+    if (cd->wstart == 0) {
+	// the first packet only marks where the first window's dispersion starts
+	cd->wstart = arrival;
+	cd->wtransit = transit;
+	return false;
+    }
+    double x = (arrival - cd->wstart) / 1e9;
+    double y = (transit - cd->wtransit) / 1e9;
+    cd->wbytes += bytes;
+    cd->wpkts++;
+    cd->sx += x;
+    cd->sy += y;
+    cd->sxx += x * x;
+    cd->sxy += x * y;
+    if (((arrival - cd->wstart) < cd->window) || (cd->wpkts < CAPDETECT_MINPKTS))
+	return false;
+    return capdetect_window(cd, arrival, transit);
+}
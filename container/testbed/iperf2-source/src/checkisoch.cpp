@@ -103,7 +103,7 @@ int main (int argc, char **argv) {
 	if (forceslip && count == 8) {
 	    delay_loop (1000000/frequency + 10);
 	}
-	fc->wait_tick();
+	fc->wait_tick(NULL, false);
 	posttimestamp(count, (round(lognormal(mean,variance)) / (frequency * 8)));
 	if (fc->slip) {
 	    fprintf(stdout,"Slip occurred\n");
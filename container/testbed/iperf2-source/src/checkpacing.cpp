@@ -0,0 +1,383 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * checkpacing.cpp
+ * Pacing and timer accuracy benchmark, a superset of checkdelay and
+ * checkisoch. Each pacing primitive is run at periods from 10 usecs
+ * to 100 ms and the wake error, i.e. actual minus requested, goes
+ * into a histogram.  Output is the error distribution, the fraction
+ * of early wakes, the cpu cost and a per period recommendation of
+ * which primitive to use for that packet or frame rate on this host.
+ * ------------------------------------------------------------------- */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include "headers.h"
+#include "isochronous.hpp"
+#include "delay.h"
+#include "histogram.h"
+#include "util.h"
+#include <sys/resource.h>
+#if HAVE_SCHED_SETSCHEDULER
+#include <sched.h>
+#ifdef HAVE_MLOCKALL
+#include <sys/mman.h>
+#endif
+#endif
+
+#define PACING_BINS 101000     // 1 usec bins from -1 ms to +100 ms
+#define PACING_OFFSET -1e-3    // histogram offset, units seconds
+#define PACING_CPUMAX 25.0     // cpu percent considered modest enough to recommend
+
+enum pacing_primitive {
+    DELAY_LOOP = 0,
+    DELAY_BUSYLOOP,
+    DELAY_KALMAN,
+    CLOCK_USLEEP,
+    CLOCK_USLEEP_ABSTIME,
+    DELAY_PACER,
+    WAIT_TICK,
+    PACING_PRIMITIVES
+};
+
+static const char *pacing_names[PACING_PRIMITIVES] = {
+    "delay_loop",
+    "delay_busyloop",
+    "delay_kalman",
+    "clock_usleep",
+    "clock_usleep_abstime",
+    "delay_pacer",
+    "wait_tick"
+};
+
+static const long default_periods[] = {10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000};
+
+struct pacing_result {
+    int samples;
+    double mean;
+    double min;
+    double max;
+    double p1;
+    double p50;
+    double p99;
+    double early;  // percent of wakes before the deadline
+    double cpu;    // percent of one core
+    bool valid;
+};
+
+static double pacing_now (clockid_t clk) {
+    struct timespec t1;
+    clock_gettime(clk, &t1);
+    return (t1.tv_sec + (t1.tv_nsec / 1e9));
+}
+
+// calibrated per primitive run, see pacing_run()
+static struct delay_pacer pacing_pacer;
+
+static double pacing_cputime (void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + (ru.ru_utime.tv_usec / 1e6) + ru.ru_stime.tv_sec + (ru.ru_stime.tv_usec / 1e6));
+}
+
+// Returns the wake error in seconds, positive is late
+static double pacing_sample (int primitive, long period, Isochronous::FrameCounter *fc, double *deadline) {
+    double start, err = 0;
+    struct timeval tv;
+    switch (primitive) {
+    case DELAY_LOOP:
+	start = pacing_now(CLOCK_MONOTONIC);
+	delay_loop(period);
+	err = pacing_now(CLOCK_MONOTONIC) - start - (period / 1e6);
+	break;
+    case DELAY_BUSYLOOP:
+	start = pacing_now(CLOCK_MONOTONIC);
+	delay_busyloop(period);
+	err = pacing_now(CLOCK_MONOTONIC) - start - (period / 1e6);
+	break;
+#ifdef HAVE_KALMAN
+    case DELAY_KALMAN:
+	start = pacing_now(CLOCK_MONOTONIC);
+	delay_kalman(period);
+	err = pacing_now(CLOCK_MONOTONIC) - start - (period / 1e6);
+	break;
+#endif
+    case CLOCK_USLEEP:
+	tv.tv_sec = period / 1000000;
+	tv.tv_usec = period % 1000000;
+	start = pacing_now(CLOCK_MONOTONIC);
+	clock_usleep(&tv);
+	err = pacing_now(CLOCK_MONOTONIC) - start - (period / 1e6);
+	break;
+    case CLOCK_USLEEP_ABSTIME:
+	// absolute deadlines don't accumulate the previous wake's error
+	*deadline += (period / 1e6);
+	tv.tv_sec = (long) *deadline;
+	tv.tv_usec = (long) ((*deadline - tv.tv_sec) * 1e6);
+	clock_usleep_abstime(&tv);
+	err = pacing_now(CLOCK_REALTIME) - *deadline;
+	break;
+    case DELAY_PACER:
+	start = pacing_now(CLOCK_MONOTONIC);
+	delay_pacer(&pacing_pacer, period * 1e3);
+	err = pacing_now(CLOCK_MONOTONIC) - start - (period / 1e6);
+	break;
+    case WAIT_TICK:
+    {
+	// slot n's deadline is the first tick plus n - 1 periods
+	unsigned int slot = fc->wait_tick(NULL, true);
+	double now = pacing_now(CLOCK_REALTIME);
+	if (slot > 1) {
+	    err = now - (fc->getSecs() + (fc->getUsecs() / 1e6) + ((slot - 1) * (period / 1e6)));
+	}
+	break;
+    }
+    default:
+	break;
+    }
+    return err;
+}
+
+static void pacing_run (int primitive, long period, double budget, int maxcount, struct histogram *h, struct pacing_result *result) {
+    int count = (int) ((budget * 1e6) / period);
+    if (count > maxcount)
+	count = maxcount;
+    if (count < 10)
+	count = 10;
+    memset(result, 0, sizeof(struct pacing_result));
+    histogram_clear(h);
+    Isochronous::FrameCounter *fc = NULL;
+    double deadline = pacing_now(CLOCK_REALTIME);
+    delay_pacer_init(&pacing_pacer);
+    if (primitive == WAIT_TICK) {
+	fc = new Isochronous::FrameCounter(1e6 / period);
+	fc->wait_tick(NULL, true); // the first tick only sets the start time
+    }
+    // one untimed sample to fault in pages and warm up any filter state
+    pacing_sample(primitive, period, fc, &deadline);
+    double sum = 0;
+    int early = 0;
+    result->min = 1e9;
+    result->max = -1e9;
+    double wallstart = pacing_now(CLOCK_MONOTONIC);
+    double cpustart = pacing_cputime();
+    for (int ix = 0; ix < count; ix++) {
+	double err = pacing_sample(primitive, period, fc, &deadline);
+	histogram_insert(h, (float) err, NULL);
+	sum += err;
+	if (err < 0)
+	    early++;
+	if (err < result->min)
+	    result->min = err;
+	if (err > result->max)
+	    result->max = err;
+    }
+    double wall = pacing_now(CLOCK_MONOTONIC) - wallstart;
+    result->cpu = ((wall > 0) ? (100.0 * (pacing_cputime() - cpustart) / wall) : 0);
+    result->samples = count;
+    result->mean = sum / count;
+    result->p1 = histogram_percentile(h, 1.0);
+    result->p50 = histogram_percentile(h, 50.0);
+    result->p99 = histogram_percentile(h, 99.0);
+    result->early = 100.0 * early / count;
+    result->valid = true;
+    DELETE_PTR(fc);
+}
+
+#if HAVE_SCHED_SETSCHEDULER
+static bool pacing_realtime (bool enable) {
+    struct sched_param sp;
+    memset(&sp, 0, sizeof(sp));
+    if (enable)
+	sp.sched_priority = sched_get_priority_max(SCHED_RR);
+    if (sched_setscheduler(0, (enable ? SCHED_RR : SCHED_OTHER), &sp) < 0) {
+	WARN_errno(1, "sched_setscheduler");
+	return false;
+    }
+#ifdef HAVE_MLOCKALL
+    if (enable)
+	WARN_errno(mlockall(MCL_CURRENT | MCL_FUTURE) != 0, "mlockall");
+#endif
+    return true;
+}
+#endif
+
+static void usage (void) {
+    fprintf(stderr, "Usage: checkpacing [-c count] [-t secs] [-p usecs[,usecs...]] [-m name] [-r]\n" \
+	    "  -c  max samples per primitive and period (default 2000)\n" \
+	    "  -t  time budget per primitive and period (default 0.5 secs)\n" \
+	    "  -p  periods in usecs (default 10 to 100000)\n" \
+	    "  -m  only run primitives whose name contains this string\n"
+#if HAVE_SCHED_SETSCHEDULER
+	    "  -r  also run every test with the realtime scheduler (SCHED_RR)\n"
+#endif
+	);
+}
+
+int main (int argc, char **argv) {
+    int c, maxcount = 2000, realtime = 0;
+    double budget = 0.5;
+    long periods[64];
+    int periodcnt = 0;
+    char *match = NULL;
+
+    while ((c = getopt(argc, argv, "c:m:p:rt:")) != -1) {
+	switch (c) {
+	case 'c':
+	    maxcount = atoi(optarg);
+	    break;
+	case 'm':
+	    match = optarg;
+	    break;
+	case 'p':
+	{
+	    char *tok = strtok(optarg, ",");
+	    while (tok && (periodcnt < 64)) {
+		long value = atol(tok);
+		if ((value < 1) || (value > 1000000)) {
+		    fprintf(stderr, "ERROR: period %s must be 1 to 1000000 usecs\n", tok);
+		    return 1;
+		}
+		periods[periodcnt++] = value;
+		tok = strtok(NULL, ",");
+	    }
+	    break;
+	}
+#if HAVE_SCHED_SETSCHEDULER
+	case 'r':
+	    realtime = 1;
+	    break;
+#endif
+	case 't':
+	    budget = atof(optarg);
+	    break;
+	default:
+	    usage();
+	    return 1;
+	}
+    }
+    if ((maxcount < 1) || (budget <= 0)) {
+	usage();
+	return 1;
+    }
+    if (!periodcnt) {
+	for (periodcnt = 0; periodcnt < (int) (sizeof(default_periods) / sizeof(long)); periodcnt++)
+	    periods[periodcnt] = default_periods[periodcnt];
+    }
+    char name[] = "E";
+    struct histogram *h = histogram_init(PACING_BINS, 1, PACING_OFFSET, 1e6, 5, 95, 0, name, false);
+    if (!h)
+	return 1;
+    struct pacing_result results[PACING_PRIMITIVES];
+
+    for (int pass = 0; pass <= realtime; pass++) {
+#if HAVE_SCHED_SETSCHEDULER
+	if (pass && !pacing_realtime(true)) {
+	    fprintf(stdout, "Realtime scheduler not available, skipping realtime pass\n");
+	    break;
+	}
+#endif
+	fprintf(stdout, "Pacing accuracy (%s scheduler), error = actual - requested in usecs, 1 usec bins, positive is late\n", \
+		(pass ? "realtime SCHED_RR" : "default"));
+	for (int px = 0; px < periodcnt; px++) {
+	    long period = periods[px];
+	    fprintf(stdout, "%-20s %8s %7s %9s %9s %9s %9s %9s %9s %7s %7s\n", "primitive", "period", "samples", \
+		    "mean", "min", "p1", "p50", "p99", "max", "early%", "cpu%");
+	    for (int ix = 0; ix < PACING_PRIMITIVES; ix++) {
+		results[ix].valid = false;
+#ifndef HAVE_KALMAN
+		if (ix == DELAY_KALMAN)
+		    continue;
+#endif
+		if (match && !strstr(pacing_names[ix], match))
+		    continue;
+		pacing_run(ix, period, budget, maxcount, h, &results[ix]);
+		struct pacing_result *r = &results[ix];
+		fprintf(stdout, "%-20s %8ld %7d %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %7.1f %7.1f\n", pacing_names[ix], period, r->samples, \
+			r->mean * 1e6, r->min * 1e6, r->p1 * 1e6, r->p50 * 1e6, r->p99 * 1e6, r->max * 1e6, r->early, r->cpu);
+		fflush(stdout);
+	    }
+	    // score is the worse of the 1st and 99th percentile errors, a primitive
+	    // whose error exceeds the period can't hold the rate at all
+	    int best = -1, bestmodest = -1;
+	    double bestscore = 0, bestmodestscore = 0;
+	    for (int ix = 0; ix < PACING_PRIMITIVES; ix++) {
+		if (!results[ix].valid)
+		    continue;
+		double score = fmax(fabs(results[ix].p1), fabs(results[ix].p99));
+		if ((best < 0) || (score < bestscore)) {
+		    best = ix;
+		    bestscore = score;
+		}
+		if ((results[ix].cpu < PACING_CPUMAX) && (score < (period / 1e6)) && \
+		    ((bestmodest < 0) || (score < bestmodestscore))) {
+		    bestmodest = ix;
+		    bestmodestscore = score;
+		}
+	    }
+	    if (best >= 0) {
+		fprintf(stdout, "Period %ld usecs (%.0f pps or fps): ", period, 1e6 / period);
+		if (bestmodest >= 0) {
+		    fprintf(stdout, "use %s (error within %.1f usecs, cpu %.1f%%)", pacing_names[bestmodest], \
+			    bestmodestscore * 1e6, results[bestmodest].cpu);
+		    if (best != bestmodest)
+			fprintf(stdout, ", %s is within %.1f usecs at %.1f%% cpu", pacing_names[best], \
+				bestscore * 1e6, results[best].cpu);
+		} else {
+		    fprintf(stdout, "no low cpu primitive holds this rate, %s is within %.1f usecs at %.1f%% cpu", pacing_names[best], \
+			    bestscore * 1e6, results[best].cpu);
+		}
+		fprintf(stdout, "\n\n");
+	    }
+	}
+    }
+#if HAVE_SCHED_SETSCHEDULER
+    if (realtime)
+	pacing_realtime(false);
+#endif
+    histogram_delete(h);
+    return 0;
+}
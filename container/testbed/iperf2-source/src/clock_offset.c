@@ -0,0 +1,132 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * clock_offset.c
+ * NTP style clock filter and least squares drift estimate
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "clock_offset.h"
+
+struct ClockOffset *clock_offset_alloc (void) {
+    struct ClockOffset *co = (struct ClockOffset *) calloc(1, sizeof(struct ClockOffset));
+    if (co == NULL) {
+	fprintf(stderr, "ERROR: clock offset out of memory\n");
+	exit(1);
+    }
+    return co;
+}
+
+// Least squares slope of offset over time, ns per ns
+static void clock_offset_fit (struct ClockOffset *co) {
+    struct ClockOffsetSample *first = &co->history[(co->historyix - co->nhistory + CLKOFFSET_HISTORY) % CLKOFFSET_HISTORY];
+    double sumt = 0, sumo = 0, sumtt = 0, sumto = 0;
+    int ix;
+    struct ClockOffsetSample *last = &co->history[(co->historyix + CLKOFFSET_HISTORY - 1) % CLKOFFSET_HISTORY];
+    // a short span turns microseconds of offset noise into ppms of drift
+    if ((co->nhistory < 4) || ((last->t - first->t) < CLKOFFSET_FITSPAN))
+	return;
+    for (ix = 0; ix < co->nhistory; ix++) {
+	struct ClockOffsetSample *s = &co->history[(co->historyix - co->nhistory + ix + CLKOFFSET_HISTORY) % CLKOFFSET_HISTORY];
+	// relative to the oldest sample to keep the doubles exact enough
+	double t = (double) (s->t - first->t);
+	double o = (double) (s->offset - first->offset);
+	sumt += t;
+	sumo += o;
+	sumtt += t * t;
+	sumto += t * o;
+    }
+    double denom = (co->nhistory * sumtt) - (sumt * sumt);
+    if (denom <= 0)
+	return;
+    double drift = ((co->nhistory * sumto) - (sumt * sumo)) / denom;
+    if (drift > CLKOFFSET_MAXDRIFT)
+	drift = CLKOFFSET_MAXDRIFT;
+    else if (drift < -CLKOFFSET_MAXDRIFT)
+	drift = -CLKOFFSET_MAXDRIFT;
+    co->drift = drift;
+}
+
+// t1 client send, t2 server receive, t3 server send, t4 client receive
+void clock_offset_sample (struct ClockOffset *co, int64_t t1, int64_t t2, int64_t t3, int64_t t4) {
+    struct ClockOffsetSample sample;
+    int ix;
+    sample.t = t4;
+    sample.offset = ((t2 - t1) + (t3 - t4)) / 2;
+    sample.delay = (t4 - t1) - (t3 - t2);
+    if (sample.delay < 0)
+	sample.delay = 0;
+    co->filter[co->filterix] = sample;
+    co->filterix = (co->filterix + 1) % CLKOFFSET_FILTER;
+    if (co->nfilter < CLKOFFSET_FILTER)
+	co->nfilter++;
+    // The minimum delay sample has the least queueing so the best offset
+    struct ClockOffsetSample *best = &co->filter[0];
+    for (ix = 1; ix < co->nfilter; ix++) {
+	if (co->filter[ix].delay < best->delay)
+	    best = &co->filter[ix];
+    }
+    co->reftime = best->t;
+    co->offset = best->offset;
+    co->delay = best->delay;
+    if (!co->nhistory || ((best->t - co->history[(co->historyix + CLKOFFSET_HISTORY - 1) % CLKOFFSET_HISTORY].t) >= CLKOFFSET_EPOCH)) {
+	co->history[co->historyix] = *best;
+	co->historyix = (co->historyix + 1) % CLKOFFSET_HISTORY;
+	if (co->nhistory < CLKOFFSET_HISTORY)
+	    co->nhistory++;
+	clock_offset_fit(co);
+    }
+    co->pub.samples++;
+    co->pub.offset = co->offset;
+    co->pub.bound = co->delay / 2;
+    co->pub.drift = co->drift;
+    co->pub.valid = (co->pub.samples >= CLKOFFSET_MINSAMPLES);
+}
+
+// Offset at client time t extrapolated by the drift. The bound is half
+// the selected round trip, the most the offset can be off by for any
+// path asymmetry, plus the frequency tolerance over the sample's age.
+int64_t clock_offset_at (struct ClockOffset *co, int64_t t, int64_t *bound) {
+    int64_t age = t - co->reftime;
+    if (age < 0)
+	age = -age;
+    *bound = (co->delay / 2) + (int64_t) (age * CLKOFFSET_PHI);
+    return co->offset + (int64_t) (co->drift * (double) (t - co->reftime));
+}
@@ -0,0 +1,191 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * dscp_stats.c
+ * Per DSCP class counters, latency and jitter for --dscp-stats
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "dscp.h"
+#include "dscp_stats.h"
+
+struct DSCPStats *dscpstats_alloc (int sent_tos) {
+    struct DSCPStats *ds = (struct DSCPStats *) calloc(1, sizeof(struct DSCPStats));
+    if (ds) {
+	ds->sent_tos = sent_tos;
+    }
+    return ds;
+}
+
+void dscpstats_free (struct DSCPStats *ds) {
+    free(ds);
+}
+
+static inline void dscpstats_latency (struct DSCPStatsLatency *lat, int64_t transit) {
+    if (!lat->cnt || (transit < lat->min))
+	lat->min = transit;
+    if (!lat->cnt || (transit > lat->max))
+	lat->max = transit;
+    lat->sum += transit;
+    lat->cnt++;
+}
+
+static inline void dscpstats_latency_merge (struct DSCPStatsLatency *into, struct DSCPStatsLatency *from) {
+    if (from->cnt) {
+	if (!into->cnt || (from->min < into->min))
+	    into->min = from->min;
+	if (!into->cnt || (from->max > into->max))
+	    into->max = from->max;
+	into->sum += from->sum;
+	into->cnt += from->cnt;
+    }
+}
+
+// Find the recent gap a late sequence number falls in, NULL when it's
+// a duplicate or older than the ring reaches
+static inline struct DSCPStatsGap *dscpstats_gap (struct DSCPStats *ds, intmax_t seqno) {
+    for (int ix = 0; ix < DSCPSTATS_GAPS; ix++) {
+	struct DSCPStatsGap *gap = &ds->gap[ix];
+	if (gap->missing && (seqno >= gap->start) && (seqno < gap->end))
+	    return gap;
+    }
+    return NULL;
+}
+
+static inline void dscpstats_count (struct DSCPStats *ds, int tos, intmax_t len, int64_t transit) {
+    int dscp = DSCP_VALUE(tos);
+    int ecn = ECN_VALUE(tos);
+    struct DSCPClass *cls = &ds->cls[dscp];
+    if (cls->cnt.packets) {
+	int64_t delta = transit - cls->transit;
+	cls->jitter += ((double) ((delta < 0) ? -delta : delta) - cls->jitter) / 16.0;
+    }
+    cls->transit = transit;
+    cls->cnt.packets++;
+    cls->cnt.bytes += len;
+    cls->cnt.ecn[ecn]++;
+    if (ds->sent_tos >= 0) {
+	if (dscp != DSCP_VALUE(ds->sent_tos))
+	    cls->cnt.remarked++;
+	if (ECN_VALUE(ds->sent_tos) && !ecn)
+	    cls->cnt.bleached++;
+    }
+    dscpstats_latency(&cls->ilat, transit);
+    dscpstats_latency(&cls->tlat, transit);
+    ds->active |= ((uint64_t) 1) << dscp;
+}
+
+// Per datagram, tos as received (DSCPSTATS_NOTOS when it wasn't) and
+// transit in ns
+void dscpstats_packet (struct DSCPStats *ds, int tos, intmax_t seqno, intmax_t len, int64_t transit) {
+    int dscp = DSCP_VALUE(tos);
+    if (!ds->top) {
+	// the sequence starts with the first datagram seen
+	ds->top = seqno - 1;
+    }
+    if (seqno > ds->top) {
+	if (seqno > ds->top + 1) {
+	    struct DSCPStatsGap *gap = &ds->gap[ds->gapix];
+	    gap->start = ds->top + 1;
+	    gap->end = seqno;
+	    gap->missing = seqno - ds->top - 1;
+	    gap->dscp = ((tos == DSCPSTATS_NOTOS) ? -1 : dscp);
+	    if (gap->dscp >= 0)
+		ds->cls[dscp].cnt.lost += gap->missing;
+	    if (++ds->gapix == DSCPSTATS_GAPS)
+		ds->gapix = 0;
+	}
+	ds->top = seqno;
+    } else {
+	struct DSCPStatsGap *gap = dscpstats_gap(ds, seqno);
+	if (gap) {
+	    gap->missing--;
+	    if (gap->dscp >= 0)
+		ds->cls[gap->dscp].cnt.lost--;
+	}
+    }
+    if (tos == DSCPSTATS_NOTOS) {
+	ds->held.len = len;
+	ds->held.transit = transit;
+	ds->held.valid = true;
+	return;
+    }
+    if (ds->held.valid) {
+	dscpstats_count(ds, tos, ds->held.len, ds->held.transit);
+	ds->held.valid = false;
+    }
+    dscpstats_count(ds, tos, len, transit);
+}
+
+// Add a flow's interval into a sum report's, called before the flow
+// moves on to its next interval
+void dscpstats_sum (struct DSCPStats *sum, struct DSCPStats *ds) {
+    for (int ix = 0; ix < DSCPSTATS_CLASSES; ix++) {
+	struct DSCPClass *cls = &ds->cls[ix];
+	struct DSCPClass *to = &sum->cls[ix];
+	if (!(ds->active & (((uint64_t) 1) << ix)))
+	    continue;
+	to->cnt.packets += cls->cnt.packets - cls->prev.packets;
+	to->cnt.bytes += cls->cnt.bytes - cls->prev.bytes;
+	to->cnt.lost += cls->cnt.lost - cls->prev.lost;
+	to->cnt.remarked += cls->cnt.remarked - cls->prev.remarked;
+	to->cnt.bleached += cls->cnt.bleached - cls->prev.bleached;
+	for (int jx = 0; jx < 4; jx++)
+	    to->cnt.ecn[jx] += cls->cnt.ecn[jx] - cls->prev.ecn[jx];
+	dscpstats_latency_merge(&to->ilat, &cls->ilat);
+	dscpstats_latency_merge(&to->tlat, &cls->ilat);
+	// jitter doesn't add across flows, the sum's is the worst of them
+	if (cls->jitter > to->jitter)
+	    to->jitter = cls->jitter;
+    }
+    sum->active |= ds->active;
+}
+
+void dscpstats_next_interval (struct DSCPStats *ds) {
+    for (int ix = 0; ix < DSCPSTATS_CLASSES; ix++) {
+	if (ds->active & (((uint64_t) 1) << ix)) {
+	    ds->cls[ix].prev = ds->cls[ix].cnt;
+	    memset(&ds->cls[ix].ilat, 0, sizeof(struct DSCPStatsLatency));
+	    // a sum's jitter is the interval's worst, a flow's carries on
+	    if (ds->sent_tos == DSCPSTATS_NOTOS)
+		ds->cls[ix].jitter = 0.0;
+	}
+    }
+}
@@ -125,10 +125,7 @@ void histogram_delete(struct histogram *h) {
 }
 
 // value is units seconds
-int histogram_insert(struct histogram *h, float value, struct timeval *ts) {
-    int bin;
-    // calculate the bin, convert the value units from seconds to units of interest
-    bin = (int) (h->units  * (value - h->offset) / h->binwidth);
+static inline int histogram_insert_bin(struct histogram *h, int bin, double value, struct timeval *ts) {
     h->populationcnt++;
     if (ts && (value > h->maxval)) {
         h->maxbin = bin;
@@ -147,7 +144,7 @@ int histogram_insert(struct histogram *h, float value, struct timeval *ts) {
     if (bin < 0) {
 	h->cntloweroutofbounds++;
 	return(-1);
-    } else if (bin > (int) h->bincount) {
+    } else if (bin >= (int) h->bincount) {
 	h->cntupperoutofbounds++;
 	return(-2);
     }
@@ -157,6 +154,20 @@ int histogram_insert(struct histogram *h, float value, struct timeval *ts) {
     }
 }
 
+int histogram_insert(struct histogram *h, float value, struct timeval *ts) {
+    // calculate the bin, convert the value units from seconds to units of interest
+    int bin = (int) (h->units  * (value - h->offset) / h->binwidth);
+    return histogram_insert_bin(h, bin, value, ts);
+}
+
+// Same as above but for a value in integer nanoseconds, this avoids the
+// float rounding of large transits (e.g. unsynced clocks) before binning
+int histogram_insert_ns(struct histogram *h, int64_t value, struct timeval *ts) {
+    double secs = value / 1e9;
+    int bin = (int) (((double) h->units * (secs - h->offset)) / h->binwidth);
+    return histogram_insert_bin(h, bin, secs, ts);
+}
+
 void histogram_clear(struct histogram *h) {
     memset(h->mybins, 0, (h->bincount * sizeof(unsigned int)));
     h->populationcnt = 0;
@@ -194,6 +205,21 @@ void histogram_add(struct histogram *to, struct histogram *from) {
     }
 }
 
+// Returns the value (units seconds) of the bin where the cumulative
+// population first exceeds pct percent, or zero if the histogram is empty
+double histogram_percentile(struct histogram *h, double pct) {
+    unsigned int ix, running = 0;
+    unsigned int population = h->populationcnt - h->cntloweroutofbounds - h->cntupperoutofbounds;
+    if (population == 0)
+	return 0.0;
+    for (ix = 0; ix < h->bincount; ix++) {
+	running += h->mybins[ix];
+	if ((double) running / population > pct / 100.0)
+	    break;
+    }
+    return ((double) (ix + 1) * h->binwidth / h->units) + h->offset;
+}
+
 void histogram_print(struct histogram *h, double start, double end) {
     if (h->final && h->prev) {
 	histogram_clear(h->prev);
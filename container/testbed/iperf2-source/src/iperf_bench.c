@@ -0,0 +1,538 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ *
+ * iperf_bench.c
+ * Microbenchmarks for the per packet code paths, i.e. the packet
+ * ring, histogram insert, the reporter's UDP server packet handler
+ * and running mean/min/max, the UDP checksum, the markov chain
+ * length generator and the lognormal pdf. Inputs are synthetic and
+ * generated before timing so only the function under test is measured.
+ *
+ * Build and run with "make bench" from the top or src directory.
+ * Output is ns/op and, on x86, TSC ticks/op as the median of several
+ * runs.  Use -c for csv output suitable for tracking across commits.
+ * ------------------------------------------------------------------- */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "headers.h"
+#include "Reporter.h"
+#include "histogram.h"
+#include "packet_ring.h"
+#include "markov.h"
+#include "pdfs.h"
+#include "link_emul.h"
+#include "capacity_detect.h"
+#include "seq_window.h"
+#include "loss_stats.h"
+#include "jitter_buffer.h"
+#include "dscp_stats.h"
+#ifdef HAVE_AF_PACKET
+#include "checksums.h"
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_BENCH_TSC 1
+#else
+#define HAVE_BENCH_TSC 0
+#endif
+
+// Globals normally owned by main.cpp, the bench links the rest of iperf
+int sInterupted = 0;
+int groupID = 0;
+Mutex transferid_mutex;
+struct Condition ReportCond;
+struct AwaitMutex reporter_state;
+struct AwaitMutex threads_start;
+struct BarrierMutex transmits_start;
+
+#define BENCH_SAMPLES 65536 // power of 2, synthetic inputs are indexed with a mask
+#define BENCH_MASK (BENCH_SAMPLES - 1)
+#define BENCH_RUNS 5
+#define BENCH_RINGSIZE 512
+#define BENCH_FLOWS 16 // rings of the default depth, together well past the caches
+
+struct bench_ctx {
+    struct PacketRing *ring;
+    struct PacketRing *flowrings[BENCH_FLOWS];
+    struct Condition ring_cond;
+    struct histogram *histogram;
+    struct MeanMinMaxStats mmm;
+    struct ReporterData *rdata;
+    struct ReportStruct *packets;
+    float *values;
+    struct markov_graph *markov;
+    struct LinkEmul *linkemul;
+    struct CapacityDetect *capdetect;
+    struct SeqWindow *seqwin;
+    struct LossStats *lossstats;
+    struct JitterBuffer *jitterbuf;
+    struct DSCPStats *dscpstats;
+    char *udp_pdu;
+    int udp_len;
+};
+
+static volatile intmax_t bench_sink;
+
+static void bench_ring (struct bench_ctx *ctx, long iters) {
+    struct ReportStruct *packet;
+    for (long ix = 0; ix < iters; ix++) {
+	packetring_enqueue(ctx->ring, &ctx->packets[ix & BENCH_MASK]);
+	if ((packet = packetring_dequeue(ctx->ring)) != NULL)
+	    bench_sink += packet->packetID;
+    }
+}
+
+// Fill then drain the ring so the producer and consumer indices are apart
+static void bench_ring_batch (struct bench_ctx *ctx, long iters) {
+    struct ReportStruct *packet;
+    int batch = BENCH_RINGSIZE / 2;
+    for (long ix = 0; ix < iters; ix += batch) {
+	for (int jx = 0; jx < batch; jx++)
+	    packetring_enqueue(ctx->ring, &ctx->packets[(ix + jx) & BENCH_MASK]);
+	while ((packet = packetring_dequeue(ctx->ring)) != NULL)
+	    bench_sink += packet->packetID;
+    }
+}
+
+// Traffic threads fill their rings from a hot scratch ReportStruct and
+// the reporter drains them in turn, per the default ring depth
+static void bench_ring_flows (struct bench_ctx *ctx, long iters) {
+    struct ReportStruct *packet;
+    struct ReportStruct scratch = ctx->packets[0];
+    int batch = NUM_REPORT_STRUCTS / 2;
+    long ix = 0;
+    while (ix < iters) {
+	for (int fx = 0; fx < BENCH_FLOWS; fx++) {
+	    for (int jx = 0; jx < batch; jx++, ix++) {
+		scratch.packetID = ix;
+		scratch.packetTime.tv_usec = ix % 1000000;
+		packetring_enqueue(ctx->flowrings[fx], &scratch);
+	    }
+	}
+	for (int fx = 0; fx < BENCH_FLOWS; fx++) {
+	    while ((packet = packetring_dequeue(ctx->flowrings[fx])) != NULL)
+		bench_sink += packet->packetID;
+	}
+    }
+}
+
+// --link-emul at 1 Mpps, 20 ms +/- 2 ms and 1% loss, so ~20K packets are
+// held and each op is an enqueue plus the releases now due
+static void bench_linkemul (struct bench_ctx *ctx, long iters) {
+    struct ReportStruct *packet;
+    static int64_t now = 0;
+    for (long ix = 0; ix < iters; ix++) {
+	now += 1000;
+	linkemul_enqueue(ctx->linkemul, &ctx->packets[ix & BENCH_MASK], now);
+	while ((packet = linkemul_dequeue(ctx->linkemul, now)) != NULL)
+	    bench_sink += packet->packetID;
+    }
+}
+
+// --capacity-detect at 1 Mpps of 1470 byte datagrams with the transit
+// wobbling, so a 10 ms window closes every 10K packets
+static void bench_capdetect (struct bench_ctx *ctx, long iters) {
+    static int64_t now = 0;
+    for (long ix = 0; ix < iters; ix++) {
+	now += 1000;
+	bench_sink += capdetect_packet(ctx->capdetect, now, (1000000 + (ix & 0xFFF)), 1470);
+    }
+}
+
+// --reorder-window of the default tolerance with one in 16 datagrams
+// swapped with its neighbour and one in 64 lost
+static void bench_seqwin (struct bench_ctx *ctx, long iters) {
+    static intmax_t seqno = 0;
+    for (long ix = 0; ix < iters; ix++) {
+	seqno++;
+	if ((seqno & 0x3F) == 0)
+	    continue;
+	bench_sink += seqwin_packet(ctx->seqwin, (((seqno & 0xF) == 1) ? (seqno + 1) : (((seqno & 0xF) == 2) ? (seqno - 1) : seqno)));
+    }
+}
+
+// --loss-stats at 1 Mpps with the losses from the synthetic packets
+// lognormal transits, about one in 32, in runs of up to four
+static void bench_lossstats (struct bench_ctx *ctx, long iters) {
+    static intmax_t seqno = 0;
+    static int64_t now = 0;
+    for (long ix = 0; ix < iters; ix++) {
+	seqno += ((ctx->packets[ix & BENCH_MASK].sentTime.tv_usec & 0x1F) ? 1 : (1 + (ix & 0x3)));
+	now += 1000;
+	bench_sink += lossstats_packet(ctx->lossstats, seqno, now);
+    }
+}
+
+// --jitter-buffer of four depths over the synthetic packets' lognormal
+// transits, the depths scaled down so each sees late discards
+static void bench_jitterbuf (struct bench_ctx *ctx, long iters) {
+    for (long ix = 0; ix < iters; ix++) {
+	jitterbuf_packet(ctx->jitterbuf, (int64_t) (ctx->values[ix & BENCH_MASK] * 1e9));
+    }
+    bench_sink += ctx->jitterbuf->cnt.late[0];
+}
+
+// --dscp-stats with the synthetic packets spread over four classes, one
+// of them ECN marked, their loss and reordering and lognormal transits
+static void bench_dscpstats (struct bench_ctx *ctx, long iters) {
+    static const int tos[4] = {0xb8, 0x88, 0x00, 0x03};
+    for (long ix = 0; ix < iters; ix++) {
+	struct ReportStruct *packet = &ctx->packets[ix & BENCH_MASK];
+	dscpstats_packet(ctx->dscpstats, tos[ix & 0x3], packet->packetID, packet->packetLen, (int64_t) (ctx->values[ix & BENCH_MASK] * 1e9));
+    }
+    bench_sink += ctx->dscpstats->cls[46].cnt.packets;
+}
+
+static void bench_histogram_insert (struct bench_ctx *ctx, long iters) {
+    for (long ix = 0; ix < iters; ix++) {
+	histogram_insert(ctx->histogram, ctx->values[ix & BENCH_MASK], &ctx->packets[ix & BENCH_MASK].packetTime);
+    }
+}
+
+static void bench_update_mmm (struct bench_ctx *ctx, long iters) {
+    for (long ix = 0; ix < iters; ix++) {
+	reporter_update_mmm(&ctx->mmm, ctx->values[ix & BENCH_MASK]);
+    }
+    bench_sink += ctx->mmm.cnt;
+}
+
+// The packet ids and times must keep moving forward across passes
+// over the synthetic stream, otherwise every packet is out of order
+static void bench_server_udp (struct bench_ctx *ctx, long iters) {
+    struct ReportStruct packet;
+    for (long ix = 0; ix < iters; ix++) {
+	long pass = ix / BENCH_SAMPLES;
+	packet = ctx->packets[ix & BENCH_MASK];
+	packet.packetID += pass * BENCH_SAMPLES;
+	packet.packetTime.tv_sec += pass;
+	packet.sentTime.tv_sec += pass;
+	packet.prevPacketTime.tv_sec += pass;
+	reporter_handle_packet_server_udp(ctx->rdata, &packet);
+    }
+    bench_sink += ctx->rdata->info.total.Datagrams.current;
+}
+
+#ifdef HAVE_AF_PACKET
+static void bench_udpchecksum (struct bench_ctx *ctx, long iters) {
+    for (long ix = 0; ix < iters; ix++) {
+	bench_sink += udpchecksum(ctx->udp_pdu, ctx->udp_pdu + 20, ctx->udp_len, 0);
+    }
+}
+#endif
+
+static void bench_markov_next (struct bench_ctx *ctx, long iters) {
+    for (long ix = 0; ix < iters; ix++) {
+	bench_sink += markov_graph_next(ctx->markov);
+    }
+}
+
+static void bench_lognormal (struct bench_ctx *ctx, long iters) {
+    float sum = 0;
+    for (long ix = 0; ix < iters; ix++) {
+	sum += lognormal(1e6, 1e5);
+    }
+    bench_sink += (intmax_t) sum;
+}
+
+static void bench_clock_gettime (struct bench_ctx *ctx, long iters) {
+    struct timespec t1;
+    for (long ix = 0; ix < iters; ix++) {
+	clock_gettime(CLOCK_REALTIME, &t1);
+	bench_sink += t1.tv_nsec;
+    }
+}
+
+#if HAVE_FASTCLOCK
+static void bench_fastclock (struct bench_ctx *ctx, long iters) {
+    struct timespec t1;
+    for (long ix = 0; ix < iters; ix++) {
+	fastclock_gettime(&t1);
+	bench_sink += t1.tv_nsec;
+    }
+}
+#endif
+
+struct bench_entry {
+    const char *name;
+    void (*run)(struct bench_ctx *ctx, long iters);
+};
+
+static const struct bench_entry benches[] = {
+    {"packetring_enqueue_dequeue", bench_ring},
+    {"packetring_batch", bench_ring_batch},
+    {"packetring_flows", bench_ring_flows},
+    {"linkemul_1mpps", bench_linkemul},
+    {"capdetect_1mpps", bench_capdetect},
+    {"seqwin_reorder", bench_seqwin},
+    {"lossstats_1mpps", bench_lossstats},
+    {"jitterbuf_4depths", bench_jitterbuf},
+    {"dscpstats_4class", bench_dscpstats},
+    {"histogram_insert", bench_histogram_insert},
+    {"reporter_update_mmm", bench_update_mmm},
+    {"reporter_handle_packet_server_udp", bench_server_udp},
+#ifdef HAVE_AF_PACKET
+    {"udpchecksum_1470", bench_udpchecksum},
+#endif
+    {"markov_graph_next", bench_markov_next},
+    {"lognormal", bench_lognormal},
+    {"clock_gettime_realtime", bench_clock_gettime},
+#if HAVE_FASTCLOCK
+    {"fastclock_gettime", bench_fastclock},
+#endif
+    {NULL, NULL}
+};
+
+static double bench_now (void) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec * 1e9 + t1.tv_nsec);
+}
+
+static uint64_t bench_ticks (void) {
+#if HAVE_BENCH_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static int bench_cmp (const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return ((x > y) - (x < y));
+}
+
+// Synthetic UDP server stream: 10 usec spacing, lognormal transit
+// around 1 ms, a loss every 1000 and a reorder every 5000 packets
+static void bench_init (struct bench_ctx *ctx) {
+    int ix;
+    srandom(1);
+#if HAVE_FASTCLOCK
+    // calibrate for the fastclock bench only, the other benches keep clock_gettime()
+    fastclock_init();
+    fastclock_enabled = 0;
+#endif
+    ctx->packets = (struct ReportStruct *) calloc(BENCH_SAMPLES, sizeof(struct ReportStruct));
+    ctx->values = (float *) calloc(BENCH_SAMPLES, sizeof(float));
+    if (!ctx->packets || !ctx->values) {
+	fprintf(stderr, "ERROR: out of memory\n");
+	exit(1);
+    }
+    intmax_t packetid = 0;
+    for (ix = 0; ix < BENCH_SAMPLES; ix++) {
+	struct ReportStruct *packet = &ctx->packets[ix];
+	long usecs = ix * 10;
+	float transit = lognormal(1e-3, 2e-4);
+	packetid++;
+	if ((ix % 1000) == 999)
+	    packetid++;
+	packet->packetID = packetid;
+	if ((ix % 5000) == 4999)
+	    packet->packetID = packetid - 2;
+	packet->packetLen = 1470;
+	packet->packetTime.tv_sec = usecs / 1000000;
+	packet->packetTime.tv_usec = usecs % 1000000;
+	packet->prevPacketTime.tv_sec = (usecs - 10) / 1000000;
+	packet->prevPacketTime.tv_usec = (usecs - 10) % 1000000;
+	long sent = usecs - (long) (transit * 1e6);
+	packet->sentTime.tv_sec = sent / 1000000;
+	packet->sentTime.tv_usec = sent % 1000000;
+	if (packet->sentTime.tv_usec < 0) {
+	    packet->sentTime.tv_sec--;
+	    packet->sentTime.tv_usec += 1000000;
+	}
+	packet->err_readwrite = ReadSuccess;
+	ctx->values[ix] = transit;
+    }
+    Condition_Initialize(&ctx->ring_cond);
+    ctx->ring = packetring_init(BENCH_RINGSIZE, &ctx->ring_cond, NULL);
+    for (ix = 0; ix < BENCH_FLOWS; ix++)
+	ctx->flowrings[ix] = packetring_init(NUM_REPORT_STRUCTS, &ctx->ring_cond, NULL);
+    char name[] = "T8";
+    ctx->histogram = histogram_init(100000, 100, 0, 1e6, 5, 95, 1, name, false);
+    ctx->rdata = (struct ReporterData *) calloc(1, sizeof(struct ReporterData));
+    struct ReportCommon *common = (struct ReportCommon *) calloc(1, sizeof(struct ReportCommon));
+    if (!ctx->rdata || !common) {
+	fprintf(stderr, "ERROR: out of memory\n");
+	exit(1);
+    }
+    common->ThreadMode = kMode_Server;
+    ctx->rdata->info.common = common;
+    ctx->rdata->info.latency_histogram = histogram_init(100000, 100, 0, 1e6, 5, 95, 1, name, false);
+    ctx->rdata->info.transit.current.min = FLT_MAX;
+    ctx->rdata->info.transit.total.min = FLT_MAX;
+    char braket[] = "<256|0.1,0.7,0.2<1024|0.2,0.5,0.3<1470|0.4,0.4,0.2";
+    ctx->markov = markov_graph_init(braket);
+    struct LinkEmulParams params;
+    char spec[] = "delay=20ms,jitter=2ms,loss=1%,limit=65536";
+    linkemul_parse(spec, &params);
+    ctx->linkemul = linkemul_alloc(&params);
+    ctx->capdetect = capdetect_alloc(CAPDETECT_DEFWINDOW);
+    ctx->seqwin = seqwin_alloc(SEQWINDOW_DEFAULT);
+    ctx->lossstats = lossstats_alloc(LOSSSTATS_DEFOUTAGE);
+    int64_t depths[] = {200000, 400000, 600000, 1000000};
+    ctx->jitterbuf = jitterbuf_alloc(4, depths);
+    ctx->dscpstats = dscpstats_alloc(0xb8);
+    // IPv4 header followed by a UDP header and a 1470 byte payload
+    ctx->udp_len = 8 + 1470;
+    ctx->udp_pdu = (char *) calloc(1, 20 + ctx->udp_len);
+    if (!ctx->markov || !ctx->udp_pdu || !ctx->capdetect || !ctx->seqwin || !ctx->lossstats || !ctx->jitterbuf || !ctx->dscpstats) {
+	fprintf(stderr, "ERROR: out of memory\n");
+	exit(1);
+    }
+    for (ix = 12; ix < (20 + ctx->udp_len); ix++)
+	ctx->udp_pdu[ix] = (char) random();
+    uint16_t *udphdr = (uint16_t *) (ctx->udp_pdu + 20);
+    udphdr[2] = htons(ctx->udp_len);
+    if (!udphdr[3])
+	udphdr[3] = 0x1234; // zero means no checksum so nothing would be computed
+}
+
+static void bench_free (struct bench_ctx *ctx) {
+    packetring_free(ctx->ring);
+    for (int ix = 0; ix < BENCH_FLOWS; ix++)
+	packetring_free(ctx->flowrings[ix]);
+    Condition_Destroy(&ctx->ring_cond);
+    histogram_delete(ctx->histogram);
+    histogram_delete(ctx->rdata->info.latency_histogram);
+    free(ctx->rdata->info.common);
+    free(ctx->rdata);
+    markov_graph_free(ctx->markov);
+    linkemul_free(ctx->linkemul);
+    capdetect_free(ctx->capdetect);
+    seqwin_free(ctx->seqwin);
+    lossstats_free(ctx->lossstats);
+    jitterbuf_free(ctx->jitterbuf);
+    dscpstats_free(ctx->dscpstats);
+    free(ctx->udp_pdu);
+    free(ctx->packets);
+    free(ctx->values);
+}
+
+static void usage (void) {
+    fprintf(stderr, "Usage: iperf_bench [-c] [-l] [-n iterations] [-r runs] [name ...]\n" \
+	    "  -c  csv output: name,iterations,ns_per_op,ticks_per_op\n" \
+	    "  -l  list the benchmarks\n" \
+	    "  -n  iterations per run (default 1000000)\n" \
+	    "  -r  runs, the median is reported (default %d)\n", BENCH_RUNS);
+}
+
+int main (int argc, char **argv) {
+    int c, csv = 0, runs = BENCH_RUNS;
+    long iters = 1000000;
+    const struct bench_entry *bench;
+
+    while ((c = getopt(argc, argv, "cln:r:")) != -1) {
+	switch (c) {
+	case 'c':
+	    csv = 1;
+	    break;
+	case 'l':
+	    for (bench = benches; bench->name; bench++)
+		fprintf(stdout, "%s\n", bench->name);
+	    return 0;
+	case 'n':
+	    iters = atol(optarg);
+	    break;
+	case 'r':
+	    runs = atoi(optarg);
+	    break;
+	default:
+	    usage();
+	    return 1;
+	}
+    }
+    if ((iters <= 0) || (runs <= 0)) {
+	usage();
+	return 1;
+    }
+    double *ns = (double *) calloc(runs, sizeof(double));
+    double *ticks = (double *) calloc(runs, sizeof(double));
+    if (!ns || !ticks) {
+	fprintf(stderr, "ERROR: out of memory\n");
+	return 1;
+    }
+    if (csv) {
+	fprintf(stdout, "name,iterations,ns_per_op,ticks_per_op\n");
+    } else {
+	fprintf(stdout, "iperf_bench: %ld iterations, median of %d runs, %s\n", iters, runs, \
+		(HAVE_BENCH_TSC ? "ticks are TSC (reference) cycles" : "no cycle counter on this platform"));
+	fprintf(stdout, "%-36s %12s %12s\n", "benchmark", "ns/op", "ticks/op");
+    }
+    for (bench = benches; bench->name; bench++) {
+	if (optind < argc) {
+	    int ix, match = 0;
+	    for (ix = optind; ix < argc; ix++) {
+		if (strstr(bench->name, argv[ix]))
+		    match = 1;
+	    }
+	    if (!match)
+		continue;
+	}
+	// Fresh state per benchmark, with an untimed warm up pass
+	struct bench_ctx ctx;
+	memset(&ctx, 0, sizeof(ctx));
+	bench_init(&ctx);
+	bench->run(&ctx, (iters / 10) + 1);
+	for (int ix = 0; ix < runs; ix++) {
+	    double start = bench_now();
+	    uint64_t tstart = bench_ticks();
+	    bench->run(&ctx, iters);
+	    uint64_t tend = bench_ticks();
+	    ns[ix] = (bench_now() - start) / iters;
+	    ticks[ix] = (double) (tend - tstart) / iters;
+	}
+	qsort(ns, runs, sizeof(double), bench_cmp);
+	qsort(ticks, runs, sizeof(double), bench_cmp);
+	if (csv) {
+	    fprintf(stdout, "%s,%ld,%.3f,%.1f\n", bench->name, iters, ns[runs / 2], ticks[runs / 2]);
+	} else {
+	    fprintf(stdout, "%-36s %12.3f %12.1f\n", bench->name, ns[runs / 2], ticks[runs / 2]);
+	}
+	fflush(stdout);
+	bench_free(&ctx);
+    }
+    free(ns);
+    free(ticks);
+    return 0;
+}
@@ -0,0 +1,374 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * iperf_metrics.c
+ * Seqlock protected live counters and an optional OpenMetrics
+ * (Prometheus text format) http endpoint, e.g. --metrics-port 9100
+ * The flow table can also live in a POSIX shared memory segment,
+ * e.g. --stats-shm /iperf, see iperf_shmstat.c for a reader
+ * -------------------------------------------------------------------
+ */
+#include <stddef.h>
+#include "headers.h"
+#include "Settings.hpp"
+#include "Reporter.h"
+#include "histogram.h"
+#include "util.h"
+#include "iperf_metrics.h"
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+static struct iperf_metrics_flow metrics_static[METRICS_MAXFLOWS];
+// Points into the shared memory segment when --stats-shm is used
+static struct iperf_metrics_flow *metrics_table = metrics_static;
+static int metrics_listenfd = -1;
+
+struct iperf_metrics_flow *iperf_metrics_alloc (void) {
+    int ix;
+    for (ix = 0; ix < METRICS_MAXFLOWS; ix++) {
+	uint32_t expected = 0;
+	if (__atomic_compare_exchange_n(&metrics_table[ix].inuse, &expected, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+	    struct iperf_metrics_flow *slot = &metrics_table[ix];
+	    uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+	    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+	    __atomic_thread_fence(__ATOMIC_RELEASE);
+	    memset(((char *) slot) + offsetof(struct iperf_metrics_flow, transferID), 0, \
+		   sizeof(struct iperf_metrics_flow) - offsetof(struct iperf_metrics_flow, transferID));
+	    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+	    return slot;
+	}
+    }
+    return NULL;
+}
+
+void iperf_metrics_free (struct iperf_metrics_flow *slot) {
+    if (slot) {
+	__atomic_store_n(&slot->inuse, 0, __ATOMIC_RELEASE);
+    }
+}
+
+// Reporter thread context, the only writer of a slot
+void iperf_metrics_publish (struct TransferInfo *stats, struct ReporterData *data) {
+    struct iperf_metrics_flow *slot = stats->metrics;
+    double p50 = 0, p90 = 0, p99 = 0;
+    // percentiles walk the bins so only refresh them once per second of packet time
+    bool newpct = (stats->latency_histogram && (TimeDifference(stats->ts.packetTime, stats->metrics_nextpct) >= 0));
+    if (newpct) {
+	p50 = histogram_percentile(stats->latency_histogram, 50.0);
+	p90 = histogram_percentile(stats->latency_histogram, 90.0);
+	p99 = histogram_percentile(stats->latency_histogram, 99.0);
+	stats->metrics_nextpct = stats->ts.packetTime;
+	stats->metrics_nextpct.tv_sec += 1;
+    }
+    uint32_t seq = slot->seq;
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->transferID = stats->common->transferID;
+    slot->type = stats->type;
+    slot->server = (stats->common->ThreadMode == kMode_Server);
+    slot->udp = isUDP(stats->common);
+    slot->bytes = stats->total.Bytes.current;
+    if (stats->type == SUM_REPORT) {
+	slot->datagrams = stats->total.Datagrams.current;
+    } else {
+	slot->datagrams = stats->PacketID;
+    }
+    slot->lost = stats->total.Lost.current;
+    if (!isReorderWindow(stats->common))
+	slot->lost -= stats->total.OutofOrder.current;
+    if (slot->lost < 0)
+	slot->lost = 0;
+    slot->outoforder = stats->total.OutofOrder.current;
+    slot->ring_stalls = (data && data->packetring) ? data->packetring->awaitcounter : 0;
+    slot->transit_cnt = stats->transit.total.cnt;
+    if (stats->transit.total.cnt > 0) {
+	slot->transit_mean = stats->transit.total.sum / stats->transit.total.cnt;
+	slot->transit_min = stats->transit.total.min;
+	slot->transit_max = stats->transit.total.max;
+    }
+    if (newpct) {
+	slot->transit_p50 = p50;
+	slot->transit_p90 = p90;
+	slot->transit_p99 = p99;
+    }
+    slot->jitter = stats->jitter;
+    slot->transit_last = stats->transit.current.last;
+#if HAVE_TCP_STATS
+    if (!slot->udp && !slot->server && (stats->type == DATA_REPORT)) {
+	slot->tcp_cwnd = stats->sock_callstats.write.tcpstats.cwnd;
+	slot->tcp_rtt = stats->sock_callstats.write.tcpstats.rtt;
+	slot->tcp_retry = stats->sock_callstats.write.tcpstats.retry_tot;
+    }
+#endif
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// Returns false if the slot is unused or if a consistent copy couldn't be made
+bool iperf_metrics_snapshot (struct iperf_metrics_flow *slot, struct iperf_metrics_flow *copy) {
+    int retries;
+    for (retries = 0; retries < METRICS_READRETRIES; retries++) {
+	uint32_t seq1 = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+	if (seq1 & 0x1)
+	    continue;
+	memcpy(copy, slot, sizeof(struct iperf_metrics_flow));
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq1)
+	    return (copy->inuse != 0);
+    }
+    return false;
+}
+
+#if defined(HAVE_POSIX_THREAD)
+#define METRICS_OUTBUFSIZE (METRICS_MAXFLOWS * 1536)
+
+struct metrics_family {
+    const char *name;
+    const char *type;
+    const char *help;
+};
+
+static const struct metrics_family metrics_families[] = {
+    {"iperf_bytes_total", "counter", "Bytes transferred"},
+    {"iperf_datagrams_total", "counter", "UDP datagrams (highest sequence number for flows)"},
+    {"iperf_lost_datagrams_total", "counter", "UDP datagrams lost (net of out of order)"},
+    {"iperf_outoforder_datagrams_total", "counter", "UDP datagrams received out of order"},
+    {"iperf_packetring_stalls_total", "counter", "Traffic thread waits on a full packet ring"},
+    {"iperf_transit_samples_total", "counter", "One way transit samples"},
+    {"iperf_transit_mean_seconds", "gauge", "One way transit mean"},
+    {"iperf_transit_min_seconds", "gauge", "One way transit min"},
+    {"iperf_transit_max_seconds", "gauge", "One way transit max"},
+    {"iperf_transit_seconds", "gauge", "One way transit percentiles (requires --histograms)"},
+    {"iperf_jitter_seconds", "gauge", "RFC 1889 interarrival jitter"},
+};
+
+static int metrics_print_family (char *buf, int len, int family, struct iperf_metrics_flow *flows, int cnt) {
+    int n = snprintf(buf, len, "# HELP %s %s\n# TYPE %s %s\n", metrics_families[family].name, metrics_families[family].help, \
+		     metrics_families[family].name, metrics_families[family].type);
+    for (int ix = 0; (ix < cnt) && (n < len); ix++) {
+	struct iperf_metrics_flow *f = &flows[ix];
+	char labels[96];
+	snprintf(labels, sizeof(labels), "id=\"%d\",report=\"%s\",role=\"%s\",proto=\"%s\"", f->transferID, \
+		 ((f->type == SUM_REPORT) ? "sum" : "flow"), (f->server ? "server" : "client"), (f->udp ? "udp" : "tcp"));
+	switch (family) {
+	case 0 :
+	    n += snprintf(buf + n, len - n, "%s{%s} %" PRIu64 "\n", metrics_families[family].name, labels, f->bytes);
+	    break;
+	case 1 :
+	case 2 :
+	case 3 :
+	case 4 :
+	case 5 :
+	{
+	    int64_t value = ((family == 1) ? f->datagrams : (family == 2) ? f->lost : (family == 3) ? f->outoforder : \
+			     (family == 4) ? f->ring_stalls : f->transit_cnt);
+	    if (f->udp || (family == 4))
+		n += snprintf(buf + n, len - n, "%s{%s} %" PRId64 "\n", metrics_families[family].name, labels, value);
+	}
+	    break;
+	case 6 :
+	case 7 :
+	case 8 :
+	case 10 :
+	    if (f->transit_cnt > 0) {
+		double value = ((family == 6) ? f->transit_mean : (family == 7) ? f->transit_min : \
+				(family == 8) ? f->transit_max : f->jitter);
+		n += snprintf(buf + n, len - n, "%s{%s} %.9f\n", metrics_families[family].name, labels, value);
+	    }
+	    break;
+	case 9 :
+	    if (f->transit_p99 > 0) {
+		const char *quantile[3] = {"0.5", "0.9", "0.99"};
+		double value[3] = {f->transit_p50, f->transit_p90, f->transit_p99};
+		// a full buffer stops here, len - n would otherwise go negative
+		for (int qx = 0; (qx < 3) && (n < len); qx++)
+		    n += snprintf(buf + n, len - n, "%s{%s,quantile=\"%s\"} %.9f\n", metrics_families[family].name, labels, quantile[qx], value[qx]);
+	    }
+	    break;
+	default :
+	    break;
+	}
+    }
+    return ((n < len) ? n : len - 1);
+}
+
+static void metrics_serve (int fd, char *outbuf, struct iperf_metrics_flow *flows) {
+    char request[1024];
+    char header[160];
+    int cnt = 0, len = 0, rc;
+    rc = recv(fd, request, sizeof(request) - 1, 0);
+    if (rc <= 0)
+	return;
+    request[rc] = '\0';
+    if (strncmp(request, "GET /metrics", 12) && strncmp(request, "GET / ", 6)) {
+	const char notfound[] = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+	rc = send(fd, notfound, strlen(notfound), MSG_NOSIGNAL);
+	return;
+    }
+    for (int ix = 0; ix < METRICS_MAXFLOWS; ix++) {
+	if (__atomic_load_n(&metrics_table[ix].inuse, __ATOMIC_ACQUIRE) && iperf_metrics_snapshot(&metrics_table[ix], &flows[cnt])) {
+	    cnt++;
+	}
+    }
+    len = snprintf(outbuf, METRICS_OUTBUFSIZE, "# HELP iperf_reports_active Active flow and group sum reports\n" \
+		   "# TYPE iperf_reports_active gauge\niperf_reports_active %d\n", cnt);
+    for (int family = 0; family < (int) (sizeof(metrics_families) / sizeof(struct metrics_family)); family++) {
+	len += metrics_print_family(outbuf + len, METRICS_OUTBUFSIZE - len, family, flows, cnt);
+    }
+    snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n" \
+	     "Content-Length: %d\r\nConnection: close\r\n\r\n", len);
+    if (send(fd, header, strlen(header), MSG_NOSIGNAL) > 0) {
+	int sent = 0;
+	while ((sent < len) && ((rc = send(fd, outbuf + sent, len - sent, MSG_NOSIGNAL)) > 0)) {
+	    sent += rc;
+	}
+    }
+}
+
+static void *metrics_listener (void *arg) {
+    char *outbuf = (char *) malloc(METRICS_OUTBUFSIZE);
+    struct iperf_metrics_flow *flows = (struct iperf_metrics_flow *) calloc(METRICS_MAXFLOWS, sizeof(struct iperf_metrics_flow));
+    if (!outbuf || !flows) {
+	fprintf(stderr, "ERROR: metrics out of memory\n");
+	return NULL;
+    }
+    while (1) {
+	int fd = accept(metrics_listenfd, NULL, NULL);
+	if (fd < 0) {
+	    if (errno == EINTR)
+		continue;
+	    break;
+	}
+	struct timeval timeout = {1, 0};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (char *) &timeout, sizeof(timeout));
+	metrics_serve(fd, outbuf, flows);
+	close(fd);
+    }
+    free(flows);
+    free(outbuf);
+    return NULL;
+}
+#endif
+
+// Must be called before any slots are allocated, i.e. prior to starting threads
+int iperf_metrics_shm_open (char *name) {
+#ifndef WIN32
+    size_t len = sizeof(struct iperf_metrics_shm) + (METRICS_MAXFLOWS * sizeof(struct iperf_metrics_flow));
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+	WARN_errno(1, "stats shm_open");
+	return -1;
+    }
+    if (ftruncate(fd, len) < 0) {
+	WARN_errno(1, "stats shm ftruncate");
+	close(fd);
+	return -1;
+    }
+    void *base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+	WARN_errno(1, "stats shm mmap");
+	return -1;
+    }
+    struct iperf_metrics_shm *hdr = (struct iperf_metrics_shm *) base;
+    // a previous run may have left a table behind, invalidate then clear it
+    __atomic_store_n(&hdr->magic, 0, __ATOMIC_RELEASE);
+    memset(base, 0, len);
+    hdr->version = METRICS_SHM_VERSION;
+    hdr->maxflows = METRICS_MAXFLOWS;
+    hdr->flowsize = sizeof(struct iperf_metrics_flow);
+    hdr->pid = (int64_t) getpid();
+    hdr->start_sec = (int64_t) time(NULL);
+    metrics_table = (struct iperf_metrics_flow *) (hdr + 1);
+    // publish the magic last, readers treat the segment as not ready until then
+    __atomic_store_n(&hdr->magic, METRICS_SHM_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+#else
+    fprintf(stderr, "WARN: --stats-shm not supported\n");
+    return -1;
+#endif
+}
+
+// Bind string is [<ipv4 addr>:]<port>, the default address is loopback
+int iperf_metrics_start (char *bindstr) {
+#if defined(HAVE_POSIX_THREAD)
+    struct sockaddr_in addr;
+    char *port = strrchr(bindstr, ':');
+    pthread_t tid;
+    int one = 1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (port) {
+	*port++ = '\0';
+	if ((*bindstr != '\0') && (inet_pton(AF_INET, bindstr, &addr.sin_addr) != 1)) {
+	    fprintf(stderr, "ERROR: --metrics-port address %s invalid\n", bindstr);
+	    return -1;
+	}
+    } else {
+	port = bindstr;
+    }
+    addr.sin_port = htons(atoi(port));
+    if ((metrics_listenfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+	WARN_errno(1, "metrics socket");
+	return -1;
+    }
+    setsockopt(metrics_listenfd, SOL_SOCKET, SO_REUSEADDR, (char *) &one, sizeof(one));
+    if ((bind(metrics_listenfd, (struct sockaddr *) &addr, sizeof(addr)) < 0) || (listen(metrics_listenfd, 8) < 0)) {
+	WARN_errno(1, "metrics bind");
+	close(metrics_listenfd);
+	metrics_listenfd = -1;
+	return -1;
+    }
+    // This thread is not a user thread, i.e. it doesn't hold off the reporter's exit
+    if (pthread_create(&tid, NULL, metrics_listener, NULL) != 0) {
+	WARN_errno(1, "metrics pthread_create");
+	close(metrics_listenfd);
+	metrics_listenfd = -1;
+	return -1;
+    }
+    pthread_detach(tid);
+    return 0;
+#else
+    fprintf(stderr, "WARN: --metrics-port requires threads\n");
+    return -1;
+#endif
+}
@@ -0,0 +1,404 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * iperf_selftest.c
+ * Fork and exec iperf server and client processes over loopback, one
+ * pair per configuration, and collect their final counters from
+ * --stats-shm segments. CPU comes from the children's rusage and the
+ * reporter lag is the number of packet ring stalls, i.e. the times a
+ * traffic thread had to wait on the reporter thread.
+ * -------------------------------------------------------------------
+ */
+#include "headers.h"
+#include "Settings.hpp"
+#include "Reporter.h"
+#include "Locale.h"
+#include "iperf_metrics.h"
+#include "iperf_selftest.h"
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+#ifndef WIN32
+struct selftest_config {
+    const char *name;
+    bool udp;
+    bool isoch;
+    bool bounceback;
+    int len;
+    int threads;
+};
+
+struct selftest_result {
+    double pps;
+    double bps;
+    double cpu_client; // percent of one core
+    double cpu_server;
+    intmax_t ring_stalls;
+};
+
+// Totals of the data (not sum) slots of a --stats-shm segment
+struct selftest_counts {
+    uintmax_t bytes;
+    intmax_t datagrams;
+    intmax_t ring_stalls;
+};
+
+static double selftest_now (void) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec + (now.tv_usec / 1e6));
+}
+
+// Let the kernel pick a free loopback port
+static int selftest_port (void) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int port = -1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+	return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) && \
+	(getsockname(fd, (struct sockaddr *) &addr, &len) == 0)) {
+	port = ntohs(addr.sin_port);
+    }
+    close(fd);
+    return port;
+}
+
+// The listener holds the port once a plain bind (no SO_REUSEADDR) fails
+static bool selftest_listening (int port, bool udp) {
+    struct sockaddr_in addr;
+    bool inuse = false;
+    int fd = socket(AF_INET, (udp ? SOCK_DGRAM : SOCK_STREAM), 0);
+    if (fd < 0)
+	return false;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if ((bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) && (errno == EADDRINUSE))
+	inuse = true;
+    close(fd);
+    return inuse;
+}
+
+static pid_t selftest_spawn (const char *exe, char **args) {
+    pid_t pid = fork();
+    if (pid == 0) {
+	int fd = open("/dev/null", O_RDWR);
+	if (fd >= 0) {
+	    dup2(fd, STDIN_FILENO);
+	    dup2(fd, STDOUT_FILENO);
+	    dup2(fd, STDERR_FILENO);
+	    close(fd);
+	}
+	if (strchr(exe, '/'))
+	    execv(exe, args);
+	else
+	    execvp(exe, args);
+	_exit(127);
+    }
+    WARN_errno((pid < 0), "selftest fork");
+    return pid;
+}
+
+// Returns false if the child had to be killed or exited non zero
+static bool selftest_reap (pid_t pid, double timeout, struct rusage *ru) {
+    int status = 0;
+    double end = selftest_now() + timeout;
+    pid_t rc;
+    while ((rc = wait4(pid, &status, WNOHANG, ru)) == 0) {
+	if (selftest_now() > end) {
+	    kill(pid, SIGKILL);
+	    wait4(pid, &status, 0, ru);
+	    return false;
+	}
+	usleep(10000);
+    }
+    return ((rc == pid) && WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+}
+
+static double selftest_cpu (struct rusage *ru, double secs) {
+    double used = ru->ru_utime.tv_sec + (ru->ru_utime.tv_usec / 1e6) + \
+	ru->ru_stime.tv_sec + (ru->ru_stime.tv_usec / 1e6);
+    return ((secs > 0) ? (100.0 * used / secs) : 0);
+}
+
+// The writer has exited so the slots are stable, no seqlock retries needed
+static bool selftest_collect (const char *name, struct selftest_counts *counts) {
+    size_t len = sizeof(struct iperf_metrics_shm) + (METRICS_MAXFLOWS * sizeof(struct iperf_metrics_flow));
+    bool valid = false;
+    memset(counts, 0, sizeof(struct selftest_counts));
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+	return false;
+    void *base = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base != MAP_FAILED) {
+	struct iperf_metrics_shm *hdr = (struct iperf_metrics_shm *) base;
+	if ((hdr->magic == METRICS_SHM_MAGIC) && (hdr->flowsize == sizeof(struct iperf_metrics_flow))) {
+	    struct iperf_metrics_flow *table = (struct iperf_metrics_flow *) (hdr + 1);
+	    int ix;
+	    for (ix = 0; ix < METRICS_MAXFLOWS; ix++) {
+		// slots that were ever published have a non zero sequence
+		if (table[ix].seq && (table[ix].type == DATA_REPORT)) {
+		    counts->bytes += table[ix].bytes;
+		    counts->datagrams += table[ix].datagrams - table[ix].lost;
+		    counts->ring_stalls += table[ix].ring_stalls;
+		    valid = true;
+		}
+	    }
+	}
+	munmap(base, len);
+    }
+    shm_unlink(name);
+    return valid;
+}
+
+static bool selftest_run (const char *exe, struct selftest_config *cfg, double secs, struct selftest_result *result) {
+    char port[16], duration[32], len[16], threads[16], sname[64], cname[64];
+    char isoch[] = "--isochronous=2000:2g,0"; // near the max mean rate, above loopback udp rates
+    char *sargs[16], *cargs[32];
+    int ix, p = selftest_port();
+    struct rusage sru, cru;
+    struct selftest_counts scounts, ccounts;
+    bool ok = true;
+
+    memset(result, 0, sizeof(struct selftest_result));
+    if (p < 0)
+	return false;
+    snprintf(port, sizeof(port), "%d", p);
+    snprintf(duration, sizeof(duration), "%.2f", secs);
+    snprintf(len, sizeof(len), "%d", cfg->len);
+    snprintf(threads, sizeof(threads), "%d", cfg->threads);
+    snprintf(sname, sizeof(sname), "/iperf-selftest-%d-s", (int) getpid());
+    snprintf(cname, sizeof(cname), "/iperf-selftest-%d-c", (int) getpid());
+
+    ix = 0;
+    sargs[ix++] = (char *) exe;
+    sargs[ix++] = (char *) "-s";
+    sargs[ix++] = (char *) "-e";
+    sargs[ix++] = (char *) "-B";
+    sargs[ix++] = (char *) "127.0.0.1";
+    sargs[ix++] = (char *) "-p";
+    sargs[ix++] = port;
+    if (cfg->udp)
+	sargs[ix++] = (char *) "-u";
+    sargs[ix++] = (char *) "--stats-shm";
+    sargs[ix++] = sname;
+    sargs[ix] = NULL;
+
+    ix = 0;
+    cargs[ix++] = (char *) exe;
+    cargs[ix++] = (char *) "-c";
+    cargs[ix++] = (char *) "127.0.0.1";
+    cargs[ix++] = (char *) "-e";
+    cargs[ix++] = (char *) "-p";
+    cargs[ix++] = port;
+    cargs[ix++] = (char *) "-t";
+    cargs[ix++] = duration;
+    cargs[ix++] = (char *) "-P";
+    cargs[ix++] = threads;
+    cargs[ix++] = (char *) "--stats-shm";
+    cargs[ix++] = cname;
+    if (cfg->udp) {
+	cargs[ix++] = (char *) "-u";
+	cargs[ix++] = (char *) "-l";
+	cargs[ix++] = len;
+	if (cfg->isoch) {
+	    cargs[ix++] = isoch;
+	} else {
+	    cargs[ix++] = (char *) "-b";
+	    cargs[ix++] = (char *) "0";
+	}
+    } else if (cfg->bounceback) {
+	cargs[ix++] = (char *) "--bounceback";
+	cargs[ix++] = (char *) "--bounceback-period";
+	cargs[ix++] = (char *) "0";
+	cargs[ix++] = (char *) "--bounceback-request";
+	cargs[ix++] = len;
+    } else {
+	cargs[ix++] = (char *) "-l";
+	cargs[ix++] = len;
+    }
+    cargs[ix] = NULL;
+
+    pid_t server = selftest_spawn(exe, sargs);
+    if (server < 0)
+	return false;
+    double end = selftest_now() + 2.0;
+    while (!selftest_listening(p, cfg->udp) && (selftest_now() < end))
+	usleep(10000);
+    double start = selftest_now();
+    pid_t client = selftest_spawn(exe, cargs);
+    if (client < 0) {
+	ok = false;
+    } else {
+	ok = selftest_reap(client, secs + 10.0, &cru);
+    }
+    double elapsed = selftest_now() - start;
+    // let the server finish its final reports then stop it
+    usleep(250000);
+    kill(server, SIGINT);
+    if (!selftest_reap(server, 5.0, &sru)) {
+	// a server stopped by SIGINT may not exit cleanly, its counters still count
+	memset(&sru, 0, sizeof(sru));
+    }
+    bool haveserver = selftest_collect(sname, &scounts);
+    bool haveclient = selftest_collect(cname, &ccounts);
+    if (!ok || !haveclient || (!haveserver && !cfg->bounceback))
+	return false;
+    // bounce-back is measured at the client, i.e. round trips per second
+    struct selftest_counts *counts = (cfg->bounceback ? &ccounts : &scounts);
+    result->bps = (counts->bytes * 8.0) / secs;
+    if (cfg->udp) {
+	result->pps = counts->datagrams / secs;
+    } else {
+	result->pps = (counts->bytes / (double) cfg->len) / secs;
+    }
+    result->cpu_client = selftest_cpu(&cru, elapsed);
+    result->cpu_server = selftest_cpu(&sru, elapsed);
+    result->ring_stalls = scounts.ring_stalls + ccounts.ring_stalls;
+    return true;
+}
+
+static void selftest_print (struct selftest_config *cfg, struct selftest_result *result, bool ok) {
+    if (!ok) {
+	printf(report_selftest_failed, cfg->name, cfg->len, cfg->threads);
+	fflush(stdout);
+	return;
+    }
+    double cores = (result->cpu_client + result->cpu_server) / 100.0;
+    printf(report_selftest, cfg->name, cfg->len, cfg->threads, result->pps, result->bps / 1e9, \
+	   result->pps / cfg->threads, ((cores > 0) ? ((result->bps / 1e9) / cores) : 0), \
+	   result->cpu_client, result->cpu_server, result->ring_stalls);
+    fflush(stdout);
+}
+
+int iperf_selftest (struct thread_Settings *settings, char *argv0) {
+    char exe[PATH_MAX];
+    struct selftest_config cfg;
+    struct selftest_result result;
+    double secs = ((settings->mSelfTestTime > 0) ? settings->mSelfTestTime : SELFTEST_DEFAULT_TIME);
+    ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (len > 0) {
+	exe[len] = '\0';
+    } else {
+	snprintf(exe, sizeof(exe), "%s", argv0);
+    }
+    // fork() below would otherwise duplicate unflushed output
+    fflush(stdout);
+    fflush(stderr);
+    printf(report_selftest_heading, secs);
+    if (settings->mThreadMode == kMode_Client) {
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.udp = isUDP(settings);
+	cfg.isoch = isIsochronous(settings);
+	cfg.bounceback = isBounceBack(settings);
+	cfg.len = (cfg.bounceback ? settings->mBounceBackBytes : settings->mBufLen);
+	cfg.threads = ((settings->mThreads > 0) ? settings->mThreads : 1);
+	cfg.name = (cfg.bounceback ? "bounceback" : (cfg.isoch ? "isoch" : (cfg.udp ? "udp" : "tcp")));
+	bool ok = selftest_run(exe, &cfg, secs, &result);
+	selftest_print(&cfg, &result, ok);
+	// -b is per traffic thread, isochronous uses its mean rate
+	double offered = 0;
+	if (cfg.isoch) {
+	    offered = settings->mMean * cfg.threads;
+	} else if ((cfg.udp || isBWSet(settings)) && (settings->mAppRateUnits == kRate_BW)) {
+	    offered = (double) settings->mAppRate * cfg.threads;
+	}
+	if (ok && (offered > 0)) {
+	    if (offered > result.bps) {
+		fprintf(stderr, warn_selftest_ceiling, offered / 1e9, result.bps / 1e9, result.pps);
+	    } else {
+		printf(report_selftest_within, offered / 1e9, (100.0 * offered / result.bps));
+	    }
+	}
+	fflush(stdout);
+	return (ok ? 0 : 1);
+    }
+    int maxthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (maxthreads > SELFTEST_MAXTHREADS)
+	maxthreads = SELFTEST_MAXTHREADS;
+    if (maxthreads < 1)
+	maxthreads = 1;
+    // a zero thread count is a -P sweep point, i.e. one traffic thread per core up to the max
+    const struct selftest_config sweep[] = {
+	{"tcp", false, false, false, 8192, 1},
+	{"tcp", false, false, false, 131072, 1},
+	{"tcp", false, false, false, 131072, 0},
+	{"udp", true, false, false, 64, 1},
+	{"udp", true, false, false, 1470, 1},
+	{"udp", true, false, false, 64, 0},
+	{"udp", true, false, false, 1470, 0},
+	{"isoch", true, true, false, 1470, 1},
+	{"bounceback", false, false, true, 100, 1},
+	{"bounceback", false, false, true, 100, 0},
+    };
+    int ix, failed = 0;
+    for (ix = 0; ix < (int) (sizeof(sweep) / sizeof(sweep[0])); ix++) {
+	cfg = sweep[ix];
+	if (!cfg.threads) {
+	    if (maxthreads == 1)
+		continue;
+	    cfg.threads = maxthreads;
+	}
+	bool ok = selftest_run(exe, &cfg, secs, &result);
+	selftest_print(&cfg, &result, ok);
+	if (!ok)
+	    failed++;
+	if (sInterupted)
+	    break;
+    }
+    return (failed ? 1 : 0);
+}
+#else
+int iperf_selftest (struct thread_Settings *settings, char *argv0) {
+    fprintf(stderr, "WARN: --selftest not supported\n");
+    return 1;
+}
+#endif
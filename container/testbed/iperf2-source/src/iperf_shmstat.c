@@ -0,0 +1,195 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * iperf_shmstat.c
+ * Attach read only to an iperf --stats-shm segment and print the
+ * live flow table, or just an aggregate, every interval. No
+ * syscalls are made by iperf for these reads, the reporter thread
+ * updates the table in place using per slot sequence counters.
+ *
+ * Build with "make iperf_shmstat" from the src directory
+ * ------------------------------------------------------------------- */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "headers.h"
+#include "Reporter.h"
+#include "iperf_metrics.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <signal.h>
+
+// Same retry loop as iperf_metrics_snapshot(), the writer is in another process
+static bool shmstat_snapshot (struct iperf_metrics_flow *slot, struct iperf_metrics_flow *copy) {
+    int retries;
+    for (retries = 0; retries < METRICS_READRETRIES; retries++) {
+	uint32_t seq1 = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+	if (seq1 & 0x1)
+	    continue;
+	memcpy(copy, slot, sizeof(struct iperf_metrics_flow));
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq1)
+	    return (copy->inuse != 0);
+    }
+    return false;
+}
+
+static void usage (void) {
+    fprintf(stderr, "Usage: iperf_shmstat [-a] [-c count] [-i secs] <name>\n" \
+	    "  -a  aggregate flows only\n" \
+	    "  -c  number of samples (default run until the writer exits)\n" \
+	    "  -i  seconds between samples (default 1)\n");
+}
+
+int main (int argc, char **argv) {
+    int c, count = 0, aggregate = 0, samples = 0;
+    double interval = 1.0;
+    char name[256];
+
+    while ((c = getopt(argc, argv, "ac:i:")) != -1) {
+	switch (c) {
+	case 'a':
+	    aggregate = 1;
+	    break;
+	case 'c':
+	    count = atoi(optarg);
+	    break;
+	case 'i':
+	    interval = atof(optarg);
+	    if (interval <= 0)
+		interval = 1.0;
+	    break;
+	default:
+	    usage();
+	    return 1;
+	}
+    }
+    if (optind >= argc) {
+	usage();
+	return 1;
+    }
+    snprintf(name, sizeof(name), "%s%s", ((argv[optind][0] == '/') ? "" : "/"), argv[optind]);
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+	fprintf(stderr, "ERROR: shm_open %s: %s\n", name, strerror(errno));
+	return 1;
+    }
+    struct stat st;
+    size_t len = sizeof(struct iperf_metrics_shm) + (METRICS_MAXFLOWS * sizeof(struct iperf_metrics_flow));
+    if ((fstat(fd, &st) < 0) || ((size_t) st.st_size < len)) {
+	fprintf(stderr, "ERROR: %s is not an iperf stats segment\n", name);
+	close(fd);
+	return 1;
+    }
+    void *base = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+	fprintf(stderr, "ERROR: mmap %s: %s\n", name, strerror(errno));
+	return 1;
+    }
+    struct iperf_metrics_shm *hdr = (struct iperf_metrics_shm *) base;
+    if ((__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != METRICS_SHM_MAGIC) || (hdr->version != METRICS_SHM_VERSION) || \
+	(hdr->flowsize != sizeof(struct iperf_metrics_flow)) || (hdr->maxflows != METRICS_MAXFLOWS)) {
+	fprintf(stderr, "ERROR: %s version mismatch (magic=0x%x version=%u flowsize=%u)\n", name, \
+		hdr->magic, hdr->version, hdr->flowsize);
+	return 1;
+    }
+    struct iperf_metrics_flow *table = (struct iperf_metrics_flow *) (hdr + 1);
+    struct iperf_metrics_flow flow;
+    // per slot byte counts from the previous sample, used for rates
+    uint64_t *prevbytes = (uint64_t *) calloc(METRICS_MAXFLOWS, sizeof(uint64_t));
+    int32_t *previd = (int32_t *) calloc(METRICS_MAXFLOWS, sizeof(int32_t));
+    if (!prevbytes || !previd) {
+	fprintf(stderr, "ERROR: out of memory\n");
+	return 1;
+    }
+    fprintf(stdout, "Attached to %s (writer pid %" PRId64 ")\n", name, hdr->pid);
+    while (1) {
+	bool alive = ((kill((pid_t) hdr->pid, 0) == 0) || (errno != ESRCH));
+	uint64_t totbytes = 0;
+	double totrate = 0;
+	int64_t totdgrams = 0, totlost = 0, totooo = 0;
+	int flows = 0;
+	if (!aggregate) {
+	    fprintf(stdout, "[ ID] Report Role   Proto        Bytes     Mbits/sec   Datagrams  Lost  OOO  Transit(ms) Jitter(ms)  Cwnd(K)  RTT(us)\n");
+	}
+	for (int ix = 0; ix < METRICS_MAXFLOWS; ix++) {
+	    if (!shmstat_snapshot(&table[ix], &flow)) {
+		continue;
+	    }
+	    if (previd[ix] != flow.transferID) {
+		previd[ix] = flow.transferID;
+		prevbytes[ix] = (samples ? 0 : flow.bytes);
+	    }
+	    double rate = ((double) (flow.bytes - prevbytes[ix]) * 8.0) / (interval * 1e6);
+	    prevbytes[ix] = flow.bytes;
+	    if (flow.type == DATA_REPORT) {
+		totbytes += flow.bytes;
+		totrate += rate;
+		totdgrams += flow.datagrams;
+		totlost += flow.lost;
+		totooo += flow.outoforder;
+		flows++;
+	    }
+	    if (!aggregate) {
+		fprintf(stdout, "[%3d] %-6s %-6s %-5s %12" PRIu64 " %13.2f %11" PRId64 " %5" PRId64 " %4" PRId64 " %12.3f %10.3f %8" PRId64 " %8" PRId64 "\n", \
+			flow.transferID, ((flow.type == SUM_REPORT) ? "sum" : "flow"), (flow.server ? "server" : "client"), \
+			(flow.udp ? "udp" : "tcp"), flow.bytes, (samples ? rate : 0.0), flow.datagrams, flow.lost, flow.outoforder, \
+			flow.transit_last * 1e3, flow.jitter * 1e3, flow.tcp_cwnd, flow.tcp_rtt);
+	    }
+	}
+	fprintf(stdout, "[SUM] flows=%d bytes=%" PRIu64 " rate=%.2f Mbits/sec datagrams=%" PRId64 " lost=%" PRId64 " ooo=%" PRId64 "\n", \
+		flows, totbytes, (samples ? totrate : 0.0), totdgrams, totlost, totooo);
+	fflush(stdout);
+	samples++;
+	if (!alive) {
+	    fprintf(stdout, "Writer pid %" PRId64 " exited\n", hdr->pid);
+	    break;
+	}
+	if (count && (samples >= count))
+	    break;
+	usleep((useconds_t) (interval * 1e6));
+    }
+    free(prevbytes);
+    free(previd);
+    munmap(base, len);
+    return 0;
+}
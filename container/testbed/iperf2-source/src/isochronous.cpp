@@ -49,6 +49,7 @@
 #include "Timestamp.hpp"
 #include "isochronous.hpp"
 #include "delay.h"
+#include "iperf_probes.h"
 
 #define BILLION 1000000000
 
@@ -61,6 +62,10 @@ FrameCounter::FrameCounter (double value, const Timestamp& start) : frequency(va
     lastcounter = 0;
     slot_counter = 0;
     slip = 0;
+#ifndef WIN32
+    delay_pacer_init(&pacer);
+    wheel = NULL;
+#endif
 }
 FrameCounter::FrameCounter (double value) : frequency(value) {
 #ifdef WIN32
@@ -68,6 +73,9 @@ FrameCounter::FrameCounter (double value) : frequency(value) {
     my_timer = CreateWaitableTimer(NULL, TRUE, NULL);
     if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
 	WARN_errno(1, "SetThreadPriority");
+#else
+    delay_pacer_init(&pacer);
+    wheel = NULL;
 #endif
     startTime.setnow();
     nextslotTime = startTime;
@@ -83,6 +91,19 @@ FrameCounter::~FrameCounter () {
     /* Clean resources */
     if (my_timer)
 	CloseHandle(my_timer);
+#else
+    if (wheel)
+	timer_wheel_entry_destroy(&wheel_entry);
+#endif
+}
+
+// Hand the slot sleeps to a --tick-scheduler wheel, a NULL wheel keeps the per thread pacer
+void FrameCounter::set_timer_wheel (struct timer_wheel *inWheel) {
+#ifndef WIN32
+    if (inWheel && !wheel) {
+	timer_wheel_entry_init(&wheel_entry);
+	wheel = inWheel;
+    }
 #endif
 }
 
@@ -143,7 +164,11 @@ unsigned int FrameCounter::wait_tick (long *sched_err, bool sync_strict) {
     timespec txtime_ts;
     txtime_ts.tv_sec = nextslotTime.getSecs();
     txtime_ts.tv_nsec = nextslotTime.getUsecs() * 1000;
-    rc = clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &txtime_ts, NULL);
+    if (wheel) {
+	rc = timer_wheel_wait(wheel, &wheel_entry, &txtime_ts);
+    } else {
+	rc = delay_pacer_abstime(&pacer, &txtime_ts);
+    }
   #else
     long duration = nextslotTime.subUsec(now);
     rc = mySetWaitableTimer(10 * duration); // convert us to 100 ns
@@ -174,6 +199,7 @@ unsigned int FrameCounter::wait_tick (long *sched_err, bool sync_strict) {
 	}
     }
     WARN_errno((rc!=0), "wait_tick failed");
+    IPERF_PROBE4(wait_tick, this, slot_counter, (sched_err ? *sched_err : 0), slip);
   #ifdef HAVE_THREAD_DEBUG
     // thread_debug("Client tick occurred per %ld.%06ld", txtime_ts.tv_sec, txtime_ts.tv_nsec / 1000);
   #endif
@@ -216,6 +242,7 @@ unsigned int FrameCounter::wait_tick (long *sched_err, bool sync_strict) {
 	    WARN_errno((rc != 0), "nanosleep wait_tick");
 	}
     }
+    IPERF_PROBE4(wait_tick, this, slot_counter, (sched_err ? *sched_err : 0), slip);
     return(slot_counter);
 }
 #endif
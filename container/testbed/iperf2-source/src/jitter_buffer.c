@@ -0,0 +1,105 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * jitter_buffer.c
+ * Playout buffer late discards and the E-model for --jitter-buffer
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "jitter_buffer.h"
+
+struct JitterBuffer *jitterbuf_alloc (int depths, int64_t *depth) {
+    struct JitterBuffer *jb;
+    if ((depths < 1) || (depths > JITTERBUF_MAXDEPTHS))
+	return NULL;
+    if ((jb = (struct JitterBuffer *) calloc(1, sizeof(struct JitterBuffer))) != NULL) {
+	// insertion sort, there's a handful at most
+	for (int ix = 0; ix < depths; ix++) {
+	    int jx = jb->depths++;
+	    while ((jx > 0) && (jb->depth[jx - 1] > depth[ix])) {
+		jb->depth[jx] = jb->depth[jx - 1];
+		jx--;
+	    }
+	    jb->depth[jx] = depth[ix];
+	}
+    }
+    return jb;
+}
+
+void jitterbuf_free (struct JitterBuffer *jb) {
+    free(jb);
+}
+
+// Per datagram, transit in ns. A datagram faster than any before moves
+// the anchor, the buffer then holds it (and those after) that much longer
+void jitterbuf_packet (struct JitterBuffer *jb, int64_t transit) {
+    int64_t behind;
+    jb->cnt.arrived++;
+    if (!jb->anchored || (transit < jb->anchor)) {
+	jb->anchor = transit;
+	jb->anchored = true;
+	return;
+    }
+    behind = transit - jb->anchor;
+    for (int ix = 0; (ix < jb->depths) && (behind > jb->depth[ix]); ix++) {
+	jb->cnt.late[ix]++;
+    }
+}
+
+// Simplified E-model, R = R0 - Id - Ie,eff with the advantage factor zero
+double jitterbuf_rfactor (double delay_ms, double loss_pct) {
+    double id = 0.024 * delay_ms;
+    double ie_eff;
+    if (delay_ms > 177.3)
+	id += 0.11 * (delay_ms - 177.3);
+    if (loss_pct < 0.0)
+	loss_pct = 0.0;
+    // random loss, BurstR of one
+    ie_eff = JITTERBUF_IE + (95.0 - JITTERBUF_IE) * loss_pct / (loss_pct + JITTERBUF_BPL);
+    return (JITTERBUF_R0 - id - ie_eff);
+}
+
+double jitterbuf_mos (double rfactor) {
+    if (rfactor <= 0.0)
+	return 1.0;
+    if (rfactor >= 100.0)
+	return 4.5;
+    return (1.0 + 0.035 * rfactor + 7e-6 * rfactor * (rfactor - 60.0) * (100.0 - rfactor));
+}
@@ -0,0 +1,221 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * kernel_timestamps.c
+ * SO_TIMESTAMPING receive and transmit stamp collection
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "kernel_timestamps.h"
+
+struct KernelTsStats *kernelts_alloc (bool hardware) {
+    struct KernelTsStats *kts = (struct KernelTsStats *) calloc(1, sizeof(struct KernelTsStats));
+    if (kts == NULL) {
+	fprintf(stderr, "ERROR: kernel timestamps out of memory\n");
+	exit(1);
+    }
+    kts->hardware = hardware;
+    return kts;
+}
+
+int64_t kernelts_now (void) {
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec t1;
+    clock_gettime(CLOCK_REALTIME, &t1);
+    return ((int64_t) t1.tv_sec * 1000000000LL) + t1.tv_nsec;
+#else
+    struct timeval t1;
+    gettimeofday(&t1, NULL);
+    return ((int64_t) t1.tv_sec * 1000000000LL) + ((int64_t) t1.tv_usec * 1000);
+#endif
+}
+
+static inline void kernelts_delay (int64_t *sum, int64_t *max, int64_t delay) {
+    *sum += delay;
+    if (delay > *max)
+	*max = delay;
+}
+
+#if HAVE_SO_TIMESTAMPING
+// Hardware stamps need the device to be told to generate them. This
+// is best effort, drivers may refuse, e.g. when a ptp daemon owns
+// the configuration, in which case the existing setup is used.
+static void kernelts_enable_device (int sock, const char *ifname, bool tx) {
+    struct ifreq ifr;
+    struct hwtstamp_config hwcfg;
+    if (ifname == NULL) {
+	fprintf(stderr, "WARN: --so-timestamping=hw without a %%<dev> uses the device's current timestamp config\n");
+	return;
+    }
+    memset(&ifr, 0, sizeof(ifr));
+    memset(&hwcfg, 0, sizeof(hwcfg));
+    strncpy(ifr.ifr_name, ifname, (size_t) (IFNAMSIZ - 1));
+    hwcfg.tx_type = (tx ? HWTSTAMP_TX_ON : HWTSTAMP_TX_OFF);
+    hwcfg.rx_filter = (tx ? HWTSTAMP_FILTER_NONE : HWTSTAMP_FILTER_ALL);
+    ifr.ifr_data = (char *) &hwcfg;
+    if (ioctl(sock, SIOCSHWTSTAMP, &ifr) < 0) {
+	fprintf(stderr, "WARN: SIOCSHWTSTAMP on %s failed: %s\n", ifname, strerror(errno));
+    }
+}
+
+int kernelts_enable_rx (int sock, bool hardware, const char *ifname) {
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if (hardware) {
+	kernelts_enable_device(sock, ifname, false);
+	flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+    }
+    return setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+}
+
+// OPT_ID numbers each write from zero, starting now, and OPT_TSONLY
+// keeps the payload from being looped back with every stamp
+int kernelts_enable_tx (int sock, bool hardware, const char *ifname) {
+    int flags = SOF_TIMESTAMPING_TX_SCHED | SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE | \
+	SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+    if (hardware) {
+	kernelts_enable_device(sock, ifname, true);
+	flags |= SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+    }
+    return setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+}
+
+// Pair a stamp with its write. Writes older than the slot ring, or ids
+// never recorded, e.g. the final FIN packets, are counted unmatched.
+static void kernelts_tx_complete (struct KernelTsStats *kts, uint32_t id, uint32_t type, struct scm_timestamping *tss) {
+    uint32_t age = kts->tx_next - id - 1;
+    if (age >= KERNELTS_TXSLOTS) {
+	kts->cnt.tx_unmatched++;
+	return;
+    }
+    int slot = id & (KERNELTS_TXSLOTS - 1);
+    int64_t swts = ((int64_t) tss->ts[0].tv_sec * 1000000000LL) + tss->ts[0].tv_nsec;
+    int64_t hwts = ((int64_t) tss->ts[2].tv_sec * 1000000000LL) + tss->ts[2].tv_nsec;
+    switch (type) {
+    case SCM_TSTAMP_SCHED :
+	if (swts >= kts->tx_user[slot]) {
+	    kts->tx_sched[slot] = swts;
+	    kts->cnt.tx_sched++;
+	    kernelts_delay(&kts->cnt.user2stack, &kts->cnt.user2stack_max, swts - kts->tx_user[slot]);
+	} else {
+	    kts->cnt.tx_unmatched++;
+	}
+	break;
+    case SCM_TSTAMP_SND :
+	if (hwts) {
+	    kts->hwseen = true;
+	    swts = hwts;
+	}
+	// a hardware clock isn't necessarily the system clock so
+	// don't reject its stamps as being out of order
+	if (kts->tx_sched[slot] && (hwts || (swts >= kts->tx_sched[slot]))) {
+	    kts->cnt.tx_wire++;
+	    kernelts_delay(&kts->cnt.stack2wire, &kts->cnt.stack2wire_max, swts - kts->tx_sched[slot]);
+	    kts->tx_sched[slot] = 0;
+	} else {
+	    kts->cnt.tx_unmatched++;
+	}
+	break;
+    default :
+	break;
+    }
+}
+
+void kernelts_tx_drain (struct KernelTsStats *kts, int sock) {
+    char ctrl[CMSG_SPACE(sizeof(struct scm_timestamping)) + CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    while (1) {
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_control = ctrl;
+	msg.msg_controllen = sizeof(ctrl);
+	if (recvmsg(sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+	    break;
+	struct scm_timestamping *tss = NULL;
+	struct sock_extended_err *serr = NULL;
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+	    if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_TIMESTAMPING)) {
+		tss = (struct scm_timestamping *) CMSG_DATA(cmsg);
+	    } else if (((cmsg->cmsg_level == SOL_IP) && (cmsg->cmsg_type == IP_RECVERR)) || \
+		       ((cmsg->cmsg_level == SOL_IPV6) && (cmsg->cmsg_type == IPV6_RECVERR))) {
+		serr = (struct sock_extended_err *) CMSG_DATA(cmsg);
+	    }
+	}
+	if (tss && serr && (serr->ee_errno == ENOMSG) && (serr->ee_origin == SO_EE_ORIGIN_TIMESTAMPING)) {
+	    kernelts_tx_complete(kts, serr->ee_data, serr->ee_info, tss);
+	}
+    }
+}
+
+// Record a successful write, user_ns is the time carried in the payload
+void kernelts_tx_sent (struct KernelTsStats *kts, int sock, int64_t user_ns) {
+    int slot = kts->tx_next & (KERNELTS_TXSLOTS - 1);
+    kts->tx_user[slot] = user_ns;
+    kts->tx_sched[slot] = 0;
+    kts->tx_next++;
+    kts->cnt.tx++;
+    if ((kts->tx_next % KERNELTS_TXDRAIN) == 0)
+	kernelts_tx_drain(kts, sock);
+}
+#else
+int kernelts_enable_rx (int sock, bool hardware, const char *ifname) {
+    errno = ENOTSUP;
+    return -1;
+}
+int kernelts_enable_tx (int sock, bool hardware, const char *ifname) {
+    errno = ENOTSUP;
+    return -1;
+}
+void kernelts_tx_drain (struct KernelTsStats *kts, int sock) {
+}
+void kernelts_tx_sent (struct KernelTsStats *kts, int sock, int64_t user_ns) {
+    kts->cnt.tx++;
+}
+#endif
+
+// wire_ns is the kernel receive stamp, the wire->user delay runs to now
+void kernelts_rx (struct KernelTsStats *kts, int64_t wire_ns, bool hardware) {
+    int64_t delay = kernelts_now() - wire_ns;
+    if (hardware)
+	kts->hwseen = true;
+    if (delay >= 0) {
+	kts->cnt.rx++;
+	kernelts_delay(&kts->cnt.wire2user, &kts->cnt.wire2user_max, delay);
+    }
+}
@@ -0,0 +1,339 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * link_emul.c
+ * Loss, token bucket and timing wheel delay line for --link-emul
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "util.h"
+#include "link_emul.h"
+
+#define LINKEMUL_SLOTS (1 << LINKEMUL_WHEELBITS)
+#define LINKEMUL_MASK (LINKEMUL_SLOTS - 1)
+
+// Time with an optional ns, us, ms or s suffix, milliseconds by default
+static int linkemul_time (const char *str, int64_t *ns) {
+    char *end;
+    double value = strtod(str, &end);
+    double scale = 1e6;
+    if (end == str)
+	return -1;
+    if (strcmp(end, "ns") == 0) {
+	scale = 1;
+    } else if (strcmp(end, "us") == 0) {
+	scale = 1e3;
+    } else if (strcmp(end, "s") == 0) {
+	scale = 1e9;
+    } else if ((*end != '\0') && (strcmp(end, "ms") != 0)) {
+	return -1;
+    }
+    if (value < 0)
+	return -1;
+    *ns = (int64_t) (value * scale);
+    return 0;
+}
+
+// Percentages as netem takes them, the % sign is optional
+static int linkemul_percent (const char *str, double *probability) {
+    char *end;
+    double value = strtod(str, &end);
+    if ((end == str) || ((*end != '\0') && (strcmp(end, "%") != 0)) || (value < 0) || (value > 100))
+	return -1;
+    *probability = value / 100.0;
+    return 0;
+}
+
+// ge=p[:r[:1-h[:1-k]]] with netem's defaults of r = 1 - p, 1-h = 100% and 1-k = 0%
+static int linkemul_gemodel (char *str, struct LinkEmulParams *params) {
+    double *fields[4] = {&params->ge_p, &params->ge_r, &params->ge_lossbad, &params->ge_lossgood};
+    char *saveptr = NULL;
+    char *field;
+    int ix = 0;
+    params->ge_lossbad = 1.0;
+    params->ge_lossgood = 0.0;
+    for (field = strtok_r(str, ":", &saveptr); field; field = strtok_r(NULL, ":", &saveptr)) {
+	if ((ix >= 4) || (linkemul_percent(field, fields[ix]) != 0))
+	    return -1;
+	ix++;
+    }
+    if (ix == 0)
+	return -1;
+    if (ix == 1)
+	params->ge_r = 1.0 - params->ge_p;
+    params->gemodel = true;
+    return 0;
+}
+
+// Parse delay=,jitter=,rate=,burst=,limit=,loss= and ge= key value pairs
+int linkemul_parse (const char *spec, struct LinkEmulParams *params) {
+    char *copy = strdup(spec);
+    char *saveptr = NULL;
+    char *token;
+    int rc = 0;
+    if (copy == NULL)
+	return -1;
+    memset(params, 0, sizeof(struct LinkEmulParams));
+    params->burst = LINKEMUL_DEFBURST;
+    params->limit = LINKEMUL_DEFLIMIT;
+    for (token = strtok_r(copy, ",", &saveptr); token && (rc == 0); token = strtok_r(NULL, ",", &saveptr)) {
+	char *value = strchr(token, '=');
+	if (value == NULL) {
+	    rc = -1;
+	    break;
+	}
+	*value++ = '\0';
+	if (strcmp(token, "delay") == 0) {
+	    rc = linkemul_time(value, &params->delay);
+	} else if (strcmp(token, "jitter") == 0) {
+	    rc = linkemul_time(value, &params->jitter);
+	} else if (strcmp(token, "rate") == 0) {
+	    params->rate = bitorbyte_atof(value);
+	    rc = ((params->rate < 0) ? -1 : 0);
+	} else if (strcmp(token, "burst") == 0) {
+	    params->burst = byte_atoi(value);
+	    rc = ((params->burst <= 0) ? -1 : 0);
+	} else if (strcmp(token, "limit") == 0) {
+	    params->limit = atoi(value);
+	    rc = (((params->limit <= 0) || (params->limit > LINKEMUL_MAXLIMIT)) ? -1 : 0);
+	} else if (strcmp(token, "loss") == 0) {
+	    rc = linkemul_percent(value, &params->loss);
+	} else if (strcmp(token, "ge") == 0) {
+	    rc = linkemul_gemodel(value, params);
+	} else {
+	    rc = -1;
+	}
+    }
+    free(copy);
+    if (params->jitter > params->delay)
+	rc = -1;
+    return rc;
+}
+
+struct LinkEmul *linkemul_alloc (struct LinkEmulParams *params) {
+    struct LinkEmul *le = (struct LinkEmul *) calloc(1, sizeof(struct LinkEmul));
+    int32_t ix;
+    if (le) {
+	le->head = (int32_t *) malloc(LINKEMUL_SLOTS * sizeof(int32_t));
+	le->tail = (int32_t *) malloc(LINKEMUL_SLOTS * sizeof(int32_t));
+	// untouched pool pages aren't resident, so a large limit only costs what's held
+	le->pool = (struct LinkEmulEntry *) calloc(params->limit, sizeof(struct LinkEmulEntry));
+    }
+    if (!le || !le->head || !le->tail || !le->pool) {
+	fprintf(stderr, "ERROR: link emulation out of memory\n");
+	exit(1);
+    }
+    le->params = *params;
+    for (ix = 0; ix < LINKEMUL_SLOTS; ix++) {
+	le->head[ix] = -1;
+	le->tail[ix] = -1;
+    }
+    for (ix = 0; ix < params->limit; ix++) {
+	le->pool[ix].next = ((ix + 1) < params->limit) ? (ix + 1) : -1;
+    }
+    le->freelist = 0;
+    le->cursor = -1;
+    le->rng = 0x9E3779B97F4A7C15ULL ^ (uint64_t) (uintptr_t) le;
+    le->tb_tokens = (double) params->burst;
+    return le;
+}
+
+void linkemul_free (struct LinkEmul *le) {
+    if (le) {
+	free(le->head);
+	free(le->tail);
+	free(le->pool);
+	free(le);
+    }
+}
+
+// xorshift64*, uniform in [0, 1)
+static inline double linkemul_random (struct LinkEmul *le) {
+    le->rng ^= le->rng >> 12;
+    le->rng ^= le->rng << 25;
+    le->rng ^= le->rng >> 27;
+    return (double) ((le->rng * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static inline bool linkemul_lost (struct LinkEmul *le) {
+    if (le->params.gemodel) {
+	// state transition first, then the loss draw for the new state
+	if (le->ge_bad) {
+	    if (linkemul_random(le) < le->params.ge_r)
+		le->ge_bad = false;
+	} else if (linkemul_random(le) < le->params.ge_p) {
+	    le->ge_bad = true;
+	}
+	if (linkemul_random(le) < (le->ge_bad ? le->params.ge_lossbad : le->params.ge_lossgood)) {
+	    if (le->ge_bad) {
+		le->cnt.lost_burst++;
+	    } else {
+		le->cnt.lost_random++;
+	    }
+	    return true;
+	}
+    }
+    if ((le->params.loss > 0) && (linkemul_random(le) < le->params.loss)) {
+	le->cnt.lost_random++;
+	return true;
+    }
+    return false;
+}
+
+// Token bucket departure time, tb_time runs ahead of now while backlogged
+static inline int64_t linkemul_shape (struct LinkEmul *le, int64_t len, int64_t now) {
+    double rate = le->params.rate / 8e9; // bytes per ns
+    int64_t base = (now > le->tb_time) ? now : le->tb_time;
+    int64_t depart = base;
+    le->tb_tokens += (base - le->tb_time) * rate;
+    if (le->tb_tokens > le->params.burst)
+	le->tb_tokens = (double) le->params.burst;
+    if (le->tb_tokens >= len) {
+	le->tb_tokens -= len;
+    } else {
+	depart += (int64_t) ((len - le->tb_tokens) / rate);
+	le->tb_tokens = 0;
+    }
+    le->tb_time = depart;
+    return depart;
+}
+
+// Returns false when the packet was lost or dropped, true when it's held
+bool linkemul_enqueue (struct LinkEmul *le, struct ReportStruct *packet, int64_t now) {
+    int64_t release = now;
+    le->cnt.in++;
+    if (linkemul_lost(le))
+	return false;
+    if (le->freelist < 0) {
+	le->cnt.queue_drops++;
+	return false;
+    }
+    if (le->params.rate > 0)
+	release = linkemul_shape(le, packet->packetLen, now);
+    release += le->params.delay;
+    if (le->params.jitter > 0)
+	release += (int64_t) ((2.0 * linkemul_random(le) - 1.0) * le->params.jitter);
+    if (release < now)
+	release = now;
+    int64_t tick = release >> LINKEMUL_TICKSHIFT;
+    if (le->cursor < 0) {
+	le->cursor = now >> LINKEMUL_TICKSHIFT;
+    }
+    // already passed over, so hang it on the slot being released
+    if (tick < le->cursor)
+	tick = le->cursor;
+    int32_t ix = le->freelist;
+    struct LinkEmulEntry *entry = &le->pool[ix];
+    le->freelist = entry->next;
+    entry->release = release;
+    entry->next = -1;
+    entry->packet = *packet;
+    entry->packet.packetTimeNs = now;
+    int slot = (int) (tick & LINKEMUL_MASK);
+    if (le->tail[slot] < 0) {
+	le->head[slot] = ix;
+    } else {
+	le->pool[le->tail[slot]].next = ix;
+    }
+    le->tail[slot] = ix;
+    if (++le->held > le->cnt.held_max)
+	le->cnt.held_max = le->held;
+    return true;
+}
+
+// Returns the next packet due by now, with its packet time set to the
+// emulated delivery time, or NULL. The pointer is valid until the next call.
+struct ReportStruct *linkemul_dequeue (struct LinkEmul *le, int64_t now) {
+    int64_t nowtick = now >> LINKEMUL_TICKSHIFT;
+    if (le->held == 0) {
+	le->cursor = nowtick;
+	return NULL;
+    }
+    // after an idle revolution every slot still needs one visit, but only one
+    if ((nowtick - le->cursor) >= LINKEMUL_SLOTS)
+	le->cursor = nowtick - LINKEMUL_SLOTS + 1;
+    while (le->cursor <= nowtick) {
+	int slot = (int) (le->cursor & LINKEMUL_MASK);
+	int32_t prev = -1;
+	int32_t ix;
+	// entries for later revolutions share the slot and are skipped
+	for (ix = le->head[slot]; ix >= 0; prev = ix, ix = le->pool[ix].next) {
+	    struct LinkEmulEntry *entry = &le->pool[ix];
+	    if (entry->release <= now) {
+		if (prev < 0) {
+		    le->head[slot] = entry->next;
+		} else {
+		    le->pool[prev].next = entry->next;
+		}
+		if (le->tail[slot] == ix)
+		    le->tail[slot] = prev;
+		le->out = entry->packet;
+		entry->next = le->freelist;
+		le->freelist = ix;
+		le->held--;
+		int64_t added = entry->release - le->out.packetTimeNs;
+		le->cnt.out++;
+		le->cnt.added += added;
+		if (added > le->cnt.added_max)
+		    le->cnt.added_max = added;
+		le->out.packetTimeNs = entry->release;
+		le->out.packetTime.tv_sec = (long) (entry->release / 1000000000LL);
+		le->out.packetTime.tv_usec = (long) ((entry->release % 1000000000LL) / 1000);
+		return &le->out;
+	    }
+	}
+	if (le->cursor == nowtick)
+	    break;
+	le->cursor++;
+    }
+    return NULL;
+}
+
+// Release the held packets in delivery time order without waiting for
+// them, e.g. when the flow ends. Returns NULL once the line is empty.
+struct ReportStruct *linkemul_flush (struct LinkEmul *le) {
+    struct ReportStruct *packet = NULL;
+    if (le->held > 0) {
+	int64_t tick = le->cursor;
+	while ((packet = linkemul_dequeue(le, (tick << LINKEMUL_TICKSHIFT) | ((1 << LINKEMUL_TICKSHIFT) - 1))) == NULL)
+	    tick++;
+    }
+    return packet;
+}
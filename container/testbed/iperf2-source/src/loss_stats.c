@@ -0,0 +1,179 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * loss_stats.c
+ * Burst, gap, Gilbert-Elliott and outage accounting for --loss-stats
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "loss_stats.h"
+
+struct LossStats *lossstats_alloc (int outage_factor) {
+    struct LossStats *ls = (struct LossStats *) calloc(1, sizeof(struct LossStats));
+    if (ls) {
+	ls->outage_factor = ((outage_factor > 0) ? outage_factor : LOSSSTATS_DEFOUTAGE);
+    }
+    return ls;
+}
+
+void lossstats_free (struct LossStats *ls) {
+    free(ls);
+}
+
+// Bin 0 is a run of one, bin n is 2^(n-1)+1 through 2^n, the last is open
+static inline void lossstats_bin (intmax_t *bins, intmax_t len) {
+    int ix = 0;
+    intmax_t span = len - 1;
+    while ((span > 0) && (ix < (LOSSSTATS_BINS - 1))) {
+	span >>= 1;
+	ix++;
+    }
+    bins[ix]++;
+}
+
+// The non-empty bins as lo-hi:count, less prev when given
+int lossstats_bins_snprintf (char *buf, size_t len, intmax_t *bins, intmax_t *prev) {
+    int used = 0;
+    buf[0] = '\0';
+    for (int ix = 0; ix < LOSSSTATS_BINS; ix++) {
+	intmax_t cnt = bins[ix] - (prev ? prev[ix] : 0);
+	intmax_t lo = ((ix == 0) ? 1 : ((((intmax_t) 1) << (ix - 1)) + 1));
+	intmax_t hi = ((intmax_t) 1) << ix;
+	int n;
+	if (cnt == 0)
+	    continue;
+	if (ix <= 1) {
+	    n = snprintf(buf + used, len - used, "%s%" PRIdMAX ":%" PRIdMAX, (used ? " " : ""), lo, cnt);
+	} else if (ix == (LOSSSTATS_BINS - 1)) {
+	    n = snprintf(buf + used, len - used, "%s%" PRIdMAX "+:%" PRIdMAX, (used ? " " : ""), lo, cnt);
+	} else {
+	    n = snprintf(buf + used, len - used, "%s%" PRIdMAX "-%" PRIdMAX ":%" PRIdMAX, (used ? " " : ""), lo, hi, cnt);
+	}
+	if ((n < 0) || ((size_t) n >= (len - used)))
+	    break;
+	used += n;
+    }
+    return used;
+}
+
+static inline void lossstats_max (struct LossStats *ls, intmax_t burst, intmax_t gap, int64_t outage) {
+    if (burst > ls->imax.burst)
+	ls->imax.burst = burst;
+    if (gap > ls->imax.gap)
+	ls->imax.gap = gap;
+    if (outage > ls->imax.outage)
+	ls->imax.outage = outage;
+    if (burst > ls->tmax.burst)
+	ls->tmax.burst = burst;
+    if (gap > ls->tmax.gap)
+	ls->tmax.gap = gap;
+    if (outage > ls->tmax.outage)
+	ls->tmax.outage = outage;
+}
+
+// Per datagram, true when it ended an outage, which is then in ls->outage
+bool lossstats_packet (struct LossStats *ls, intmax_t seqno, int64_t arrival) {
+    struct LossStatsCounters *cnt = &ls->cnt;
+    intmax_t lost;
+    bool fired = false;
+    if (seqno <= ls->top)
+	return false;
+    lost = seqno - ls->top - 1;
+    if (ls->last > 0) {
+	int64_t delta = arrival - ls->last;
+	double sample = (double) delta / (seqno - ls->top);
+	if ((ls->ipg_samples >= LOSSSTATS_IPGSAMPLES) && (ls->ipg > 0) && (delta > (ls->outage_factor * ls->ipg))) {
+	    ls->outage.start = ls->last;
+	    ls->outage.end = arrival;
+	    ls->outage.lost = lost;
+	    cnt->outages++;
+	    cnt->outage_time += delta;
+	    lossstats_max(ls, 0, 0, delta);
+	    fired = true;
+	} else if (ls->ipg_samples < LOSSSTATS_IPGSAMPLES) {
+	    ls->ipg_samples++;
+	    ls->ipg += (sample - ls->ipg) / ls->ipg_samples;
+	} else {
+	    ls->ipg += (sample - ls->ipg) / 16;
+	}
+    }
+    ls->top = seqno;
+    ls->last = arrival;
+    if (lost > 0) {
+	if (ls->run > 0) {
+	    cnt->gaps++;
+	    cnt->gap_rcvd += ls->run;
+	    lossstats_max(ls, 0, ls->run, 0);
+	    lossstats_bin(cnt->gap_bins, ls->run);
+	}
+	cnt->bursts++;
+	cnt->burst_lost += lost;
+	lossstats_max(ls, lost, 0, 0);
+	lossstats_bin(cnt->burst_bins, lost);
+	// RFC 3611, losses fewer than gmin received apart are one burst
+	if (ls->burst) {
+	    ls->burst_len += ls->run + lost;
+	    ls->burst_lost += lost;
+	} else {
+	    ls->burst = true;
+	    ls->burst_len = lost;
+	    ls->burst_lost = lost;
+	}
+	ls->run = 0;
+    }
+    ls->run++;
+    cnt->rcvd++;
+    if (!ls->burst) {
+	cnt->good++;
+    } else if (ls->run >= LOSSSTATS_GMIN) {
+	// gmin received closes it, a lone loss is the good state's
+	if (ls->burst_lost > 1) {
+	    cnt->badcnt++;
+	    cnt->bad += ls->burst_len;
+	    cnt->bad_lost += ls->burst_lost;
+	} else {
+	    cnt->good += ls->burst_len;
+	    cnt->good_lost += ls->burst_lost;
+	}
+	cnt->good += ls->run;
+	ls->burst = false;
+    }
+    return fired;
+}
@@ -71,6 +71,10 @@
 #include "util.h"
 #include "Reporter.h"
 #include "payloads.h"
+#include "iperf_metrics.h"
+#include "iperf_selftest.h"
+#include "timer_wheel.h"
+#include "traffic_profile.h"
 
 #ifdef WIN32
 #include "service.h"
@@ -185,6 +189,29 @@ int main(int argc, char **argv) {
     Settings_ParseEnvironment(ext_gSettings);
     // read settings from command-line parameters
     Settings_ParseCommandLine(argc, argv, ext_gSettings);
+    // A profile's flows replace the command line's one, the first becomes the global settings
+    if (ext_gSettings->mProfileStr) {
+	struct thread_Settings *flows = traffic_profile_load(argc, argv, ext_gSettings);
+	Settings_Destroy(ext_gSettings);
+	ext_gSettings = flows;
+    }
+
+    // The selftest forks iperf processes so it has to run before any threads start
+    if (isSelfTest(ext_gSettings)) {
+	int rc = iperf_selftest(ext_gSettings, argv[0]);
+	if ((ext_gSettings->mThreadMode != kMode_Client) && (ext_gSettings->mThreadMode != kMode_Listener))
+	    return rc;
+    }
+
+    // Calibrate before any threads so they all share the TSC rate
+    if (isTscClock(ext_gSettings)) {
+	if (fastclock_init() == 0) {
+	    fprintf(stdout, report_tsc_clock, fastclock_ghz(), (FASTCLOCK_REANCHOR_NS / 1000000));
+	} else {
+	    fprintf(stderr, "%s", warn_tsc_clock);
+	    unsetTscClock(ext_gSettings);
+	}
+    }
 
     // Check for either having specified client or server
     if ((ext_gSettings->mThreadMode != kMode_Client) && (ext_gSettings->mThreadMode != kMode_Listener)) {
@@ -223,12 +250,14 @@ int main(int argc, char **argv) {
 
     }
 
-    int mbuflen = (ext_gSettings->mBufLen > MINMBUFALLOCSIZE) ? ext_gSettings->mBufLen : MINMBUFALLOCSIZE;
+    for (struct thread_Settings *flow = ext_gSettings; flow != NULL; flow = flow->mProfileNext) {
+	int mbuflen = (flow->mBufLen > MINMBUFALLOCSIZE) ? flow->mBufLen : MINMBUFALLOCSIZE;
 #if (((HAVE_TUNTAP_TUN) || (HAVE_TUNTAP_TAP)) && (AF_PACKET))
-    mbuflen += TAPBYTESSLOP;
+	mbuflen += TAPBYTESSLOP;
 #endif
-    ext_gSettings->mBuf = new char[mbuflen];
-    memset(ext_gSettings->mBuf, 0, mbuflen);
+	flow->mBuf = new char[mbuflen];
+	memset(flow->mBuf, 0, mbuflen);
+    }
 
 
     unsetReport(ext_gSettings);
@@ -239,8 +268,11 @@ int main(int argc, char **argv) {
 	    return 0;
 	}
         // initialize client(s)
-	transmits_start.count = ext_gSettings->mThreads;
-	ext_gSettings->connects_done = &transmits_start;
+	// the threads of every profile flow meet at the one connect barrier
+	for (struct thread_Settings *flow = ext_gSettings; flow != NULL; flow = flow->mProfileNext) {
+	    transmits_start.count += flow->mThreads;
+	    flow->connects_done = &transmits_start;
+	}
         client_init(ext_gSettings);
 	ReporterThreadMode = kMode_ReporterClient;
 	break;
@@ -277,6 +309,17 @@ int main(int argc, char **argv) {
 	fprintf(stderr, "unknown mode");
 	break;
     }
+    // The stats segment has to be mapped before any reports (and their slots) exist
+    if (isStatsShm(ext_gSettings) && (iperf_metrics_shm_open(ext_gSettings->mStatsShmStr) < 0)) {
+	unsetStatsShm(ext_gSettings);
+    }
+    // The metrics listener is started after any daemon() fork
+    if (isMetrics(ext_gSettings) && (iperf_metrics_start(ext_gSettings->mMetricsStr) < 0)) {
+	unsetMetrics(ext_gSettings);
+    }
+    if (isTickScheduler(ext_gSettings) && (timer_wheel_start(ext_gSettings->mTickSchedThreads) < 0)) {
+	unsetTickScheduler(ext_gSettings);
+    }
 #ifdef HAVE_THREAD
     // Last step is to initialize the reporter then start all threads
     {
@@ -48,6 +48,9 @@
 #include "packet_ring.h"
 #include "Condition.h"
 #include "Thread.h"
+#include "iperf_probes.h"
+#include "util.h"
+#include "link_emul.h"
 
 #ifdef HAVE_THREAD_DEBUG
 #include "Mutex.h"
@@ -65,8 +68,8 @@ struct PacketRing * packetring_init (int count, struct Condition *awake_consumer
     struct PacketRing *pr = NULL;
     if ((pr = (struct PacketRing *) calloc(1, sizeof(struct PacketRing)))) {
         pr->bytes = sizeof(struct PacketRing);
-	pr->data = (struct ReportStruct *) calloc(count, sizeof(struct ReportStruct));
-        pr->bytes += count * sizeof(struct ReportStruct);
+	pr->data = (struct ReportRecord *) calloc(count, sizeof(struct ReportRecord));
+        pr->bytes += count * sizeof(struct ReportRecord);
     }
     if (!pr || !pr->data) {
         fprintf(stderr, "ERROR: no memory for packet ring of size %d count, try to reduce with option --NUM_REPORT_STRUCTS\n", count);
@@ -95,9 +98,221 @@ struct PacketRing * packetring_init (int count, struct Condition *awake_consumer
     return (pr);
 }
 
+//
+// Allocate the side records for rings whose traffic carries isoch, burst,
+// tcpinfo, bounceback, l2 or logical flow fields. This must be done
+// before traffic starts, rings without side records only carry the hot
+// fields.
+//
+void packetring_side_init (struct PacketRing *pr) {
+    assert(pr != NULL);
+    if (pr->side)
+	return;
+    if (!(pr->side = (struct ReportSide *) calloc(pr->maxcount, sizeof(struct ReportSide)))) {
+	fprintf(stderr, "ERROR: no memory for packet ring side records of size %d count, try to reduce with option --NUM_REPORT_STRUCTS\n", pr->maxcount);
+	exit(1);
+    }
+    pr->bytes += pr->maxcount * sizeof(struct ReportSide);
+}
+
+// Use the nanosecond time only while it's still the same microsecond as
+// the timeval, i.e. a producer that only updated the timeval since it
+// last took the nanosecond time would otherwise report a stale time,
+// so then fall back to the timeval
+static inline int64_t report_nsecs (struct timeval tv, int64_t nsecs) {
+    int64_t tvns = TimeNsecs(tv);
+    return (((nsecs - tvns) >= 0) && ((nsecs - tvns) < 1000)) ? nsecs : tvns;
+}
+
+static inline void report_timeval (struct timeval *tv, int64_t nsecs) {
+    int64_t secs = nsecs / 1000000000LL;
+    tv->tv_sec = (time_t) secs;
+    // the remainder fits 32 bits which keeps this second divide cheap
+    tv->tv_usec = (long) (((uint32_t) (nsecs - (secs * 1000000000LL))) / 1000U);
+}
+
+static inline uint16_t report_side_flags (struct ReportStruct *metapacket) {
+    uint16_t flags = 0;
+    if ((metapacket->frameID | metapacket->prevframeID | metapacket->burstsize | metapacket->burstperiod \
+	 | metapacket->remaining) || metapacket->sched_err || !TimeZero(metapacket->isochStartTime))
+	flags |= REPORT_SIDE_FRAME;
+    if (metapacket->write_time || metapacket->writeLen || metapacket->recvLen)
+	flags |= REPORT_SIDE_WRITE;
+    if (!TimeZero(metapacket->sentTimeRX) || !TimeZero(metapacket->sentTimeTX))
+	flags |= REPORT_SIDE_BB;
+    if (metapacket->l2errors || metapacket->l2len || metapacket->expected_l2len)
+	flags |= REPORT_SIDE_L2;
+    if (metapacket->tcpstats.isValid)
+	flags |= REPORT_SIDE_TCP;
+    if (metapacket->flowseqno)
+	flags |= REPORT_SIDE_FLOW;
+#if defined(HAVE_DECL_SO_MAX_PACING_RATE)
+    if (metapacket->FQPacingRate)
+	flags |= REPORT_SIDE_TCP;
+#endif
+    return flags;
+}
+
+static inline void report_pack (struct PacketRing *pr, int index, struct ReportStruct *metapacket) {
+    struct ReportRecord *record = pr->data + index;
+    uint16_t flags = (pr->side ? report_side_flags(metapacket) : 0);
+    if (metapacket->emptyreport)
+	flags |= REPORT_EMPTY;
+    if (metapacket->transit_ready)
+	flags |= REPORT_TRANSIT_READY;
+    if (metapacket->scheduled)
+	flags |= REPORT_SCHEDULED;
+    record->packetID = metapacket->packetID;
+    record->packetLen = metapacket->packetLen;
+    record->packetTime = report_nsecs(metapacket->packetTime, metapacket->packetTimeNs);
+    record->sentTime = report_nsecs(metapacket->sentTime, metapacket->sentTimeNs);
+    record->prevPacketTime = TimeNsecs(metapacket->prevPacketTime);
+    record->prevSentTime = TimeNsecs(metapacket->prevSentTime);
+    record->writecnt = metapacket->writecnt;
+    record->flags = flags;
+    record->err_readwrite = (uint8_t) metapacket->err_readwrite;
+    record->tos = metapacket->tos;
+    if (!(flags & REPORT_SIDE_MASK))
+	return;
+    struct ReportSide *side = pr->side + index;
+    if (flags & REPORT_SIDE_FRAME) {
+	side->isochStartTime = metapacket->isochStartTime;
+	side->prevframeID = metapacket->prevframeID;
+	side->frameID = metapacket->frameID;
+	side->burstsize = metapacket->burstsize;
+	side->burstperiod = metapacket->burstperiod;
+	side->remaining = metapacket->remaining;
+	side->sched_err = metapacket->sched_err;
+    }
+    if (flags & REPORT_SIDE_WRITE) {
+	side->write_time = metapacket->write_time;
+	side->writeLen = metapacket->writeLen;
+	side->recvLen = metapacket->recvLen;
+    }
+    if (flags & REPORT_SIDE_BB) {
+	side->sentTimeRX = metapacket->sentTimeRX;
+	side->sentTimeTX = metapacket->sentTimeTX;
+    }
+    if (flags & REPORT_SIDE_L2) {
+	side->l2errors = metapacket->l2errors;
+	side->l2len = metapacket->l2len;
+	side->expected_l2len = metapacket->expected_l2len;
+    }
+    if (flags & REPORT_SIDE_TCP) {
+	side->tcpstats = metapacket->tcpstats;
+#if defined(HAVE_DECL_SO_MAX_PACING_RATE)
+	side->FQPacingRate = metapacket->FQPacingRate;
+#endif
+    }
+    if (flags & REPORT_SIDE_FLOW) {
+	side->flowid = metapacket->flowid;
+	side->flowseqno = metapacket->flowseqno;
+    }
+}
+
+// Unpack into the ring's ReportStruct, side fields not carried by this
+// record are zeroed but only if the previous unpack had set them
+static inline struct ReportStruct *report_unpack (struct PacketRing *pr, int index) {
+    struct ReportRecord *record = pr->data + index;
+    struct ReportStruct *packet = &pr->unpacked;
+    uint16_t flags = record->flags;
+    packet->packetID = record->packetID;
+    packet->packetLen = record->packetLen;
+    report_timeval(&packet->packetTime, record->packetTime);
+    report_timeval(&packet->sentTime, record->sentTime);
+    report_timeval(&packet->prevPacketTime, record->prevPacketTime);
+    report_timeval(&packet->prevSentTime, record->prevSentTime);
+    packet->packetTimeNs = record->packetTime;
+    packet->sentTimeNs = record->sentTime;
+    packet->writecnt = record->writecnt;
+    packet->err_readwrite = (enum ReadWriteExtReturnVals) record->err_readwrite;
+    packet->tos = record->tos;
+    packet->emptyreport = ((flags & REPORT_EMPTY) != 0);
+    packet->transit_ready = ((flags & REPORT_TRANSIT_READY) != 0);
+    packet->scheduled = ((flags & REPORT_SCHEDULED) != 0);
+    if (!((flags | pr->unpacked_side) & REPORT_SIDE_MASK))
+	return packet;
+    struct ReportSide *side = ((flags & REPORT_SIDE_MASK) ? (pr->side + index) : NULL);
+    if (flags & REPORT_SIDE_FRAME) {
+	packet->isochStartTime = side->isochStartTime;
+	packet->prevframeID = side->prevframeID;
+	packet->frameID = side->frameID;
+	packet->burstsize = side->burstsize;
+	packet->burstperiod = side->burstperiod;
+	packet->remaining = side->remaining;
+	packet->sched_err = side->sched_err;
+    } else if (pr->unpacked_side & REPORT_SIDE_FRAME) {
+	packet->isochStartTime.tv_sec = 0;
+	packet->isochStartTime.tv_usec = 0;
+	packet->prevframeID = 0;
+	packet->frameID = 0;
+	packet->burstsize = 0;
+	packet->burstperiod = 0;
+	packet->remaining = 0;
+	packet->sched_err = 0;
+    }
+    if (flags & REPORT_SIDE_WRITE) {
+	packet->write_time = side->write_time;
+	packet->writeLen = side->writeLen;
+	packet->recvLen = side->recvLen;
+    } else if (pr->unpacked_side & REPORT_SIDE_WRITE) {
+	packet->write_time = 0;
+	packet->writeLen = 0;
+	packet->recvLen = 0;
+    }
+    if (flags & REPORT_SIDE_BB) {
+	packet->sentTimeRX = side->sentTimeRX;
+	packet->sentTimeTX = side->sentTimeTX;
+    } else if (pr->unpacked_side & REPORT_SIDE_BB) {
+	memset(&packet->sentTimeRX, 0, sizeof(struct timeval));
+	memset(&packet->sentTimeTX, 0, sizeof(struct timeval));
+    }
+    if (flags & REPORT_SIDE_L2) {
+	packet->l2errors = side->l2errors;
+	packet->l2len = side->l2len;
+	packet->expected_l2len = side->expected_l2len;
+    } else if (pr->unpacked_side & REPORT_SIDE_L2) {
+	packet->l2errors = 0;
+	packet->l2len = 0;
+	packet->expected_l2len = 0;
+    }
+    if (flags & REPORT_SIDE_TCP) {
+	packet->tcpstats = side->tcpstats;
+#if defined(HAVE_DECL_SO_MAX_PACING_RATE)
+	packet->FQPacingRate = side->FQPacingRate;
+#endif
+    } else if (pr->unpacked_side & REPORT_SIDE_TCP) {
+	memset(&packet->tcpstats, 0, sizeof(struct iperf_tcpstats));
+#if defined(HAVE_DECL_SO_MAX_PACING_RATE)
+	packet->FQPacingRate = 0;
+#endif
+    }
+    if (flags & REPORT_SIDE_FLOW) {
+	packet->flowid = side->flowid;
+	packet->flowseqno = side->flowseqno;
+    } else if (pr->unpacked_side & REPORT_SIDE_FLOW) {
+	packet->flowid = 0;
+	packet->flowseqno = 0;
+    }
+    pr->unpacked_side = (flags & REPORT_SIDE_MASK);
+    return packet;
+}
+
 inline void packetring_enqueue (struct PacketRing *pr, struct ReportStruct *metapacket) {
+    double blocked_start = 0;
+    if (pr->hotpath) {
+	int occupancy = pr->producer - pr->consumer;
+	if (occupancy < 0)
+	    occupancy += pr->maxcount;
+	if (occupancy > pr->hotpath->ring_highwater)
+	    pr->hotpath->ring_highwater = occupancy;
+    }
     while (((pr->producer == pr->maxcount) && (pr->consumer == 0)) || \
 	   ((pr->producer + 1) == pr->consumer)) {
+	if (pr->hotpath && (blocked_start == 0)) {
+	    blocked_start = hotpath_now();
+	    pr->hotpath->enqueue_waits++;
+	}
 	// Signal the consumer thread to process a full queue
 	if (pr->mutex_enable) {
 	    assert(pr->awake_consumer != NULL);
@@ -106,6 +321,7 @@ inline void packetring_enqueue (struct PacketRing *pr, struct ReportStruct *meta
 	    assert(pr->awake_producer != NULL);
 	    Condition_Lock((*(pr->awake_producer)));
 	    pr->awaitcounter++;
+	    IPERF_PROBE2(ring_stall, pr, pr->awaitcounter);
 #ifdef HAVE_THREAD_DEBUG_PERF
 	    {
 		struct timeval now;
@@ -121,6 +337,8 @@ inline void packetring_enqueue (struct PacketRing *pr, struct ReportStruct *meta
 	    Condition_Unlock((*(pr->awake_producer)));
 	}
     }
+    if (blocked_start > 0)
+	pr->hotpath->enqueue_blocked += hotpath_now() - blocked_start;
     int writeindex;
     if ((pr->producer + 1) == pr->maxcount)
 	writeindex = 0;
@@ -128,8 +346,10 @@ inline void packetring_enqueue (struct PacketRing *pr, struct ReportStruct *meta
 	writeindex = (pr->producer  + 1);
 
     /* Next two lines must be maintained as is */
-    memcpy((pr->data + writeindex), metapacket, sizeof(struct ReportStruct));
+    report_pack(pr, writeindex, metapacket);
     pr->producer = writeindex;
+    IPERF_PROBE4(ring_enqueue, pr, metapacket->packetID, metapacket->packetLen, \
+		 ((pr->producer >= pr->consumer) ? (pr->producer - pr->consumer) : (pr->producer - pr->consumer + pr->maxcount)));
 }
 
 inline struct ReportStruct *packetring_dequeue (struct PacketRing *pr) {
@@ -143,7 +363,8 @@ inline struct ReportStruct *packetring_dequeue (struct PacketRing *pr) {
     else
 	readindex = (pr->consumer + 1);
 
-    packet = (pr->data + readindex);
+    packet = report_unpack(pr, readindex);
+    IPERF_PROBE3(ring_dequeue, pr, packet->packetID, packet->packetLen);
     // See if the dequeue needs to detect an event so the reporter
     // can move to the next packet ring
     pr->consumer = readindex;
@@ -165,6 +386,38 @@ inline enum edgeLevel toggleLevel(enum edgeLevel level) {
     return ((level == HIGH) ? LOW : HIGH);
 }
 
+// Hot path instrumentation helpers, callers check for a non NULL
+// HotPathStats so there's no clock read when --hotpath-stats is off
+double hotpath_now (void) {
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec + (t1.tv_nsec / 1e9));
+#else
+    struct timeval t1;
+    gettimeofday(&t1, NULL);
+    return (t1.tv_sec + (t1.tv_usec / 1e6));
+#endif
+}
+
+void hotpath_syscall (struct HotPathStats *hp, double start) {
+    double elapsed = hotpath_now() - start;
+    hp->syscalls++;
+    hp->syscall_time += elapsed;
+    if (elapsed > hp->syscall_max)
+	hp->syscall_max = elapsed;
+}
+
+void hotpath_delay (struct HotPathStats *hp, double start, unsigned long usecs) {
+    double oversleep = (hotpath_now() - start) - (usecs / 1e6);
+    hp->delay_calls++;
+    if (oversleep > 0) {
+	hp->delay_oversleep += oversleep;
+	if (oversleep > hp->delay_oversleep_max)
+	    hp->delay_oversleep_max = oversleep;
+    }
+}
+
 inline void enqueue_ackring (struct PacketRing *pr, struct ReportStruct *metapacket) {
     packetring_enqueue(pr, metapacket);
     // Keep the latency low by signaling the consumer thread
@@ -204,6 +457,16 @@ void packetring_free (struct PacketRing *pr) {
 #endif
 	    free(pr->data);
 	}
+	if (pr->side)
+	    free(pr->side);
+	if (pr->hotpath)
+	    free(pr->hotpath);
+	if (pr->kernelts)
+	    free(pr->kernelts);
+	if (pr->clkoffset)
+	    free(pr->clkoffset);
+	if (pr->linkemul)
+	    linkemul_free(pr->linkemul);
 	free(pr);
     }
 }
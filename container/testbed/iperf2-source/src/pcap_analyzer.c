@@ -0,0 +1,1130 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * pcap_analyzer.c
+ * Offline analyzer for iperf UDP traffic captured in pcap or pcapng
+ * files. The capture is mmap'd and split into byte ranges which are
+ * decoded in parallel, each thread resyncing on the first record or
+ * block header of its range. UDP flows are demultiplexed per 5-tuple,
+ * the per range flows are then merged in capture order, and each
+ * flow's payloads are decoded the same way as Server::ReadPacketID().
+ * Loss, out of order, latency and RFC 1889 jitter are recomputed per
+ * flow, split into packet ranges so a big flow uses all the threads,
+ * with the reporter's accounting rules.
+ *
+ * Build with "make pcap_analyzer" from the src directory
+ * ------------------------------------------------------------------- */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "headers.h"
+#include "payloads.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <math.h>
+
+#define PCAP_MAGIC_USEC    0xa1b2c3d4
+#define PCAP_MAGIC_NSEC    0xa1b23c4d
+#define PCAPNG_SHB         0x0A0D0D0A
+#define PCAPNG_IDB         0x00000001
+#define PCAPNG_SPB         0x00000003
+#define PCAPNG_NRB         0x00000004
+#define PCAPNG_ISB         0x00000005
+#define PCAPNG_EPB         0x00000006
+#define PCAPNG_DSB         0x0000000A
+#define PCAPNG_BOM         0x1A2B3C4D
+#define PCAPNG_MAXIFACES   64
+
+#define LINKTYPE_NULL      0
+#define LINKTYPE_ETHERNET  1
+#define LINKTYPE_RAW       101
+#define LINKTYPE_LOOP      108
+#define LINKTYPE_SLL       113
+#define LINKTYPE_IPV4      228
+#define LINKTYPE_IPV6      229
+#define LINKTYPE_SLL2      276
+
+#define FLOWHASHSIZE       4096
+#define MAXTHREADS         64
+#define MINCHUNKBYTES      (4 * 1024 * 1024) // smallest byte range worth its own decode thread
+#define MINSEGPKTS         16384 // smallest packet range worth its own analysis work item
+#define RESYNCRECORDS      8 // consecutive plausible headers needed to resync a range
+#define MAXRECORDLEN       (256 * 1024)
+
+struct pcap_mmm {
+    double min;
+    double max;
+    double mean;
+    double m2;
+    intmax_t cnt;
+};
+
+struct pcap_pkt {
+    const uint8_t *payload;
+    uint32_t caplen;    // bytes of UDP payload present in the capture
+    uint32_t udplen;    // UDP payload length per the UDP header
+    int64_t ts_ns;      // capture timestamp
+};
+
+struct pcap_flow {
+    int af;
+    uint8_t src[16];
+    uint8_t dst[16];
+    uint16_t sport;
+    uint16_t dport;
+    struct pcap_pkt *pkts;
+    size_t pktcnt;
+    size_t pktmax;
+    struct pcap_flow *hashnext;
+    struct pcap_flow *next;
+    int id;
+    // results merged from the analysis of the flow's packet ranges
+    bool seqno64b;
+    bool nsects;
+    intmax_t datagrams;
+    intmax_t short_datagrams;
+    uintmax_t bytes;
+    intmax_t PacketID;
+    intmax_t lost;
+    intmax_t outoforder;
+    intmax_t fin;
+    double jitter;
+    double lasttransit;
+    struct pcap_mmm transit;
+};
+
+struct pcap_flowtable {
+    struct pcap_flow *hash[FLOWHASHSIZE];
+    struct pcap_flow *head;
+    struct pcap_flow *tail;
+    int flowcnt;
+};
+
+// pcapng byte order and interface table, which SHB and IDB blocks change
+struct pcapng_state {
+    bool swapped;
+    int ifcnt;
+    int linktype[PCAPNG_MAXIFACES];
+    double tsunits[PCAPNG_MAXIFACES];  // nanoseconds per timestamp tick
+};
+
+struct pcap_capture {
+    const uint8_t *base;
+    size_t len;
+    bool pcapng;
+    // pcap global header
+    bool swapped;
+    bool nsecs;
+    int linktype;
+    uint32_t snaplen;
+    uint32_t firstsec;  // of the first record, to sanity check a resync
+    struct pcap_flowtable flows;
+    intmax_t records;
+    intmax_t skipped;
+    int port;
+    int force32;
+};
+
+// A byte range of the capture decoded by one thread. Records or blocks
+// starting in [start, end) are decoded, the walk stops at the first one
+// starting at or past end. The ranges are accepted in order only when a
+// range's walk starts where the previous one stopped, with the same
+// pcapng state, otherwise it's decoded again from there.
+struct pcap_chunk {
+    struct pcap_capture *cap;
+    size_t start;
+    size_t end;
+    size_t begin;  // first record or block decoded, SIZE_MAX when none found
+    size_t stop;   // where the walk stopped
+    bool truncated;
+    bool badformat;
+    struct pcapng_state first;
+    struct pcapng_state last;
+    struct pcap_flowtable flows;
+    intmax_t records;
+    intmax_t skipped;
+};
+
+// A range of one flow's packets, in capture order, analyzed as one work item
+struct pcap_seg {
+    struct pcap_flow *flow;
+    size_t begin;
+    size_t end;
+    intmax_t maxid;     // highest packet id of the range, pass one
+    intmax_t PacketID;  // highest packet id before the range, set before pass two
+    intmax_t datagrams;
+    intmax_t short_datagrams;
+    uintmax_t bytes;
+    intmax_t lost;
+    intmax_t outoforder;
+    intmax_t fin;
+    struct pcap_mmm transit;
+    double firsttransit;
+    double lasttransit;
+    double jitter;           // jitter of the updates after the range's first transit, from zero
+    intmax_t jitterupdates;
+};
+
+struct pcap_worker {
+    struct pcap_seg *segs;
+    int segcnt;
+    int *nextseg;
+    bool maxpass;
+    pthread_mutex_t *lock;
+};
+
+static inline uint16_t rd16 (const uint8_t *p, bool swapped) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return (swapped ? (uint16_t) ((v >> 8) | (v << 8)) : v);
+}
+
+static inline uint32_t rd32 (const uint8_t *p, bool swapped) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return (swapped ? __builtin_bswap32(v) : v);
+}
+
+static inline uint16_t rdbe16 (const uint8_t *p) {
+    return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+static void pcap_update_mmm (struct pcap_mmm *stats, double value) {
+    stats->cnt++;
+    if (stats->cnt == 1) {
+	stats->min = value;
+	stats->max = value;
+	stats->mean = value;
+	stats->m2 = 0;
+    } else {
+	double vd = value - stats->mean;
+	stats->mean += (vd / stats->cnt);
+	stats->m2 += vd * (value - stats->mean);
+	if (value < stats->min)
+	    stats->min = value;
+	if (value > stats->max)
+	    stats->max = value;
+    }
+}
+
+// Combine the stats of two sets of samples, Chan et al.'s parallel variance
+static void pcap_merge_mmm (struct pcap_mmm *stats, const struct pcap_mmm *other) {
+    if (other->cnt == 0)
+	return;
+    if (stats->cnt == 0) {
+	*stats = *other;
+	return;
+    }
+    intmax_t cnt = stats->cnt + other->cnt;
+    double vd = other->mean - stats->mean;
+    stats->mean += vd * other->cnt / cnt;
+    stats->m2 += other->m2 + vd * vd * stats->cnt * other->cnt / cnt;
+    if (other->min < stats->min)
+	stats->min = other->min;
+    if (other->max > stats->max)
+	stats->max = other->max;
+    stats->cnt = cnt;
+}
+
+static unsigned int flow_hash (int af, const uint8_t *src, const uint8_t *dst, uint16_t sport, uint16_t dport) {
+    unsigned int h = 2166136261u;
+    int len = (af == AF_INET6) ? 16 : 4;
+    for (int ix = 0; ix < len; ix++) {
+	h = (h ^ src[ix]) * 16777619u;
+	h = (h ^ dst[ix]) * 16777619u;
+    }
+    h = (h ^ sport) * 16777619u;
+    h = (h ^ dport) * 16777619u;
+    return h & (FLOWHASHSIZE - 1);
+}
+
+static struct pcap_flow *flow_lookup (struct pcap_flowtable *table, int af, const uint8_t *src, const uint8_t *dst, \
+				      uint16_t sport, uint16_t dport) {
+    int len = (af == AF_INET6) ? 16 : 4;
+    unsigned int h = flow_hash(af, src, dst, sport, dport);
+    struct pcap_flow *flow;
+    for (flow = table->hash[h]; flow != NULL; flow = flow->hashnext) {
+	if ((flow->af == af) && (flow->sport == sport) && (flow->dport == dport) && \
+	    !memcmp(flow->src, src, len) && !memcmp(flow->dst, dst, len))
+	    return flow;
+    }
+    flow = (struct pcap_flow *) calloc(1, sizeof(struct pcap_flow));
+    if (!flow) {
+	fprintf(stderr, "ERROR: out of memory allocating flow\n");
+	exit(1);
+    }
+    flow->af = af;
+    memcpy(flow->src, src, len);
+    memcpy(flow->dst, dst, len);
+    flow->sport = sport;
+    flow->dport = dport;
+    flow->id = ++table->flowcnt;
+    flow->hashnext = table->hash[h];
+    table->hash[h] = flow;
+    if (table->tail)
+	table->tail->next = flow;
+    else
+	table->head = flow;
+    table->tail = flow;
+    return flow;
+}
+
+static void flowtable_free (struct pcap_flowtable *table) {
+    struct pcap_flow *flow = table->head;
+    while (flow != NULL) {
+	struct pcap_flow *next = flow->next;
+	free(flow->pkts);
+	free(flow);
+	flow = next;
+    }
+    memset(table, 0, sizeof(struct pcap_flowtable));
+}
+
+static void flow_reserve (struct pcap_flow *flow, size_t count) {
+    if (count > flow->pktmax) {
+	size_t newmax = (flow->pktmax ? flow->pktmax : 1024);
+	while (newmax < count)
+	    newmax *= 2;
+	struct pcap_pkt *tmp = (struct pcap_pkt *) realloc(flow->pkts, newmax * sizeof(struct pcap_pkt));
+	if (!tmp) {
+	    fprintf(stderr, "ERROR: out of memory growing flow %d\n", flow->id);
+	    exit(1);
+	}
+	flow->pkts = tmp;
+	flow->pktmax = newmax;
+    }
+}
+
+static void flow_append (struct pcap_flow *flow, const uint8_t *payload, uint32_t caplen, uint32_t udplen, int64_t ts_ns) {
+    if (flow->pktcnt == flow->pktmax)
+	flow_reserve(flow, flow->pktcnt + 1);
+    struct pcap_pkt *pkt = &flow->pkts[flow->pktcnt++];
+    pkt->payload = payload;
+    pkt->caplen = caplen;
+    pkt->udplen = udplen;
+    pkt->ts_ns = ts_ns;
+}
+
+// Walk the L3 header (v4 or v6) down to UDP and file the payload with its flow
+static void decode_ip (struct pcap_chunk *chunk, const uint8_t *p, uint32_t len, int64_t ts_ns) {
+    const uint8_t *src, *dst;
+    const uint8_t *l4;
+    int af;
+    uint32_t l4len;
+    if (len < 1) {
+	chunk->skipped++;
+	return;
+    }
+    if ((p[0] >> 4) == 4) {
+	uint32_t ihl = (p[0] & 0x0f) * 4;
+	if ((len < 20) || (ihl < 20) || (len < ihl) || (p[9] != IPPROTO_UDP) || (rdbe16(&p[6]) & 0x1fff)) {
+	    // not UDP or a non first fragment
+	    chunk->skipped++;
+	    return;
+	}
+	af = AF_INET;
+	src = &p[12];
+	dst = &p[16];
+	l4 = p + ihl;
+	l4len = len - ihl;
+    } else if ((p[0] >> 4) == 6) {
+	uint8_t nexthdr;
+	uint32_t off = 40;
+	if (len < 40) {
+	    chunk->skipped++;
+	    return;
+	}
+	nexthdr = p[6];
+	// skip hop-by-hop, routing, fragment and destination option headers
+	while ((nexthdr == 0) || (nexthdr == 43) || (nexthdr == 44) || (nexthdr == 60)) {
+	    if (len < off + 8) {
+		chunk->skipped++;
+		return;
+	    }
+	    if (nexthdr == 44) {
+		if (rdbe16(&p[off + 2]) & 0xfff8) {
+		    chunk->skipped++;
+		    return;
+		}
+		nexthdr = p[off];
+		off += 8;
+	    } else {
+		uint8_t tmp = p[off];
+		off += (p[off + 1] + 1) * 8;
+		nexthdr = tmp;
+	    }
+	}
+	if ((nexthdr != IPPROTO_UDP) || (len < off)) {
+	    chunk->skipped++;
+	    return;
+	}
+	af = AF_INET6;
+	src = &p[8];
+	dst = &p[24];
+	l4 = p + off;
+	l4len = len - off;
+    } else {
+	chunk->skipped++;
+	return;
+    }
+    if (l4len < 8) {
+	chunk->skipped++;
+	return;
+    }
+    uint16_t sport = rdbe16(&l4[0]);
+    uint16_t dport = rdbe16(&l4[2]);
+    uint16_t udplen = rdbe16(&l4[4]);
+    if (chunk->cap->port && (sport != chunk->cap->port) && (dport != chunk->cap->port)) {
+	chunk->skipped++;
+	return;
+    }
+    uint32_t paylen = (udplen >= 8) ? (udplen - 8) : 0;
+    uint32_t caplen = l4len - 8;
+    if (caplen > paylen)
+	caplen = paylen;  // trim ethernet padding
+    struct pcap_flow *flow = flow_lookup(&chunk->flows, af, src, dst, sport, dport);
+    flow_append(flow, l4 + 8, caplen, paylen, ts_ns);
+}
+
+static void decode_link (struct pcap_chunk *chunk, int linktype, const uint8_t *p, uint32_t len, int64_t ts_ns) {
+    uint16_t ethertype;
+    chunk->records++;
+    switch (linktype) {
+    case LINKTYPE_ETHERNET :
+	if (len < 14) {
+	    chunk->skipped++;
+	    return;
+	}
+	ethertype = rdbe16(&p[12]);
+	p += 14;
+	len -= 14;
+	while (((ethertype == 0x8100) || (ethertype == 0x88a8)) && (len >= 4)) {
+	    ethertype = rdbe16(&p[2]);
+	    p += 4;
+	    len -= 4;
+	}
+	if ((ethertype != 0x0800) && (ethertype != 0x86dd)) {
+	    chunk->skipped++;
+	    return;
+	}
+	break;
+    case LINKTYPE_NULL :
+    case LINKTYPE_LOOP :
+	if (len < 4) {
+	    chunk->skipped++;
+	    return;
+	}
+	p += 4;
+	len -= 4;
+	break;
+    case LINKTYPE_SLL :
+	if (len < 16) {
+	    chunk->skipped++;
+	    return;
+	}
+	p += 16;
+	len -= 16;
+	break;
+    case LINKTYPE_SLL2 :
+	if (len < 20) {
+	    chunk->skipped++;
+	    return;
+	}
+	p += 20;
+	len -= 20;
+	break;
+    case LINKTYPE_RAW :
+    case LINKTYPE_IPV4 :
+    case LINKTYPE_IPV6 :
+	break;
+    default :
+	chunk->skipped++;
+	return;
+    }
+    decode_ip(chunk, p, len, ts_ns);
+}
+
+static int parse_pcap_header (struct pcap_capture *cap) {
+    uint32_t magic = rd32(cap->base, false);
+    if ((magic == PCAP_MAGIC_USEC) || (magic == PCAP_MAGIC_NSEC)) {
+	cap->swapped = false;
+    } else if ((__builtin_bswap32(magic) == PCAP_MAGIC_USEC) || (__builtin_bswap32(magic) == PCAP_MAGIC_NSEC)) {
+	cap->swapped = true;
+	magic = __builtin_bswap32(magic);
+    } else {
+	return -1;
+    }
+    cap->nsecs = (magic == PCAP_MAGIC_NSEC);
+    if (cap->len < 24)
+	return -1;
+    cap->snaplen = rd32(&cap->base[16], cap->swapped);
+    cap->linktype = (int) (rd32(&cap->base[20], cap->swapped) & 0x0fffffff);
+    if (cap->len >= 28)
+	cap->firstsec = rd32(&cap->base[24], cap->swapped);
+    return 0;
+}
+
+// Does a plausible pcap record header start at off, followed by more of them?
+// Only used to find a range's first record, a wrong guess costs a decode again.
+static bool pcap_resync_ok (struct pcap_capture *cap, size_t off) {
+    uint32_t maxlen = ((cap->snaplen > MAXRECORDLEN) || !cap->snaplen) ? MAXRECORDLEN : cap->snaplen;
+    for (int ix = 0; ix < RESYNCRECORDS; ix++) {
+	if (off == cap->len)
+	    return true;
+	if (off + 16 > cap->len)
+	    return false;
+	const uint8_t *rec = cap->base + off;
+	uint32_t sec = rd32(&rec[0], cap->swapped);
+	uint32_t frac = rd32(&rec[4], cap->swapped);
+	uint32_t incl = rd32(&rec[8], cap->swapped);
+	uint32_t orig = rd32(&rec[12], cap->swapped);
+	// within a day before and a year after the first record
+	if (((sec + 86400ULL) < cap->firstsec) || (sec > (cap->firstsec + 366ULL * 86400)))
+	    return false;
+	if ((frac >= (cap->nsecs ? 1000000000U : 1000000U)) || !incl || (incl > maxlen) || (incl > orig) || (orig > MAXRECORDLEN))
+	    return false;
+	off += 16 + incl;
+	if (off > cap->len)
+	    return false;
+    }
+    return true;
+}
+
+static void walk_pcap (struct pcap_chunk *chunk, size_t off) {
+    struct pcap_capture *cap = chunk->cap;
+    chunk->begin = off;
+    while ((off < chunk->end) && (off + 16 <= cap->len)) {
+	const uint8_t *rec = cap->base + off;
+	uint32_t sec = rd32(&rec[0], cap->swapped);
+	uint32_t frac = rd32(&rec[4], cap->swapped);
+	uint32_t incl = rd32(&rec[8], cap->swapped);
+	if (incl > (cap->len - off - 16)) {
+	    chunk->truncated = true;
+	    break;
+	}
+	int64_t ts_ns = (int64_t) sec * 1000000000LL + (cap->nsecs ? frac : ((int64_t) frac * 1000));
+	decode_link(chunk, cap->linktype, rec + 16, incl, ts_ns);
+	off += 16 + incl;
+    }
+    chunk->stop = off;
+}
+
+// Apply a SHB or IDB to the pcapng state, returns -1 on an unknown byte order
+static int pcapng_state_block (struct pcapng_state *state, const uint8_t *blk, uint32_t type, uint32_t blklen) {
+    if (type == PCAPNG_SHB) {
+	// a new section resets byte order and the interface table
+	uint32_t bom = rd32(&blk[8], false);
+	if (bom == PCAPNG_BOM) {
+	    state->swapped = false;
+	} else if (__builtin_bswap32(bom) == PCAPNG_BOM) {
+	    state->swapped = true;
+	} else {
+	    return -1;
+	}
+	state->ifcnt = 0;
+    } else if ((type == PCAPNG_IDB) && (blklen >= 20)) {
+	if (state->ifcnt < PCAPNG_MAXIFACES) {
+	    int ifcnt = state->ifcnt;
+	    state->linktype[ifcnt] = rd16(&blk[8], state->swapped);
+	    state->tsunits[ifcnt] = 1000.0;
+	    // scan the options for if_tsresol
+	    size_t opt = 16;
+	    while (opt + 4 <= blklen - 4) {
+		uint16_t code = rd16(&blk[opt], state->swapped);
+		uint16_t olen = rd16(&blk[opt + 2], state->swapped);
+		if (code == 0)
+		    break;
+		if ((code == 9) && (olen >= 1)) {
+		    uint8_t res = blk[opt + 4];
+		    if (res & 0x80)
+			state->tsunits[ifcnt] = 1e9 / pow(2.0, (res & 0x7f));
+		    else
+			state->tsunits[ifcnt] = 1e9 / pow(10.0, res);
+		}
+		opt += 4 + ((olen + 3) & ~3);
+	    }
+	    state->ifcnt++;
+	}
+    }
+    return 0;
+}
+
+static bool pcapng_state_equal (const struct pcapng_state *a, const struct pcapng_state *b) {
+    return ((a->swapped == b->swapped) && (a->ifcnt == b->ifcnt) && \
+	    !memcmp(a->linktype, b->linktype, a->ifcnt * sizeof(int)) && \
+	    !memcmp(a->tsunits, b->tsunits, a->ifcnt * sizeof(double)));
+}
+
+// Does a plausible pcapng block start at off, i.e. a known type with the
+// trailing length matching the leading one, followed by more of them?
+static bool pcapng_resync_ok (struct pcap_capture *cap, size_t off, bool swapped) {
+    for (int ix = 0; ix < RESYNCRECORDS; ix++) {
+	if (off == cap->len)
+	    return true;
+	if (off + 12 > cap->len)
+	    return false;
+	const uint8_t *blk = cap->base + off;
+	uint32_t type = rd32(blk, swapped);
+	uint32_t blklen = rd32(&blk[4], swapped);
+	if ((type != PCAPNG_EPB) && (type != PCAPNG_IDB) && (type != PCAPNG_SPB) && (type != PCAPNG_NRB) && \
+	    (type != PCAPNG_ISB) && (type != PCAPNG_DSB))
+	    return false;
+	if ((blklen < 12) || (blklen & 3) || (blklen > (cap->len - off)) || (rd32(&blk[blklen - 4], swapped) != blklen))
+	    return false;
+	off += blklen;
+    }
+    return true;
+}
+
+static void walk_pcapng (struct pcap_chunk *chunk, size_t off) {
+    struct pcap_capture *cap = chunk->cap;
+    struct pcapng_state *state = &chunk->last;
+    chunk->begin = off;
+    *state = chunk->first;
+    while ((off < chunk->end) && (off + 12 <= cap->len)) {
+	const uint8_t *blk = cap->base + off;
+	uint32_t type = rd32(blk, state->swapped);
+	uint32_t blklen;
+	if ((type == PCAPNG_SHB) && (pcapng_state_block(state, blk, type, 0) < 0)) {
+	    chunk->badformat = true;
+	    break;
+	}
+	blklen = rd32(&blk[4], state->swapped);
+	if ((blklen < 12) || (blklen > (cap->len - off))) {
+	    chunk->truncated = true;
+	    break;
+	}
+	if (type == PCAPNG_IDB) {
+	    pcapng_state_block(state, blk, type, blklen);
+	} else if ((type == PCAPNG_EPB) && (blklen >= 32)) {
+	    uint32_t ifid = rd32(&blk[8], state->swapped);
+	    uint64_t ts = ((uint64_t) rd32(&blk[12], state->swapped) << 32) | rd32(&blk[16], state->swapped);
+	    uint32_t incl = rd32(&blk[20], state->swapped);
+	    if ((ifid < (uint32_t) state->ifcnt) && (incl <= blklen - 32)) {
+		int64_t ts_ns;
+		if (state->tsunits[ifid] == 1000.0)
+		    ts_ns = (int64_t) ts * 1000;
+		else if (state->tsunits[ifid] == 1.0)
+		    ts_ns = (int64_t) ts;
+		else
+		    ts_ns = (int64_t) ((double) ts * state->tsunits[ifid]);
+		decode_link(chunk, state->linktype[ifid], &blk[28], incl, ts_ns);
+	    } else {
+		chunk->records++;
+		chunk->skipped++;
+	    }
+	}
+	off += blklen;
+    }
+    chunk->stop = off;
+}
+
+static void *decode_worker (void *arg) {
+    struct pcap_chunk *chunk = (struct pcap_chunk *) arg;
+    struct pcap_capture *cap = chunk->cap;
+    size_t off;
+    for (off = chunk->start; off < chunk->end; off += (cap->pcapng ? 4 : 1)) {
+	if (cap->pcapng ? pcapng_resync_ok(cap, off, chunk->first.swapped) : pcap_resync_ok(cap, off))
+	    break;
+    }
+    if (off >= chunk->end) {
+	// no record or block starts in this range
+	chunk->begin = SIZE_MAX;
+	chunk->stop = SIZE_MAX;
+	chunk->last = chunk->first;
+	return NULL;
+    }
+    if (cap->pcapng)
+	walk_pcapng(chunk, off);
+    else
+	walk_pcap(chunk, off);
+    return NULL;
+}
+
+// The pcapng state in effect after the blocks ahead of the first packet,
+// which the ranges other than the first start with
+static void pcapng_head_state (struct pcap_capture *cap, struct pcapng_state *state) {
+    size_t off = 0;
+    memset(state, 0, sizeof(struct pcapng_state));
+    while (off + 12 <= cap->len) {
+	const uint8_t *blk = cap->base + off;
+	uint32_t type = rd32(blk, state->swapped);
+	if ((type == PCAPNG_EPB) || ((type == PCAPNG_SHB) && (pcapng_state_block(state, blk, type, 0) < 0)))
+	    break;
+	uint32_t blklen = rd32(&blk[4], state->swapped);
+	if ((blklen < 12) || (blklen > (cap->len - off)))
+	    break;
+	if (type == PCAPNG_IDB)
+	    pcapng_state_block(state, blk, type, blklen);
+	off += blklen;
+    }
+}
+
+static void chunk_reset (struct pcap_chunk *chunk) {
+    flowtable_free(&chunk->flows);
+    chunk->records = 0;
+    chunk->skipped = 0;
+    chunk->truncated = false;
+    chunk->badformat = false;
+}
+
+// Append a range's flows to the capture's, in capture order
+static void merge_chunk (struct pcap_capture *cap, struct pcap_chunk *chunk) {
+    for (struct pcap_flow *flow = chunk->flows.head; flow != NULL; flow = flow->next) {
+	struct pcap_flow *merged = flow_lookup(&cap->flows, flow->af, flow->src, flow->dst, flow->sport, flow->dport);
+	if (merged->pktcnt == 0) {
+	    free(merged->pkts);
+	    merged->pkts = flow->pkts;
+	    merged->pktcnt = flow->pktcnt;
+	    merged->pktmax = flow->pktmax;
+	    flow->pkts = NULL;
+	} else {
+	    flow_reserve(merged, merged->pktcnt + flow->pktcnt);
+	    memcpy(&merged->pkts[merged->pktcnt], flow->pkts, flow->pktcnt * sizeof(struct pcap_pkt));
+	    merged->pktcnt += flow->pktcnt;
+	}
+    }
+    cap->records += chunk->records;
+    cap->skipped += chunk->skipped;
+    flowtable_free(&chunk->flows);
+}
+
+// Pass one, decode the capture's byte ranges in parallel and merge the flows
+static int decode_capture (struct pcap_capture *cap, int threads) {
+    size_t first = 0;
+    struct pcapng_state head;
+    memset(&head, 0, sizeof(head));
+    if (cap->pcapng) {
+	pcapng_head_state(cap, &head);
+    } else {
+	if (parse_pcap_header(cap) < 0)
+	    return -1;
+	first = 24;
+    }
+    int chunkcnt = (int) ((cap->len - first) / MINCHUNKBYTES);
+    if (chunkcnt > threads)
+	chunkcnt = threads;
+    if (chunkcnt < 1)
+	chunkcnt = 1;
+    struct pcap_chunk *chunks = (struct pcap_chunk *) calloc(chunkcnt, sizeof(struct pcap_chunk));
+    pthread_t tids[MAXTHREADS];
+    if (!chunks) {
+	fprintf(stderr, "ERROR: out of memory\n");
+	exit(1);
+    }
+    size_t span = (cap->len - first) / chunkcnt;
+    if (cap->pcapng)
+	span &= ~((size_t) 3);  // blocks are 32 bit aligned
+    for (int ix = 0; ix < chunkcnt; ix++) {
+	chunks[ix].cap = cap;
+	chunks[ix].start = first + (ix * span);
+	chunks[ix].end = ((ix == chunkcnt - 1) ? cap->len : (first + ((ix + 1) * span)));
+	chunks[ix].first = head;
+    }
+    // the first range starts at a known record, the others resync
+    memset(&chunks[0].first, 0, sizeof(struct pcapng_state));
+    for (int ix = 1; ix < chunkcnt; ix++) {
+	if (pthread_create(&tids[ix], NULL, decode_worker, &chunks[ix]) != 0) {
+	    fprintf(stderr, "ERROR: pthread_create failed\n");
+	    exit(1);
+	}
+    }
+    if (cap->pcapng)
+	walk_pcapng(&chunks[0], first);
+    else
+	walk_pcap(&chunks[0], first);
+    for (int ix = 1; ix < chunkcnt; ix++)
+	pthread_join(tids[ix], NULL);
+    int rc = 0;
+    for (int ix = 0; ix < chunkcnt; ix++) {
+	struct pcap_chunk *chunk = &chunks[ix];
+	if (ix > 0) {
+	    struct pcap_chunk *prev = &chunks[ix - 1];
+	    if (prev->stop >= chunk->end) {
+		// the previous walk went past this range, e.g. a record spanning it
+		chunk_reset(chunk);
+		chunk->stop = prev->stop;
+		chunk->last = prev->last;
+		continue;
+	    }
+	    if ((chunk->begin != prev->stop) || !pcapng_state_equal(&chunk->first, &prev->last)) {
+		// a wrong resync or a state change in the previous range
+		chunk_reset(chunk);
+		chunk->first = prev->last;
+		if (cap->pcapng)
+		    walk_pcapng(chunk, prev->stop);
+		else
+		    walk_pcap(chunk, prev->stop);
+	    }
+	}
+	if (chunk->badformat) {
+	    rc = -1;
+	    break;
+	}
+	merge_chunk(cap, chunk);
+	if (chunk->truncated) {
+	    // the rest can't be walked to
+	    fprintf(stderr, "WARN: truncated %s at offset %zu\n", (cap->pcapng ? "block" : "record"), chunk->stop);
+	    break;
+	}
+    }
+    for (int ix = 0; ix < chunkcnt; ix++)
+	flowtable_free(&chunks[ix].flows);
+    free(chunks);
+    return rc;
+}
+
+// Newer clients advertise 64 bit seqno in the test header flags
+// that follows the UDP_datagram, see Settings_GenerateClientHdr()
+static void flow_header (struct pcap_flow *flow, int force32) {
+    if (force32)
+	return;
+    for (size_t ix = 0; ix < flow->pktcnt; ix++) {
+	if (flow->pkts[ix].caplen >= (sizeof(struct UDP_datagram) + sizeof(int32_t))) {
+	    uint32_t flags = ntohl(rd32(flow->pkts[ix].payload + sizeof(struct UDP_datagram), false));
+	    flow->seqno64b = ((flags & HEADER_SEQNO64B) != 0);
+	    flow->nsects = ((flags & HEADER_NSECTS) != 0);
+	    break;
+	}
+    }
+}
+
+// Returns the packet id, zero when the datagram is too short or has none
+static inline intmax_t pkt_id (struct pcap_flow *flow, struct pcap_pkt *pkt, bool *fin) {
+    struct UDP_datagram mBuf_UDP;
+    intmax_t packetID;
+    *fin = false;
+    if (pkt->caplen < sizeof(struct UDP_datagram))
+	return 0;
+    memcpy(&mBuf_UDP, pkt->payload, sizeof(mBuf_UDP));
+    if (flow->seqno64b) {
+	packetID = (intmax_t) (((uint32_t) ntohl(mBuf_UDP.id)) | ((uintmax_t) ntohl(mBuf_UDP.id2) << 32));
+    } else {
+	packetID = (int32_t) ntohl(mBuf_UDP.id);
+    }
+    if (packetID < 0) {
+	packetID = -packetID;
+	*fin = true;
+    }
+    return packetID;
+}
+
+// Pass one of the analysis, the highest packet id of a range which
+// gives the next range the id it's accounted against
+static void analyze_seg_maxid (struct pcap_seg *seg) {
+    struct pcap_flow *flow = seg->flow;
+    bool fin;
+    seg->maxid = 0;
+    for (size_t ix = seg->begin; ix < seg->end; ix++) {
+	intmax_t packetID = pkt_id(flow, &flow->pkts[ix], &fin);
+	if (packetID > seg->maxid)
+	    seg->maxid = packetID;
+    }
+}
+
+// Per range accounting, mirrors reporter_handle_packet_server_udp()
+// and reporter_handle_packet_oneway_transit(). The jitter is computed
+// from zero after the range's first transit and folded into the flow's
+// by merge_seg(), the filter being linear.
+static void analyze_seg (struct pcap_seg *seg) {
+    struct pcap_flow *flow = seg->flow;
+    intmax_t PacketID = seg->PacketID;
+    bool fin;
+    for (size_t ix = seg->begin; ix < seg->end; ix++) {
+	struct pcap_pkt *pkt = &flow->pkts[ix];
+	if (pkt->caplen < sizeof(struct UDP_datagram)) {
+	    seg->short_datagrams++;
+	    continue;
+	}
+	intmax_t packetID = pkt_id(flow, pkt, &fin);
+	if (fin)
+	    seg->fin++;
+	if (packetID == 0)
+	    continue;
+	seg->datagrams++;
+	seg->bytes += pkt->udplen;
+	bool ooo_packet = false;
+	if (packetID != PacketID + 1) {
+	    if (packetID < PacketID + 1) {
+		seg->outoforder++;
+		ooo_packet = true;
+	    } else {
+		seg->lost += packetID - PacketID - 1;
+	    }
+	}
+	if (packetID > PacketID)
+	    PacketID = packetID;
+	if (!ooo_packet) {
+	    int64_t sent_ns;
+	    if (flow->nsects && (pkt->caplen >= (uint32_t) MINNSECTSPAYLOAD)) {
+		struct UDP_datagram_nsects nsects;
+		memcpy(&nsects, pkt->payload + sizeof(struct client_udp_testhdr), sizeof(nsects));
+		sent_ns = ((int64_t) ntohl(nsects.tv_nsec_u) << 32) | ntohl(nsects.tv_nsec_l);
+	    } else {
+		struct UDP_datagram mBuf_UDP;
+		memcpy(&mBuf_UDP, pkt->payload, sizeof(mBuf_UDP));
+		sent_ns = (int64_t) ntohl(mBuf_UDP.tv_sec) * 1000000000LL + (int64_t) ntohl(mBuf_UDP.tv_usec) * 1000;
+	    }
+	    double transit = (double) (pkt->ts_ns - sent_ns) / 1e9;
+	    if (seg->transit.cnt == 0) {
+		seg->firsttransit = transit;
+	    } else {
+		double deltaTransit = transit - seg->lasttransit;
+		if (deltaTransit < 0.0)
+		    deltaTransit = -deltaTransit;
+		seg->jitter += (deltaTransit - seg->jitter) / (16.0);
+		seg->jitterupdates++;
+	    }
+	    seg->lasttransit = transit;
+	    pcap_update_mmm(&seg->transit, transit);
+	}
+    }
+}
+
+// Fold a range's results into its flow, ranges must be merged in order
+static void merge_seg (struct pcap_seg *seg) {
+    struct pcap_flow *flow = seg->flow;
+    flow->datagrams += seg->datagrams;
+    flow->short_datagrams += seg->short_datagrams;
+    flow->bytes += seg->bytes;
+    flow->lost += seg->lost;
+    flow->outoforder += seg->outoforder;
+    flow->fin += seg->fin;
+    if (seg->maxid > flow->PacketID)
+	flow->PacketID = seg->maxid;
+    if (seg->transit.cnt > 0) {
+	if (flow->transit.cnt > 0) {
+	    double deltaTransit = seg->firsttransit - flow->lasttransit;
+	    if (deltaTransit < 0.0)
+		deltaTransit = -deltaTransit;
+	    flow->jitter += (deltaTransit - flow->jitter) / (16.0);
+	}
+	// J' = J + (D - J)/16 is (15/16)J + D/16, so the range's updates
+	// scale the incoming jitter and add what they gave from zero
+	flow->jitter = flow->jitter * pow(15.0 / 16.0, (double) seg->jitterupdates) + seg->jitter;
+	flow->lasttransit = seg->lasttransit;
+	pcap_merge_mmm(&flow->transit, &seg->transit);
+    }
+}
+
+static void *analyze_worker (void *arg) {
+    struct pcap_worker *worker = (struct pcap_worker *) arg;
+    int ix;
+    while (1) {
+	pthread_mutex_lock(worker->lock);
+	ix = (*worker->nextseg)++;
+	pthread_mutex_unlock(worker->lock);
+	if (ix >= worker->segcnt)
+	    break;
+	if (worker->maxpass)
+	    analyze_seg_maxid(&worker->segs[ix]);
+	else
+	    analyze_seg(&worker->segs[ix]);
+    }
+    return NULL;
+}
+
+static void analyze_run (struct pcap_seg *segs, int segcnt, int threads, bool maxpass) {
+    pthread_t tids[MAXTHREADS];
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    int nextseg = 0;
+    struct pcap_worker worker = {segs, segcnt, &nextseg, maxpass, &lock};
+    if (threads > segcnt)
+	threads = segcnt;
+    for (int ix = 0; ix < threads; ix++) {
+	if (pthread_create(&tids[ix], NULL, analyze_worker, &worker) != 0) {
+	    fprintf(stderr, "ERROR: pthread_create failed\n");
+	    exit(1);
+	}
+    }
+    for (int ix = 0; ix < threads; ix++)
+	pthread_join(tids[ix], NULL);
+}
+
+// Pass two, split the flows into packet ranges, find each range's
+// starting packet id, then account the ranges in parallel and merge
+static void analyze_flows (struct pcap_flow **flows, int flowcnt, int threads, int force32) {
+    size_t total = 0;
+    int segcnt = 0;
+    for (int ix = 0; ix < flowcnt; ix++)
+	total += flows[ix]->pktcnt;
+    size_t segpkts = total / ((size_t) threads * 4);
+    if (segpkts < MINSEGPKTS)
+	segpkts = MINSEGPKTS;
+    for (int ix = 0; ix < flowcnt; ix++)
+	segcnt += (int) ((flows[ix]->pktcnt + segpkts - 1) / segpkts);
+    if (segcnt == 0)
+	return;
+    struct pcap_seg *segs = (struct pcap_seg *) calloc(segcnt, sizeof(struct pcap_seg));
+    if (!segs) {
+	fprintf(stderr, "ERROR: out of memory\n");
+	exit(1);
+    }
+    int seg = 0;
+    for (int ix = 0; ix < flowcnt; ix++) {
+	flow_header(flows[ix], force32);
+	for (size_t begin = 0; begin < flows[ix]->pktcnt; begin += segpkts) {
+	    segs[seg].flow = flows[ix];
+	    segs[seg].begin = begin;
+	    segs[seg].end = ((begin + segpkts) < flows[ix]->pktcnt) ? (begin + segpkts) : flows[ix]->pktcnt;
+	    seg++;
+	}
+    }
+    analyze_run(segs, segcnt, threads, true);
+    intmax_t PacketID = 0;
+    for (int ix = 0; ix < segcnt; ix++) {
+	if ((ix == 0) || (segs[ix].flow != segs[ix - 1].flow))
+	    PacketID = 0;
+	segs[ix].PacketID = PacketID;
+	if (segs[ix].maxid > PacketID)
+	    PacketID = segs[ix].maxid;
+    }
+    analyze_run(segs, segcnt, threads, false);
+    for (int ix = 0; ix < segcnt; ix++)
+	merge_seg(&segs[ix]);
+    free(segs);
+}
+
+static void print_flow (struct pcap_flow *flow) {
+    char srcstr[INET6_ADDRSTRLEN], dststr[INET6_ADDRSTRLEN];
+    inet_ntop(flow->af, flow->src, srcstr, sizeof(srcstr));
+    inet_ntop(flow->af, flow->dst, dststr, sizeof(dststr));
+    double duration = 0.0;
+    if (flow->pktcnt > 1)
+	duration = (double) (flow->pkts[flow->pktcnt - 1].ts_ns - flow->pkts[0].ts_ns) / 1e9;
+    intmax_t lost = flow->lost - flow->outoforder;
+    if (lost < 0)
+	lost = 0;
+    intmax_t total = flow->PacketID;
+    printf("[%3d] %s port %u connected with %s port %u%s%s\n", flow->id, dststr, flow->dport, srcstr, flow->sport, \
+	   (flow->seqno64b ? " (seqno64b)" : ""), (flow->nsects ? " (nsects)" : ""));
+    printf("[%3d] 0.00-%.2f sec %" PRIuMAX " Bytes %.0f bits/sec %.3f ms %" PRIdMAX "/%" PRIdMAX " (%.2g%%) %" PRIdMAX " OOO", \
+	   flow->id, duration, flow->bytes, ((duration > 0) ? (flow->bytes * 8.0 / duration) : 0.0), \
+	   flow->jitter * 1e3, lost, total, ((total > 0) ? (100.0 * lost / total) : 0.0), flow->outoforder);
+    if (flow->transit.cnt > 0) {
+	double stdev = (flow->transit.cnt > 1) ? sqrt(flow->transit.m2 / (flow->transit.cnt - 1)) : 0.0;
+	printf(" %.3f/%.3f/%.3f/%.3f ms", flow->transit.mean * 1e3, flow->transit.min * 1e3, \
+	       flow->transit.max * 1e3, stdev * 1e3);
+    }
+    printf(" %.0f pps\n", ((duration > 0) ? (flow->datagrams / duration) : 0.0));
+    if (flow->short_datagrams)
+	printf("[%3d] WARN: %" PRIdMAX " datagrams too short to decode\n", flow->id, flow->short_datagrams);
+}
+
+int main (int argc, char **argv) {
+    struct pcap_capture cap;
+    struct stat sb;
+    int c, fd, threads = 4;
+    memset(&cap, 0, sizeof(cap));
+
+    while ((c = getopt(argc, argv, "op:t:")) != -1) {
+	switch (c) {
+	case 'o':
+	    cap.force32 = 1;
+	    break;
+	case 'p':
+	    cap.port = atoi(optarg);
+	    break;
+	case 't':
+	    threads = atoi(optarg);
+	    break;
+	case '?':
+	default:
+	    fprintf(stderr, "Usage: %s [-o 32 bit seqno (old client)] [-p port] [-t threads] <file.pcap|file.pcapng>\n", argv[0]);
+	    return 1;
+	}
+    }
+    if (optind >= argc) {
+	fprintf(stderr, "Usage: %s [-o 32 bit seqno (old client)] [-p port] [-t threads] <file.pcap|file.pcapng>\n", argv[0]);
+	return 1;
+    }
+    if (threads < 1)
+	threads = 1;
+    else if (threads > MAXTHREADS)
+	threads = MAXTHREADS;
+
+    if ((fd = open(argv[optind], O_RDONLY)) < 0) {
+	fprintf(stderr, "ERROR: open %s: %s\n", argv[optind], strerror(errno));
+	return 1;
+    }
+    if ((fstat(fd, &sb) < 0) || (sb.st_size < 24)) {
+	fprintf(stderr, "ERROR: %s is not a capture file\n", argv[optind]);
+	close(fd);
+	return 1;
+    }
+    cap.len = (size_t) sb.st_size;
+    cap.base = (const uint8_t *) mmap(NULL, cap.len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (cap.base == MAP_FAILED) {
+	fprintf(stderr, "ERROR: mmap %s: %s\n", argv[optind], strerror(errno));
+	return 1;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise((void *) cap.base, cap.len, MADV_SEQUENTIAL);
+#endif
+    cap.pcapng = (rd32(cap.base, false) == PCAPNG_SHB);
+    if (decode_capture(&cap, threads) < 0) {
+	fprintf(stderr, "ERROR: %s has an unknown capture format\n", argv[optind]);
+	flowtable_free(&cap.flows);
+	munmap((void *) cap.base, cap.len);
+	return 1;
+    }
+    struct pcap_flow **flows = NULL;
+    if (cap.flows.flowcnt > 0) {
+	flows = (struct pcap_flow **) calloc(cap.flows.flowcnt, sizeof(struct pcap_flow *));
+	if (!flows) {
+	    fprintf(stderr, "ERROR: out of memory\n");
+	    return 1;
+	}
+	int ix = 0;
+	for (struct pcap_flow *flow = cap.flows.head; flow != NULL; flow = flow->next)
+	    flows[ix++] = flow;
+	analyze_flows(flows, cap.flows.flowcnt, threads, cap.force32);
+    }
+    printf("%s: %" PRIdMAX " records, %" PRIdMAX " skipped, %d UDP flow(s)\n", argv[optind], cap.records, cap.skipped, cap.flows.flowcnt);
+    printf("[ ID] Interval Transfer Bandwidth Jitter Lost/Total Datagrams OOO Latency avg/min/max/stdev PPS\n");
+    for (int ix = 0; ix < cap.flows.flowcnt; ix++)
+	print_flow(flows[ix]);
+    free(flows);
+    flowtable_free(&cap.flows);
+    munmap((void *) cap.base, cap.len);
+    return 0;
+}
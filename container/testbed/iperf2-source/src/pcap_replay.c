@@ -0,0 +1,441 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * pcap_replay.c
+ * Capture parsing and the (gap, length) table for --pcap-replay
+ * ------------------------------------------------------------------- */
+#include <math.h>
+#include "headers.h"
+#include "pcap_replay.h"
+
+#define PCAP_MAGIC_USEC    0xa1b2c3d4
+#define PCAP_MAGIC_NSEC    0xa1b23c4d
+#define PCAPNG_SHB         0x0A0D0D0A
+#define PCAPNG_IDB         0x00000001
+#define PCAPNG_EPB         0x00000006
+#define PCAPNG_BOM         0x1A2B3C4D
+#define PCAPNG_MAXIFACES   64
+
+#define LINKTYPE_NULL      0
+#define LINKTYPE_ETHERNET  1
+#define LINKTYPE_RAW       101
+#define LINKTYPE_LOOP      108
+#define LINKTYPE_SLL       113
+#define LINKTYPE_IPV4      228
+#define LINKTYPE_IPV6      229
+#define LINKTYPE_SLL2      276
+
+struct pcap_replay_parse {
+    struct PcapReplay *pr;
+    const uint8_t *base;
+    size_t len;
+    bool swapped;
+    intmax_t slots;
+    bool started;
+    int64_t first_ts;
+    int64_t prev_ts;
+};
+
+static inline uint32_t pcap_replay_swap32 (uint32_t v) {
+    return (((v & 0xff) << 24) | ((v & 0xff00) << 8) | ((v >> 8) & 0xff00) | (v >> 24));
+}
+
+static inline uint16_t rd16 (const uint8_t *p, bool swapped) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return (swapped ? (uint16_t) ((v >> 8) | (v << 8)) : v);
+}
+
+static inline uint32_t rd32 (const uint8_t *p, bool swapped) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return (swapped ? pcap_replay_swap32(v) : v);
+}
+
+static inline uint16_t rdbe16 (const uint8_t *p) {
+    return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+static int pcap_replay_append (struct pcap_replay_parse *parse, uint32_t gap, uint16_t len) {
+    struct PcapReplay *pr = parse->pr;
+    if (pr->count == parse->slots) {
+	intmax_t slots = (parse->slots ? (2 * parse->slots) : 4096);
+	struct PcapReplayPkt *grow = (struct PcapReplayPkt *) realloc(pr->pkts, slots * sizeof(struct PcapReplayPkt));
+	if (grow == NULL)
+	    return -1;
+	pr->pkts = grow;
+	parse->slots = slots;
+    }
+    pr->pkts[pr->count].gap = gap;
+    pr->pkts[pr->count].len = len;
+    pr->count++;
+    return 0;
+}
+
+// File a datagram of len bytes sent at ts, a capture's out of order
+// timestamps give a zero gap and gaps too long for one entry are split
+static int pcap_replay_datagram (struct pcap_replay_parse *parse, uint32_t len, int64_t ts) {
+    struct PcapReplay *pr = parse->pr;
+    int64_t gap = 0;
+    if (len > PCAPREPLAY_MAXLEN)
+	len = PCAPREPLAY_MAXLEN;
+    if (!parse->started) {
+	parse->started = true;
+	parse->first_ts = ts;
+    } else if (ts > parse->prev_ts) {
+	gap = (int64_t) ((ts - parse->prev_ts) * pr->scale);
+    }
+    if (ts > parse->prev_ts)
+	parse->prev_ts = ts;
+    while (gap > (int64_t) UINT32_MAX) {
+	if (pcap_replay_append(parse, UINT32_MAX, 0) != 0)
+	    return -1;
+	gap -= UINT32_MAX;
+    }
+    if (pcap_replay_append(parse, (uint32_t) gap, (uint16_t) len) != 0)
+	return -1;
+    pr->datagrams++;
+    pr->duration += gap;
+    if ((int) len > pr->maxlen)
+	pr->maxlen = len;
+    return 0;
+}
+
+// Walk the L3 header (v4 or v6) down to UDP
+static int pcap_replay_ip (struct pcap_replay_parse *parse, const uint8_t *p, uint32_t len, int64_t ts) {
+    const uint8_t *l4;
+    uint32_t l4len;
+    if (len < 1) {
+	parse->pr->skipped++;
+	return 0;
+    }
+    if ((p[0] >> 4) == 4) {
+	uint32_t ihl = (p[0] & 0x0f) * 4;
+	if ((len < 20) || (ihl < 20) || (len < ihl) || (p[9] != IPPROTO_UDP) || (rdbe16(&p[6]) & 0x1fff)) {
+	    // not UDP or a non first fragment
+	    parse->pr->skipped++;
+	    return 0;
+	}
+	l4 = p + ihl;
+	l4len = len - ihl;
+    } else if ((p[0] >> 4) == 6) {
+	uint8_t nexthdr;
+	uint32_t off = 40;
+	if (len < 40) {
+	    parse->pr->skipped++;
+	    return 0;
+	}
+	nexthdr = p[6];
+	// skip hop-by-hop, routing, fragment and destination option headers
+	while ((nexthdr == 0) || (nexthdr == 43) || (nexthdr == 44) || (nexthdr == 60)) {
+	    if (len < off + 8) {
+		parse->pr->skipped++;
+		return 0;
+	    }
+	    if (nexthdr == 44) {
+		if (rdbe16(&p[off + 2]) & 0xfff8) {
+		    parse->pr->skipped++;
+		    return 0;
+		}
+		nexthdr = p[off];
+		off += 8;
+	    } else {
+		uint8_t tmp = p[off];
+		off += (p[off + 1] + 1) * 8;
+		nexthdr = tmp;
+	    }
+	}
+	if ((nexthdr != IPPROTO_UDP) || (len < off)) {
+	    parse->pr->skipped++;
+	    return 0;
+	}
+	l4 = p + off;
+	l4len = len - off;
+    } else {
+	parse->pr->skipped++;
+	return 0;
+    }
+    // the UDP header's length is the datagram's, even when the snap length cut it
+    if ((l4len < 8) || (rdbe16(&l4[4]) < 8) || \
+	(parse->pr->port && (rdbe16(&l4[0]) != parse->pr->port) && (rdbe16(&l4[2]) != parse->pr->port))) {
+	parse->pr->skipped++;
+	return 0;
+    }
+    return pcap_replay_datagram(parse, rdbe16(&l4[4]) - 8, ts);
+}
+
+static int pcap_replay_link (struct pcap_replay_parse *parse, int linktype, const uint8_t *p, uint32_t len, int64_t ts) {
+    uint32_t hdrlen = 0;
+    switch (linktype) {
+    case LINKTYPE_ETHERNET :
+	if (len >= 14) {
+	    uint16_t ethertype = rdbe16(&p[12]);
+	    hdrlen = 14;
+	    while (((ethertype == 0x8100) || (ethertype == 0x88a8)) && (len >= hdrlen + 4)) {
+		ethertype = rdbe16(&p[hdrlen + 2]);
+		hdrlen += 4;
+	    }
+	    if ((ethertype != 0x0800) && (ethertype != 0x86dd))
+		hdrlen = len + 1;
+	}
+	break;
+    case LINKTYPE_NULL :
+    case LINKTYPE_LOOP :
+	hdrlen = 4;
+	break;
+    case LINKTYPE_SLL :
+	hdrlen = 16;
+	break;
+    case LINKTYPE_SLL2 :
+	hdrlen = 20;
+	break;
+    case LINKTYPE_RAW :
+    case LINKTYPE_IPV4 :
+    case LINKTYPE_IPV6 :
+	break;
+    default :
+	hdrlen = len + 1;
+	break;
+    }
+    if ((hdrlen > len) || ((linktype == LINKTYPE_ETHERNET) && (len < 14))) {
+	parse->pr->skipped++;
+	return 0;
+    }
+    return pcap_replay_ip(parse, p + hdrlen, len - hdrlen, ts);
+}
+
+static int pcap_replay_pcap (struct pcap_replay_parse *parse) {
+    uint32_t magic = rd32(parse->base, false);
+    if ((magic != PCAP_MAGIC_USEC) && (magic != PCAP_MAGIC_NSEC)) {
+	parse->swapped = true;
+	magic = pcap_replay_swap32(magic);
+    }
+    bool nsecs = (magic == PCAP_MAGIC_NSEC);
+    int linktype = (int) (rd32(&parse->base[20], parse->swapped) & 0x0fffffff);
+    size_t off = 24;
+    while (off + 16 <= parse->len) {
+	const uint8_t *rec = parse->base + off;
+	uint32_t sec = rd32(&rec[0], parse->swapped);
+	uint32_t frac = rd32(&rec[4], parse->swapped);
+	uint32_t incl = rd32(&rec[8], parse->swapped);
+	off += 16;
+	if (incl > (parse->len - off)) {
+	    fprintf(stderr, "WARN: --pcap-replay truncated record at offset %zu\n", off - 16);
+	    break;
+	}
+	int64_t ts = (int64_t) sec * 1000000000LL + (nsecs ? frac : ((int64_t) frac * 1000));
+	if (pcap_replay_link(parse, linktype, rec + 16, incl, ts) != 0)
+	    return -1;
+	off += incl;
+    }
+    return 0;
+}
+
+static int pcap_replay_pcapng (struct pcap_replay_parse *parse) {
+    int linktype[PCAPNG_MAXIFACES];
+    int64_t tsmul[PCAPNG_MAXIFACES];   // ns per tick for decimal resolutions to ns
+    double tsunit[PCAPNG_MAXIFACES];   // ns per tick otherwise, tsmul is zero
+    int ifcnt = 0;
+    size_t off = 0;
+    while (off + 12 <= parse->len) {
+	const uint8_t *blk = parse->base + off;
+	uint32_t type = rd32(blk, parse->swapped);
+	uint32_t blklen;
+	if (type == PCAPNG_SHB) {
+	    // a new section resets byte order and the interface table
+	    uint32_t bom = rd32(&blk[8], false);
+	    if (bom == PCAPNG_BOM) {
+		parse->swapped = false;
+	    } else if (pcap_replay_swap32(bom) == PCAPNG_BOM) {
+		parse->swapped = true;
+	    } else {
+		return -1;
+	    }
+	    ifcnt = 0;
+	}
+	blklen = rd32(&blk[4], parse->swapped);
+	if ((blklen < 12) || (blklen > (parse->len - off))) {
+	    fprintf(stderr, "WARN: --pcap-replay truncated block at offset %zu\n", off);
+	    break;
+	}
+	if ((type == PCAPNG_IDB) && (blklen >= 20) && (ifcnt < PCAPNG_MAXIFACES)) {
+	    linktype[ifcnt] = rd16(&blk[8], parse->swapped);
+	    tsmul[ifcnt] = 1000;
+	    tsunit[ifcnt] = 1000.0;
+	    // scan the options for if_tsresol
+	    size_t opt = 16;
+	    while (opt + 4 <= blklen - 4) {
+		uint16_t code = rd16(&blk[opt], parse->swapped);
+		uint16_t olen = rd16(&blk[opt + 2], parse->swapped);
+		if (code == 0)
+		    break;
+		if ((code == 9) && (olen >= 1)) {
+		    uint8_t res = blk[opt + 4];
+		    tsmul[ifcnt] = 0;
+		    if (res & 0x80) {
+			tsunit[ifcnt] = 1e9 / pow(2.0, (res & 0x7f));
+		    } else {
+			tsunit[ifcnt] = 1e9 / pow(10.0, res);
+			if (res <= 9) {
+			    tsmul[ifcnt] = 1;
+			    for (int ix = res; ix < 9; ix++)
+				tsmul[ifcnt] *= 10;
+			}
+		    }
+		}
+		opt += 4 + ((olen + 3) & ~3);
+	    }
+	    ifcnt++;
+	} else if ((type == PCAPNG_EPB) && (blklen >= 32)) {
+	    uint32_t ifid = rd32(&blk[8], parse->swapped);
+	    uint64_t ticks = ((uint64_t) rd32(&blk[12], parse->swapped) << 32) | rd32(&blk[16], parse->swapped);
+	    uint32_t caplen = rd32(&blk[20], parse->swapped);
+	    if ((ifid >= (uint32_t) ifcnt) || (caplen > (blklen - 32))) {
+		parse->pr->skipped++;
+	    } else {
+		int64_t ts = (tsmul[ifid] ? ((int64_t) ticks * tsmul[ifid]) : (int64_t) (ticks * tsunit[ifid]));
+		if (pcap_replay_link(parse, linktype[ifid], &blk[28], caplen, ts) != 0)
+		    return -1;
+	    }
+	}
+	off += blklen;
+    }
+    return 0;
+}
+
+// Options after the file name are the same key=value style as --link-emul
+static int pcap_replay_options (char *options, struct PcapReplay *pr) {
+    char *saveptr = NULL;
+    for (char *token = strtok_r(options, ",", &saveptr); token; token = strtok_r(NULL, ",", &saveptr)) {
+	char *value = strchr(token, '=');
+	char *end = NULL;
+	if (value)
+	    *value++ = '\0';
+	if ((strcmp(token, "loop") == 0) && (value == NULL)) {
+	    pr->loops = 0;
+	    continue;
+	}
+	if (value == NULL)
+	    return -1;
+	if (strcmp(token, "scale") == 0) {
+	    pr->scale = strtod(value, &end);
+	    if (!(pr->scale > 0))
+		return -1;
+	} else if (strcmp(token, "loop") == 0) {
+	    pr->loops = (int) strtol(value, &end, 10);
+	    if (pr->loops < 0)
+		return -1;
+	} else if (strcmp(token, "port") == 0) {
+	    pr->port = (int) strtol(value, &end, 10);
+	    if ((pr->port <= 0) || (pr->port > 65535))
+		return -1;
+	} else {
+	    return -1;
+	}
+	if (*end != '\0')
+	    return -1;
+    }
+    return 0;
+}
+
+struct PcapReplay *pcap_replay_load (const char *spec) {
+    struct pcap_replay_parse parse;
+    struct PcapReplay *pr;
+    char *filename = strdup(spec);
+    char *options;
+    FILE *fp = NULL;
+    long size;
+    int rc = -1;
+    memset(&parse, 0, sizeof(struct pcap_replay_parse));
+    if ((filename == NULL) || ((pr = (struct PcapReplay *) calloc(1, sizeof(struct PcapReplay))) == NULL)) {
+	free(filename);
+	return NULL;
+    }
+    pr->scale = 1.0;
+    pr->loops = 1;
+    parse.pr = pr;
+    if ((options = strchr(filename, ',')) != NULL)
+	*options++ = '\0';
+    if (options && (pcap_replay_options(options, pr) != 0)) {
+	fprintf(stderr, "ERROR: --pcap-replay %s not understood, expect <file>[,scale=<x>][,loop[=<n>]][,port=<p>]\n", spec);
+    } else if ((fp = fopen(filename, "rb")) == NULL) {
+	fprintf(stderr, "ERROR: --pcap-replay %s: %s\n", filename, strerror(errno));
+    } else if ((fseek(fp, 0, SEEK_END) != 0) || ((size = ftell(fp)) < 0) || (fseek(fp, 0, SEEK_SET) != 0)) {
+	fprintf(stderr, "ERROR: --pcap-replay %s: %s\n", filename, strerror(errno));
+    } else if ((size < 24) || ((parse.base = (const uint8_t *) malloc(size)) == NULL) || \
+	       (fread((void *) parse.base, 1, size, fp) != (size_t) size)) {
+	fprintf(stderr, "ERROR: --pcap-replay %s: can't read the capture\n", filename);
+    } else {
+	uint32_t magic = rd32(parse.base, false);
+	parse.len = (size_t) size;
+	if ((magic == PCAPNG_SHB) || (pcap_replay_swap32(magic) == PCAPNG_SHB)) {
+	    rc = pcap_replay_pcapng(&parse);
+	} else if ((magic == PCAP_MAGIC_USEC) || (magic == PCAP_MAGIC_NSEC) || \
+		   (pcap_replay_swap32(magic) == PCAP_MAGIC_USEC) || (pcap_replay_swap32(magic) == PCAP_MAGIC_NSEC)) {
+	    rc = pcap_replay_pcap(&parse);
+	}
+	if (rc != 0) {
+	    fprintf(stderr, "ERROR: --pcap-replay %s isn't a pcap or pcapng capture\n", filename);
+	} else if (pr->datagrams < 1) {
+	    fprintf(stderr, "ERROR: --pcap-replay %s has no UDP datagrams%s\n", filename, (pr->port ? " for the port" : ""));
+	    rc = -1;
+	} else {
+	    // back to back loops keep the capture's mean gap between them
+	    pr->wrapgap = ((pr->datagrams > 1) ? (pr->duration / (pr->datagrams - 1)) : 0);
+	}
+    }
+    if (fp)
+	fclose(fp);
+    free((void *) parse.base);
+    free(filename);
+    if (rc != 0) {
+	pcap_replay_free(pr);
+	pr = NULL;
+    }
+    return pr;
+}
+
+void pcap_replay_free (struct PcapReplay *pr) {
+    if (pr) {
+	free(pr->pkts);
+	free(pr);
+    }
+}
@@ -0,0 +1,227 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * rate_schedule.c
+ * Piecewise constant and ramped rate schedules for --rate-schedule
+ * ------------------------------------------------------------------- */
+#include <math.h>
+#include "headers.h"
+#include "util.h"
+#include "rate_schedule.h"
+
+// Duration with an optional ns, us, ms or s suffix, seconds by default
+static int rate_schedule_duration (const char *str, int64_t *ns) {
+    char *end;
+    double value = strtod(str, &end);
+    double scale = 1e9;
+    if (end == str)
+	return -1;
+    if (strcmp(end, "ns") == 0) {
+	scale = 1;
+    } else if (strcmp(end, "us") == 0) {
+	scale = 1e3;
+    } else if (strcmp(end, "ms") == 0) {
+	scale = 1e6;
+    } else if ((*end != '\0') && (strcmp(end, "s") != 0)) {
+	return -1;
+    }
+    *ns = (int64_t) (value * scale);
+    return ((*ns > 0) ? 0 : -1);
+}
+
+static int rate_schedule_rate (const char *str, double base_rate, double *rate) {
+    size_t len = strlen(str);
+    if ((len > 1) && (str[len - 1] == 'x')) {
+	if (base_rate <= 0)
+	    return -1;
+	*rate = atof(str) * base_rate;
+    } else {
+	if (!isdigit((int) str[0]) && (str[0] != '.'))
+	    return -1;
+	*rate = bitorbyte_atof(str);
+    }
+    return ((*rate >= 0) ? 0 : -1);
+}
+
+struct RateSchedule *rate_schedule_load (const char *filename, double base_rate) {
+    FILE *fp = fopen(filename, "r");
+    struct RateSchedule *rs;
+    char line[256];
+    int lineno = 0;
+    int slots = 0;
+    if (fp == NULL) {
+	fprintf(stderr, "ERROR: --rate-schedule %s: %s\n", filename, strerror(errno));
+	return NULL;
+    }
+    if ((rs = (struct RateSchedule *) calloc(1, sizeof(struct RateSchedule))) == NULL) {
+	fclose(fp);
+	return NULL;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+	char duration[64], rate[64], ramp[16];
+	char *comment = strchr(line, '#');
+	lineno++;
+	if (comment)
+	    *comment = '\0';
+	int fields = sscanf(line, "%63s %63s %15s", duration, rate, ramp);
+	if (fields <= 0)
+	    continue;
+	if (rs->count == slots) {
+	    slots = (slots ? (2 * slots) : 16);
+	    struct RateSegment *grow = (struct RateSegment *) realloc(rs->segments, slots * sizeof(struct RateSegment));
+	    if (grow == NULL)
+		break;
+	    rs->segments = grow;
+	}
+	struct RateSegment *seg = &rs->segments[rs->count];
+	memset(seg, 0, sizeof(struct RateSegment));
+	if ((fields < 2) || (rate_schedule_duration(duration, &seg->duration) != 0) || \
+	    (rate_schedule_rate(rate, base_rate, &seg->rate_end) != 0) || \
+	    ((fields == 3) && (strcmp(ramp, "ramp") != 0))) {
+	    fprintf(stderr, "ERROR: --rate-schedule %s line %d, expect <duration>[ns|us|ms|s] <rate>[kmgKMG|x] [ramp]%s\n", \
+		    filename, lineno, ((base_rate <= 0) ? ", x rates need -b" : ""));
+	    break;
+	}
+	// rate_start of a ramp is the previous segment's, filled in below
+	seg->rate_start = ((fields == 3) ? -1 : seg->rate_end);
+	rs->count++;
+    }
+    bool complete = feof(fp);
+    fclose(fp);
+    if (complete && (rs->count > 0)) {
+	int ix;
+	for (ix = 0; ix < rs->count; ix++) {
+	    struct RateSegment *seg = &rs->segments[ix];
+	    if (seg->rate_start < 0) {
+		// the schedule repeats so the first segment ramps from the last
+		struct RateSegment *prev = &rs->segments[(ix + rs->count - 1) % rs->count];
+		seg->rate_start = prev->rate_end;
+	    }
+	    seg->start = rs->period;
+	    seg->bits_before = rs->period_bits;
+	    rs->period += seg->duration;
+	    rs->period_bits += (seg->rate_start + seg->rate_end) / 2.0 * (seg->duration / 1e9);
+	}
+	if (rs->period_bits > 0)
+	    return rs;
+	fprintf(stderr, "ERROR: --rate-schedule %s has no segment with a rate above zero\n", filename);
+    } else if (complete) {
+	fprintf(stderr, "ERROR: --rate-schedule %s has no segments\n", filename);
+    }
+    rate_schedule_free(rs);
+    return NULL;
+}
+
+void rate_schedule_free (struct RateSchedule *rs) {
+    if (rs) {
+	free(rs->segments);
+	free(rs);
+    }
+}
+
+// Last segment starting at or before offset ns into the period
+static struct RateSegment *rate_schedule_find (struct RateSchedule *rs, int64_t offset) {
+    int lo = 0, hi = rs->count - 1;
+    while (lo < hi) {
+	int mid = (lo + hi + 1) / 2;
+	if (rs->segments[mid].start <= offset) {
+	    lo = mid;
+	} else {
+	    hi = mid - 1;
+	}
+    }
+    return &rs->segments[lo];
+}
+
+// Bits scheduled in the first x ns of a segment
+static inline double rate_segment_bits (struct RateSegment *seg, double x) {
+    double slope = (seg->rate_end - seg->rate_start) / seg->duration;
+    return (seg->rate_start * x + slope * x * x / 2.0) / 1e9;
+}
+
+// Bits scheduled from time zero to t
+static double rate_schedule_cumulative (struct RateSchedule *rs, int64_t t) {
+    if (t <= 0)
+	return 0;
+    int64_t periods = t / rs->period;
+    int64_t offset = t % rs->period;
+    struct RateSegment *seg = rate_schedule_find(rs, offset);
+    return (periods * rs->period_bits) + seg->bits_before + rate_segment_bits(seg, (double) (offset - seg->start));
+}
+
+double rate_schedule_bits (struct RateSchedule *rs, int64_t t0, int64_t t1) {
+    return rate_schedule_cumulative(rs, t1) - rate_schedule_cumulative(rs, t0);
+}
+
+// The time, t or later, by which the schedule allows another bits to be sent
+int64_t rate_schedule_advance (struct RateSchedule *rs, int64_t t, double bits) {
+    double target = rate_schedule_cumulative(rs, t) + bits;
+    int64_t periods = (int64_t) floor(target / rs->period_bits);
+    double residual = target - (periods * rs->period_bits);
+    // the segment holding the residual, zero rate segments hold none
+    int lo = 0, hi = rs->count - 1;
+    while (lo < hi) {
+	int mid = (lo + hi + 1) / 2;
+	if (rs->segments[mid].bits_before <= residual) {
+	    lo = mid;
+	} else {
+	    hi = mid - 1;
+	}
+    }
+    while ((lo > 0) && (rs->segments[lo].rate_start == 0) && (rs->segments[lo].rate_end == 0))
+	lo--;
+    struct RateSegment *seg = &rs->segments[lo];
+    residual -= seg->bits_before;
+    // solve rate_start x + slope x^2 / 2 = residual for x, in the form
+    // that holds up as the slope goes to zero
+    double slope = (seg->rate_end - seg->rate_start) / seg->duration;
+    double root = sqrt((seg->rate_start * seg->rate_start) + (2.0 * slope * residual * 1e9));
+    double x = ((seg->rate_start + root) > 0) ? ((2.0 * residual * 1e9) / (seg->rate_start + root)) : 0;
+    if (x > seg->duration)
+	x = (double) seg->duration;
+    int64_t next = (periods * rs->period) + seg->start + (int64_t) ceil(x);
+    return ((next > t) ? next : t);
+}
+
+// Segment index, from zero, in effect at t
+int rate_schedule_segment (struct RateSchedule *rs, int64_t t) {
+    return (int) (rate_schedule_find(rs, ((t > 0) ? (t % rs->period) : 0)) - rs->segments);
+}
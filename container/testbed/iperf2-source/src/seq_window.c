@@ -0,0 +1,151 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * seq_window.c
+ * Bitmap reorder window for the UDP server's sequence accounting
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "seq_window.h"
+
+struct SeqWindow *seqwin_alloc (intmax_t tolerance) {
+    struct SeqWindow *sw = (struct SeqWindow *) calloc(1, sizeof(struct SeqWindow));
+    intmax_t size = 64;
+    if (sw == NULL)
+	return NULL;
+    sw->tolerance = ((tolerance > 0) ? tolerance : SEQWINDOW_DEFAULT);
+    while (size <= (sw->tolerance + 1))
+	size <<= 1;
+    sw->mask = size - 1;
+    if ((sw->bits = (uint64_t *) calloc((size >> 6), sizeof(uint64_t))) == NULL) {
+	free(sw);
+	return NULL;
+    }
+    return sw;
+}
+
+void seqwin_free (struct SeqWindow *sw) {
+    if (sw) {
+	free(sw->bits);
+	free(sw);
+    }
+}
+
+static inline int seqwin_popcount (uint64_t x) {
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int) ((x * 0x0101010101010101ULL) >> 56);
+}
+
+// Count and clear the seen bits of sequence numbers lo through hi, no
+// more than the window, a word at a time. The bitmap is whole
+// words so a word's bits never wrap
+static intmax_t seqwin_take (struct SeqWindow *sw, intmax_t lo, intmax_t hi) {
+    intmax_t seen = 0;
+    while (lo <= hi) {
+	intmax_t bit = lo & sw->mask;
+	int shift = (int) (bit & 63);
+	intmax_t n = 64 - shift;
+	if (n > (hi - lo + 1))
+	    n = hi - lo + 1;
+	uint64_t span = ((n == 64) ? ~0ULL : (((1ULL << n) - 1) << shift));
+	uint64_t *word = &sw->bits[bit >> 6];
+	seen += seqwin_popcount(*word & span);
+	*word &= ~span;
+	lo += n;
+    }
+    return seen;
+}
+
+// Classify a datagram, O(1) apart from the word walk when the window
+// slides, which is bounded by the tolerance and amortized over the
+// sequence numbers sliding out
+enum SeqClass seqwin_packet (struct SeqWindow *sw, intmax_t seqno) {
+    // the window is the highest seen and the tolerance behind it
+    intmax_t span = sw->tolerance + 1;
+    uint64_t bit;
+    uint64_t *word;
+    if (seqno > sw->top) {
+	// what's now more than the tolerance behind slides out, unseen is lost
+	intmax_t lo = sw->top - span + 1;
+	intmax_t hi = seqno - span;
+	if (lo < 1)
+	    lo = 1;
+	if (hi >= lo) {
+	    intmax_t inwindow = ((hi < sw->top) ? hi : sw->top);
+	    if (inwindow >= lo)
+		sw->cnt.lost += (inwindow - lo + 1) - seqwin_take(sw, lo, inwindow);
+	    if (hi > sw->top)
+		sw->cnt.lost += hi - sw->top; // a jump past the whole window
+	}
+	sw->bits[(seqno & sw->mask) >> 6] |= (1ULL << (seqno & 63));
+	sw->top = seqno;
+	return SEQ_INORDER;
+    }
+    if (seqno <= (sw->top - span)) {
+	sw->cnt.late++;
+	return SEQ_LATE;
+    }
+    word = &sw->bits[(seqno & sw->mask) >> 6];
+    bit = 1ULL << (seqno & 63);
+    if (*word & bit) {
+	sw->cnt.duplicates++;
+	return SEQ_DUPLICATE;
+    }
+    *word |= bit;
+    sw->cnt.reordered++;
+    sw->cnt.distance += sw->top - seqno;
+    if ((sw->top - seqno) > sw->cnt.distance_max)
+	sw->cnt.distance_max = sw->top - seqno;
+    return SEQ_REORDERED;
+}
+
+// End of traffic, whatever is still missing in the window is lost
+void seqwin_flush (struct SeqWindow *sw) {
+    intmax_t span = sw->tolerance + 1;
+    intmax_t lo = sw->top - span + 1;
+    if (lo < 1)
+	lo = 1;
+    if (sw->top >= lo)
+	sw->cnt.lost += (sw->top - lo + 1) - seqwin_take(sw, lo, sw->top);
+    // anything after the flush is behind the window
+    sw->top += span;
+}
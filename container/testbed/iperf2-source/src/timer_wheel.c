@@ -0,0 +1,246 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * timer_wheel.c
+ * Hierarchical timer wheel run by a few scheduler threads which
+ * release frames for many isochronous and burst flows, see
+ * timer_wheel.h
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "timer_wheel.h"
+#include "delay.h"
+#include "util.h"
+
+static struct timer_wheel *timer_wheels = NULL;
+static int timer_wheel_count = 0;
+static int timer_wheel_next = 0;
+
+static inline uint64_t timer_wheel_now (void) {
+    struct timespec t1;
+#ifdef HAVE_CLOCK_GETTIME
+    clock_gettime(CLOCK_REALTIME, &t1);
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    t1.tv_sec = tv.tv_sec;
+    t1.tv_nsec = tv.tv_usec * 1000;
+#endif
+    return ((((uint64_t) t1.tv_sec * 1000000000) + t1.tv_nsec) / TIMER_WHEEL_TICK_NS);
+}
+
+// Caller holds the wheel lock, expire is after current
+static void timer_wheel_insert (struct timer_wheel *wheel, struct timer_wheel_entry *entry) {
+    uint64_t delta = entry->expire - wheel->current;
+    struct timer_wheel_entry **slot;
+    if (delta < TIMER_WHEEL_ROOTSIZE) {
+	slot = &wheel->root[entry->expire & (TIMER_WHEEL_ROOTSIZE - 1)];
+    } else {
+	int lvl;
+	for (lvl = 0; lvl < (TIMER_WHEEL_LEVELS - 1); lvl++) {
+	    if (delta < (1ULL << (TIMER_WHEEL_ROOTBITS + ((lvl + 1) * TIMER_WHEEL_LEVELBITS))))
+		break;
+	}
+	if (lvl == (TIMER_WHEEL_LEVELS - 1)) {
+	    // beyond the wheel's span, park in the last slot and let it cascade again
+	    lvl--;
+	    entry->expire = wheel->current + (1ULL << (TIMER_WHEEL_ROOTBITS + ((lvl + 1) * TIMER_WHEEL_LEVELBITS))) - 1;
+	}
+	slot = &wheel->level[lvl][(entry->expire >> (TIMER_WHEEL_ROOTBITS + (lvl * TIMER_WHEEL_LEVELBITS))) & (TIMER_WHEEL_LEVELSIZE - 1)];
+    }
+    entry->next = *slot;
+    *slot = entry;
+}
+
+// Move a higher level slot's entries down, returns the slot index
+static int timer_wheel_cascade (struct timer_wheel *wheel, int lvl) {
+    int index = (wheel->current >> (TIMER_WHEEL_ROOTBITS + (lvl * TIMER_WHEEL_LEVELBITS))) & (TIMER_WHEEL_LEVELSIZE - 1);
+    struct timer_wheel_entry *entry = wheel->level[lvl][index];
+    wheel->level[lvl][index] = NULL;
+    while (entry) {
+	struct timer_wheel_entry *next = entry->next;
+	timer_wheel_insert(wheel, entry);
+	wheel->cascaded++;
+	entry = next;
+    }
+    return index;
+}
+
+// Advance one tick moving the due entries onto the fire list
+static void timer_wheel_advance (struct timer_wheel *wheel, struct timer_wheel_entry **fire) {
+    int index = wheel->current & (TIMER_WHEEL_ROOTSIZE - 1);
+    if (!index) {
+	int lvl;
+	for (lvl = 0; lvl < (TIMER_WHEEL_LEVELS - 1); lvl++) {
+	    if (timer_wheel_cascade(wheel, lvl))
+		break;
+	}
+    }
+    struct timer_wheel_entry *entry = wheel->root[index];
+    wheel->root[index] = NULL;
+    while (entry) {
+	struct timer_wheel_entry *next = entry->next;
+	entry->next = *fire;
+	*fire = entry;
+	wheel->count--;
+	wheel->fired++;
+	entry = next;
+    }
+    wheel->ticks++;
+}
+
+#if defined(HAVE_POSIX_THREAD)
+static void *timer_wheel_run (void *arg) {
+    struct timer_wheel *wheel = (struct timer_wheel *) arg;
+    Condition_Lock(wheel->await);
+    while (1) {
+	while (!wheel->count) {
+	    Condition_Wait(&wheel->await);
+	}
+	uint64_t next = (wheel->current + 1) * TIMER_WHEEL_TICK_NS;
+	Condition_Unlock(wheel->await);
+#if defined(HAVE_CLOCK_NANOSLEEP) && defined(TIMER_ABSTIME)
+	struct timespec ts;
+	ts.tv_sec = (time_t) (next / 1000000000);
+	ts.tv_nsec = (long) (next % 1000000000);
+	clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, NULL);
+#else
+	delay_loop(TIMER_WHEEL_TICK_NS / 1000);
+#endif
+	uint64_t now = timer_wheel_now();
+	struct timer_wheel_entry *fire = NULL;
+	Condition_Lock(wheel->await);
+	// catch up on every tick missed while asleep
+	while (wheel->current < now) {
+	    wheel->current++;
+	    timer_wheel_advance(wheel, &fire);
+	}
+	Condition_Unlock(wheel->await);
+	// the entry can be reused by its flow as soon as it's signaled
+	while (fire) {
+	    struct timer_wheel_entry *entry = fire;
+	    fire = entry->next;
+	    Condition_Lock(entry->await);
+	    entry->fired = 1;
+	    Condition_Signal(&entry->await);
+	    Condition_Unlock(entry->await);
+	}
+	Condition_Lock(wheel->await);
+    }
+    return NULL;
+}
+#endif
+
+int timer_wheel_start (int threads) {
+#if defined(HAVE_POSIX_THREAD)
+    int ix;
+    if (timer_wheels)
+	return 0;
+    if (threads < 1)
+	threads = 1;
+    if (threads > TIMER_WHEEL_MAXTHREADS)
+	threads = TIMER_WHEEL_MAXTHREADS;
+    timer_wheels = (struct timer_wheel *) calloc(threads, sizeof(struct timer_wheel));
+    if (!timer_wheels) {
+	fprintf(stderr, "ERROR: timer wheel out of memory\n");
+	return -1;
+    }
+    for (ix = 0; ix < threads; ix++) {
+	pthread_t tid;
+	Condition_Initialize(&timer_wheels[ix].await);
+	timer_wheels[ix].current = timer_wheel_now();
+	if (pthread_create(&tid, NULL, timer_wheel_run, &timer_wheels[ix]) != 0) {
+	    WARN_errno(1, "timer wheel pthread_create");
+	    break;
+	}
+	pthread_detach(tid);
+    }
+    timer_wheel_count = ix;
+    return (ix ? 0 : -1);
+#else
+    fprintf(stderr, "WARN: --tick-scheduler requires threads\n");
+    return -1;
+#endif
+}
+
+struct timer_wheel *timer_wheel_attach (void) {
+    if (!timer_wheel_count)
+	return NULL;
+    int ix = __atomic_fetch_add(&timer_wheel_next, 1, __ATOMIC_RELAXED);
+    return &timer_wheels[ix % timer_wheel_count];
+}
+
+void timer_wheel_entry_init (struct timer_wheel_entry *entry) {
+    memset(entry, 0, sizeof(struct timer_wheel_entry));
+    Condition_Initialize(&entry->await);
+}
+
+void timer_wheel_entry_destroy (struct timer_wheel_entry *entry) {
+    Condition_Destroy(&entry->await);
+}
+
+int timer_wheel_wait (struct timer_wheel *wheel, struct timer_wheel_entry *entry, struct timespec *deadline) {
+    // round up so a frame is never released before its deadline
+    uint64_t ns = ((uint64_t) deadline->tv_sec * 1000000000) + deadline->tv_nsec;
+    entry->expire = (ns + TIMER_WHEEL_TICK_NS - 1) / TIMER_WHEEL_TICK_NS;
+    entry->fired = 0;
+    Condition_Lock(wheel->await);
+    if (!wheel->count) {
+	// an idle wheel stops ticking, bring it up to date
+	uint64_t now = timer_wheel_now();
+	if (now > wheel->current)
+	    wheel->current = now;
+    }
+    if (entry->expire <= wheel->current) {
+	Condition_Unlock(wheel->await);
+	return 0;
+    }
+    timer_wheel_insert(wheel, entry);
+    if (!wheel->count++) {
+	Condition_Signal(&wheel->await);
+    }
+    Condition_Unlock(wheel->await);
+    Condition_Lock(entry->await);
+    while (!entry->fired) {
+	Condition_Wait(&entry->await);
+    }
+    Condition_Unlock(entry->await);
+    return 0;
+}
@@ -0,0 +1,158 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * traffic_profile.cpp
+ * Flow declarations and the shared report clock for --profile
+ * ------------------------------------------------------------------- */
+#include <math.h>
+#include "headers.h"
+#include "Settings.hpp"
+#include "util.h"
+#include "gnu_getopt.h"
+#include "traffic_profile.h"
+
+static struct TrafficProfile the_profile;
+
+// Parse each line of the profile file as the command line less --profile
+// plus the line's options, the line's options parsed last so they win.
+// Returns the first flow with the rest linked by mProfileNext, exits on error.
+struct thread_Settings *traffic_profile_load (int argc, char **argv, struct thread_Settings *common) {
+    const char *filename = common->mProfileStr;
+    struct thread_Settings *head = NULL;
+    struct thread_Settings **tail = &head;
+    char **flowargv = new char *[argc + TRAFFICPROFILE_MAXARGS + 1];
+    char line[1024];
+    int commonargc = 0;
+    int lineno = 0;
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+	fprintf(stderr, "ERROR: --profile %s: %s\n", filename, strerror(errno));
+	exit(1);
+    }
+    for (int ix = 0; ix < argc; ix++) {
+	if (strcmp(argv[ix], "--profile") == 0) {
+	    ix++;
+	} else if (strncmp(argv[ix], "--profile=", 10) != 0) {
+	    flowargv[commonargc++] = argv[ix];
+	}
+    }
+    Mutex_Initialize(&the_profile.lock);
+    while (fgets(line, sizeof(line), fp)) {
+	char *comment = strchr(line, '#');
+	char *saveptr = NULL;
+	lineno++;
+	if (comment)
+	    *comment = '\0';
+	char *name = strtok_r(line, " \t\r\n", &saveptr);
+	if (name == NULL)
+	    continue;
+	int flowargc = commonargc;
+	char *tok;
+	while ((tok = strtok_r(NULL, " \t\r\n", &saveptr)) != NULL) {
+	    if (flowargc == (commonargc + TRAFFICPROFILE_MAXARGS)) {
+		fprintf(stderr, "ERROR: --profile %s line %d has more than %d options\n", filename, lineno, TRAFFICPROFILE_MAXARGS);
+		exit(1);
+	    }
+	    flowargv[flowargc++] = tok;
+	}
+	flowargv[flowargc] = NULL;
+	struct thread_Settings *flow = new thread_Settings;
+	Settings_Initialize(flow);
+	Settings_ParseEnvironment(flow);
+	// gnu_optind of zero restarts the scan on a new argument vector
+	gnu_optind = 0;
+	Settings_ParseCommandLine(flowargc, flowargv, flow);
+	if (flow->mProfileStr != NULL) {
+	    fprintf(stderr, "ERROR: --profile %s line %d, profiles don't nest\n", filename, lineno);
+	    exit(1);
+	}
+	if (flow->mThreadMode != kMode_Client) {
+	    fprintf(stderr, "ERROR: --profile %s line %d, flow %s needs a -c host\n", filename, lineno, name);
+	    exit(1);
+	}
+	flow->mProfileName = new char[strlen(name) + 1];
+	strcpy(flow->mProfileName, name);
+	flow->mProfile = &the_profile;
+	the_profile.flows++;
+	*tail = flow;
+	tail = &flow->mProfileNext;
+    }
+    fclose(fp);
+    DELETE_ARRAY(flowargv);
+    if (head == NULL) {
+	fprintf(stderr, "ERROR: --profile %s has no flows\n", filename);
+	exit(1);
+    }
+    return head;
+}
+
+// Move a flow's report onto the profile clock. The start time becomes the
+// profile origin and the flow's offset from it the start of its first
+// interval, which ends on the shared grid of -i boundaries.
+void traffic_profile_start (struct TrafficProfile *profile, struct ReportTimeStamps *ts, const struct timeval *holdback) {
+    Mutex_Lock(&profile->lock);
+    if (TimeZero(profile->origin)) {
+	// the profile started when the first flow would have without its delay
+	profile->origin = ts->startTime;
+	if (holdback) {
+	    profile->origin.tv_sec -= holdback->tv_sec;
+	    profile->origin.tv_usec -= holdback->tv_usec;
+	    if (profile->origin.tv_usec < 0) {
+		profile->origin.tv_usec += rMillion;
+		profile->origin.tv_sec--;
+	    }
+	}
+    }
+    struct timeval origin = profile->origin;
+    Mutex_Unlock(&profile->lock);
+    double offset = TimeDifference(ts->startTime, origin);
+    if (offset < 0)
+	offset = 0;
+    ts->startTime = origin;
+    ts->tStart = offset;
+    ts->iEnd = offset;
+    if (!TimeZero(ts->intervalTime)) {
+	int64_t interval_us = (int64_t) ts->intervalTime.tv_sec * rMillion + ts->intervalTime.tv_usec;
+	int64_t next_us = ((int64_t) floor(offset * rMillion / interval_us) + 1) * interval_us;
+	ts->nextTime = origin;
+	TimeAddIntUsec(ts->nextTime, next_us);
+    }
+}
@@ -0,0 +1,183 @@
+/*---------------------------------------------------------------
+ * Copyright (c) 2024
+ * Broadcom Corporation
+ * All Rights Reserved.
+ *---------------------------------------------------------------
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software
+ * without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute,
+ * sublicense, and/or sell copies of the Software, and to permit
+ * persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ *
+ * Redistributions of source code must retain the above
+ * copyright notice, this list of conditions and
+ * the following disclaimers.
+ *
+ *
+ * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimers in the documentation and/or other materials
+ * provided with the distribution.
+ *
+ *
+ * Neither the name of Broadcom Coporation,
+ * nor the names of its contributors may be used to endorse
+ * or promote products derived from this Software without
+ * specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE CONTIBUTORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * ________________________________________________________________
+ *
+ * udp_flows.c
+ * Per flow pacing on the client and per flow accounting on the server
+ * for --udp-flows
+ * ------------------------------------------------------------------- */
+#include "headers.h"
+#include "markov.h"
+#include "udp_flows.h"
+
+static inline int64_t udpflows_tx_ipg (struct UDPFlowsTx *tx, int len) {
+    return (int64_t) (tx->pps ? (1e9 / tx->rate) : (len * 8e9 / tx->rate));
+}
+
+struct UDPFlowsTx *udpflows_tx_alloc (int flows, double rate, bool pps, int buflen, int minlen, char *braket) {
+    struct UDPFlowsTx *tx = (struct UDPFlowsTx *) calloc(1, sizeof(struct UDPFlowsTx));
+    if (tx == NULL)
+	return NULL;
+    tx->flows = flows;
+    tx->rate = rate;
+    tx->pps = pps;
+    tx->buflen = buflen;
+    tx->minlen = minlen;
+    tx->heap = (int *) calloc(flows, sizeof(int));
+    tx->next = (int64_t *) calloc(flows, sizeof(int64_t));
+    tx->seqno = (intmax_t *) calloc(flows, sizeof(intmax_t));
+    if (braket)
+	tx->len_graph = (struct markov_graph **) calloc(flows, sizeof(struct markov_graph *));
+    if (!tx->heap || !tx->next || !tx->seqno || (braket && !tx->len_graph)) {
+	udpflows_tx_free(tx);
+	return NULL;
+    }
+    // spread the starts over one gap so the flows don't send in a burst,
+    // ascending so the heap is already in order
+    int64_t ipg = udpflows_tx_ipg(tx, buflen);
+    for (int ix = 0; ix < flows; ix++) {
+	tx->heap[ix] = ix;
+	tx->next[ix] = ipg * ix / flows;
+	if (braket)
+	    tx->len_graph[ix] = markov_graph_init(braket);
+    }
+    return tx;
+}
+
+void udpflows_tx_free (struct UDPFlowsTx *tx) {
+    if (tx) {
+	if (tx->len_graph) {
+	    for (int ix = 0; ix < tx->flows; ix++) {
+		if (tx->len_graph[ix])
+		    markov_graph_free(tx->len_graph[ix]);
+	    }
+	    free(tx->len_graph);
+	}
+	free(tx->heap);
+	free(tx->next);
+	free(tx->seqno);
+	free(tx);
+    }
+}
+
+// A flow's next datagram length, each flow walks its own chain
+int udpflows_tx_len (struct UDPFlowsTx *tx, int flowid) {
+    int len = (tx->len_graph ? markov_graph_next(tx->len_graph[flowid]) : tx->buflen);
+    return ((len < tx->minlen) ? tx->minlen : len);
+}
+
+// Move the flow at the top of the heap, just sent with len bytes, on to
+// its next send time and sift it down, now is ns relative to the start
+void udpflows_tx_advance (struct UDPFlowsTx *tx, int len, int64_t now) {
+    int flowid = tx->heap[0];
+    int64_t next = tx->next[flowid] + udpflows_tx_ipg(tx, len);
+    if (next < (now - UDPFLOWS_MAXLAG))
+	next = now;
+    tx->next[flowid] = next;
+    int ix = 0;
+    for (;;) {
+	int child = 2 * ix + 1;
+	if (child >= tx->flows)
+	    break;
+	if (((child + 1) < tx->flows) && (tx->next[tx->heap[child + 1]] < tx->next[tx->heap[child]]))
+	    child++;
+	if (tx->next[tx->heap[child]] >= next)
+	    break;
+	tx->heap[ix] = tx->heap[child];
+	ix = child;
+    }
+    tx->heap[ix] = flowid;
+}
+
+struct UDPFlowsRx *udpflows_rx_alloc (void) {
+    return (struct UDPFlowsRx *) calloc(1, sizeof(struct UDPFlowsRx));
+}
+
+void udpflows_rx_free (struct UDPFlowsRx *rx) {
+    if (rx) {
+	free(rx->flow);
+	free(rx);
+    }
+}
+
+// Per datagram with a flow record, transit in ns
+void udpflows_rx_packet (struct UDPFlowsRx *rx, uint32_t flowid, intmax_t seqno, intmax_t len, int64_t transit) {
+    if (flowid >= UDPFLOWS_MAX) {
+	rx->unknown++;
+	return;
+    }
+    if ((int) flowid >= rx->slots) {
+	// flows show up in id order, so grow by doubling
+	int slots = (rx->slots ? rx->slots : 64);
+	while (slots <= (int) flowid)
+	    slots *= 2;
+	struct UDPFlow *grow = (struct UDPFlow *) realloc(rx->flow, slots * sizeof(struct UDPFlow));
+	if (grow == NULL) {
+	    rx->unknown++;
+	    return;
+	}
+	memset(grow + rx->slots, 0, (slots - rx->slots) * sizeof(struct UDPFlow));
+	rx->flow = grow;
+	rx->slots = slots;
+    }
+    if ((int) flowid >= rx->flows)
+	rx->flows = flowid + 1;
+    struct UDPFlow *flow = &rx->flow[flowid];
+    if (seqno > flow->top) {
+	flow->cnt.lost += seqno - flow->top - 1;
+	flow->top = seqno;
+    } else {
+	flow->cnt.reordered++;
+	if (flow->cnt.lost > 0)
+	    flow->cnt.lost--;
+    }
+    if (flow->cnt.packets) {
+	int64_t delta = transit - flow->transit;
+	flow->jitter += ((double) ((delta < 0) ? -delta : delta) - flow->jitter) / 16.0;
+    }
+    flow->transit = transit;
+    flow->cnt.packets++;
+    flow->cnt.bytes += len;
+}
+
+void udpflows_rx_next_interval (struct UDPFlowsRx *rx) {
+    for (int ix = 0; ix < rx->flows; ix++)
+	rx->flow[ix].prev = rx->flow[ix].cnt;
+}
@@ -18,12 +18,14 @@ run_iperf() {
     server=(-s)
     client=(-c)
     match=""
+    regex=""
     # Split server and client args lists
     while [ $# -gt 0 ]; do
 	case $1 in
 	    (-c) mode=client;;
 	    (-s) mode=server;;
 	    (-match) shift; match=$1;;
+	    (-regex) shift; regex=$1;;
 	    (*)
 		case $mode in
 		    (server) server+=($1);;
@@ -49,5 +51,8 @@ run_iperf() {
     if [[ -n "$match" && ! ("$results" =~ "$match") ]]; then
        exit 1
     fi
+    if [[ -n "$regex" && ! ("$results" =~ $regex) ]]; then
+       exit 1
+    fi
     exit 0
 }
@@ -0,0 +1,14 @@
+#!/bin/bash -e
+. $(dirname $0)/base.sh
+
+# usage:
+# run_iperf -s server args   -c client args
+#
+# client args should contain $ip or -V $ip6
+# results returned in $results
+
+# a 10 ms emulated delay should show as about 10 ms of latency
+run_iperf    \
+    -regex "\(0%\) (9\.9|10\.[01])[0-9]*/" \
+    -s -P 1 -u -i 1 -t 3 -e --link-emul delay=10ms    \
+    -c $ip -P 1 -u -b 1m -i 1 -t 2 --trip-times
@@ -0,0 +1,14 @@
+#!/bin/bash -e
+. $(dirname $0)/base.sh
+
+# usage:
+# run_iperf -s server args   -c client args
+#
+# client args should contain $ip or -V $ip6
+# results returned in $results
+
+# emulated jitter reorders datagrams, which the window shouldn't count as lost
+run_iperf    \
+    -regex "0/[0-9]+ \(0%\).*reorder-window: reordered=[1-9]" \
+    -s -P 1 -u -i 1 -t 3 -e --reorder-window --link-emul delay=10ms,jitter=5ms    \
+    -c $ip -P 1 -u -b 10m -i 1 -t 2
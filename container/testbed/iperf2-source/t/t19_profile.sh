@@ -0,0 +1,18 @@
+#!/bin/bash -e
+. $(dirname $0)/base.sh
+
+# usage:
+# run_iperf -s server args   -c client args
+#
+# client args should contain $ip or -V $ip6
+# results returned in $results
+
+profile=$(mktemp)
+trap "rm -f $profile" EXIT
+printf '# a voip flow alongside a bulk one\nvoip -u -b 64k -l 200\nbulk -u -b 2m\n' > $profile
+
+# both flows should report under their names
+run_iperf    \
+    -regex "\[voip\([0-9]+\)\].*\[bulk\([0-9]+\)\]|\[bulk\([0-9]+\)\].*\[voip\([0-9]+\)\]" \
+    -s -P 2 -u -i 1 -t 3 -e    \
+    -c $ip -i 1 -t 2 --profile $profile
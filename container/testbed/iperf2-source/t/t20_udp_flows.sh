@@ -0,0 +1,13 @@
+#!/bin/bash -e
+. $(dirname $0)/base.sh
+
+# usage:
+# run_iperf -s server args   -c client args
+#
+# client args should contain $ip or -V $ip6
+# results returned in $results
+
+run_iperf    \
+    -match "udp-flows: 4/4 active" \
+    -s -P 1 -u -i 1 -t 3 -e    \
+    -c $ip -P 1 -u -b 1m -i 1 -t 2 -l 200 --udp-flows 4